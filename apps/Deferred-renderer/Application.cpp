@@ -1,12 +1,21 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
 #include <iostream>
 #include <unordered_set>
 #include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstddef>
+#include <cassert>
 
 #include <imgui.h>
-#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/Image2D.hpp>
 #include <glmlv/scene_loading.hpp>
+#include <glmlv/ShaderVariants.hpp>
+#include <glmlv/ProgramBuilder.hpp>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -23,77 +32,196 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
+
+		m_GLState.beginFrame(); // ImGui bound its own objects at the end of the previous frame
+		m_GPUProfiler.beginFrame();
 
 		// Geometry pass
 		{
-			program.use();
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
+			const bool occlusionCulling = m_SubmitMode == SubmitMode::GPUCulling && m_bOcclusionCulling && !m_shapes.empty();
+			glmlv::GPUProfiler::Scope profilerScope(m_GPUProfiler, occlusionCulling ? "Geometry pass (occlusion culling)" : "Geometry pass");
+
+			m_GLState.useProgram(program.glId());
+			m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
 
 			glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			const auto projMatrix = glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight, 0.01f * m_SceneSize, m_SceneSize);
+			const auto zNear = 0.01f * m_SceneSize;
+			const auto zFar = m_SceneSize;
+			const auto projMatrix = glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight, zNear, zFar);
 			const auto viewMatrix = viewController.getViewMatrix();
+			const auto viewProjMatrix = projMatrix * viewMatrix;
+
+			if (m_SubmitMode == SubmitMode::GPUCulling)
+			{
+				GLMLV_PROFILE_SCOPE("GPU culling");
+
+				const auto frustum = glmlv::extractFrustumPlanes(viewProjMatrix);
+				const auto cameraPosition = glm::vec3(viewController.getRcpViewMatrix()[3]);
+				const bool compact = m_bUseIndirectCount && glMultiDrawElementsIndirectCount;
+
+				m_GLState.useProgram(m_CullProgram.glId());
+				glUniform4fv(m_uFrustumPlanesLocation, 6, glm::value_ptr(frustum.planes[0]));
+				glUniform3fv(m_uCameraPositionLocation, 1, glm::value_ptr(cameraPosition));
+				glUniform1ui(m_uObjectCountLocation, GLuint(m_shapes.size()));
+				glUniform1i(m_uFrustumCullingLocation, m_bFrustumCulling);
+				glUniform1i(m_uConeCullingLocation, m_bConeCulling);
+				glUniform1i(m_uCompactLocation, compact);
+
+				if (!m_bOcclusionCulling)
+					m_bHiZValid = false;
+
+				if (occlusionCulling)
+				{
+					// The slot of this frame was last written OcclusionStatsFrameCount frames ago: read it if the GPU is done with it
+					const auto slot = m_nOcclusionStatsFrame % OcclusionStatsFrameCount;
+					auto & fence = m_OcclusionStatsFences[slot];
+					if (fence)
+					{
+						const auto status = glClientWaitSync(fence, 0, 0);
+						if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+							m_LastOcclusionStats = m_pOcclusionStats[slot];
+						glDeleteSync(fence);
+						fence = nullptr;
+					}
+					glClearNamedBufferSubData(m_OcclusionStats.glId(), GL_R32UI, GLintptr(slot * sizeof(OcclusionStats)), sizeof(OcclusionStats), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+					glUniform1i(m_uHiZValidLocation, m_bHiZValid);
+					glUniform1ui(m_uStatsOffsetLocation, GLuint(slot * sizeof(OcclusionStats) / sizeof(uint32_t)));
+				}
+
+				if (!m_shapes.empty())
+					cullDraws(occlusionCulling ? 1 : 0, m_PreviousViewProjMatrix, m_CulledCommands, m_DrawCount);
+
+				m_GLState.useProgram(program.glId());
+			}
+			else
+			{
+				GLMLV_PROFILE_SCOPE("Render queue");
+
+				if (m_bFrustumCulling)
+				{
+					m_CullingStats = glmlv::cullFrustum(m_ShapeBounds, projMatrix * viewMatrix, m_ShapeVisibility);
+				}
+				else
+				{
+					m_CullingStats = glmlv::CullingStats();
+					m_CullingStats.visibleCount = m_shapes.size();
+				}
+
+				m_RenderQueue.clear();
+				for (size_t i = 0; i < m_shapes.size(); ++i)
+				{
+					if (m_bFrustumCulling && !m_ShapeVisibility[i])
+						continue;
+
+					uint32_t depth = 0;
+					if (m_bSortFrontToBack)
+					{
+						// Distance to the nearest point of the bounding sphere along the view axis
+						const auto & shape = m_shapes[i];
+						const auto viewDepth = -(viewMatrix * glm::vec4(shape.boundingSphereCenter, 1)).z - shape.boundingSphereRadius;
+						depth = glmlv::RenderQueue::quantizeDepth(viewDepth, zNear, zFar);
+					}
+					m_RenderQueue.push(glmlv::RenderQueue::makeKey(0, 0, 0, depth, 0), uint32_t(i));
+				}
+				m_RenderQueue.sort();
+			}
 
-			const auto modelMatrix = glm::mat4(1);
+			// Transforms are applied by the vertex shader from the per draw data: only the camera is set per frame
+			glUniformMatrix4fv(uViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+			glUniformMatrix4fv(uProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(projMatrix));
 
-			const auto mvMatrix = viewMatrix * modelMatrix;
-			const auto mvpMatrix = projMatrix * mvMatrix;
-			const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
+			// Texture array i is bound to unit i for the whole frame, with the same sampler for all units
+			const auto textureArrayCount = GLuint(m_TexturePacker.arrays().size());
+			assert(textureArrayCount <= glmlv::TexturePackerOptions::DefaultMaxArrayCount); // Length of uTextureArrays, enforced by the packer
+			for (GLuint i = 0; i < textureArrayCount; ++i)
+			{
+				m_GLState.bindTexture(i, m_TexturePacker.arrays()[i].glId);
+				m_GLState.bindSampler(i, textureSampler);
+			}
+
+			m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataStorageBinding, m_DrawData.glId());
+			m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialStorageBinding, m_MaterialStorage.glId());
 
-			glUniformMatrix4fv(uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-			glUniformMatrix4fv(uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-			glUniformMatrix4fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+			m_GLState.bindVertexArray(vaoObjModel);
 
-			// Same sampler for all texture units
-			glBindSampler(0, textureSampler);
-			glBindSampler(1, textureSampler);
-			glBindSampler(2, textureSampler);
-			glBindSampler(3, textureSampler);
+			if (m_SubmitMode == SubmitMode::MultiDrawIndirect)
+			{
+				GLMLV_PROFILE_SCOPE("Multi-draw indirect");
 
-			// Set texture unit of each sampler
-			glUniform1i(uKaSamplerLocation, 0);
-			glUniform1i(uKdSamplerLocation, 1);
-			glUniform1i(uKsSamplerLocation, 2);
-			glUniform1i(uShininessSamplerLocation, 3);
+				m_DrawCommandsData.clear();
+				for (const auto & draw : m_RenderQueue.draws())
+				{
+					const auto & shape = m_shapes[draw.payload];
+					glmlv::DrawElementsIndirectCommand command;
+					command.count = shape.indexCount;
+					command.firstIndex = shape.indexOffset;
+					command.baseInstance = draw.payload;
+					m_DrawCommandsData.emplace_back(command);
+				}
 
-			const auto bindMaterial = [&](const PhongMaterial & material)
+				if (!m_DrawCommandsData.empty())
+				{
+					m_DrawCommands.setSubData(0, GLsizeiptr(m_DrawCommandsData.size() * sizeof(glmlv::DrawElementsIndirectCommand)), m_DrawCommandsData.data());
+					m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_DrawCommands.glId());
+					glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(m_DrawCommandsData.size()), 0);
+					m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+				}
+			}
+			else if (m_SubmitMode == SubmitMode::GPUCulling)
 			{
-				glUniform3fv(uKaLocation, 1, glm::value_ptr(material.Ka));
-				glUniform3fv(uKdLocation, 1, glm::value_ptr(material.Kd));
-				glUniform3fv(uKsLocation, 1, glm::value_ptr(material.Ks));
-				glUniform1fv(uShininessLocation, 1, &material.shininess);
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, material.KaTextureId);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, material.KdTextureId);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, material.KsTextureId);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, material.shininessTextureId);
-			};
-
-			glBindVertexArray(vaoObjModel);
-
-			const PhongMaterial * currentMaterial = nullptr;
-
-			// We draw each shape by specifying how much indices it carries, and with an offset in the global index buffer
-			for (const auto shape : m_shapes)
+				GLMLV_PROFILE_SCOPE("Multi-draw indirect count");
+
+				if (!m_shapes.empty())
+				{
+					glmlv::GPUProfiler::Scope phaseScope(m_GPUProfiler, "Phase 1");
+					drawCulledCommands(m_CulledCommands, m_DrawCount);
+				}
+
+				if (occlusionCulling)
+				{
+					// Without a pyramid phase 1 has drawn everything in the frustum, there is nothing left for phase 2
+					if (m_bHiZValid)
+					{
+						glmlv::GPUProfiler::Scope phaseScope(m_GPUProfiler, "Phase 2");
+						buildHiZPyramid();
+						cullDraws(2, viewProjMatrix, m_LateCommands, m_LateDrawCount);
+						m_GLState.useProgram(program.glId());
+						drawCulledCommands(m_LateCommands, m_LateDrawCount);
+					}
+
+					// Pyramid of the complete depth buffer, tested by phase 1 of the next frame
+					{
+						glmlv::GPUProfiler::Scope pyramidScope(m_GPUProfiler, "Hi-Z pyramid");
+						buildHiZPyramid();
+					}
+					m_bHiZValid = true;
+					m_PreviousViewProjMatrix = viewProjMatrix;
+
+					// The counters are read back by the CPU once the fence is signaled
+					glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+					m_OcclusionStatsFences[m_nOcclusionStatsFrame % OcclusionStatsFrameCount] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+					++m_nOcclusionStatsFrame;
+				}
+			}
+			else
 			{
-				const auto & material = shape.materialID >= 0 ? m_SceneMaterials[shape.materialID] : m_DefaultMaterial;
-				if (currentMaterial != &material)
+				GLMLV_PROFILE_SCOPE("Draw per shape");
+				// We draw each shape by specifying how much indices it carries, and with an offset in the global index buffer.
+				// baseInstance selects the per draw data, as in the indirect commands.
+				for (const auto & draw : m_RenderQueue.draws())
 				{
-					bindMaterial(material);
-					currentMaterial = &material;
+					const auto & shape = m_shapes[draw.payload];
+					glDrawElementsInstancedBaseInstance(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, (const GLvoid*)(shape.indexOffset * sizeof(GLuint)), 1, draw.payload);
 				}
-				glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, (const GLvoid*)(shape.indexOffset * sizeof(GLuint)));
 			}
 
-			for (GLuint i : {0, 1, 2, 3})
-				glBindSampler(0, textureSampler);
+			for (GLuint i = 0; i < textureArrayCount; ++i)
+				m_GLState.bindSampler(i, 0);
 
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		}
 
 
@@ -103,17 +231,18 @@ int Application::run()
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO);
+		m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO);
         glReadBuffer(GL_COLOR_ATTACHMENT0 + m_CurrentlyDisplayed);
         glBlitFramebuffer(0, 0, m_nWindowWidth, m_nWindowHeight,
             0, 0, m_nWindowWidth, m_nWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
         // GUI code:
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -121,12 +250,51 @@ int Application::run()
 				glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.f);
 			}
 
-			if (ImGui::Button("Sort shapes wrt materialID"))
+			if (ImGui::RadioButton("One draw per shape", m_SubmitMode == SubmitMode::PerShape))
+				m_SubmitMode = SubmitMode::PerShape;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Multi-draw indirect", m_SubmitMode == SubmitMode::MultiDrawIndirect))
+				m_SubmitMode = SubmitMode::MultiDrawIndirect;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("GPU culling", m_SubmitMode == SubmitMode::GPUCulling))
+				m_SubmitMode = SubmitMode::GPUCulling;
+
+			ImGui::Checkbox("Frustum culling", &m_bFrustumCulling);
+			if (m_SubmitMode == SubmitMode::GPUCulling)
 			{
-				std::sort(begin(m_shapes), end(m_shapes), [&](auto lhs, auto rhs)
+				// The commands are appended in the order the invocations finish: no sorting in this mode
+				ImGui::Checkbox("Back-face cone culling", &m_bConeCulling);
+				if (glMultiDrawElementsIndirectCount)
+					ImGui::Checkbox("Use indirect count", &m_bUseIndirectCount);
+				else
+					ImGui::Text("No indirect count support: culled commands are drawn with 0 instances");
+
+				ImGui::Checkbox("Hi-Z occlusion culling", &m_bOcclusionCulling);
+				if (m_bOcclusionCulling)
+				{
+					const auto & stats = m_LastOcclusionStats;
+					ImGui::Text("Phase 1: %u drawn, %u occluded in the previous frame", stats.earlyDrawCount, stats.earlyOccludedCount);
+					ImGui::Text("Phase 2: %u drawn, %u still occluded", stats.lateDrawCount, stats.earlyOccludedCount - stats.lateDrawCount);
+					ImGui::Text("Frustum / back-face culled: %u", stats.culledCount);
+				}
+
+				// Both sections only hold frames of their own setting: toggle occlusion culling to compare them
+				double withOcclusionMs = 0., withoutOcclusionMs = 0.;
+				for (const auto & section : m_GPUProfiler.getStats())
 				{
-					return lhs.materialID < rhs.materialID;
-				});
+					if (section.depth == 1 && section.sampleCount && section.name == "Geometry pass (occlusion culling)")
+						withOcclusionMs = section.averageMs;
+					else if (section.depth == 1 && section.sampleCount && section.name == "Geometry pass")
+						withoutOcclusionMs = section.averageMs;
+				}
+				if (withOcclusionMs > 0. && withoutOcclusionMs > 0.)
+					ImGui::Text("Geometry pass: %.3f ms, %.3f ms without occlusion culling (%.3f ms saved)", withOcclusionMs, withoutOcclusionMs, withoutOcclusionMs - withOcclusionMs);
+			}
+			else
+			{
+				ImGui::Text("Camera: %zu visible, %zu culled", m_CullingStats.visibleCount, m_CullingStats.culledCount);
+				ImGui::Checkbox("Sort draws front to back", &m_bSortFrontToBack);
+				ImGui::Text("Render queue: %zu draws, %zu radix passes", m_RenderQueue.size(), m_RenderQueue.lastSortPassCount());
 			}
 
 			if (ImGui::CollapsingHeader("GBuffer"))
@@ -138,11 +306,47 @@ int Application::run()
 				}
 			}
 
+			if (ImGui::CollapsingHeader("GPU profiler"))
+			{
+				m_GPUProfiler.drawGUI();
+				if (ImGui::Button("Clear history"))
+					m_GPUProfiler.clearHistory();
+			}
+
+			if (ImGui::CollapsingHeader("GL state"))
+			{
+				m_GLState.drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL calls"))
+			{
+				glmlv::drawGLCallStatsGUI(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gl_calls.json"));
+			}
+
+			if (ImGui::CollapsingHeader("GPU memory"))
+			{
+				glmlv::GPUMemoryLedger::get().drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL trace"))
+			{
+				if (glmlv::isGLCommandTraceCapturePending())
+				{
+					ImGui::Text("Capturing...");
+				}
+				else if (ImGui::Button("Capture next frame"))
+				{
+					glmlv::requestGLCommandTraceCapture(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gltrace"));
+				}
+			}
+
             ImGui::End();
         }
 
 		glmlv::imguiRenderFrame();
 
+		m_GPUProfiler.endFrame();
+
         glfwPollEvents(); // Poll for and process events
 
         auto ellapsedTime = glfwGetTime() - seconds;
@@ -155,6 +359,8 @@ int Application::run()
 		m_GLFWHandle.swapBuffers(); // Swap front and back buffers
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
@@ -164,15 +370,29 @@ Application::Application(int argc, char** argv):
     m_ImGuiIniFilename { m_AppName + ".imgui.ini" },
     m_ShadersRootPath { m_AppPath.parent_path() / "shaders" }
 {
+	// The C++ structs uploaded to the storage buffers must match the std430 structs of geometryPass.vs.glsl / geometryPass.fs.glsl
+	static_assert(PhongMaterialLayout::matches({ offsetof(PhongMaterial, Ka), offsetof(PhongMaterial, KaArray),
+	    offsetof(PhongMaterial, Kd), offsetof(PhongMaterial, KdArray), offsetof(PhongMaterial, Ks), offsetof(PhongMaterial, KsArray),
+	    offsetof(PhongMaterial, shininess), offsetof(PhongMaterial, shininessArray), offsetof(PhongMaterial, layers),
+	    offsetof(PhongMaterial, KaUVTransform), offsetof(PhongMaterial, KdUVTransform), offsetof(PhongMaterial, KsUVTransform),
+	    offsetof(PhongMaterial, shininessUVTransform) }, sizeof(PhongMaterial)),
+	    "PhongMaterial does not match the std430 struct PhongMaterial");
+	static_assert(DrawDataLayout::matches({ offsetof(DrawData, localToWorldMatrix), offsetof(DrawData, localToWorldNormalMatrix),
+	    offsetof(DrawData, materialIndex) }, sizeof(DrawData)),
+	    "DrawData does not match the std430 struct DrawData");
+	static_assert(ObjectBoundsLayout::matches({ offsetof(ObjectBounds, centerRadius), offsetof(ObjectBounds, extent),
+	    offsetof(ObjectBounds, coneAxisSin) }, sizeof(ObjectBounds)),
+	    "ObjectBounds does not match the std430 struct ObjectBounds");
+
 	if (argc < 2)
 	{
-		std::cerr << "Usage: " << argv[0] << " < path to model >" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " < path to model > [--max-texture-size <pixels>] [--texture-budget <megabytes>]" << std::endl;
 		exit(-1);
 	}
 
 	ImGui::GetIO().IniFilename = m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows positions in this file
 
-	initScene(glmlv::fs::path{ argv[1] });
+	initScene(glmlv::fs::path{ argv[1] }, glmlv::parseTextureLoadOptions(argc, argv));
 	initShadersData();
 
 	glEnable(GL_DEPTH_TEST);
@@ -180,21 +400,19 @@ Application::Application(int argc, char** argv):
     viewController.setSpeed(m_SceneSize * 0.1f); // Let's travel 10% of the scene per second
 
 	// Init GBuffer
-	glGenTextures(GBufferTextureCount, m_GBufferTextures);
-
 	for (int32_t i = GPosition; i < GBufferTextureCount; ++i)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[i]);
-		glTexStorage2D(GL_TEXTURE_2D, 1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
+		m_GBufferTextures[i].setStorage2D(1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
+		glmlv::GPUMemoryLedger::get().setCategory(glmlv::GPUMemoryLedger::ResourceType::Texture, m_GBufferTextures[i].glId(), glmlv::GPUMemoryLedger::Category::RenderTarget);
 	}
 
 	glGenFramebuffers(1, &m_GBufferFBO);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
 	for (int32_t i = GPosition; i < GDepth; ++i)
 	{
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_GBufferTextures[i], 0);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_GBufferTextures[i].glId(), 0);
 	}
-	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_GBufferTextures[GDepth], 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_GBufferTextures[GDepth].glId(), 0);
 
 	// we will write into 5 textures from the fragment shader
 	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
@@ -208,16 +426,29 @@ Application::Application(int argc, char** argv):
 	}
 
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	// Hi-Z pyramid of the GBuffer depth for the occlusion culling, with the sizes of the usual mip chain
+	m_nHiZLevelCount = 1 + GLsizei(std::floor(std::log2(float(std::max(m_nWindowWidth, m_nWindowHeight)))));
+	m_HiZTexture.setStorage2D(m_nHiZLevelCount, GL_R32F, m_nWindowWidth, m_nWindowHeight);
+	glmlv::GPUMemoryLedger::get().setCategory(glmlv::GPUMemoryLedger::ResourceType::Texture, m_HiZTexture.glId(), glmlv::GPUMemoryLedger::Category::RenderTarget);
 }
 
-void Application::initScene(const glmlv::fs::path & objPath)
+Application::~Application()
+{
+	for (auto & fence : m_OcclusionStatsFences)
+		glDeleteSync(fence);
+}
+
+void Application::initScene(const glmlv::fs::path & objPath, const glmlv::TextureLoadOptions & textureOptions)
 {
 	glGenBuffers(1, &vboObjModel);
 	glGenBuffers(1, &iboObjModel);
 
+	std::vector<ObjectBounds> objectBounds; // Filled while the scene data is loaded, uploaded with the other per shape buffers
+
 	{
 		glmlv::SceneData data;
-		loadObjScene(objPath, data);
+		loadObjScene(objPath, data, true, textureOptions);
 		m_SceneSize = glm::length(data.bboxMax - data.bboxMin);
 
 		std::cout << "# of shapes    : " << data.shapeCount << std::endl;
@@ -228,11 +459,13 @@ void Application::initScene(const glmlv::fs::path & objPath)
 		// Fill VBO
 		glBindBuffer(GL_ARRAY_BUFFER, vboObjModel);
 		glBufferStorage(GL_ARRAY_BUFFER, data.vertexBuffer.size() * sizeof(glmlv::Vertex3f3f2f), data.vertexBuffer.data(), 0);
+		glmlv::GPUMemoryLedger::get().registerBuffer(vboObjModel, data.vertexBuffer.size() * sizeof(glmlv::Vertex3f3f2f), glmlv::GPUMemoryLedger::Category::VertexIndex);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		// Fill IBO
 		glBindBuffer(GL_ARRAY_BUFFER, iboObjModel);
 		glBufferStorage(GL_ARRAY_BUFFER, data.indexBuffer.size() * sizeof(uint32_t), data.indexBuffer.data(), 0);
+		glmlv::GPUMemoryLedger::get().registerBuffer(iboObjModel, data.indexBuffer.size() * sizeof(uint32_t), glmlv::GPUMemoryLedger::Category::VertexIndex);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		// Init shape infos
@@ -244,53 +477,128 @@ void Application::initScene(const glmlv::fs::path & objPath)
 			shape.indexCount = data.indexCountPerShape[shapeID];
 			shape.indexOffset = indexOffset;
 			shape.materialID = data.materialIDPerShape[shapeID];
+			shape.localToWorldMatrix = data.localToWorldMatrixPerShape[shapeID];
 			indexOffset += shape.indexCount;
+
+			// Sphere around the world space box of the corners of the local bounding box
+			auto worldBBoxMin = glm::vec3(std::numeric_limits<float>::max());
+			auto worldBBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
+			for (auto corner = 0; corner < 8; ++corner)
+			{
+				const auto localCorner = glm::vec3(corner & 1 ? data.bboxMaxPerShape[shapeID].x : data.bboxMinPerShape[shapeID].x,
+					corner & 2 ? data.bboxMaxPerShape[shapeID].y : data.bboxMinPerShape[shapeID].y,
+					corner & 4 ? data.bboxMaxPerShape[shapeID].z : data.bboxMinPerShape[shapeID].z);
+				const auto worldCorner = glm::vec3(shape.localToWorldMatrix * glm::vec4(localCorner, 1));
+				worldBBoxMin = glm::min(worldBBoxMin, worldCorner);
+				worldBBoxMax = glm::max(worldBBoxMax, worldCorner);
+			}
+			shape.boundingSphereCenter = 0.5f * (worldBBoxMin + worldBBoxMax);
+			shape.boundingSphereRadius = 0.5f * glm::length(worldBBoxMax - worldBBoxMin);
+			m_ShapeBounds.push(worldBBoxMin, worldBBoxMax);
+
+			const auto normalCone = glmlv::computeNormalCone(data.vertexBuffer, data.indexBuffer.data() + shape.indexOffset, shape.indexCount, shape.localToWorldMatrix);
+			ObjectBounds bounds;
+			bounds.centerRadius = glm::vec4(shape.boundingSphereCenter, shape.boundingSphereRadius);
+			bounds.extent = glm::vec4(0.5f * (worldBBoxMax - worldBBoxMin), 0);
+			bounds.coneAxisSin = glm::vec4(normalCone.axis, normalCone.sinHalfAngle);
+			objectBounds.emplace_back(bounds);
 		}
+		m_RenderQueue.reserve(m_shapes.size());
 
-		glGenTextures(1, &m_WhiteTexture);
-		glBindTexture(GL_TEXTURE_2D, m_WhiteTexture);
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, 1, 1);
-		glm::vec4 white(1.f, 1.f, 1.f, 1.f);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_FLOAT, &white);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// A white 1x1 texture for materials without texture, R8 is expanded to (1, 1, 1, 1) by the swizzle mask
+		glmlv::Image2DR8 white(1, 1);
+		white.data()[0] = 255;
+		data.textures.emplace_back(std::move(white));
 
-		// Upload all textures to the GPU
-		std::vector<GLint> textureIds;
-		for (const auto & texture : data.textures)
+		// Upload all textures to the GPU, packed in a few texture arrays so that the whole scene is drawn without texture binds
+		// Each texture keeps the format of its file (e.g. R8 for grayscale masks), the swizzle mask expands it to RGBA for the shaders
+		const auto textureRefs = m_TexturePacker.pack(data.textures);
+		const auto whiteTexture = textureRefs.back();
+
+		// Images that failed to load are not packed
+		const auto getTextureRef = [&](int32_t textureId)
 		{
-			GLuint texId = 0;
-			glGenTextures(1, &texId);
-			glBindTexture(GL_TEXTURE_2D, texId);
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, texture.width(), texture.height());
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.width(), texture.height(), GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-			glBindTexture(GL_TEXTURE_2D, 0);
-
-			textureIds.emplace_back(texId);
-		}
+			return textureId >= 0 && textureRefs[textureId].arrayIndex >= 0 ? textureRefs[textureId] : whiteTexture;
+		};
 
-		for (const auto & material : data.materials)
+		std::vector<PhongMaterial> materials;
+		const auto addMaterial = [&](glm::vec3 Ka, glm::vec3 Kd, glm::vec3 Ks, float shininess, int32_t KaTextureId, int32_t KdTextureId, int32_t KsTextureId, int32_t shininessTextureId)
 		{
+			const auto KaTexture = getTextureRef(KaTextureId), KdTexture = getTextureRef(KdTextureId), KsTexture = getTextureRef(KsTextureId), shininessTexture = getTextureRef(shininessTextureId);
+
 			PhongMaterial newMaterial;
-			newMaterial.Ka = material.Ka;
-			newMaterial.Kd = material.Kd;
-			newMaterial.Ks = material.Ks;
-			newMaterial.shininess = material.shininess;
-			newMaterial.KaTextureId = material.KaTextureId >= 0 ? textureIds[material.KaTextureId] : m_WhiteTexture;
-			newMaterial.KdTextureId = material.KdTextureId >= 0 ? textureIds[material.KdTextureId] : m_WhiteTexture;
-			newMaterial.KsTextureId = material.KsTextureId >= 0 ? textureIds[material.KsTextureId] : m_WhiteTexture;
-			newMaterial.shininessTextureId = material.shininessTextureId >= 0 ? textureIds[material.shininessTextureId] : m_WhiteTexture;
-
-			m_SceneMaterials.emplace_back(newMaterial);
+			newMaterial.Ka = Ka;
+			newMaterial.Kd = Kd;
+			newMaterial.Ks = Ks;
+			newMaterial.shininess = shininess;
+			newMaterial.KaArray = KaTexture.arrayIndex;
+			newMaterial.KdArray = KdTexture.arrayIndex;
+			newMaterial.KsArray = KsTexture.arrayIndex;
+			newMaterial.shininessArray = shininessTexture.arrayIndex;
+			newMaterial.layers = glm::ivec4(KaTexture.layer, KdTexture.layer, KsTexture.layer, shininessTexture.layer);
+			newMaterial.KaUVTransform = glm::vec4(KaTexture.uvScale, KaTexture.uvOffset);
+			newMaterial.KdUVTransform = glm::vec4(KdTexture.uvScale, KdTexture.uvOffset);
+			newMaterial.KsUVTransform = glm::vec4(KsTexture.uvScale, KsTexture.uvOffset);
+			newMaterial.shininessUVTransform = glm::vec4(shininessTexture.uvScale, shininessTexture.uvOffset);
+			materials.emplace_back(newMaterial);
+		};
+
+		for (const auto & material : data.materials) {
+			addMaterial(material.Ka, material.Kd, material.Ks, material.shininess, material.KaTextureId, material.KdTextureId, material.KsTextureId, material.shininessTextureId);
+		}
+
+		m_DefaultMaterialIndex = int32_t(materials.size());
+		addMaterial(glm::vec3(0), glm::vec3(1), glm::vec3(1), 32.f, -1, -1, -1, -1);
+
+		m_MaterialStorage.setStorage(GLsizeiptr(materials.size() * sizeof(PhongMaterial)), materials.data());
+	}
+
+	// Draw index read by the vertex shader: one value per instance, each draw reads element baseInstance
+	if (!m_shapes.empty())
+	{
+		std::vector<uint32_t> drawIndices(m_shapes.size());
+		std::iota(begin(drawIndices), end(drawIndices), 0u);
+		m_DrawIndices.setStorage(GLsizeiptr(drawIndices.size() * sizeof(uint32_t)), drawIndices.data());
+		glmlv::GPUMemoryLedger::get().setCategory(glmlv::GPUMemoryLedger::ResourceType::Buffer, m_DrawIndices.glId(), glmlv::GPUMemoryLedger::Category::VertexIndex);
+
+		// Per draw data is indexed by shape, it does not depend on the order of the commands
+		std::vector<DrawData> drawData;
+		for (const auto & shape : m_shapes)
+		{
+			DrawData data;
+			data.localToWorldMatrix = shape.localToWorldMatrix;
+			data.localToWorldNormalMatrix = glm::transpose(glm::inverse(shape.localToWorldMatrix));
+			data.materialIndex = shape.materialID >= 0 ? shape.materialID : m_DefaultMaterialIndex;
+			drawData.emplace_back(data);
 		}
+		m_DrawData = glmlv::GLBuffer(drawData);
+
+		m_DrawCommands.setStorage(GLsizeiptr(m_shapes.size() * sizeof(glmlv::DrawElementsIndirectCommand)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		m_DrawCommandsData.reserve(m_shapes.size());
 
-		m_DefaultMaterial.Ka = glm::vec3(0);
-		m_DefaultMaterial.Kd = glm::vec3(1);
-		m_DefaultMaterial.Ks = glm::vec3(1);
-		m_DefaultMaterial.shininess = 32.f;
-		m_DefaultMaterial.KaTextureId = m_WhiteTexture;
-		m_DefaultMaterial.KdTextureId = m_WhiteTexture;
-		m_DefaultMaterial.KsTextureId = m_WhiteTexture;
-		m_DefaultMaterial.shininessTextureId = m_WhiteTexture;
+		// Input of the GPU culling: the same commands as MultiDrawIndirect, in shape order
+		std::vector<glmlv::DrawElementsIndirectCommand> inputCommands;
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			glmlv::DrawElementsIndirectCommand command;
+			command.count = m_shapes[i].indexCount;
+			command.firstIndex = m_shapes[i].indexOffset;
+			command.baseInstance = uint32_t(i);
+			inputCommands.emplace_back(command);
+		}
+		m_ObjectBounds = glmlv::GLBuffer(objectBounds);
+		m_InputCommands = glmlv::GLBuffer(inputCommands);
+		m_CulledCommands.setStorage(GLsizeiptr(m_shapes.size() * sizeof(glmlv::DrawElementsIndirectCommand)), nullptr); // Only written by the GPU
+		m_DrawCount.setStorage(GLsizeiptr(sizeof(GLuint)), nullptr);
+
+		m_OcclusionFlags.setStorage(GLsizeiptr(m_shapes.size() * sizeof(GLuint)), nullptr);
+		m_LateCommands.setStorage(GLsizeiptr(m_shapes.size() * sizeof(glmlv::DrawElementsIndirectCommand)), nullptr);
+		m_LateDrawCount.setStorage(GLsizeiptr(sizeof(GLuint)), nullptr);
+
+		const auto statsFlags = GLbitfield(GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		const auto statsByteSize = GLsizeiptr(OcclusionStatsFrameCount * sizeof(OcclusionStats));
+		m_OcclusionStats.setStorage(statsByteSize, nullptr, statsFlags);
+		m_pOcclusionStats = (const OcclusionStats *) m_OcclusionStats.mapRange(0, statsByteSize, statsFlags);
 	}
 
 	// Fill VAO
@@ -300,6 +608,7 @@ void Application::initScene(const glmlv::fs::path & objPath)
 	const GLint positionAttrLocation = 0;
 	const GLint normalAttrLocation = 1;
 	const GLint texCoordsAttrLocation = 2;
+	const GLint drawIndexAttrLocation = 3;
 
 	// We tell OpenGL what vertex attributes our VAO is describing:
 	glEnableVertexAttribArray(positionAttrLocation);
@@ -312,6 +621,15 @@ void Application::initScene(const glmlv::fs::path & objPath)
 	glVertexAttribPointer(normalAttrLocation, 3, GL_FLOAT, GL_FALSE, sizeof(glmlv::Vertex3f3f2f), (const GLvoid*)offsetof(glmlv::Vertex3f3f2f, normal));
 	glVertexAttribPointer(texCoordsAttrLocation, 2, GL_FLOAT, GL_FALSE, sizeof(glmlv::Vertex3f3f2f), (const GLvoid*)offsetof(glmlv::Vertex3f3f2f, texCoords));
 
+	// Instanced attribute: advances once per instance instead of once per vertex
+	if (!m_shapes.empty())
+	{
+		glEnableVertexAttribArray(drawIndexAttrLocation);
+		glBindBuffer(GL_ARRAY_BUFFER, m_DrawIndices.glId());
+		glVertexAttribIPointer(drawIndexAttrLocation, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (const GLvoid*)0);
+		glVertexAttribDivisor(drawIndexAttrLocation, 1);
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, 0); // We can unbind the VBO because OpenGL has "written" in the VAO what VBO it needs to read when the VAO will be drawn
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboObjModel); // Binding the IBO to GL_ELEMENT_ARRAY_BUFFER while a VAO is bound "writes" it in the VAO for usage when the VAO will be drawn
@@ -320,24 +638,109 @@ void Application::initScene(const glmlv::fs::path & objPath)
 
 	// Note: no need to bind a sampler for modifying it: the sampler API is already direct_state_access
 	glGenSamplers(1, &textureSampler);
-	glSamplerParameteri(textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glSamplerParameteri(textureSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 void Application::initShadersData()
 {
-	program = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "geometryPass.vs.glsl", m_ShadersRootPath / m_AppName / "geometryPass.fs.glsl" });
-
-	uModelViewProjMatrixLocation = glGetUniformLocation(program.glId(), "uModelViewProjMatrix");
-	uModelViewMatrixLocation = glGetUniformLocation(program.glId(), "uModelViewMatrix");
-	uNormalMatrixLocation = glGetUniformLocation(program.glId(), "uNormalMatrix");
-
-	uKaLocation = glGetUniformLocation(program.glId(), "uKa");
-	uKdLocation = glGetUniformLocation(program.glId(), "uKd");
-	uKsLocation = glGetUniformLocation(program.glId(), "uKs");
-	uShininessLocation = glGetUniformLocation(program.glId(), "uShininess");
-	uKaSamplerLocation = glGetUniformLocation(program.glId(), "uKaSampler");
-	uKdSamplerLocation = glGetUniformLocation(program.glId(), "uKdSampler");
-	uKsSamplerLocation = glGetUniformLocation(program.glId(), "uKsSampler");
-	uShininessSamplerLocation = glGetUniformLocation(program.glId(), "uShininessSampler");
-}
\ No newline at end of file
+	// The length of uTextureArrays is the limit of the packer
+	const glmlv::ShaderDefines textureArrayDefines = { { "TEXTURE_ARRAY_COUNT", std::to_string(glmlv::TexturePackerOptions::DefaultMaxArrayCount) } };
+	glmlv::ProgramBuilder programBuilder;
+	const auto geometryPassProgram = programBuilder.add({ glmlv::loadShaderVariant(m_ShadersRootPath / m_AppName / "geometryPass.vs.glsl", textureArrayDefines),
+		glmlv::loadShaderVariant(m_ShadersRootPath / m_AppName / "geometryPass.fs.glsl", textureArrayDefines) });
+	program = programBuilder.take(geometryPassProgram);
+
+	uViewMatrixLocation = glGetUniformLocation(program.glId(), "uViewMatrix");
+	uProjMatrixLocation = glGetUniformLocation(program.glId(), "uProjMatrix");
+
+	m_CullProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "cullDraws.cs.glsl" });
+
+	m_uFrustumPlanesLocation = glGetUniformLocation(m_CullProgram.glId(), "uFrustumPlanes");
+	m_uCameraPositionLocation = glGetUniformLocation(m_CullProgram.glId(), "uCameraPosition");
+	m_uObjectCountLocation = glGetUniformLocation(m_CullProgram.glId(), "uObjectCount");
+	m_uFrustumCullingLocation = glGetUniformLocation(m_CullProgram.glId(), "uFrustumCulling");
+	m_uConeCullingLocation = glGetUniformLocation(m_CullProgram.glId(), "uConeCulling");
+	m_uCompactLocation = glGetUniformLocation(m_CullProgram.glId(), "uCompact");
+	m_uOcclusionPhaseLocation = glGetUniformLocation(m_CullProgram.glId(), "uOcclusionPhase");
+	m_uHiZValidLocation = glGetUniformLocation(m_CullProgram.glId(), "uHiZValid");
+	m_uHiZViewProjMatrixLocation = glGetUniformLocation(m_CullProgram.glId(), "uHiZViewProjMatrix");
+	m_uStatsOffsetLocation = glGetUniformLocation(m_CullProgram.glId(), "uStatsOffset");
+	m_CullProgram.use();
+	glUniform1i(glGetUniformLocation(m_CullProgram.glId(), "uHiZ"), GLint(HiZTextureUnit));
+
+	GLint maxTextureUnits = 0;
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
+	assert(GLint(HiZTextureUnit) < maxTextureUnits);
+
+	m_HiZProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "hiZDownsample.cs.glsl" });
+
+	m_uCopyDepthLocation = glGetUniformLocation(m_HiZProgram.glId(), "uCopyDepth");
+	m_HiZProgram.use();
+	glUniform1i(glGetUniformLocation(m_HiZProgram.glId(), "uDepth"), GLint(HiZTextureUnit));
+}
+
+void Application::cullDraws(int occlusionPhase, const glm::mat4 & hiZViewProjMatrix, const glmlv::GLBuffer & commands, const glmlv::GLBuffer & drawCount)
+{
+	m_GLState.useProgram(m_CullProgram.glId());
+	glUniform1i(m_uOcclusionPhaseLocation, occlusionPhase);
+	glUniformMatrix4fv(m_uHiZViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(hiZViewProjMatrix));
+
+	if (m_bUseIndirectCount && glMultiDrawElementsIndirectCount)
+		glClearNamedBufferSubData(drawCount.glId(), GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	m_GLState.bindTexture(HiZTextureUnit, m_HiZTexture.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectBoundsStorageBinding, m_ObjectBounds.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, InputCommandStorageBinding, m_InputCommands.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OutputCommandStorageBinding, commands.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawCountStorageBinding, drawCount.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OcclusionFlagStorageBinding, m_OcclusionFlags.glId());
+	m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OcclusionStatsStorageBinding, m_OcclusionStats.glId());
+	glDispatchCompute((GLuint(m_shapes.size()) + 63) / 64, 1, 1);
+
+	// The draw reads the commands and the count as indirect parameters, phase 2 reads the flags of phase 1
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Application::drawCulledCommands(const glmlv::GLBuffer & commands, const glmlv::GLBuffer & drawCount)
+{
+	m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.glId());
+	if (m_bUseIndirectCount && glMultiDrawElementsIndirectCount)
+	{
+		// The number of commands is the value of the atomic counter, never more than the number of shapes
+		m_GLState.bindBuffer(GL_PARAMETER_BUFFER_ARB, drawCount.glId());
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, GLsizei(m_shapes.size()), 0);
+		m_GLState.bindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(m_shapes.size()), 0);
+	}
+	m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Application::buildHiZPyramid()
+{
+	m_GLState.useProgram(m_HiZProgram.glId());
+
+	// Level 0: copy of the depth texture, sampled from the unit of the pyramid
+	glUniform1i(m_uCopyDepthLocation, GL_TRUE);
+	m_GLState.bindTexture(HiZTextureUnit, m_GBufferTextures[GDepth].glId());
+	glBindImageTexture(1, m_HiZTexture.glId(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute((GLuint(m_nWindowWidth) + 7) / 8, (GLuint(m_nWindowHeight) + 7) / 8, 1);
+
+	glUniform1i(m_uCopyDepthLocation, GL_FALSE);
+	for (GLsizei level = 1; level < m_nHiZLevelCount; ++level)
+	{
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glBindImageTexture(0, m_HiZTexture.glId(), level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, m_HiZTexture.glId(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		const auto width = std::max(GLuint(m_nWindowWidth) >> level, 1u);
+		const auto height = std::max(GLuint(m_nWindowHeight) >> level, 1u);
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+	}
+
+	// The depth texture is still attached to the GBuffer: it must not stay bound while the geometry pass draws
+	m_GLState.bindTexture(HiZTextureUnit, m_HiZTexture.glId());
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -5,6 +5,16 @@
 #include <glmlv/GLProgram.hpp>
 #include <glmlv/ViewController.hpp>
 #include <glmlv/simple_geometry.hpp>
+#include <glmlv/Image2D.hpp>
+#include <glmlv/TexturePacker.hpp>
+#include <glmlv/BufferLayout.hpp>
+#include <glmlv/GLBuffer.hpp>
+#include <glmlv/GLTexture.hpp>
+#include <glmlv/GLStateCache.hpp>
+#include <glmlv/indirect_draw.hpp>
+#include <glmlv/RenderQueue.hpp>
+#include <glmlv/frustum_culling.hpp>
+#include <glmlv/GPUProfiler.hpp>
 #include <glm/glm.hpp>
 #include <limits>
 
@@ -13,13 +23,25 @@ class Application
 public:
     Application(int argc, char** argv);
 
+    ~Application();
+
     int run();
 private:
 	
-	void initScene(const glmlv::fs::path & objPath);
+	void initScene(const glmlv::fs::path & objPath, const glmlv::TextureLoadOptions & textureOptions);
 
 	void initShadersData();
 
+	// Run cullDraws.cs.glsl for occlusionPhase (0 without occlusion culling), writing to commands and drawCount. The uniforms shared
+	// by the phases must have been set.
+	void cullDraws(int occlusionPhase, const glm::mat4 & hiZViewProjMatrix, const glmlv::GLBuffer & commands, const glmlv::GLBuffer & drawCount);
+
+	// Draw the output of cullDraws() with the geometry pass program
+	void drawCulledCommands(const glmlv::GLBuffer & commands, const glmlv::GLBuffer & drawCount);
+
+	// Rebuild m_HiZTexture from the depth of the GBuffer
+	void buildHiZPyramid();
+
 	static glm::vec3 computeDirectionVector(float phiRadians, float thetaRadians)
 	{
 		const auto cosPhi = glm::cos(phiRadians);
@@ -51,7 +73,7 @@ private:
 
 	const char * m_GBufferTexNames[GBufferTextureCount] = { "position", "normal", "ambient", "diffuse", "glossyShininess", "depth" };
 	const GLenum m_GBufferTextureFormat[GBufferTextureCount] = { GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGBA32F, GL_DEPTH_COMPONENT32F };
-	GLuint m_GBufferTextures[GBufferTextureCount];
+	glmlv::GLTexture m_GBufferTextures[GBufferTextureCount]; // Render targets, size of the window
 	GLuint m_GBufferFBO; // Framebuffer object
 
 	GBufferTextureType m_CurrentlyDisplayed = GDiffuse;
@@ -68,46 +90,156 @@ private:
 		uint32_t indexOffset; // Offset in GPU index buffer
 		int materialID = -1;
 		glm::mat4 localToWorldMatrix;
+		glm::vec3 boundingSphereCenter; // World space, encloses the bounding box of the shape
+		float boundingSphereRadius = 0.f;
 	};
 
 	std::vector<ShapeInfo> m_shapes; // For each shape of the scene, its number of indices
 	float m_SceneSize = 0.f; // Used for camera speed and projection matrix parameters
 
+	// Element of the storage block bMaterialStorage of geometryPass.fs.glsl, one per material uploaded once at load
 	struct PhongMaterial
 	{
 		glm::vec3 Ka = glm::vec3(0); // Ambient multiplier
+		int32_t KaArray = 0; // Index of the array of each texture in m_TexturePacker, also its texture unit
 		glm::vec3 Kd = glm::vec3(0); // Diffuse multiplier
+		int32_t KdArray = 0;
 		glm::vec3 Ks = glm::vec3(0); // Glossy multiplier
+		int32_t KsArray = 0;
 		float shininess = 1.f; // Glossy exponent
+		int32_t shininessArray = 0;
+		glm::vec2 padding;
+		glm::ivec4 layers = glm::ivec4(0); // Layer of each texture in its array: Ka, Kd, Ks, shininess
+		glm::vec4 KaUVTransform = glm::vec4(1, 1, 0, 0); // xy: scale, zw: offset in the layer
+		glm::vec4 KdUVTransform = glm::vec4(1, 1, 0, 0);
+		glm::vec4 KsUVTransform = glm::vec4(1, 1, 0, 0);
+		glm::vec4 shininessUVTransform = glm::vec4(1, 1, 0, 0);
+	};
+	using PhongMaterialLayout = glmlv::Std430Layout<glm::vec3, int32_t, glm::vec3, int32_t, glm::vec3, int32_t, float, int32_t, glm::ivec4, glm::vec4, glm::vec4, glm::vec4, glm::vec4>;
+
+	// Element of the storage block bDrawDataStorage of geometryPass.vs.glsl, one per shape
+	struct DrawData
+	{
+		glm::mat4 localToWorldMatrix;
+		glm::mat4 localToWorldNormalMatrix;
+		int32_t materialIndex;
+		int32_t padding[3];
+	};
+	using DrawDataLayout = glmlv::Std430Layout<glm::mat4, glm::mat4, int32_t>;
+
+	static const GLuint DrawDataStorageBinding = 0;
+	static const GLuint MaterialStorageBinding = 1;
 
-		// OpenGL texture ids:
-		GLuint KaTextureId = 0;
-		GLuint KdTextureId = 0;
-		GLuint KsTextureId = 0;
-		GLuint shininessTextureId = 0;
+	// The geometry pass draws the whole scene with one glMultiDrawElementsIndirect. The command of m_shapes[i] has baseInstance i, which
+	// the vertex shader reads back through the instanced attribute aDrawIndex to index the per draw data and the materials: no uniform or
+	// texture changes between draws. The commands are rewritten each frame in the order of m_RenderQueue.
+	enum class SubmitMode
+	{
+		PerShape, // The same draws, issued one by one with glDrawElementsInstancedBaseInstance
+		MultiDrawIndirect,
+		GPUCulling // Commands culled and written by cullDraws.cs.glsl, no visibility work on the CPU
 	};
 
-	GLuint m_WhiteTexture; // A white 1x1 texture
-	PhongMaterial m_DefaultMaterial;
-	std::vector<PhongMaterial> m_SceneMaterials;
+	SubmitMode m_SubmitMode = SubmitMode::MultiDrawIndirect;
+	glmlv::GLBuffer m_DrawCommands; // DrawElementsIndirectCommand per shape, updated each frame
+	std::vector<glmlv::DrawElementsIndirectCommand> m_DrawCommandsData; // Kept to reuse its allocation
+	glmlv::GLBuffer m_DrawData; // DrawData per shape
+	glmlv::GLBuffer m_DrawIndices; // 0, 1, 2, ... read by aDrawIndex
+
+	glmlv::TexturePacker m_TexturePacker; // All scene textures, plus a white 1x1 texture for materials without texture
+	glmlv::GLBuffer m_MaterialStorage; // Scene materials followed by the default material
+	int32_t m_DefaultMaterialIndex = 0;
+
+	// All shapes are submitted to the queue each frame, front to back so that early depth testing skips the hidden fragments of the
+	// geometry pass. Materials do not change between draws, the keys only hold the depth.
+	glmlv::RenderQueue m_RenderQueue;
+	bool m_bSortFrontToBack = true;
+
+	// Shapes outside the camera frustum are not submitted to the queue
+	glmlv::CullingBounds m_ShapeBounds; // World space box of each shape
+	std::vector<uint8_t> m_ShapeVisibility;
+	glmlv::CullingStats m_CullingStats;
+	bool m_bFrustumCulling = true;
+
+	// Element of the storage block bObjectBoundsStorage of cullDraws.cs.glsl, one per shape
+	struct ObjectBounds
+	{
+		glm::vec4 centerRadius; // World space bounding sphere
+		glm::vec4 extent; // xyz: half size of the world space bounding box
+		glm::vec4 coneAxisSin; // Normal cone, see glmlv::NormalCone
+	};
+	using ObjectBoundsLayout = glmlv::Std430Layout<glm::vec4, glm::vec4, glm::vec4>;
+
+	static const GLuint ObjectBoundsStorageBinding = 2;
+	static const GLuint InputCommandStorageBinding = 3;
+	static const GLuint OutputCommandStorageBinding = 4;
+	static const GLuint DrawCountStorageBinding = 5;
+	static const GLuint OcclusionFlagStorageBinding = 6;
+	static const GLuint OcclusionStatsStorageBinding = 7;
+
+	// GPUCulling: cullDraws.cs.glsl tests each shape and appends the commands of the visible ones to m_CulledCommands, counting them
+	// with an atomic add in m_DrawCount, which glMultiDrawElementsIndirectCount reads as parameter buffer. Without indirect count support
+	// the culled commands are kept in place with instanceCount = 0 and all of them are submitted.
+	glmlv::GLBuffer m_ObjectBounds; // ObjectBounds per shape
+	glmlv::GLBuffer m_InputCommands; // DrawElementsIndirectCommand per shape, in shape order
+	glmlv::GLBuffer m_CulledCommands; // Written by the compute shader
+	glmlv::GLBuffer m_DrawCount; // One uint
+	glmlv::GLProgram m_CullProgram;
+	bool m_bUseIndirectCount = true;
+	bool m_bConeCulling = true;
+
+	// Occlusion culling, GPUCulling only: shapes hidden in the Hi-Z pyramid of the previous frame are left out of a first draw, then
+	// those visible in the pyramid of this first draw are drawn by a second one (see cullDraws.cs.glsl)
+	glmlv::GLTexture m_HiZTexture; // R32F, size of the GBuffer, full mip chain
+	GLsizei m_nHiZLevelCount = 0;
+	// First unit after the range of uTextureArrays, holds the depth texture while level 0 is copied
+	static const GLuint HiZTextureUnit = GLuint(glmlv::TexturePackerOptions::DefaultMaxArrayCount);
+	glmlv::GLProgram m_HiZProgram;
+	glm::mat4 m_PreviousViewProjMatrix; // Camera of m_HiZTexture
+	bool m_bHiZValid = false; // False until the pyramid is built, and when occlusion culling is turned back on
+	bool m_bOcclusionCulling = true;
+	glmlv::GLBuffer m_OcclusionFlags; // One uint per shape, written by phase 1 for phase 2
+	glmlv::GLBuffer m_LateCommands; // Output of phase 2
+	glmlv::GLBuffer m_LateDrawCount;
+
+	// Counters of cullDraws.cs.glsl (bStats), one slot per frame in flight so that they are read back without waiting for the GPU
+	struct OcclusionStats
+	{
+		uint32_t culledCount = 0; // Outside the frustum or back facing
+		uint32_t earlyDrawCount = 0; // Drawn by phase 1
+		uint32_t earlyOccludedCount = 0; // Hidden in the previous pyramid
+		uint32_t lateDrawCount = 0; // Drawn by phase 2
+	};
 
-	GLuint textureSampler = 0; // Only one sampler object since we will use the same sampling parameters for all textures
+	static const size_t OcclusionStatsFrameCount = 3;
+	glmlv::GLBuffer m_OcclusionStats; // OcclusionStats per slot, persistently mapped
+	const OcclusionStats * m_pOcclusionStats = nullptr;
+	GLsync m_OcclusionStatsFences[OcclusionStatsFrameCount] = {};
+	size_t m_nOcclusionStatsFrame = 0;
+	OcclusionStats m_LastOcclusionStats; // Most recent slot read back
+
+	glmlv::GPUProfiler m_GPUProfiler; // The geometry pass is measured separately with and without occlusion culling
+
+	GLint m_uFrustumPlanesLocation;
+	GLint m_uCameraPositionLocation;
+	GLint m_uObjectCountLocation;
+	GLint m_uFrustumCullingLocation;
+	GLint m_uConeCullingLocation;
+	GLint m_uCompactLocation;
+	GLint m_uOcclusionPhaseLocation;
+	GLint m_uHiZValidLocation;
+	GLint m_uHiZViewProjMatrixLocation;
+	GLint m_uStatsOffsetLocation;
+	GLint m_uCopyDepthLocation;
+
+	GLuint textureSampler = 0; // Only one sampler object since we will use the same sampling parameters for all textures (bound to a unit per texture array)
 
 	glmlv::ViewController viewController{ m_GLFWHandle.window(), 3.f };
 
-	GLint uModelViewProjMatrixLocation;
-	GLint uModelViewMatrixLocation;
-	GLint uNormalMatrixLocation;
-
 	glmlv::GLProgram program;
+	glmlv::GLStateCache m_GLState; // Programs, vertex arrays, textures, samplers, framebuffers and buffers of the render loop are bound through it
 
-	GLint uKaLocation;
-	GLint uKdLocation;
-	GLint uKsLocation;
-	GLint uShininessLocation;
-	GLint uKaSamplerLocation;
-	GLint uKdSamplerLocation;
-	GLint uKsSamplerLocation;
-	GLint uShininessSamplerLocation;
+	GLint uViewMatrixLocation;
+	GLint uProjMatrixLocation;
 
 };
\ No newline at end of file
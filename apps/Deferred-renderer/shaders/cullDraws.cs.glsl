@@ -0,0 +1,172 @@
+#version 430
+
+// One invocation per shape: tests its bounds against the camera frustum (and optionally its normal cone against the camera
+// position), then writes its draw command for the glMultiDrawElementsIndirect(Count) of the geometry pass.
+//
+// With occlusion culling the geometry pass is drawn in two phases. Phase 1 also tests the shapes against the Hi-Z pyramid of the
+// previous frame, seen from the previous camera: shapes hidden there are flagged and not drawn. Phase 2 runs once the pyramid
+// has been rebuilt from the depth of phase 1: it tests the flagged shapes again, from the current camera, and draws those that
+// are visible after all (disoccluded by the camera motion).
+layout(local_size_x = 64) in;
+
+struct ObjectBounds
+{
+    vec4 centerRadius; // World space bounding sphere
+    vec4 extent; // xyz: half size of the world space bounding box, same center
+    vec4 coneAxisSin; // Normal cone: xyz axis, w sine of the half angle (1 if the shape can not be back-face culled)
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 2) readonly buffer bObjectBoundsStorage
+{
+    ObjectBounds bBounds[];
+};
+
+// Command of each shape, baseInstance is the index of the shape
+layout(std430, binding = 3) readonly buffer bInputCommandStorage
+{
+    DrawCommand bInputCommands[];
+};
+
+layout(std430, binding = 4) writeonly buffer bOutputCommandStorage
+{
+    DrawCommand bOutputCommands[];
+};
+
+// Number of commands written to bOutputCommands when uCompact is set, reset to 0 before the dispatch. Read by
+// glMultiDrawElementsIndirectCount from the parameter buffer.
+layout(std430, binding = 5) buffer bDrawCountStorage
+{
+    uint bDrawCount;
+};
+
+// 1 for the shapes rejected by the occlusion test of phase 1, written by phase 1 and read by phase 2
+layout(std430, binding = 6) buffer bOcclusionFlagStorage
+{
+    uint bOcclusionFlags[];
+};
+
+// Counters of the frame at uStatsOffset: rejected by the frustum or the normal cone, drawn in phase 1, occluded in phase 1, drawn in phase 2
+layout(std430, binding = 7) buffer bOcclusionStatsStorage
+{
+    uint bStats[];
+};
+
+uniform vec4 uFrustumPlanes[6]; // dot(plane.xyz, p) + plane.w >= 0 inside
+uniform vec3 uCameraPosition; // World space
+uniform uint uObjectCount;
+uniform bool uFrustumCulling;
+uniform bool uConeCulling;
+uniform bool uCompact; // Else commands stay at the index of their shape, with instanceCount = 0 if culled
+
+uniform int uOcclusionPhase; // 0: no occlusion culling, 1 or 2
+uniform bool uHiZValid; // False until a pyramid has been built: phase 1 draws everything it does not cull otherwise
+uniform sampler2D uHiZ; // Max depth of each texel of the level below, level 0 is the depth buffer
+uniform mat4 uHiZViewProjMatrix; // Camera of the pyramid: the previous one in phase 1, the current one in phase 2
+uniform uint uStatsOffset;
+
+bool isInsideFrustum(ObjectBounds bounds)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        // Distance of the box corner the furthest along the plane normal
+        vec4 plane = uFrustumPlanes[i];
+        if (dot(plane.xyz, bounds.centerRadius.xyz) + dot(abs(plane.xyz), bounds.extent.xyz) + plane.w < 0)
+            return false;
+    }
+    return true;
+}
+
+bool isBackFacing(ObjectBounds bounds)
+{
+    vec3 toCenter = bounds.centerRadius.xyz - uCameraPosition;
+    float sinHalfAngle = bounds.coneAxisSin.w;
+    return dot(toCenter, bounds.coneAxisSin.xyz) > sinHalfAngle * length(toCenter) + bounds.centerRadius.w * (1 + sinHalfAngle);
+}
+
+// True if the box is behind the depth of the pyramid everywhere it covers. Conservative: boxes crossing the near plane of the pyramid
+// camera or out of its screen are never occluded.
+bool isOccluded(ObjectBounds bounds)
+{
+    vec3 boxMin = bounds.centerRadius.xyz - bounds.extent.xyz;
+    vec3 boxMax = bounds.centerRadius.xyz + bounds.extent.xyz;
+
+    vec2 ndcMin = vec2(1e30);
+    vec2 ndcMax = vec2(-1e30);
+    float nearestDepth = 1;
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+        vec4 clip = uHiZViewProjMatrix * vec4(corner, 1);
+        if (clip.w <= 0 || clip.z < -clip.w)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        nearestDepth = min(nearestDepth, 0.5 * ndc.z + 0.5);
+    }
+    if (any(lessThan(ndcMax, vec2(-1))) || any(greaterThan(ndcMin, vec2(1))))
+        return false;
+
+    // Rectangle of level 0 texels covered by the box, then the level where it spans at most 2x2 texels. The last texel of an odd sized
+    // level also covers the texel left over by the halving, so clamping the coordinates of a level keeps them conservative.
+    ivec2 size = textureSize(uHiZ, 0);
+    ivec2 texelMin = clamp(ivec2(floor((0.5 * ndcMin + 0.5) * vec2(size))), ivec2(0), size - 1);
+    ivec2 texelMax = clamp(ivec2(floor((0.5 * ndcMax + 0.5) * vec2(size))), ivec2(0), size - 1);
+    ivec2 span = texelMax - texelMin;
+    int level = min(findMSB(uint(max(span.x, span.y))) + 1, textureQueryLevels(uHiZ) - 1);
+
+    ivec2 levelMax = textureSize(uHiZ, level) - 1;
+    ivec2 t0 = min(texelMin >> level, levelMax);
+    ivec2 t1 = min(texelMax >> level, levelMax);
+    float farthestDepth = max(max(texelFetch(uHiZ, t0, level).r, texelFetch(uHiZ, ivec2(t1.x, t0.y), level).r),
+        max(texelFetch(uHiZ, ivec2(t0.x, t1.y), level).r, texelFetch(uHiZ, t1, level).r));
+    return nearestDepth > farthestDepth;
+}
+
+void main()
+{
+    uint objectIndex = gl_GlobalInvocationID.x;
+    if (objectIndex >= uObjectCount)
+        return;
+
+    ObjectBounds bounds = bBounds[objectIndex];
+    bool visible;
+    if (uOcclusionPhase == 2)
+    {
+        visible = bOcclusionFlags[objectIndex] != 0u && !isOccluded(bounds);
+        if (visible)
+            atomicAdd(bStats[uStatsOffset + 3u], 1u);
+    }
+    else
+    {
+        visible = (!uFrustumCulling || isInsideFrustum(bounds)) && (!uConeCulling || !isBackFacing(bounds));
+        if (uOcclusionPhase == 1)
+        {
+            bool occluded = visible && uHiZValid && isOccluded(bounds);
+            bOcclusionFlags[objectIndex] = occluded ? 1u : 0u;
+            atomicAdd(bStats[uStatsOffset + (occluded ? 2u : visible ? 1u : 0u)], 1u);
+            visible = visible && !occluded;
+        }
+    }
+
+    DrawCommand command = bInputCommands[objectIndex];
+    if (uCompact)
+    {
+        if (visible)
+            bOutputCommands[atomicAdd(bDrawCount, 1u)] = command;
+    }
+    else
+    {
+        command.instanceCount = visible ? command.instanceCount : 0u;
+        bOutputCommands[objectIndex] = command;
+    }
+}
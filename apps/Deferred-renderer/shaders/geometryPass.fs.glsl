@@ -1,8 +1,9 @@
-#version 330
+#version 430
 
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
 in vec2 vTexCoords;
+flat in int vMaterialIndex;
 
 layout(location = 0) out vec3 fPosition;
 layout(location = 1) out vec3 fNormal;
@@ -10,33 +11,66 @@ layout(location = 2) out vec3 fAmbient;
 layout(location = 3) out vec3 fDiffuse;
 layout(location = 4) out vec4 fGlossyShininess;
 
-uniform vec3 uDirectionalLightDir;
-uniform vec3 uDirectionalLightIntensity;
+// Textures are packed in texture arrays by glmlv::TexturePacker, array i being bound to unit i for the whole frame.
+// A material locates each of its textures with the index of its array, its layer and a uv transform (xy: scale, zw: offset).
+// TEXTURE_ARRAY_COUNT is defined by the application: the maximum number of arrays of the packer.
+layout(binding = 0) uniform sampler2DArray uTextureArrays[TEXTURE_ARRAY_COUNT];
 
-uniform vec3 uPointLightPosition;
-uniform vec3 uPointLightIntensity;
+struct PhongMaterial
+{
+    vec3 Ka;
+    int KaArray;
+    vec3 Kd;
+    int KdArray;
+    vec3 Ks;
+    int KsArray;
+    float shininess;
+    int shininessArray;
+    ivec4 layers; // Ka, Kd, Ks, shininess
+    vec4 KaUVTransform;
+    vec4 KdUVTransform;
+    vec4 KsUVTransform;
+    vec4 shininessUVTransform;
+};
+
+// All materials, uploaded once. vMaterialIndex comes from the per draw data.
+layout(std430, binding = 1) readonly buffer bMaterialStorage
+{
+    PhongMaterial bMaterials[];
+};
 
-uniform vec3 uKa;
-uniform vec3 uKd;
-uniform vec3 uKs;
-uniform float uShininess;
+// The material index is not dynamically uniform (it is a vertex output, even if it is constant over a draw), so it cannot index the
+// array of samplers: each array is tested with a constant index instead. All the fragments of a draw take the same branch.
+// fract() repeats a texture inside its atlas rectangle, explicit gradients avoid selecting the smallest mip where it wraps;
+// they are computed outside of the branches, where derivatives are defined.
+vec4 texturePackedArray(int arrayIndex, int layer, vec4 uvTransform, vec2 uv)
+{
+    vec2 packedUV = fract(uv) * uvTransform.xy + uvTransform.zw;
+    vec2 dUVdx = dFdx(uv) * uvTransform.xy;
+    vec2 dUVdy = dFdy(uv) * uvTransform.xy;
 
-uniform sampler2D uKaSampler;
-uniform sampler2D uKdSampler;
-uniform sampler2D uKsSampler;
-uniform sampler2D uShininessSampler;
+    vec4 texel = vec4(1);
+    for (int i = 0; i < TEXTURE_ARRAY_COUNT; ++i)
+    {
+        if (i == arrayIndex) {
+            texel = textureGrad(uTextureArrays[i], vec3(packedUV, layer), dUVdx, dUVdy);
+        }
+    }
+    return texel;
+}
 
 void main()
 {
 	fPosition = vViewSpacePosition;
 	fNormal = normalize(vViewSpaceNormal);
 
-	vec3 ka = uKa * vec3(texture(uKaSampler, vTexCoords));
-	vec3 kd = uKd * vec3(texture(uKdSampler, vTexCoords));
-	vec3 ks = uKs * vec3(texture(uKsSampler, vTexCoords));
-	float shininess = uShininess * vec3(texture(uShininessSampler, vTexCoords)).x;
+	PhongMaterial material = bMaterials[vMaterialIndex];
+	vec3 ka = material.Ka * vec3(texturePackedArray(material.KaArray, material.layers.x, material.KaUVTransform, vTexCoords));
+	vec3 kd = material.Kd * vec3(texturePackedArray(material.KdArray, material.layers.y, material.KdUVTransform, vTexCoords));
+	vec3 ks = material.Ks * vec3(texturePackedArray(material.KsArray, material.layers.z, material.KsUVTransform, vTexCoords));
+	float shininess = material.shininess * texturePackedArray(material.shininessArray, material.layers.w, material.shininessUVTransform, vTexCoords).x;
 
 	fAmbient = ka;
 	fDiffuse = kd;
-	fGlossyShininess = vec4(ks, shininess);	
-}
\ No newline at end of file
+	fGlossyShininess = vec4(ks, shininess);
+}
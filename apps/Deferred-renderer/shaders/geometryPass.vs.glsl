@@ -1,23 +1,40 @@
-
-#version 330
+#version 430
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-//layout (location = 3) in vec3 Tangent;
+layout(location = 3) in uint aDrawIndex; // Instanced attribute read from 0, 1, 2...: the baseInstance of the draw
 
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
 out vec2 vTexCoords;
+flat out int vMaterialIndex;
+
+uniform mat4 uViewMatrix;
+uniform mat4 uProjMatrix;
+
+struct DrawData
+{
+    mat4 localToWorldMatrix;
+    mat4 localToWorldNormalMatrix;
+    int materialIndex;
+};
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uNormalMatrix;
+// One element per shape, uploaded at load
+layout(std430, binding = 0) readonly buffer bDrawDataStorage
+{
+    DrawData bDraws[];
+};
 
 void main()
 {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
-	vViewSpaceNormal = vec3(uNormalMatrix * vec4(aNormal, 0));
+    DrawData draw = bDraws[aDrawIndex];
+
+    vec4 viewSpacePosition = uViewMatrix * (draw.localToWorldMatrix * vec4(aPosition, 1));
+    vViewSpacePosition = vec3(viewSpacePosition);
+    // The view matrix is a rotation and a translation: its upper 3x3 part transforms normals as it is
+	vViewSpaceNormal = mat3(uViewMatrix) * vec3(draw.localToWorldNormalMatrix * vec4(aNormal, 0));
 	vTexCoords = aTexCoords;
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
-}
\ No newline at end of file
+	vMaterialIndex = draw.materialIndex;
+    gl_Position = uProjMatrix * viewSpacePosition;
+}
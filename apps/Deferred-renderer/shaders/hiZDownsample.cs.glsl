@@ -0,0 +1,38 @@
+#version 430
+
+// Builds one level of the Hi-Z pyramid: each texel is the farthest depth of the texels it covers in the level below. Level 0 is a
+// copy of the depth buffer.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform bool uCopyDepth; // Level 0: read uDepth instead of uSource
+uniform sampler2D uDepth;
+
+layout(r32f, binding = 0) readonly uniform image2D uSource;
+layout(r32f, binding = 1) writeonly uniform image2D uDestination;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(uDestination);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    if (uCopyDepth)
+    {
+        imageStore(uDestination, texel, vec4(texelFetch(uDepth, texel, 0).r));
+        return;
+    }
+
+    // The last column / row of a level also covers the texel left over by the halving of an odd sized source
+    ivec2 sourceSize = imageSize(uSource);
+    ivec2 sourceMin = 2 * texel;
+    ivec2 sourceMax = min(sourceMin + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);
+
+    float depth = 0;
+    for (int y = sourceMin.y; y <= sourceMax.y; ++y)
+    {
+        for (int x = sourceMin.x; x <= sourceMax.x; ++x)
+            depth = max(depth, imageLoad(uSource, ivec2(x, y)).r);
+    }
+    imageStore(uDestination, texel, vec4(depth));
+}
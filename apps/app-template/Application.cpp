@@ -1,5 +1,7 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+
 #include <iostream>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -13,6 +15,7 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
 
         // Put here rendering code
 		const auto fbSize = m_GLFWHandle.framebufferSize();
@@ -23,6 +26,7 @@ int Application::run()
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::End();
@@ -41,6 +45,8 @@ int Application::run()
 		m_GLFWHandle.swapBuffers(); // Swap front and back buffers
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
@@ -1,12 +1,20 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
 #include <iostream>
 #include <unordered_set>
 #include <algorithm>
+#include <numeric>
+#include <cstddef>
+#include <cassert>
 
 #include <imgui.h>
-#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/Image2D.hpp>
 #include <glmlv/scene_loading.hpp>
+#include <glmlv/ShaderVariants.hpp>
+#include <glmlv/ProgramBuilder.hpp>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -23,6 +31,9 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
+
+		m_GLState.beginFrame(); // ImGui bound its own objects at the end of the previous frame
 
         // Put here rendering code
 		const auto viewportSize = m_GLFWHandle.framebufferSize();
@@ -30,78 +41,155 @@ int Application::run()
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		const auto projMatrix = glm::perspective(70.f, float(viewportSize.x) / viewportSize.y, 0.1f, m_SceneSize);
+		const auto zNear = 0.1f;
+		const auto zFar = m_SceneSize;
+		const auto projMatrix = glm::perspective(70.f, float(viewportSize.x) / viewportSize.y, zNear, zFar);
 		const auto viewMatrix = viewController.getViewMatrix();
 
-		//light 
-		glUniform3fv(uDirectionalLightDirLocation, 1, glm::value_ptr(glm::vec3(viewMatrix * glm::vec4(glm::normalize(DirLightDirection), 0))));
-		glUniform3fv(uDirectionalLightIntensityLocation, 1, glm::value_ptr(DirLightColor * DirLightIntensity));
+		// Draw order of the frame: pass and program are the same for all shapes, the key orders by material then by depth
+		{
+			GLMLV_PROFILE_SCOPE("Render queue");
+
+			if (m_bFrustumCulling)
+			{
+				m_CullingStats = glmlv::cullFrustum(m_ShapeBounds, projMatrix * viewMatrix, m_ShapeVisibility);
+			}
+			else
+			{
+				m_CullingStats = glmlv::CullingStats();
+				m_CullingStats.visibleCount = m_shapes.size();
+				m_ShapeVisibility.assign(m_shapes.size(), 1);
+			}
+
+			// Nothing waits for the GPU before m_FrameData.beginFrame(): the occluders are rasterized while it still draws the previous frame
+			if (m_bOcclusionCulling)
+			{
+				m_OcclusionRasterizer.render(projMatrix * viewMatrix);
+				m_OcclusionStats = m_OcclusionRasterizer.cullOccluded(m_ShapeBounds, m_ShapeVisibility);
+			}
+
+			m_RenderQueue.clear();
+			for (size_t i = 0; i < m_shapes.size(); ++i)
+			{
+				if (!m_ShapeVisibility[i])
+					continue;
 
-		glUniform3fv(uPointLightPositionLocation, 1, glm::value_ptr(glm::vec3(viewMatrix * glm::vec4(PointLightPosition, 1))));
-		glUniform3fv(uPointLightIntensityLocation, 1, glm::value_ptr(PointLightColor * PointLightIntensity));
+				const auto & shape = m_shapes[i];
+				const auto material = m_SubmitMode == SubmitMode::PerShape ? (shape.materialID >= 0 ? shape.materialID : m_DefaultMaterialIndex) : 0;
 
-		// Same sampler for all texture units
-		for (GLuint i : {0, 1, 2, 3})
-			glBindSampler(i, textureSampler);
+				uint32_t depth = 0;
+				if (m_bSortFrontToBack)
+				{
+					// Distance to the nearest point of the bounding sphere along the view axis
+					const auto viewDepth = -(viewMatrix * glm::vec4(shape.boundingSphereCenter, 1)).z - shape.boundingSphereRadius;
+					depth = glmlv::RenderQueue::quantizeDepth(viewDepth, zNear, zFar);
+				}
 
-		// Set texture unit of each sampler
-		glUniform1i(uKaSamplerLocation, 0);
-		glUniform1i(uKdSamplerLocation, 1);
-		glUniform1i(uKsSamplerLocation, 2);
-		glUniform1i(uShininessSamplerLocation, 3);
+				m_RenderQueue.push(glmlv::RenderQueue::makeKey(0, 0, uint32_t(material), depth, 0), uint32_t(i));
+			}
+			m_RenderQueue.sort();
+		}
 
-		const auto bindMaterial = [&](const PhongMaterial & material)
+		// Per frame and per object data are written in the persistent mapped ring buffer, each draw only binds its range
+		m_FrameData.beginFrame();
+
+		FrameUniforms frameUniforms;
+		frameUniforms.directionalLightDir = glm::vec3(viewMatrix * glm::vec4(glm::normalize(DirLightDirection), 0));
+		frameUniforms.directionalLightIntensity = DirLightColor * DirLightIntensity;
+		frameUniforms.pointLightPosition = glm::vec3(viewMatrix * glm::vec4(PointLightPosition, 1));
+		frameUniforms.pointLightIntensity = PointLightColor * PointLightIntensity;
+		const auto frameAllocation = m_FrameData.pushUniform(frameUniforms);
+		m_GLState.bindBufferRange(GL_UNIFORM_BUFFER, FrameUniformBinding, frameAllocation.buffer, frameAllocation.offset, frameAllocation.size);
+
+		// Texture array i is bound to unit i for the whole frame, with the same sampler for all units
+		const auto textureArrayCount = GLuint(m_TexturePacker.arrays().size());
+		assert(textureArrayCount <= glmlv::TexturePackerOptions::DefaultMaxArrayCount); // Length of uTextureArrays, enforced by the packer
+		for (GLuint i = 0; i < textureArrayCount; ++i)
 		{
-			glUniform3fv(uKaLocation, 1, glm::value_ptr(material.Ka));
-			glUniform3fv(uKdLocation, 1, glm::value_ptr(material.Kd));
-			glUniform3fv(uKsLocation, 1, glm::value_ptr(material.Ks));
-			glUniform1fv(uShininessLocation, 1, &material.shininess);
-
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, material.KaTextureId);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, material.KdTextureId);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, material.KsTextureId);
-			glActiveTexture(GL_TEXTURE3);
-			glBindTexture(GL_TEXTURE_2D, material.shininessTextureId);
-		};
+			m_GLState.bindTexture(i, m_TexturePacker.arrays()[i].glId);
+			m_GLState.bindSampler(i, textureSampler.glId());
+		}
 
-		glBindVertexArray(vaoObjModel);
-		
-		const PhongMaterial * currentMaterial = nullptr;
+		m_GLState.useProgram(program.glId());
+		m_GLState.bindVertexArray(vaoObjModel.glId());
 
-		// We draw each shape by specifying how much indices it carries, and with an offset in the global index buffer
-		for (const auto shape : m_shapes)
+		if (m_SubmitMode == SubmitMode::MultiDrawIndirect)
 		{
-			const auto & material = shape.materialID >= 0 ? m_SceneMaterials[shape.materialID] : m_DefaultMaterial;
-			if (currentMaterial != &material)
+			GLMLV_PROFILE_SCOPE("Multi-draw indirect");
+
+			// Transforms are applied by the vertex shader from static per draw data: only the camera changes per frame
+			CameraUniforms cameraUniforms;
+			cameraUniforms.viewMatrix = viewMatrix;
+			cameraUniforms.projMatrix = projMatrix;
+			const auto cameraAllocation = m_FrameData.pushUniform(cameraUniforms);
+			m_GLState.bindBufferRange(GL_UNIFORM_BUFFER, CameraUniformBinding, cameraAllocation.buffer, cameraAllocation.offset, cameraAllocation.size);
+
+			m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataStorageBinding, m_DrawData.glId());
+			m_GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialStorageBinding, m_MaterialStorage.glId());
+
+			if (m_RenderQueue.size())
 			{
-				bindMaterial(material);
-				currentMaterial = &material;
+				// One command per shape in queue order, written directly in the mapped ring buffer
+				const auto commands = m_FrameData.allocate(m_RenderQueue.size() * sizeof(glmlv::DrawElementsIndirectCommand), sizeof(GLuint));
+				auto pCommand = static_cast<glmlv::DrawElementsIndirectCommand *>(commands.pData);
+				for (const auto & draw : m_RenderQueue.draws())
+				{
+					const auto & shape = m_shapes[draw.payload];
+					glmlv::DrawElementsIndirectCommand command;
+					command.count = shape.indexCount;
+					command.firstIndex = shape.indexOffset;
+					command.baseInstance = draw.payload;
+					*pCommand++ = command;
+				}
+
+				m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+				m_GLState.useProgram(m_IndirectProgram.glId());
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*)commands.offset, GLsizei(m_RenderQueue.size()), 0);
+				m_GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 			}
+		}
+		else
+		{
+			GLMLV_PROFILE_SCOPE("Draw per shape");
 
-			const auto modelMatrix = shape.localToWorldMatrix;
+			int32_t currentMaterial = -1;
 
-			const auto mvMatrix = viewMatrix * modelMatrix;
-			const auto mvpMatrix = projMatrix * mvMatrix;
-			const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
+			// We draw each shape by specifying how much indices it carries, and with an offset in the global index buffer
+			for (const auto & draw : m_RenderQueue.draws())
+			{
+				const auto & shape = m_shapes[draw.payload];
+
+				// Materials have been uploaded at load: changing material only selects another range of the buffer
+				const auto material = shape.materialID >= 0 ? shape.materialID : m_DefaultMaterialIndex;
+				if (currentMaterial != material)
+				{
+					m_GLState.bindBufferRange(GL_UNIFORM_BUFFER, MaterialUniformBinding, m_Materials.glId(), GLintptr(material * m_Materials.stride()), sizeof(PhongMaterial));
+					currentMaterial = material;
+				}
 
-			glUniformMatrix4fv(uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-			glUniformMatrix4fv(uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-			glUniformMatrix4fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+				const auto mvMatrix = viewMatrix * shape.localToWorldMatrix;
+				ObjectUniforms objectUniforms;
+				objectUniforms.modelViewProjMatrix = projMatrix * mvMatrix;
+				objectUniforms.modelViewMatrix = mvMatrix;
+				objectUniforms.normalMatrix = glm::transpose(glm::inverse(mvMatrix));
+				const auto objectAllocation = m_FrameData.pushUniform(objectUniforms);
+				m_GLState.bindBufferRange(GL_UNIFORM_BUFFER, ObjectUniformBinding, objectAllocation.buffer, objectAllocation.offset, objectAllocation.size);
 
-			glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, (const GLvoid*)(shape.indexOffset * sizeof(GLuint)));
+				glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, (const GLvoid*)(shape.indexOffset * sizeof(GLuint)));
+			}
 		}
 
-		for (GLuint i : {0, 1, 2, 3})
-			glBindSampler(i, 0);
+		for (GLuint i = 0; i < textureArrayCount; ++i)
+			m_GLState.bindSampler(i, 0);
+
+		m_FrameData.endFrame();
 
 
         // GUI code:
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -109,14 +197,25 @@ int Application::run()
 				glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.f);
 			}
 
-			if (ImGui::Button("Sort shapes wrt materialID"))
+			ImGui::Checkbox("Sort draws front to back", &m_bSortFrontToBack);
+			ImGui::Text("Render queue: %zu draws, %zu radix passes", m_RenderQueue.size(), m_RenderQueue.lastSortPassCount());
+			ImGui::Checkbox("Frustum culling", &m_bFrustumCulling);
+			ImGui::Text("Camera: %zu visible, %zu culled", m_CullingStats.visibleCount, m_CullingStats.culledCount);
+			ImGui::Checkbox("Occlusion culling (CPU)", &m_bOcclusionCulling);
+			if (m_bOcclusionCulling)
 			{
-				std::sort(begin(m_shapes), end(m_shapes), [&](auto lhs, auto rhs)
-				{
-					return lhs.materialID < rhs.materialID;
-				});
+				const auto & renderStats = m_OcclusionRasterizer.lastRenderStats();
+				ImGui::Text("Occluders: %zu shapes, %zu / %zu triangles rasterized at %zux%zu", m_nOccluderCount, renderStats.rasterizedTriangleCount,
+					renderStats.occluderTriangleCount, m_OcclusionRasterizer.width(), m_OcclusionRasterizer.height());
+				ImGui::Text("Occlusion: %zu visible, %zu occluded", m_OcclusionStats.visibleCount, m_OcclusionStats.culledCount);
 			}
 
+			if (ImGui::RadioButton("One draw per shape", m_SubmitMode == SubmitMode::PerShape))
+				m_SubmitMode = SubmitMode::PerShape;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Multi-draw indirect", m_SubmitMode == SubmitMode::MultiDrawIndirect))
+				m_SubmitMode = SubmitMode::MultiDrawIndirect;
+
 			//light
 			if (ImGui::CollapsingHeader("Directional Light"))
 			{
@@ -135,6 +234,26 @@ int Application::run()
 				ImGui::InputFloat3("Position", glm::value_ptr(PointLightPosition));
 			}
 
+			if (ImGui::CollapsingHeader("Per frame uniforms"))
+			{
+				m_FrameData.drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL state"))
+			{
+				m_GLState.drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL calls"))
+			{
+				glmlv::drawGLCallStatsGUI(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gl_calls.json"));
+			}
+
+			if (ImGui::CollapsingHeader("GPU memory"))
+			{
+				glmlv::GPUMemoryLedger::get().drawGUI();
+			}
+
             ImGui::End();
         }
 
@@ -152,6 +271,8 @@ int Application::run()
 		m_GLFWHandle.swapBuffers(); // Swap front and back buffers
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
@@ -161,23 +282,39 @@ Application::Application(int argc, char** argv):
     m_ImGuiIniFilename { m_AppName + ".imgui.ini" },
     m_ShadersRootPath { m_AppPath.parent_path() / "shaders" }
 {
+	// The C++ structs uploaded to the uniform buffers must match the std140 blocks of forward.vs.glsl / forward.fs.glsl
+	static_assert(FrameUniformsLayout::matches({ offsetof(FrameUniforms, directionalLightDir), offsetof(FrameUniforms, directionalLightIntensity),
+	    offsetof(FrameUniforms, pointLightPosition), offsetof(FrameUniforms, pointLightIntensity) }, sizeof(FrameUniforms)),
+	    "FrameUniforms does not match the std140 block uFrame");
+	static_assert(ObjectUniformsLayout::matches({ offsetof(ObjectUniforms, modelViewProjMatrix), offsetof(ObjectUniforms, modelViewMatrix),
+	    offsetof(ObjectUniforms, normalMatrix) }, sizeof(ObjectUniforms)),
+	    "ObjectUniforms does not match the std140 block uObject");
+	static_assert(PhongMaterialLayout::matches({ offsetof(PhongMaterial, Ka), offsetof(PhongMaterial, KaArray),
+	    offsetof(PhongMaterial, Kd), offsetof(PhongMaterial, KdArray), offsetof(PhongMaterial, Ks), offsetof(PhongMaterial, KsArray),
+	    offsetof(PhongMaterial, shininess), offsetof(PhongMaterial, shininessArray), offsetof(PhongMaterial, layers),
+	    offsetof(PhongMaterial, KaUVTransform), offsetof(PhongMaterial, KdUVTransform), offsetof(PhongMaterial, KsUVTransform),
+	    offsetof(PhongMaterial, shininessUVTransform) }, sizeof(PhongMaterial)),
+	    "PhongMaterial does not match the std140 block uMaterial");
+	static_assert(CameraUniformsLayout::matches({ offsetof(CameraUniforms, viewMatrix), offsetof(CameraUniforms, projMatrix) }, sizeof(CameraUniforms)),
+	    "CameraUniforms does not match the std140 block uCamera");
+	static_assert(DrawDataLayout::matches({ offsetof(DrawData, localToWorldMatrix), offsetof(DrawData, localToWorldNormalMatrix),
+	    offsetof(DrawData, materialIndex) }, sizeof(DrawData)),
+	    "DrawData does not match the std430 struct DrawData");
+	static_assert(sizeof(PhongMaterial) == PhongMaterialLayout::size(), "The materials of the storage block must have the same layout as the uniform block");
+
 	if (argc < 2)
 	{
-		std::cerr << "Usage: " << argv[0] << " < path to model >" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " < path to model > [--max-texture-size <pixels>] [--texture-budget <megabytes>]" << std::endl;
 		exit(-1);
 	}
 
 	ImGui::GetIO().IniFilename = m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows positions in this file
 
-	glGenBuffers(1, &vboObjModel);
-	glGenBuffers(1, &iboObjModel);
-
-
 	{
 		//we can also do like for the textures m_AppPath.parent_path()/m_AppName/argv[1] and so just put file.obj on the arguments 
 		const auto objPath = glmlv::fs::path{ argv[1] };
 		glmlv::SceneData data;
-		loadObjScene(objPath, data);
+		loadObjScene(objPath, data, true, glmlv::parseTextureLoadOptions(argc, argv));
 		m_SceneSize = glm::length(data.bboxMax - data.bboxMin);
 
 		std::cout << "# of shapes    : " << data.shapeCount << std::endl;
@@ -186,15 +323,9 @@ Application::Application(int argc, char** argv):
 		std::cout << "# of triangles    : " << data.indexBuffer.size() / 3 << std::endl;
 		std::cerr << "bbox : " << data.bboxMin << ", " << data.bboxMax << std::endl;
 
-		// Fill VBO
-		glBindBuffer(GL_ARRAY_BUFFER, vboObjModel);
-		glBufferStorage(GL_ARRAY_BUFFER, data.vertexBuffer.size() * sizeof(glmlv::Vertex3f3f2f), data.vertexBuffer.data(), 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// Fill IBO
-		glBindBuffer(GL_ARRAY_BUFFER, iboObjModel);
-		glBufferStorage(GL_ARRAY_BUFFER, data.indexBuffer.size() * sizeof(uint32_t), data.indexBuffer.data(), 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// Fill VBO and IBO
+		vboObjModel.setStorage(data.vertexBuffer.size() * sizeof(glmlv::Vertex3f3f2f), data.vertexBuffer.data());
+		iboObjModel.setStorage(data.indexBuffer.size() * sizeof(uint32_t), data.indexBuffer.data());
 
 		// Init shape infos
 		uint32_t indexOffset = 0;
@@ -207,114 +338,156 @@ Application::Application(int argc, char** argv):
 			shape.materialID = data.materialIDPerShape[shapeID];
 			shape.localToWorldMatrix = data.localToWorldMatrixPerShape[shapeID];
 			indexOffset += shape.indexCount;
-		}
 
-		glGenTextures(1, &m_WhiteTexture);
-		glBindTexture(GL_TEXTURE_2D, m_WhiteTexture);
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, 1, 1);
-		glm::vec4 white(1.f, 1.f, 1.f, 1.f);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_FLOAT, &white);
-		glBindTexture(GL_TEXTURE_2D, 0);
+			// Sphere around the world space box of the corners of the local bounding box
+			auto worldBBoxMin = glm::vec3(std::numeric_limits<float>::max());
+			auto worldBBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
+			for (auto corner = 0; corner < 8; ++corner)
+			{
+				const auto localCorner = glm::vec3(corner & 1 ? data.bboxMaxPerShape[shapeID].x : data.bboxMinPerShape[shapeID].x,
+					corner & 2 ? data.bboxMaxPerShape[shapeID].y : data.bboxMinPerShape[shapeID].y,
+					corner & 4 ? data.bboxMaxPerShape[shapeID].z : data.bboxMinPerShape[shapeID].z);
+				const auto worldCorner = glm::vec3(shape.localToWorldMatrix * glm::vec4(localCorner, 1));
+				worldBBoxMin = glm::min(worldBBoxMin, worldCorner);
+				worldBBoxMax = glm::max(worldBBoxMax, worldCorner);
+			}
+			shape.boundingSphereCenter = 0.5f * (worldBBoxMin + worldBBoxMax);
+			shape.boundingSphereRadius = 0.5f * glm::length(worldBBoxMax - worldBBoxMin);
+			m_ShapeBounds.push(worldBBoxMin, worldBBoxMax);
+		}
+		m_RenderQueue.reserve(m_shapes.size());
 
-		// Upload all textures to the GPU
-		std::vector<GLint> textureIds;
-		for (const auto & texture : data.textures)
+		// Occluders: the shapes with the largest bounding spheres among those cheap enough to rasterize each frame
+		std::vector<size_t> occluders;
+		for (size_t i = 0; i < m_shapes.size(); ++i)
 		{
-			GLuint texId = 0;
-			glGenTextures(1, &texId);
-			glBindTexture(GL_TEXTURE_2D, texId);
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, texture.width(), texture.height());
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.width(), texture.height(), GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-			glBindTexture(GL_TEXTURE_2D, 0);
-
-			textureIds.emplace_back(texId);
+			if (m_shapes[i].indexCount / 3 <= MaxOccluderTriangleCount)
+				occluders.emplace_back(i);
 		}
-
-		for (const auto & material : data.materials)
+		std::sort(begin(occluders), end(occluders), [&](size_t a, size_t b) { return m_shapes[a].boundingSphereRadius > m_shapes[b].boundingSphereRadius; });
+		occluders.resize(std::min(occluders.size(), size_t(MaxOccluderCount)));
+		for (const auto i : occluders)
 		{
-			PhongMaterial newMaterial;
-			newMaterial.Ka = material.Ka;
-			newMaterial.Kd = material.Kd;
-			newMaterial.Ks = material.Ks;
-			newMaterial.shininess = material.shininess;
-			newMaterial.KaTextureId = material.KaTextureId >= 0 ? textureIds[material.KaTextureId] : m_WhiteTexture;
-			newMaterial.KdTextureId = material.KdTextureId >= 0 ? textureIds[material.KdTextureId] : m_WhiteTexture;
-			newMaterial.KsTextureId = material.KsTextureId >= 0 ? textureIds[material.KsTextureId] : m_WhiteTexture;
-			newMaterial.shininessTextureId = material.shininessTextureId >= 0 ? textureIds[material.shininessTextureId] : m_WhiteTexture;
-
-			m_SceneMaterials.emplace_back(newMaterial);
+			const auto & shape = m_shapes[i];
+			m_OcclusionRasterizer.addOccluder(data.vertexBuffer, data.indexBuffer.data() + shape.indexOffset, shape.indexCount, shape.localToWorldMatrix);
 		}
+		m_nOccluderCount = occluders.size();
+		std::cout << "Occluders: " << m_nOccluderCount << " shapes, " << m_OcclusionRasterizer.occluderTriangleCount() << " triangles" << std::endl;
+
+		// A white 1x1 texture for materials without texture, R8 is expanded to (1, 1, 1, 1) by the swizzle mask
+		glmlv::Image2DR8 white(1, 1);
+		white.data()[0] = 255;
+		data.textures.emplace_back(std::move(white));
+
+		// Upload all textures to the GPU, packed in a few texture arrays
+		// Each texture keeps the format of its file (e.g. R8 for grayscale masks), the swizzle mask expands it to RGBA for the shaders
+		const auto textureRefs = m_TexturePacker.pack(data.textures);
+		m_WhiteTexture = textureRefs.back();
+		std::cout << "Packed textures: " << m_TexturePacker.byteSize() / (1024. * 1024.) << " MB with mipmaps" << std::endl;
+
+		// Images that failed to load are not packed
+		const auto getTextureRef = [&](int32_t textureId)
+		{
+			return textureId >= 0 && textureRefs[textureId].arrayIndex >= 0 ? textureRefs[textureId] : m_WhiteTexture;
+		};
 
-		m_DefaultMaterial.Ka = glm::vec3(0);
-		m_DefaultMaterial.Kd = glm::vec3(1);
-		m_DefaultMaterial.Ks = glm::vec3(1);
-		m_DefaultMaterial.shininess = 32.f;
-		m_DefaultMaterial.KaTextureId = m_WhiteTexture;
-		m_DefaultMaterial.KdTextureId = m_WhiteTexture;
-		m_DefaultMaterial.KsTextureId = m_WhiteTexture;
-		m_DefaultMaterial.shininessTextureId = m_WhiteTexture;
-	}
+		std::vector<PhongMaterial> materials;
+		const auto addMaterial = [&](glm::vec3 Ka, glm::vec3 Kd, glm::vec3 Ks, float shininess, int32_t KaTextureId, int32_t KdTextureId, int32_t KsTextureId, int32_t shininessTextureId)
+		{
+			const auto KaTexture = getTextureRef(KaTextureId), KdTexture = getTextureRef(KdTextureId), KsTexture = getTextureRef(KsTextureId), shininessTexture = getTextureRef(shininessTextureId);
 
+			PhongMaterial newMaterial;
+			newMaterial.Ka = Ka;
+			newMaterial.Kd = Kd;
+			newMaterial.Ks = Ks;
+			newMaterial.shininess = shininess;
+			newMaterial.KaArray = KaTexture.arrayIndex;
+			newMaterial.KdArray = KdTexture.arrayIndex;
+			newMaterial.KsArray = KsTexture.arrayIndex;
+			newMaterial.shininessArray = shininessTexture.arrayIndex;
+			newMaterial.layers = glm::ivec4(KaTexture.layer, KdTexture.layer, KsTexture.layer, shininessTexture.layer);
+			newMaterial.KaUVTransform = glm::vec4(KaTexture.uvScale, KaTexture.uvOffset);
+			newMaterial.KdUVTransform = glm::vec4(KdTexture.uvScale, KdTexture.uvOffset);
+			newMaterial.KsUVTransform = glm::vec4(KsTexture.uvScale, KsTexture.uvOffset);
+			newMaterial.shininessUVTransform = glm::vec4(shininessTexture.uvScale, shininessTexture.uvOffset);
+			materials.emplace_back(newMaterial);
+		};
 
-	// Fill VAO
-	glGenVertexArrays(1, &vaoObjModel);
-	glBindVertexArray(vaoObjModel);
+		for (const auto & material : data.materials) {
+			addMaterial(material.Ka, material.Kd, material.Ks, material.shininess, material.KaTextureId, material.KdTextureId, material.KsTextureId, material.shininessTextureId);
+		}
 
-	const GLint positionAttrLocation = 0;
-	const GLint normalAttrLocation = 1;
-	const GLint texCoordsAttrLocation = 2;
+		m_DefaultMaterialIndex = int32_t(materials.size());
+		addMaterial(glm::vec3(0), glm::vec3(1), glm::vec3(1), 32.f, -1, -1, -1, -1);
 
-	// We tell OpenGL what vertex attributes our VAO is describing:
-	glEnableVertexAttribArray(positionAttrLocation);
-	glEnableVertexAttribArray(normalAttrLocation);
-	glEnableVertexAttribArray(texCoordsAttrLocation);
+		// Uploaded once, each material is then selected by binding its range of the buffer
+		m_Materials = glmlv::TypedBuffer<PhongMaterial>(GL_UNIFORM_BUFFER, materials);
+		m_MaterialStorage.setStorage(GLsizeiptr(materials.size() * sizeof(PhongMaterial)), materials.data());
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboObjModel); // We bind the VBO because the next 3 calls will read what VBO is bound in order to know where the data is stored
+		// Worst case: each block padded to 256 bytes, the largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT in practice
+		const auto paddedSize = [](size_t byteSize) { return (byteSize + 255) / 256 * 256; };
+		const auto perShapeByteSize = std::max(paddedSize(sizeof(ObjectUniforms)), sizeof(glmlv::DrawElementsIndirectCommand));
+		m_FrameData = glmlv::PersistentRingBuffer(paddedSize(sizeof(FrameUniforms)) + paddedSize(sizeof(CameraUniforms)) + m_shapes.size() * perShapeByteSize + sizeof(GLuint));
+	}
 
-	glVertexAttribPointer(positionAttrLocation, 3, GL_FLOAT, GL_FALSE, sizeof(glmlv::Vertex3f3f2f), (const GLvoid*)offsetof(glmlv::Vertex3f3f2f, position));
-	glVertexAttribPointer(normalAttrLocation, 3, GL_FLOAT, GL_FALSE, sizeof(glmlv::Vertex3f3f2f), (const GLvoid*)offsetof(glmlv::Vertex3f3f2f, normal));
-	glVertexAttribPointer(texCoordsAttrLocation, 2, GL_FLOAT, GL_FALSE, sizeof(glmlv::Vertex3f3f2f), (const GLvoid*)offsetof(glmlv::Vertex3f3f2f, texCoords));
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0); // We can unbind the VBO because OpenGL has "written" in the VAO what VBO it needs to read when the VAO will be drawn
+	// Fill VAO
+	const GLuint positionAttrLocation = 0;
+	const GLuint normalAttrLocation = 1;
+	const GLuint texCoordsAttrLocation = 2;
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboObjModel); // Binding the IBO to GL_ELEMENT_ARRAY_BUFFER while a VAO is bound "writes" it in the VAO for usage when the VAO will be drawn
+	// The three attributes are interleaved in the VBO, attached to binding index 0
+	vaoObjModel.setVertexBuffer(0, vboObjModel.glId(), 0, sizeof(glmlv::Vertex3f3f2f));
+	vaoObjModel.setAttribute(positionAttrLocation, 0, 3, GL_FLOAT, GL_FALSE, offsetof(glmlv::Vertex3f3f2f, position));
+	vaoObjModel.setAttribute(normalAttrLocation, 0, 3, GL_FLOAT, GL_FALSE, offsetof(glmlv::Vertex3f3f2f, normal));
+	vaoObjModel.setAttribute(texCoordsAttrLocation, 0, 2, GL_FLOAT, GL_FALSE, offsetof(glmlv::Vertex3f3f2f, texCoords));
 
-	glBindVertexArray(0);
+	vaoObjModel.setElementBuffer(iboObjModel.glId());
+
+	// Draw index of the multi-draw indirect path: one value per instance, each command reads element baseInstance
+	if (!m_shapes.empty())
+	{
+		std::vector<uint32_t> drawIndices(m_shapes.size());
+		std::iota(begin(drawIndices), end(drawIndices), 0u);
+		m_DrawIndices.setStorage(GLsizeiptr(drawIndices.size() * sizeof(uint32_t)), drawIndices.data());
+		vaoObjModel.setVertexBuffer(DrawIndexBindingIndex, m_DrawIndices.glId(), 0, sizeof(uint32_t));
+		vaoObjModel.setIntegerAttribute(DrawIndexAttrLocation, DrawIndexBindingIndex, 1, GL_UNSIGNED_INT, 0);
+		vaoObjModel.setBindingDivisor(DrawIndexBindingIndex, 1);
+
+		// Per draw data is indexed by shape, it does not depend on the order of the commands
+		std::vector<DrawData> drawData;
+		for (const auto & shape : m_shapes)
+		{
+			DrawData data;
+			data.localToWorldMatrix = shape.localToWorldMatrix;
+			data.localToWorldNormalMatrix = glm::transpose(glm::inverse(shape.localToWorldMatrix));
+			data.materialIndex = shape.materialID >= 0 ? shape.materialID : m_DefaultMaterialIndex;
+			drawData.emplace_back(data);
+		}
+		m_DrawData = glmlv::GLBuffer(drawData);
+	}
 
-	// Note: no need to bind a sampler for modifying it: the sampler API is already direct_state_access
-	glGenSamplers(1, &textureSampler);
-	glSamplerParameteri(textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glSamplerParameteri(textureSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	textureSampler.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	textureSampler.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_MULTISAMPLE);
 
-	program = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "forward.vs.glsl", m_ShadersRootPath / m_AppName / "forward.fs.glsl" });
+	// The length of uTextureArrays is the limit of the packer
+	const glmlv::ShaderDefines textureArrayDefines = { { "TEXTURE_ARRAY_COUNT", std::to_string(glmlv::TexturePackerOptions::DefaultMaxArrayCount) } };
+	const auto loadShaders = [&](const char * vsName, const char * fsName) -> std::vector<glmlv::ShaderSource>
+	{
+		return { glmlv::loadShaderVariant(m_ShadersRootPath / m_AppName / vsName, textureArrayDefines),
+			glmlv::loadShaderVariant(m_ShadersRootPath / m_AppName / fsName, textureArrayDefines) };
+	};
+	glmlv::ProgramBuilder programBuilder;
+	const auto indirectProgram = programBuilder.add(loadShaders("forwardIndirect.vs.glsl", "forwardIndirect.fs.glsl"));
+	const auto forwardProgram = programBuilder.add(loadShaders("forward.vs.glsl", "forward.fs.glsl"));
+	m_IndirectProgram = programBuilder.take(indirectProgram);
+	program = programBuilder.take(forwardProgram);
 	program.use();
 
 	
-	//light
-	uModelViewProjMatrixLocation = glGetUniformLocation(program.glId(), "uModelViewProjMatrix");
-	uModelViewMatrixLocation = glGetUniformLocation(program.glId(), "uModelViewMatrix");
-	uNormalMatrixLocation = glGetUniformLocation(program.glId(), "uNormalMatrix");
-
-
-	uDirectionalLightDirLocation = glGetUniformLocation(program.glId(), "uDirectionalLightDir");
-	uDirectionalLightIntensityLocation = glGetUniformLocation(program.glId(), "uDirectionalLightIntensity");
-
-	uPointLightPositionLocation = glGetUniformLocation(program.glId(), "uPointLightPosition");
-	uPointLightIntensityLocation = glGetUniformLocation(program.glId(), "uPointLightIntensity");
-
-	uKaLocation = glGetUniformLocation(program.glId(), "uKa");
-	uKdLocation = glGetUniformLocation(program.glId(), "uKd");
-	uKsLocation = glGetUniformLocation(program.glId(), "uKs");
-	uShininessLocation = glGetUniformLocation(program.glId(), "uShininess");
-	uKaSamplerLocation = glGetUniformLocation(program.glId(), "uKaSampler");
-	uKdSamplerLocation = glGetUniformLocation(program.glId(), "uKdSampler");
-	uKsSamplerLocation = glGetUniformLocation(program.glId(), "uKsSampler");
-	uShininessSamplerLocation = glGetUniformLocation(program.glId(), "uShininessSampler");
-
 	//view
 	viewController.setSpeed(m_SceneSize * 0.1f); // Let's travel 10% of the scene per second
 }
-
@@ -5,6 +5,18 @@
 #include <glmlv/GLProgram.hpp>
 #include <glmlv/ViewController.hpp>
 #include <glmlv/simple_geometry.hpp>
+#include <glmlv/TexturePacker.hpp>
+#include <glmlv/BufferLayout.hpp>
+#include <glmlv/TypedBuffer.hpp>
+#include <glmlv/PersistentRingBuffer.hpp>
+#include <glmlv/GLBuffer.hpp>
+#include <glmlv/GLSampler.hpp>
+#include <glmlv/GLVertexArray.hpp>
+#include <glmlv/GLStateCache.hpp>
+#include <glmlv/indirect_draw.hpp>
+#include <glmlv/RenderQueue.hpp>
+#include <glmlv/frustum_culling.hpp>
+#include <glmlv/OcclusionRasterizer.hpp>
 #include <glm/glm.hpp>
 #include <limits>
 
@@ -15,7 +27,6 @@ public:
 
     int run();
 private:
-	
 	static glm::vec3 computeDirectionVector(float phiRadians, float thetaRadians)
 	{
 		const auto cosPhi = glm::cos(phiRadians);
@@ -34,9 +45,9 @@ private:
     const glmlv::fs::path m_ShadersRootPath;
 
 	//Creation of vao, vbo and ibo for obj model
-	GLuint vaoObjModel = 0;
-	GLuint vboObjModel = 0;
-	GLuint iboObjModel = 0;
+	glmlv::GLVertexArray vaoObjModel;
+	glmlv::GLBuffer vboObjModel;
+	glmlv::GLBuffer iboObjModel;
 
 	// Required data about the scene in CPU in order to send draw calls
 	struct ShapeInfo
@@ -45,54 +56,128 @@ private:
 		uint32_t indexOffset; // Offset in GPU index buffer
 		int materialID = -1;
 		glm::mat4 localToWorldMatrix;
+		glm::vec3 boundingSphereCenter; // World space, encloses the bounding box of the shape
+		float boundingSphereRadius = 0.f;
 	};
 
 	std::vector<ShapeInfo> m_shapes; // For each shape of the scene, its number of indices
 	float m_SceneSize = 0.f; // Used for camera speed and projection matrix parameters
 
-	struct PhongMaterial
+	// Contents of the uniform blocks of forward.fs.glsl / forward.vs.glsl, the layouts describing them are checked in Application.cpp
+	struct FrameUniforms // Binding FrameUniformBinding, updated once per frame
+	{
+		glm::vec3 directionalLightDir;
+		float padding0;
+		glm::vec3 directionalLightIntensity;
+		float padding1;
+		glm::vec3 pointLightPosition;
+		float padding2;
+		glm::vec3 pointLightIntensity;
+		float padding3;
+	};
+	using FrameUniformsLayout = glmlv::Std140Layout<glm::vec3, glm::vec3, glm::vec3, glm::vec3>;
+
+	struct ObjectUniforms // Binding ObjectUniformBinding, one element per shape updated once per frame
+	{
+		glm::mat4 modelViewProjMatrix;
+		glm::mat4 modelViewMatrix;
+		glm::mat4 normalMatrix;
+	};
+	using ObjectUniformsLayout = glmlv::Std140Layout<glm::mat4, glm::mat4, glm::mat4>;
+
+	struct PhongMaterial // Binding MaterialUniformBinding, one element per material uploaded once at load
 	{
 		glm::vec3 Ka = glm::vec3(0); // Ambient multiplier
+		int32_t KaArray = 0; // Index of the array of each texture in m_TexturePacker, also its texture unit
 		glm::vec3 Kd = glm::vec3(0); // Diffuse multiplier
+		int32_t KdArray = 0;
 		glm::vec3 Ks = glm::vec3(0); // Glossy multiplier
+		int32_t KsArray = 0;
 		float shininess = 1.f; // Glossy exponent
+		int32_t shininessArray = 0;
+		glm::vec2 padding;
+		glm::ivec4 layers = glm::ivec4(0); // Layer of each texture in its array: Ka, Kd, Ks, shininess
+		glm::vec4 KaUVTransform = glm::vec4(1, 1, 0, 0); // xy: scale, zw: offset in the layer
+		glm::vec4 KdUVTransform = glm::vec4(1, 1, 0, 0);
+		glm::vec4 KsUVTransform = glm::vec4(1, 1, 0, 0);
+		glm::vec4 shininessUVTransform = glm::vec4(1, 1, 0, 0);
+	};
+	using PhongMaterialLayout = glmlv::Std140Layout<glm::vec3, int32_t, glm::vec3, int32_t, glm::vec3, int32_t, float, int32_t, glm::ivec4, glm::vec4, glm::vec4, glm::vec4, glm::vec4>;
+
+	static const GLuint FrameUniformBinding = 0;
+	static const GLuint ObjectUniformBinding = 1;
+	static const GLuint MaterialUniformBinding = 2;
 
-		// OpenGL texture ids:
-		GLuint KaTextureId = 0;
-		GLuint KdTextureId = 0;
-		GLuint KsTextureId = 0;
-		GLuint shininessTextureId = 0;
+	// Multi-draw indirect path (forwardIndirect.vs.glsl / forwardIndirect.fs.glsl): the whole scene is drawn with one glMultiDrawElementsIndirect.
+	// The commands are written each frame in the order of m_RenderQueue, the command of m_shapes[i] has baseInstance i, which the vertex
+	// shader reads back through the instanced attribute aDrawIndex to index per draw data and materials stored in shader storage buffers.
+	enum class SubmitMode
+	{
+		PerShape, // One glDrawElements per shape, object uniforms written in m_FrameData
+		MultiDrawIndirect
 	};
 
-	GLuint m_WhiteTexture; // A white 1x1 texture
-	PhongMaterial m_DefaultMaterial;
-	std::vector<PhongMaterial> m_SceneMaterials;
+	struct CameraUniforms // Binding CameraUniformBinding, updated once per frame
+	{
+		glm::mat4 viewMatrix;
+		glm::mat4 projMatrix;
+	};
+	using CameraUniformsLayout = glmlv::Std140Layout<glm::mat4, glm::mat4>;
 
-	GLuint textureSampler = 0; // Only one sampler object since we will use the same sampling parameters for all textures
+	struct DrawData // Element of the storage block at DrawDataStorageBinding, one per shape
+	{
+		glm::mat4 localToWorldMatrix;
+		glm::mat4 localToWorldNormalMatrix;
+		int32_t materialIndex;
+		int32_t padding[3];
+	};
+	using DrawDataLayout = glmlv::Std430Layout<glm::mat4, glm::mat4, int32_t>;
+
+	static const GLuint CameraUniformBinding = 3;
+	static const GLuint DrawDataStorageBinding = 0;
+	static const GLuint MaterialStorageBinding = 1;
+	static const GLuint DrawIndexAttrLocation = 3;
+	static const GLuint DrawIndexBindingIndex = 1;
+
+	SubmitMode m_SubmitMode = SubmitMode::MultiDrawIndirect;
+	glmlv::GLBuffer m_DrawData; // DrawData per shape
+	glmlv::GLBuffer m_DrawIndices; // 0, 1, 2, ... read by aDrawIndex
+	glmlv::GLBuffer m_MaterialStorage; // Same materials as m_Materials, tightly packed for an array in a storage block
+
+	glmlv::TexturePacker m_TexturePacker; // All scene textures, plus a white 1x1 texture for materials without texture
+	glmlv::PackedTextureRef m_WhiteTexture;
+
+	// All shapes are submitted to the queue each frame, with keys sorting them by material then front to back (by depth only for the
+	// multi-draw, whose single call does not change materials). Front to back ordering lets early depth testing skip hidden fragments.
+	glmlv::RenderQueue m_RenderQueue;
+	bool m_bSortFrontToBack = true;
+
+	// Shapes outside the camera frustum are not submitted to the queue
+	glmlv::CullingBounds m_ShapeBounds; // World space box of each shape
+	std::vector<uint8_t> m_ShapeVisibility;
+	glmlv::CullingStats m_CullingStats;
+	bool m_bFrustumCulling = true;
+
+	// Then shapes hidden behind the occluders, rasterized on the CPU each frame, are not submitted either. The occluders are the
+	// largest shapes with few triangles, selected at load.
+	static const size_t MaxOccluderCount = 64;
+	static const size_t MaxOccluderTriangleCount = 2048; // Per shape
+	glmlv::OcclusionRasterizer m_OcclusionRasterizer{ 320, 180 };
+	size_t m_nOccluderCount = 0;
+	glmlv::CullingStats m_OcclusionStats;
+	bool m_bOcclusionCulling = true;
+
+	glmlv::PersistentRingBuffer m_FrameData; // FrameUniforms, then ObjectUniforms of each shape or the draw commands, rewritten every frame
+	glmlv::TypedBuffer<PhongMaterial> m_Materials; // Scene materials followed by the default material
+	int32_t m_DefaultMaterialIndex = 0;
+
+	glmlv::GLSampler textureSampler; // Only one sampler object since we will use the same sampling parameters for all textures (bound to a unit per texture array)
 
 	glmlv::ViewController viewController{ m_GLFWHandle.window(), 3.f };
 
-	GLint uModelViewProjMatrixLocation;
-	GLint uModelViewMatrixLocation;
-	GLint uNormalMatrixLocation;
-
 	glmlv::GLProgram program;
-
-	
-	GLint uDirectionalLightDirLocation;
-	GLint uDirectionalLightIntensityLocation;
-
-	GLint uPointLightPositionLocation;
-	GLint uPointLightIntensityLocation;
-
-	GLint uKaLocation;
-	GLint uKdLocation;
-	GLint uKsLocation;
-	GLint uShininessLocation;
-	GLint uKaSamplerLocation;
-	GLint uKdSamplerLocation;
-	GLint uKsSamplerLocation;
-	GLint uShininessSamplerLocation;
+	glmlv::GLProgram m_IndirectProgram;
+	glmlv::GLStateCache m_GLState; // Programs, vertex arrays, textures, samplers and buffers of the render loop are bound through it
 
 	float DirLightPhiAngleDegrees = 90.f;
 	float DirLightThetaAngleDegrees = 45.f;
@@ -1,4 +1,4 @@
-#version 330
+#version 430
 
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
@@ -6,28 +6,52 @@ in vec2 vTexCoords;
 
 out vec3 fColor;
 
-uniform vec3 uDirectionalLightDir;
-uniform vec3 uDirectionalLightIntensity;
+// Updated once per frame
+layout(std140, binding = 0) uniform uFrame
+{
+    vec3 uDirectionalLightDir;
+    vec3 uDirectionalLightIntensity;
+    vec3 uPointLightPosition;
+    vec3 uPointLightIntensity;
+};
 
-uniform vec3 uPointLightPosition;
-uniform vec3 uPointLightIntensity;
+// Textures are packed in texture arrays by glmlv::TexturePacker, array i being bound to unit i for the whole frame.
+// A material locates each of its textures with the index of its array, its layer and a uv transform (xy: scale, zw: offset).
+// TEXTURE_ARRAY_COUNT is defined by the application: the maximum number of arrays of the packer.
+layout(binding = 0) uniform sampler2DArray uTextureArrays[TEXTURE_ARRAY_COUNT];
 
-uniform vec3 uKa;
-uniform vec3 uKd;
-uniform vec3 uKs;
-uniform float uShininess;
+// All materials are uploaded once in a uniform buffer, the application binds the range of the current material
+layout(std140, binding = 2) uniform uMaterial
+{
+    vec3 uKa;
+    int uKaArray;
+    vec3 uKd;
+    int uKdArray;
+    vec3 uKs;
+    int uKsArray;
+    float uShininess;
+    int uShininessArray;
+    ivec4 uLayers; // Ka, Kd, Ks, shininess
+    vec4 uKaUVTransform;
+    vec4 uKdUVTransform;
+    vec4 uKsUVTransform;
+    vec4 uShininessUVTransform;
+};
 
-uniform sampler2D uKaSampler;
-uniform sampler2D uKdSampler;
-uniform sampler2D uKsSampler;
-uniform sampler2D uShininessSampler;
+vec4 texturePacked(sampler2DArray s, int layer, vec4 uvTransform, vec2 uv)
+{
+    // fract() repeats the texture inside its atlas rectangle, explicit gradients avoid selecting the smallest mip where it wraps
+    vec2 packedUV = fract(uv) * uvTransform.xy + uvTransform.zw;
+    return textureGrad(s, vec3(packedUV, layer), dFdx(uv) * uvTransform.xy, dFdy(uv) * uvTransform.xy);
+}
 
 void main()
 {
-    vec3 ka = uKa * vec3(texture(uKaSampler, vTexCoords));
-    vec3 kd = uKd * vec3(texture(uKdSampler, vTexCoords));
-    vec3 ks = uKs * vec3(texture(uKsSampler, vTexCoords));
-    float shininess = uShininess * vec3(texture(uShininessSampler, vTexCoords)).x;
+    // Array indices come from a uniform block, so they are dynamically uniform as required to index an array of samplers
+    vec3 ka = uKa * vec3(texturePacked(uTextureArrays[uKaArray], uLayers.x, uKaUVTransform, vTexCoords));
+    vec3 kd = uKd * vec3(texturePacked(uTextureArrays[uKdArray], uLayers.y, uKdUVTransform, vTexCoords));
+    vec3 ks = uKs * vec3(texturePacked(uTextureArrays[uKsArray], uLayers.z, uKsUVTransform, vTexCoords));
+    float shininess = uShininess * texturePacked(uTextureArrays[uShininessArray], uLayers.w, uShininessUVTransform, vTexCoords).x;
 
     vec3 normal = normalize(vViewSpaceNormal);
     vec3 eyeDir = normalize(-vViewSpacePosition);
@@ -1,5 +1,5 @@
 
-#version 330
+#version 430
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
@@ -11,9 +11,13 @@ out vec3 vViewSpaceNormal;
 out vec2 vTexCoords;
 //out vec3 Tangent;
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uNormalMatrix;
+// Per object data, the application binds the range of the object being drawn
+layout(std140, binding = 1) uniform uObject
+{
+    mat4 uModelViewProjMatrix;
+    mat4 uModelViewMatrix;
+    mat4 uNormalMatrix;
+};
 
 void main()
 {
@@ -0,0 +1,98 @@
+#version 430
+
+in vec3 vViewSpacePosition;
+in vec3 vViewSpaceNormal;
+in vec2 vTexCoords;
+flat in int vMaterialIndex;
+
+out vec3 fColor;
+
+// Updated once per frame
+layout(std140, binding = 0) uniform uFrame
+{
+    vec3 uDirectionalLightDir;
+    vec3 uDirectionalLightIntensity;
+    vec3 uPointLightPosition;
+    vec3 uPointLightIntensity;
+};
+
+// Textures are packed in texture arrays by glmlv::TexturePacker, array i being bound to unit i for the whole frame.
+// A material locates each of its textures with the index of its array, its layer and a uv transform (xy: scale, zw: offset).
+// TEXTURE_ARRAY_COUNT is defined by the application: the maximum number of arrays of the packer.
+layout(binding = 0) uniform sampler2DArray uTextureArrays[TEXTURE_ARRAY_COUNT];
+
+struct PhongMaterial
+{
+    vec3 Ka;
+    int KaArray;
+    vec3 Kd;
+    int KdArray;
+    vec3 Ks;
+    int KsArray;
+    float shininess;
+    int shininessArray;
+    ivec4 layers; // Ka, Kd, Ks, shininess
+    vec4 KaUVTransform;
+    vec4 KdUVTransform;
+    vec4 KsUVTransform;
+    vec4 shininessUVTransform;
+};
+
+// All materials, uploaded once. vMaterialIndex comes from the per draw data of the multi-draw.
+layout(std430, binding = 1) readonly buffer bMaterialStorage
+{
+    PhongMaterial bMaterials[];
+};
+
+// The material index is not dynamically uniform (it is a vertex output, even if it is constant over a draw), so it cannot index the
+// array of samplers: each array is tested with a constant index instead. All the fragments of a draw take the same branch.
+// fract() repeats a texture inside its atlas rectangle, explicit gradients avoid selecting the smallest mip where it wraps;
+// they are computed outside of the branches, where derivatives are defined.
+vec4 texturePackedArray(int arrayIndex, int layer, vec4 uvTransform, vec2 uv)
+{
+    vec2 packedUV = fract(uv) * uvTransform.xy + uvTransform.zw;
+    vec2 dUVdx = dFdx(uv) * uvTransform.xy;
+    vec2 dUVdy = dFdy(uv) * uvTransform.xy;
+
+    vec4 texel = vec4(1);
+    for (int i = 0; i < TEXTURE_ARRAY_COUNT; ++i)
+    {
+        if (i == arrayIndex) {
+            texel = textureGrad(uTextureArrays[i], vec3(packedUV, layer), dUVdx, dUVdy);
+        }
+    }
+    return texel;
+}
+
+void main()
+{
+    PhongMaterial material = bMaterials[vMaterialIndex];
+    vec3 ka = material.Ka * vec3(texturePackedArray(material.KaArray, material.layers.x, material.KaUVTransform, vTexCoords));
+    vec3 kd = material.Kd * vec3(texturePackedArray(material.KdArray, material.layers.y, material.KdUVTransform, vTexCoords));
+    vec3 ks = material.Ks * vec3(texturePackedArray(material.KsArray, material.layers.z, material.KsUVTransform, vTexCoords));
+    float shininess = material.shininess * texturePackedArray(material.shininessArray, material.layers.w, material.shininessUVTransform, vTexCoords).x;
+
+    vec3 normal = normalize(vViewSpaceNormal);
+    vec3 eyeDir = normalize(-vViewSpacePosition);
+
+    float distToPointLight = length(uPointLightPosition - vViewSpacePosition);
+    vec3 dirToPointLight = (uPointLightPosition - vViewSpacePosition) / distToPointLight;
+    vec3 pointLightIncidentLight = uPointLightIntensity / (distToPointLight * distToPointLight);
+
+    // half vectors, for blinn-phong shading
+    vec3 hPointLight = normalize(eyeDir + dirToPointLight);
+    vec3 hDirLight = normalize(eyeDir + uDirectionalLightDir);
+
+    float dothPointLight = shininess == 0 ? 1.f : max(0.f, dot(normal, hPointLight));
+    float dothDirLight = shininess == 0 ? 1.f :max(0.f, dot(normal, hDirLight));
+
+    if (shininess != 1.f && shininess != 0.f)
+    {
+        dothPointLight = pow(dothPointLight, shininess);
+        dothDirLight = pow(dothDirLight, shininess);
+    }
+
+    fColor = ka;
+    fColor += kd * (uDirectionalLightIntensity * max(0.f, dot(normal, uDirectionalLightDir)) + pointLightIncidentLight * max(0., dot(normal, dirToPointLight)));
+    fColor += ks * (uDirectionalLightIntensity * dothDirLight + pointLightIncidentLight * dothPointLight);	
+}
\ No newline at end of file
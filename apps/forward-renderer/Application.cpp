@@ -1,5 +1,7 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+
 #include <iostream>
 
 #include <glmlv/Image2DRGBA.hpp>
@@ -22,6 +24,7 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
 
         // Put here rendering code
 		const auto viewportSize = m_GLFWHandle.framebufferSize();
@@ -94,6 +97,7 @@ int Application::run()
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -141,6 +145,8 @@ int Application::run()
 		m_GLFWHandle.swapBuffers(); // Swap front and back buffers
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
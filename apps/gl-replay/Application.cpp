@@ -0,0 +1,197 @@
+#include "Application.hpp"
+
+#include <glmlv/GPUProfiler.hpp>
+
+#include <json.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+
+struct TimingStats
+{
+    double averageMs = 0.;
+    double minMs = 0.;
+    double maxMs = 0.;
+    double p50Ms = 0.;
+    double p95Ms = 0.;
+    double p99Ms = 0.;
+};
+
+TimingStats computeStats(std::vector<double> samplesMs)
+{
+    TimingStats stats;
+    if (samplesMs.empty()) {
+        return stats;
+    }
+    std::sort(begin(samplesMs), end(samplesMs));
+    const auto percentile = [&](double p) { return samplesMs[std::min(size_t(p * samplesMs.size()), samplesMs.size() - 1)]; };
+    stats.averageMs = std::accumulate(begin(samplesMs), end(samplesMs), 0.) / samplesMs.size();
+    stats.minMs = samplesMs.front();
+    stats.maxMs = samplesMs.back();
+    stats.p50Ms = percentile(0.5);
+    stats.p95Ms = percentile(0.95);
+    stats.p99Ms = percentile(0.99);
+    return stats;
+}
+
+void printStats(const char * name, const TimingStats& stats)
+{
+    std::cout << name << ": avg " << stats.averageMs << " ms, p50 " << stats.p50Ms << ", p95 " << stats.p95Ms << ", p99 " << stats.p99Ms
+        << ", min " << stats.minMs << ", max " << stats.maxMs << std::endl;
+}
+
+nlohmann::json toJSON(const TimingStats& stats)
+{
+    return { { "averageMs", stats.averageMs }, { "minMs", stats.minMs }, { "maxMs", stats.maxMs },
+        { "p50Ms", stats.p50Ms }, { "p95Ms", stats.p95Ms }, { "p99Ms", stats.p99Ms } };
+}
+
+}
+
+int Application::run()
+{
+    m_Trace.createObjects();
+    std::cout << m_Options.tracePath << ": " << m_Trace.commandCount() << " commands, " << m_Trace.objectCount() << " objects, "
+        << (m_Trace.objectByteSize() + m_Trace.commandByteSize()) / 1024 << " KB" << std::endl;
+
+    glmlv::GPUProfiler profiler(4, m_Options.frameCount);
+    std::vector<double> submitMs, frameMs; // CPU time to issue the commands of a frame, time between two frames
+    submitMs.reserve(m_Options.frameCount);
+    frameMs.reserve(m_Options.frameCount);
+
+    const auto totalFrameCount = m_Options.warmupFrameCount + m_Options.frameCount;
+    auto previousFrameStart = glfwGetTime();
+    for (size_t frame = 0; frame < totalFrameCount && !m_GLFWHandle.shouldClose(); ++frame)
+    {
+        const auto measured = frame >= m_Options.warmupFrameCount;
+        const auto frameStart = glfwGetTime();
+        if (measured && frame > m_Options.warmupFrameCount) {
+            frameMs.emplace_back(1000. * (frameStart - previousFrameStart));
+        }
+        previousFrameStart = frameStart;
+
+        if (measured) {
+            profiler.beginFrame();
+        }
+        const auto submitStart = glfwGetTime();
+        m_Trace.replayFrame();
+        if (measured)
+        {
+            submitMs.emplace_back(1000. * (glfwGetTime() - submitStart));
+            profiler.endFrame();
+        }
+
+        glfwPollEvents();
+        m_GLFWHandle.swapBuffers();
+    }
+
+    // Wait for the last frames, then let beginFrame() read their results
+    glFinish();
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    const auto submitStats = computeStats(submitMs);
+    const auto frameStats = computeStats(frameMs);
+    printStats("CPU submit", submitStats);
+    printStats("CPU frame", frameStats);
+
+    nlohmann::json gpuJSON;
+    for (const auto & section : profiler.getStats())
+    {
+        if (section.name != "Frame") {
+            continue;
+        }
+        TimingStats gpuStats;
+        gpuStats.averageMs = section.averageMs;
+        gpuStats.minMs = section.minMs;
+        gpuStats.maxMs = section.maxMs;
+        gpuStats.p50Ms = section.p50Ms;
+        gpuStats.p95Ms = section.p95Ms;
+        gpuStats.p99Ms = section.p99Ms;
+        printStats("GPU frame", gpuStats);
+        gpuJSON = toJSON(gpuStats);
+        gpuJSON["sampleCount"] = section.sampleCount;
+    }
+    if (profiler.getDroppedFrameCount()) {
+        std::cout << profiler.getDroppedFrameCount() << " frames without GPU timings (queries reused before their results were available)" << std::endl;
+    }
+
+    if (!m_Options.jsonPath.empty())
+    {
+        nlohmann::json json;
+        json["trace"] = m_Options.tracePath.string();
+        json["renderer"] = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+        json["commandCount"] = m_Trace.commandCount();
+        json["frameCount"] = submitMs.size();
+        json["warmupFrameCount"] = m_Options.warmupFrameCount;
+        json["cpuSubmit"] = toJSON(submitStats);
+        json["cpuFrame"] = toJSON(frameStats);
+        json["gpuFrame"] = gpuJSON;
+
+        if (m_Options.jsonPath.has_parent_path() && !glmlv::fs::exists(m_Options.jsonPath.parent_path())) {
+            glmlv::fs::create_directories(m_Options.jsonPath.parent_path());
+        }
+        std::ofstream out(m_Options.jsonPath.string());
+        if (!out)
+        {
+            std::cerr << "Unable to open " << m_Options.jsonPath << " for writing" << std::endl;
+            throw std::runtime_error("Unable to open " + m_Options.jsonPath.string() + " for writing");
+        }
+        out << json.dump(4) << std::endl;
+    }
+
+    return 0;
+}
+
+Application::Options Application::parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frameCount = size_t(std::max(std::atoi(argv[++i]), 1));
+        }
+        else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmupFrameCount = size_t(std::max(std::atoi(argv[++i]), 0));
+        }
+        else if (std::strcmp(argv[i], "--json") == 0 && hasValue) {
+            options.jsonPath = argv[++i];
+        }
+        else if (options.tracePath.empty() && argv[i][0] != '-') {
+            options.tracePath = argv[i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            throw std::runtime_error(std::string("Unknown argument ") + argv[i]);
+        }
+    }
+    if (options.tracePath.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace> [--frames N] [--warmup N] [--json path]" << std::endl;
+        throw std::runtime_error("No GL trace given");
+    }
+    return options;
+}
+
+Application::Application(int argc, char** argv):
+    m_AppPath { glmlv::fs::path{ argv[0] } },
+    m_AppName { m_AppPath.stem().string() },
+    m_Options { parseOptions(argc, argv) },
+    m_Trace { m_Options.tracePath }
+{
+    ImGui::GetIO().IniFilename = nullptr; // No GUI
+}
+
+Application::~Application()
+{
+    m_Trace.destroyObjects(); // While the context of m_GLFWHandle exists
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glmlv/filesystem.hpp>
+#include <glmlv/gl_command_trace.hpp>
+#include <glmlv/GLFWHandle.hpp>
+
+// Replay of a GL trace recorded with glmlv::requestGLCommandTraceCapture(), for driver and GPU benchmarks:
+//     gl-replay <trace> [--frames N] [--warmup N] [--json path]
+class Application
+{
+public:
+    Application(int argc, char** argv);
+
+    ~Application();
+
+    int run();
+private:
+    struct Options
+    {
+        glmlv::fs::path tracePath;
+        size_t frameCount = 500; // Measured frames
+        size_t warmupFrameCount = 20; // Replayed before the measures (driver caches, shader compilation on first use)
+        glmlv::fs::path jsonPath; // Empty for no JSON output
+    };
+
+    static Options parseOptions(int argc, char** argv);
+
+    const glmlv::fs::path m_AppPath;
+    const std::string m_AppName;
+    const Options m_Options;
+
+    glmlv::GLCommandTrace m_Trace; // Loaded before the window, which has the size of the recorded framebuffer
+    glmlv::GLFWHandle m_GLFWHandle{ m_Trace.framebufferWidth(), m_Trace.framebufferHeight(), "GL replay" };
+};
@@ -1,5 +1,8 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
 #include <iostream>
 #include <cmath> 
 #include <glmlv/Image2DRGBA.hpp>
@@ -22,6 +25,9 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
+
+        m_GLState.beginFrame(); // ImGui bound its own objects at the end of the previous frame
 
         // WORLD MATRIX
         if (m_model.cameras.size() > 0)
@@ -46,26 +52,30 @@ int Application::run()
 
         // ==== GEOMETRY PASS ==== //
         {
-            m_geometryPassProgram.use();
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
+            m_GLState.useProgram(m_geometryPassProgram.glId());
+            m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO.glId());
 
             glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            glBindSampler(0, m_textureSampler);
+            m_GLState.bindSampler(0, m_textureSampler.glId());
 
             glUniform1i(m_uKdSamplerLocation, 0); // Set the uniform to 0 because we use texture unit 0
 
-            // ACTIVE TEXTURE
-            glActiveTexture(GL_TEXTURE0);
-
             // GLTF DRAWING
-            DrawModel(m_model);
+            if (m_bFrustumCulling)
+            {
+                m_cameraCullingStats = glmlv::cullFrustum(m_drawItemBounds, m_projMatrix * m_viewMatrix, m_cameraVisibility);
+            }
+            else
+            {
+                m_cameraVisibility.assign(m_drawItems.size(), 1);
+                m_cameraCullingStats = glmlv::CullingStats();
+                m_cameraCullingStats.visibleCount = m_drawItems.size();
+            }
+            DrawItems(m_cameraVisibility);
 
-            // UNBIND
-            glBindSampler(0, m_textureSampler);                
-            
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
         }
 
         const auto viewportSize = m_GLFWHandle.framebufferSize();
@@ -76,7 +86,7 @@ int Application::run()
         if (m_CurrentlyDisplayed == GBufferTextureCount) // BEAUTY
         {            
             {
-                m_shadingPassProgram.use();
+                m_GLState.useProgram(m_shadingPassProgram.glId());
 
                 glUniform3fv(m_uDirectionalLightDirLocation, 1, glm::value_ptr(glm::vec3(m_viewMatrix * glm::vec4(glm::normalize(m_DirLightDirection), 0))));
                 glUniform3fv(m_uDirectionalLightIntensityLocation, 1, glm::value_ptr(m_DirLightColor * m_DirLightIntensity));
@@ -86,36 +96,31 @@ int Application::run()
 
                 for (int32_t i = GPosition; i < GDepth; ++i)
                 {
-                    glActiveTexture(GL_TEXTURE0 + i);
-                    glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[i]);
+                    m_GLState.bindTexture(i, m_GBufferTextures[i].glId());
 
                     glUniform1i(m_uGBufferSamplerLocations[i], i);
                 }
 
-                glBindVertexArray(m_TriangleVAO);
+                m_GLState.bindVertexArray(m_TriangleVAO.glId());
                 glDrawArrays(GL_TRIANGLES, 0, 3);
-                glBindVertexArray(0);
             }
         }
         else if (m_CurrentlyDisplayed == GDepth)    // DEPTH
         {
-            m_displayDepthProgram.use();
+            m_GLState.useProgram(m_displayDepthProgram.glId());
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[GDepth]);
+            m_GLState.bindTexture(0, m_GBufferTextures[GDepth].glId());
 
             glUniform1i(m_uGDepthSamplerLocation, 0);
 
-            glBindVertexArray(m_TriangleVAO);
+            m_GLState.bindVertexArray(m_TriangleVAO.glId());
             glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(0);
         }
         else if (m_CurrentlyDisplayed == GPosition) // POSITION
         {
-            m_displayPositionProgram.use();
+            m_GLState.useProgram(m_displayPositionProgram.glId());
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[GPosition]);
+            m_GLState.bindTexture(0, m_GBufferTextures[GPosition].glId());
 
             glUniform1i(m_uGDepthSamplerLocation, 0);
 
@@ -126,19 +131,18 @@ int Application::run()
 
             glUniform3fv(m_uSceneSizeLocation, 1, glm::value_ptr(frustrumTopRight_view / frustrumTopRight_view.w));
 
-            glBindVertexArray(m_TriangleVAO);
+            m_GLState.bindVertexArray(m_TriangleVAO.glId());
             glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(0);
         }
         else    // NORMAL / AMBIENT / GS
         {
             // GBuffer display
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO);
+            m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO.glId());
             glReadBuffer(GL_COLOR_ATTACHMENT0 + m_CurrentlyDisplayed);
             glBlitFramebuffer(0, 0, m_nWindowWidth, m_nWindowHeight,
                 0, 0, m_nWindowWidth, m_nWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         }
         
 
@@ -147,6 +151,7 @@ int Application::run()
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -163,6 +168,12 @@ int Application::run()
                 }
             }
 
+            if (ImGui::CollapsingHeader("Culling"))
+            {
+                ImGui::Checkbox("Frustum culling", &m_bFrustumCulling);
+                ImGui::Text("Camera: %zu visible, %zu culled", m_cameraCullingStats.visibleCount, m_cameraCullingStats.culledCount);
+            }
+
             if (ImGui::CollapsingHeader("GBuffer"))
             {
                 for (int32_t i = GPosition; i <= GBufferTextureCount; ++i)
@@ -172,6 +183,31 @@ int Application::run()
                 }
             }
 
+            if (ImGui::CollapsingHeader("GL state")) {
+                m_GLState.drawGUI();
+            }
+
+            if (ImGui::CollapsingHeader("GL debug output")) {
+                glmlv::drawGLDebugOutputGUI();
+            }
+
+            if (ImGui::CollapsingHeader("GL calls")) {
+                glmlv::drawGLCallStatsGUI(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gl_calls.json"));
+            }
+
+            if (ImGui::CollapsingHeader("GPU memory")) {
+                glmlv::GPUMemoryLedger::get().drawGUI();
+            }
+
+            if (ImGui::CollapsingHeader("GL trace")) {
+                if (glmlv::isGLCommandTraceCapturePending()) {
+                    ImGui::Text("Capturing...");
+                }
+                else if (ImGui::Button("Capture next frame")) {
+                    glmlv::requestGLCommandTraceCapture(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gltrace"));
+                }
+            }
+
             ImGui::End();
         }
 
@@ -191,6 +227,8 @@ int Application::run()
         }
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
@@ -223,7 +261,8 @@ Application::Application(int argc, char** argv):
     }
     const glmlv::fs::path gltfPath = m_AssetsRootPath / glmlv::fs::path{ argv[1] };
 
-    loadTinyGLTF(gltfPath);
+    loadTinyGLTF(gltfPath, glmlv::parseTextureLoadOptions(argc, argv));
+    FlattenModel(m_model);
 
     // 3 - CREATE SHADER PROGRAMS
     initShadersData();
@@ -231,49 +270,27 @@ Application::Application(int argc, char** argv):
     glEnable(GL_DEPTH_TEST);
 
     // Init GBuffer
-    glGenTextures(GBufferTextureCount, m_GBufferTextures);
-
     for (int32_t i = GPosition; i < GBufferTextureCount; ++i)
     {
-        glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[i]);
-        glTexStorage2D(GL_TEXTURE_2D, 1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
+        m_GBufferTextures[i].setStorage2D(1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
     }
 
-    glGenFramebuffers(1, &m_GBufferFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
     for (int32_t i = GPosition; i < GDepth; ++i)
     {
-        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_GBufferTextures[i], 0);
+        m_GBufferFBO.attachTexture(GL_COLOR_ATTACHMENT0 + i, m_GBufferTextures[i].glId());
     }
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_GBufferTextures[GDepth], 0);
+    m_GBufferFBO.attachTexture(GL_DEPTH_ATTACHMENT, m_GBufferTextures[GDepth].glId());
 
     // we will write into 5 textures from the fragment shader
-    GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
-    glDrawBuffers(5, drawBuffers);
-
-    GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "FB error, status: " << status << std::endl;
-        throw std::runtime_error("FBO error");
-    }
-
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    m_GBufferFBO.setDrawBuffers({ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 });
+    m_GBufferFBO.checkComplete("GBuffer");
 
     // TRIANGLE COVERING THE SCREEN FOR SHADING PASS
-    glGenBuffers(1, &m_TriangleVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_TriangleVBO);
-
-    GLfloat data[] = { -1, -1, 3, -1, -1, 3 };
-    glBufferStorage(GL_ARRAY_BUFFER, sizeof(data), data, 0);
+    const GLfloat data[] = { -1, -1, 3, -1, -1, 3 };
+    m_TriangleVBO.setStorage(sizeof(data), data);
 
-    glGenVertexArrays(1, &m_TriangleVAO);
-    glBindVertexArray(m_TriangleVAO);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    m_TriangleVAO.setVertexBuffer(0, m_TriangleVBO.glId(), 0, 2 * sizeof(GLfloat));
+    m_TriangleVAO.setAttribute(0, 0, 2, GL_FLOAT, GL_FALSE, 0);
 
 
 
@@ -325,7 +342,7 @@ Application::Application(int argc, char** argv):
 // ------ GLTF INITIALIZATION --------
 
 // Load an obj m_model with tinyGLTF
-void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
+void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath, const glmlv::TextureLoadOptions & textureOptions)
 {
     // 1 - LOAD
     //tinygltf::Model m_model;
@@ -337,7 +354,10 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
     std::cout << "Reading ASCII glTF" << std::endl;
     // assume ascii glTF.
 	std::cout << gltfPath.string() << std::endl;
-    ret = loader.LoadASCIIFromFile(&m_model, &err, &warn, gltfPath.string());
+    {
+        GLMLV_PROFILE_SCOPE("tinygltf::LoadASCIIFromFile");
+        ret = loader.LoadASCIIFromFile(&m_model, &err, &warn, gltfPath.string());
+    }
 
     // Catch errors
     if (!warn.empty()) {
@@ -352,20 +372,17 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
         printf("Failed to parse glTF\n");
     }
 
+    applyTextureLoadOptions(textureOptions);
+    m_GLTFTextures.resize(m_model.images.size()); // Created by AddTexture() for the images used by materials
+
     // 2 - BUFFERS (VBO / IBO)
-    
-    std::vector<GLuint> buffers(m_model.buffers.size()); // un par tinygltf::Buffer
-    //m_buffers.resize(m_model.buffers.size());
-    glGenBuffers(buffers.size(), buffers.data());
-    for (size_t i = 0; i < buffers.size(); ++i)
-    {
-        const tinygltf::BufferView &bufferView = m_model.bufferViews[i];
-        glBindBuffer(bufferView.target, buffers[i]);
-        glBufferStorage(bufferView.target, m_model.buffers[i].data.size(), m_model.buffers[i].data.data(), 0);
-        glBindBuffer(bufferView.target, 0);
+
+    // un par tinygltf::Buffer, a buffer holds both vertices and indices
+    for (const auto & buffer : m_model.buffers) {
+        m_GLTFBuffers.emplace_back(buffer.data);
     }
 
-    std::cout << "# of buffers : " << buffers.size() << std::endl;
+    std::cout << "# of buffers : " << m_GLTFBuffers.size() << std::endl;
     std::cout << "# of meshes : " << m_model.meshes.size() << std::endl;
     
     // 3 - VAOs & Primitives
@@ -386,17 +403,12 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
             const tinygltf::Primitive &primitive = mesh.primitives[primId];
 
             // 3.1 - CREATE VAO FOR EACH PRIMITIVE
-            // Generate VAO
-            GLuint vaoId;
-            glGenVertexArrays(1, &vaoId);
-            glBindVertexArray(vaoId);
+            m_GLTFVertexArrays.emplace_back();
+            auto & vao = m_GLTFVertexArrays.back();
 
             // 3.2 - INDICES (IBO)
-            tinygltf::Accessor &indexAccessor = m_model.accessors[primitive.indices];
-            tinygltf::BufferView &bufferView = m_model.bufferViews[indexAccessor.bufferView];
-            int &bufferIndex = bufferView.buffer;
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[bufferIndex]); // Binding IBO
-            //glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexAccessor.bufferView); // Binding IBO
+            const tinygltf::Accessor &indexAccessor = m_model.accessors[primitive.indices];
+            vao.setElementBuffer(m_GLTFBuffers[m_model.bufferViews[indexAccessor.bufferView].buffer].glId());
 
             // 3.3 - ATTRIBUTS
             // Pour chaque attributes de la primitive
@@ -406,11 +418,8 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
             for (; it != itEnd; it++)
             {
                 assert(it->second >= 0);
-                tinygltf::Accessor &accessor = m_model.accessors[it->second];
-                bufferView = m_model.bufferViews[accessor.bufferView];
-                bufferIndex = bufferView.buffer;
-                glBindBuffer(GL_ARRAY_BUFFER, buffers[bufferIndex]);    // Binding VBO
-                //glBindBuffer(GL_ARRAY_BUFFER, accessor.bufferView);    // Binding VBO
+                const tinygltf::Accessor &accessor = m_model.accessors[it->second];
+                const tinygltf::BufferView &bufferView = m_model.bufferViews[accessor.bufferView];
                 
                 // Get number of component
                 int size = 1;
@@ -434,10 +443,13 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
                     if (m_attribs[it->first] >= 0)
                     {
                         // Compute byteStride from Accessor + BufferView combination.
-                        int byteStride =  accessor.ByteStride(m_model.bufferViews[accessor.bufferView]);
+                        int byteStride =  accessor.ByteStride(bufferView);
                         assert(byteStride != -1);
-                        glEnableVertexAttribArray(m_attribs[it->first]);
-                        glVertexAttribPointer(m_attribs[it->first], size, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, byteStride, (const GLvoid*) (bufferView.byteOffset + accessor.byteOffset));
+
+                        // Each attribute reads its own buffer binding, with the binding index equal to its location
+                        const GLuint location = m_attribs[it->first];
+                        vao.setVertexBuffer(location, m_GLTFBuffers[bufferView.buffer].glId(), bufferView.byteOffset + accessor.byteOffset, byteStride);
+                        vao.setAttribute(location, location, size, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, 0);
 
 
                         if (it->first.compare("POSITION") == 0)
@@ -451,16 +463,12 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
                         }                        
                     }
                 }
-
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
             }
 
             // On rempli le vao et les primitives
-            meshInfos.vaos.push_back(vaoId);
+            meshInfos.vaos.push_back(vao.glId());
             meshInfos.primitives.push_back(primitive);
 
-            glBindVertexArray(0);
-
             // 3.4 - TEXTURES
             meshInfos.diffuseColor.push_back(glm::vec4(1));
             meshInfos.texture.push_back(0);            
@@ -507,20 +515,19 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
     }
 
     // SAMPLER --> TODO --> Handle multiple samplers
-    glGenSamplers(1, &m_textureSampler);
     if (m_model.samplers.size() > 0)
     {
         tinygltf::Sampler sampler = m_model.samplers[0];
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_S, sampler.wrapS);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_T, sampler.wrapT);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_R, sampler.wrapR);
+        m_textureSampler.setParameter(GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+        m_textureSampler.setParameter(GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_S, sampler.wrapS);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_T, sampler.wrapT);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_R, sampler.wrapR);
     }
     else
     {
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        m_textureSampler.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        m_textureSampler.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
 }
 
@@ -543,59 +550,81 @@ GLenum Application::getMode(int mode)
     }
 }
 
+// tinygltf decodes all images as RGBA8: downsample them right after loading to fit in the limits of textureOptions
+void Application::applyTextureLoadOptions(const glmlv::TextureLoadOptions & textureOptions)
+{
+    std::vector<glmlv::ImageInfo> infos(m_model.images.size());
+    for (size_t i = 0; i < m_model.images.size(); ++i) {
+        infos[i] = { size_t(m_model.images[i].width), size_t(m_model.images[i].height), glmlv::ImageFormat::RGBA8 };
+    }
+    const auto sizes = glmlv::computeBudgetedImageSizes(infos, textureOptions);
+
+    size_t fullResolutionByteSize = 0, residentByteSize = 0;
+    for (size_t i = 0; i < m_model.images.size(); ++i)
+    {
+        auto & image = m_model.images[i];
+        fullResolutionByteSize += infos[i].byteSize();
+        residentByteSize += sizes[i].byteSize();
+
+        if (image.image.empty() || image.component != 4 || (sizes[i].width == infos[i].width && sizes[i].height == infos[i].height)) {
+            continue;
+        }
+
+        std::cout << "Image " << i << " downsampled from " << image.width << "x" << image.height << " to " << sizes[i].width << "x" << sizes[i].height << std::endl;
+        std::vector<unsigned char> resized(sizes[i].byteSize());
+        glmlv::downsampleImage(image.image.data(), image.width, image.height, 4, resized.data(), sizes[i].width, sizes[i].height);
+        image.image.swap(resized);
+        image.width = int(sizes[i].width);
+        image.height = int(sizes[i].height);
+    }
+
+    std::cout << "Loaded " << m_model.images.size() << " images: " << residentByteSize / (1024. * 1024.) << " MB ("
+        << fullResolutionByteSize / (1024. * 1024.) << " MB at full resolution)" << std::endl;
+}
+
 void Application::AddTexture(tinygltf::Texture &tex, MeshInfos& meshInfos)
 {
     if (tex.source > -1 && tex.source < m_model.images.size())
     {
         tinygltf::Image &image = m_model.images[tex.source];
 
-        glActiveTexture(GL_TEXTURE0);
-
-        GLuint texId;
-        glGenTextures(1, &texId);
-        glBindTexture(GL_TEXTURE_2D, texId);
+        // One texture per image, shared by all the primitives using it
+        auto & texture = m_GLTFTextures[tex.source];
+        if (!texture)
+        {
+            texture.reset(new glmlv::GLTexture(GL_TEXTURE_2D, 1, GL_RGBA8, image.width, image.height)); // tinygltf always decodes to RGBA8
+            texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        // Ignore Texture.fomat.
-        GLenum format = GL_RGBA;
-        if (image.component == 3) {
-            format = GL_RGB;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            texture->setSubImage2D(0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.image.at(0));
         }
-        
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
 
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, image.width, image.height);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.image.at(0));
-        
-        glBindTexture(GL_TEXTURE_2D, 0);
-        
-        meshInfos.texture.back() = texId;
+        meshInfos.texture.back() = texture->glId();
     }
 }
 
 // ------ GLTF DRAW --------
 
 
-void Application::DrawModel(tinygltf::Model &model) {
+void Application::FlattenModel(tinygltf::Model &model) {
+  GLMLV_PROFILE_FUNCTION();
   // If the glTF asset has at least one scene, and doesn't define a default one
   // just show the first one we can find
   assert(model.scenes.size() > 0);
   int scene_to_display = model.defaultScene > -1 ? model.defaultScene : 0;
   const tinygltf::Scene &scene = model.scenes[scene_to_display];
   
-  if (scene.nodes.size() != 0) {
-	  for (size_t i = 0; i < scene.nodes.size(); i++)
-	  {
-		  DrawNode(model, model.nodes[scene.nodes[i]], glm::mat4(1));
-	  }
+  for (size_t i = 0; i < scene.nodes.size(); i++)
+  {
+	  FlattenNode(model, model.nodes[scene.nodes[i]], glm::mat4(1));
   }
 
+  std::cout << "# of draw items : " << m_drawItems.size() << std::endl;
 }
 
-// Hierarchically draw nodes
-void Application::DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix) {
+// Hierarchically flatten nodes
+void Application::FlattenNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix) {
 
     // PUSH MATRIX
     glm::mat4 modelMatrix = glm::mat4(1);
@@ -631,48 +660,62 @@ void Application::DrawNode(tinygltf::Model &model, const tinygltf::Node &node, g
     if (node.mesh > -1)
     {
         assert(node.mesh < model.meshes.size());
-        DrawMesh(node.mesh, modelMatrix);
+        const auto & meshInfos = m_meshInfos[node.mesh];
+        for (size_t i = 0; i < meshInfos.vaos.size(); ++i)
+        {
+            m_drawItems.push_back({ node.mesh, i, modelMatrix });
+            m_drawItemBounds.push(meshInfos.min[i], meshInfos.max[i], modelMatrix); // glTF requires min / max on POSITION accessors
+        }
     }
 
-    // Draw child nodes.
+    // Flatten child nodes.
     for (size_t i = 0; i < node.children.size(); i++)
     {
         assert(node.children[i] < model.nodes.size());
-        DrawNode(model, model.nodes[node.children[i]], modelMatrix);
+        FlattenNode(model, model.nodes[node.children[i]], modelMatrix);
     }
 
     // POP MATRIX
 }
 
-void Application::DrawMesh(int meshIndex, glm::mat4 modelMatrix)
+void Application::DrawItems(const std::vector<uint8_t> & visibility)
 {
-    // OBJECT MATRIX
-    const auto mvMatrix = m_viewMatrix * modelMatrix;
-    const auto mvpMatrix = m_projMatrix * mvMatrix;
-    const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-
-    glUniformMatrix4fv(m_uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glUniformMatrix4fv(m_uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-    glUniformMatrix4fv(m_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-    // DRAW EACH VAO / PRIMITIVES of this mesh
-    for (size_t i = 0; i < m_meshInfos[meshIndex].vaos.size(); ++i)
-    {        
+    GLMLV_PROFILE_FUNCTION();
+
+    const glm::mat4 * pCurrentModelMatrix = nullptr;
+    for (size_t itemIndex = 0; itemIndex < m_drawItems.size(); ++itemIndex)
+    {
+        if (!visibility[itemIndex]) {
+            continue;
+        }
+        const auto & item = m_drawItems[itemIndex];
+        const auto & meshInfos = m_meshInfos[item.meshIndex];
+        const auto i = item.primitiveIndex;
+
+        // OBJECT MATRIX, set once for the consecutive primitives of a node
+        if (!pCurrentModelMatrix || *pCurrentModelMatrix != item.modelMatrix)
+        {
+            const auto mvMatrix = m_viewMatrix * item.modelMatrix;
+            const auto mvpMatrix = m_projMatrix * mvMatrix;
+            const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
+
+            glUniformMatrix4fv(m_uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+            glUniformMatrix4fv(m_uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
+            glUniformMatrix4fv(m_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+            pCurrentModelMatrix = &item.modelMatrix;
+        }
+
         // Color
-        glm::vec3 diffuseColor(m_meshInfos[meshIndex].diffuseColor[i].x, m_meshInfos[meshIndex].diffuseColor[i].y, m_meshInfos[meshIndex].diffuseColor[i].z);
+        glm::vec3 diffuseColor(meshInfos.diffuseColor[i].x, meshInfos.diffuseColor[i].y, meshInfos.diffuseColor[i].z);
         glUniform3fv(m_uKdLocation, 1, glm::value_ptr(diffuseColor));
-        glBindTexture(GL_TEXTURE_2D, m_meshInfos[meshIndex].texture[i]);
+        m_GLState.bindTexture(0, meshInfos.texture[i]);
 
         // Bind VAO
-        const tinygltf::Accessor &indexAccessor = m_model.accessors[m_meshInfos[meshIndex].primitives[i].indices];        
-        glBindVertexArray(m_meshInfos[meshIndex].vaos[i]);
+        const tinygltf::Accessor &indexAccessor = m_model.accessors[meshInfos.primitives[i].indices];
+        m_GLState.bindVertexArray(meshInfos.vaos[i]);
 
-        // Draw
-        glDrawElements(getMode(m_meshInfos[meshIndex].primitives[i].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid*) indexAccessor.byteOffset);
-        
-        // Unbind
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        // Draw, without unbinding: primitives sharing a texture or a VAO do not bind it again
+        glDrawElements(getMode(meshInfos.primitives[i].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid*) indexAccessor.byteOffset);
     }
 }
 
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <map>
+#include <memory>
 
 #include <glmlv/filesystem.hpp>
 #include <glmlv/GLFWHandle.hpp>
 #include <glmlv/GLProgram.hpp>
+#include <glmlv/GLStateCache.hpp>
+#include <glmlv/GLBuffer.hpp>
+#include <glmlv/GLTexture.hpp>
+#include <glmlv/GLSampler.hpp>
+#include <glmlv/GLVertexArray.hpp>
+#include <glmlv/GLFramebuffer.hpp>
 #include <glmlv/ViewController.hpp>
 #include <glmlv/simple_geometry.hpp>
+#include <glmlv/Image2D.hpp>
+#include <glmlv/frustum_culling.hpp>
 
 #include <glm/glm.hpp>
 
@@ -42,6 +51,7 @@ private:
     const glmlv::fs::path m_AssetsRootPath;
 
     glmlv::GLProgram m_program;
+    glmlv::GLStateCache m_GLState; // Programs, vertex arrays, textures, samplers and framebuffers of the render loop are bound through it
 
     // ====== CAMERA ======== //
 
@@ -70,8 +80,8 @@ private:
     // ========= DEFERRED RENDERING ============ //
 
     // Triangle covering the whole screen, for the shading pass:
-    GLuint m_TriangleVBO = 0;
-    GLuint m_TriangleVAO = 0;
+    glmlv::GLBuffer m_TriangleVBO;
+    glmlv::GLVertexArray m_TriangleVAO;
 
     // GBuffer:
     enum GBufferTextureType
@@ -87,12 +97,12 @@ private:
 
     const char * m_GBufferTexNames[GBufferTextureCount + 1] = { "position", "normal", "ambient", "diffuse", "glossyShininess", "depth", "beauty" }; // Tricks, since we cant blit depth, we use its value to draw the result of the shading pass
     const GLenum m_GBufferTextureFormat[GBufferTextureCount] = { GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGBA32F, GL_DEPTH_COMPONENT32F };
-    GLuint m_GBufferTextures[GBufferTextureCount];
-    GLuint m_GBufferFBO; // Framebuffer object
+    glmlv::GLTexture m_GBufferTextures[GBufferTextureCount];
+    glmlv::GLFramebuffer m_GBufferFBO; // Framebuffer object
 
     GBufferTextureType m_CurrentlyDisplayed = GBufferTextureCount; // Default to beauty
 
-    GLuint m_textureSampler = 0; // Only one sampler object since we will use the sample sampling parameters for the two textures
+    glmlv::GLSampler m_textureSampler; // Only one sampler object since we will use the sample sampling parameters for the two textures
 
     // GLSL programs
     glmlv::GLProgram m_geometryPassProgram;
@@ -134,6 +144,11 @@ private:
     tinygltf::Model m_model;
     std::map<std::string, GLint> m_attribs;
 
+    // GL objects of the model, MeshInfos refer to them by name
+    std::vector<glmlv::GLBuffer> m_GLTFBuffers; // One per tinygltf::Buffer
+    std::vector<glmlv::GLVertexArray> m_GLTFVertexArrays; // One per primitive
+    std::vector<std::unique_ptr<glmlv::GLTexture>> m_GLTFTextures; // One per tinygltf::Image, null if no material uses it
+
     // TODO --> Maybe We can put all 3 into a structure because the same Index means the same element
     typedef struct {
         std::vector<GLuint> vaos;
@@ -147,13 +162,30 @@ private:
 
     std::vector<MeshInfos> m_meshInfos;
 
-    void loadTinyGLTF(const glmlv::fs::path & gltfPath);
+    // Primitives of the default scene with the transform of their node, flattened once at load: the geometry pass culls this list
+    // against the camera frustum and draws the visible items, instead of walking the node hierarchy every frame
+    struct DrawItem
+    {
+        int meshIndex;
+        size_t primitiveIndex; // In m_meshInfos[meshIndex]
+        glm::mat4 modelMatrix;
+    };
+
+    std::vector<DrawItem> m_drawItems;
+    glmlv::CullingBounds m_drawItemBounds; // World space box of each draw item
+
+    bool m_bFrustumCulling = true;
+    std::vector<uint8_t> m_cameraVisibility; // One per draw item
+    glmlv::CullingStats m_cameraCullingStats;
+
+    void loadTinyGLTF(const glmlv::fs::path & gltfPath, const glmlv::TextureLoadOptions & textureOptions);
+    void applyTextureLoadOptions(const glmlv::TextureLoadOptions & textureOptions);
     void drawGLTF();
     GLenum getMode(int mode);
 
-    void DrawModel(tinygltf::Model &model);
-    void DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix);
-    void DrawMesh(int meshIndex, glm::mat4 modelMatrix);
+    void FlattenModel(tinygltf::Model &model);
+    void FlattenNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix);
+    void DrawItems(const std::vector<uint8_t> & visibility);
     void DrawMesh();
 
     void AddTexture(tinygltf::Texture &tex, MeshInfos& meshInfos);
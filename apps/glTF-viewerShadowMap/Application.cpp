@@ -1,7 +1,12 @@
 #include "Application.hpp"
 
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
 #include <iostream>
 #include <cmath> 
+#include <chrono>
+#include <algorithm>
 #include <glmlv/Image2DRGBA.hpp>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -27,6 +32,10 @@ int Application::run()
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        GLMLV_PROFILE_FRAME();
+
+        m_GLState.beginFrame(); // ImGui and the frame capture bound their own objects at the end of the previous frame
+        m_GPUProfiler.beginFrame();
 
         // WORLD MATRIX
         if (m_model.cameras.size() > 0)
@@ -65,27 +74,13 @@ int Application::run()
 		{
 			if (directionalSMResolutionDirty)
 			{
-				glDeleteTextures(1, &m_directionalSMTexture);
-
-				// Realocate texture
-				glGenTextures(1, &m_directionalSMTexture);
-				glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
-				glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, m_nDirectionalSMResolution, m_nDirectionalSMResolution);
-				glBindTexture(GL_TEXTURE_2D, 0);
+				// Realocate texture, the old one is deleted by the assignment
+				m_directionalSMTexture = glmlv::GLTexture(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, m_nDirectionalSMResolution, m_nDirectionalSMResolution);
+				m_GLState.invalidate(); // The deleted texture was unbound from its unit, and its name can be reused
 
 				// Attach new texture to FBO
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_directionalSMFBO);
-				glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
-				glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_directionalSMTexture, 0);
-
-				const auto fboStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-				if (fboStatus != GL_FRAMEBUFFER_COMPLETE)
-				{
-					std::cerr << "Error on building directional shadow mapping framebuffer. Error code = " << fboStatus << std::endl;
-					throw std::runtime_error("Error on building directional shadow mapping framebuffer.");
-				}
-
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				m_directionalSMFBO.attachTexture(GL_DEPTH_ATTACHMENT, m_directionalSMTexture.glId());
+				m_directionalSMFBO.checkComplete("directional shadow mapping");
 
 				directionalSMResolutionDirty = false;
 				directionalSMDirty = true; // The shadow map must also be recomputed
@@ -93,55 +88,46 @@ int Application::run()
 
 			if (directionalSMDirty)
 			{
-				m_directionalSMProgram.use();
+				glmlv::GPUProfiler::Scope profilerScope(m_GPUProfiler, "Shadow map");
+				m_GLState.useProgram(m_directionalSMProgram.glId());
 
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_directionalSMFBO);
+				m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_directionalSMFBO.glId());
 				glViewport(0, 0, m_nDirectionalSMResolution, m_nDirectionalSMResolution);
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 				glUniformMatrix4fv(m_uDirLightViewProjMatrix, 1, GL_FALSE, glm::value_ptr(dirLightProjMatrix * dirLightViewMatrix));
 
-				//glBindVertexArray(m_TriangleVAO);
-
-				// We draw each shape by specifying how much indices it carries, and with an offset in the global index buffer
-				//for (const auto shape : m_shapes) {
-					//glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, (const GLvoid*)(shape.indexOffset * sizeof(GLuint)));
-				//}
-
-				DrawModel(m_model);
+				// Only the primitives inside the orthographic frustum of the light can cast a shadow in the map
+				m_dirLightCullingStats = CullDrawItems(dirLightProjMatrix * dirLightViewMatrix, m_dirLightVisibility);
+				DrawItems(m_dirLightVisibility, true);
 
-
-				glBindVertexArray(0);
-
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
 				directionalSMDirty = false;
 			}
 		}
         // ==== GEOMETRY PASS ==== //
         {
-            m_geometryPassProgram.use();
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
+            glmlv::GPUProfiler::Scope profilerScope(m_GPUProfiler, "Geometry pass");
+            m_GLState.useProgram(m_geometryPassProgram.glId());
+            m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO.glId());
 
             glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
 			
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             for (GLuint i : {0, 1})
-                glBindSampler(i, m_textureSampler);
+                m_GLState.bindSampler(i, m_textureSampler.glId());
 
             // Set texture unit of each sampler
             glUniform1i(m_uKaSamplerLocation, 0);
             glUniform1i(m_uKdSamplerLocation, 1);
 
             // GLTF DRAWING
-            DrawModel(m_model);
+            m_cameraCullingStats = CullDrawItems(m_projMatrix * m_viewMatrix, m_cameraVisibility);
+            DrawItems(m_cameraVisibility, false);
 
-            // UNBIND
-            for (GLuint i : {0, 1})
-                glBindSampler(0, m_textureSampler);                
-            
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            m_GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
         }
 
         const auto viewportSize = m_GLFWHandle.framebufferSize();
@@ -149,62 +135,75 @@ int Application::run()
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // ==== SHADING PASS ==== //
+        m_GPUProfiler.pushSection(m_CurrentlyDisplayed == GBufferTextureCount ? "Shading pass" : "Display pass");
         if (m_CurrentlyDisplayed == GBufferTextureCount) // BEAUTY
         {            
             {
-                m_shadingPassProgram.use();
+                if (m_DirLightSMSampleCount != m_ShadingPassSampleCount) {
+                    selectShadingPassVariant(); // Variants are already compiled
+                }
+                m_GLState.useProgram(m_pShadingPassProgram->glId());
 
-                glUniform3fv(m_uDirectionalLightDirLocation, 1, glm::value_ptr(glm::vec3(m_viewMatrix * glm::vec4(glm::normalize(m_DirLightDirection), 0))));
-                glUniform3fv(m_uDirectionalLightIntensityLocation, 1, glm::value_ptr(m_DirLightColor * m_DirLightIntensity));
+                // Each variant has its own uniform locations, found in its reflection table from name hashes computed at compile time
+                const auto & shadingPass = m_pShadingPassProgram->reflection();
 
-                glUniform3fv(m_uPointLightPositionLocation, 1, glm::value_ptr(glm::vec3(m_viewMatrix * glm::vec4(m_PointLightPosition, 1))));
-                glUniform3fv(m_uPointLightIntensityLocation, 1, glm::value_ptr(m_PointLightColor * m_PointLightIntensity));
+                glUniform3fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirectionalLightDir")), 1, glm::value_ptr(glm::vec3(m_viewMatrix * glm::vec4(glm::normalize(m_DirLightDirection), 0))));
+                glUniform3fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirectionalLightIntensity")), 1, glm::value_ptr(m_DirLightColor * m_DirLightIntensity));
 
-				glUniform1fv(m_uDirLightShadowMapBias, 1, &m_DirLightSMBias);
+                glUniform3fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uPointLightPosition")), 1, glm::value_ptr(glm::vec3(m_viewMatrix * glm::vec4(m_PointLightPosition, 1))));
+                glUniform3fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uPointLightIntensity")), 1, glm::value_ptr(m_PointLightColor * m_PointLightIntensity));
 
-				glUniform1iv(m_uDirLightShadowMapSampleCount, 1, &m_DirLightSMSampleCount);
-				glUniform1fv(m_uDirLightShadowMapSpread, 1, &m_DirLightSMSpread);
+				glUniform1fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirLightShadowMapBias")), 1, &m_DirLightSMBias);
 
-				glUniformMatrix4fv(m_uDirLightViewProjMatrix_shadingPass, 1, GL_FALSE, glm::value_ptr(dirLightProjMatrix * dirLightViewMatrix * rcpViewMatrix));
+				glUniform1iv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirLightShadowMapSampleCount")), 1, &m_DirLightSMSampleCount); // Generic variant only
+				glUniform1fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirLightShadowMapSpread")), 1, &m_DirLightSMSpread);
 
+				glUniformMatrix4fv(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirLightViewProjMatrix")), 1, GL_FALSE, glm::value_ptr(dirLightProjMatrix * dirLightViewMatrix * rcpViewMatrix));
 
+
+                constexpr uint32_t gBufferSamplerNames[GDepth] = {
+                    glmlv::hashResourceName("uGPosition"), glmlv::hashResourceName("uGNormal"), glmlv::hashResourceName("uGAmbient"),
+                    glmlv::hashResourceName("uGDiffuse"), glmlv::hashResourceName("uGGlossyShininess")
+                };
                 for (int32_t i = GPosition; i < GDepth; ++i)
                 {
-                    glActiveTexture(GL_TEXTURE0 + i);
-                    glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[i]);
+                    m_GLState.bindTexture(i, m_GBufferTextures[i].glId());
 
-                    glUniform1i(m_uGBufferSamplerLocations[i], i);
+                    glUniform1i(shadingPass.getUniformLocation(gBufferSamplerNames[i]), i);
                 }
 
-				glActiveTexture(GL_TEXTURE0 + GDepth);
-				glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
-				glBindSampler(GDepth, m_directionalSMSampler);
-				glUniform1i(m_uDirLightShadowMap, GDepth);
+				m_GLState.bindTexture(GDepth, m_directionalSMTexture.glId());
+				m_GLState.bindSampler(GDepth, m_directionalSMSampler.glId());
+				glUniform1i(shadingPass.getUniformLocation(glmlv::hashResourceName("uDirLightShadowMap")), GDepth);
 
-                glBindVertexArray(m_TriangleVAO);
+#ifndef NDEBUG
+                if (m_bValidateShadingPassBindings)
+                {
+                    shadingPass.validateBindings();
+                    m_bValidateShadingPassBindings = false;
+                }
+#endif
+
+                m_GLState.bindVertexArray(m_TriangleVAO.glId());
                 glDrawArrays(GL_TRIANGLES, 0, 3);
-                glBindVertexArray(0);
             }
         }
         else if (m_CurrentlyDisplayed == GDepth)    // DEPTH
         {
-            m_displayDepthProgram.use();
+            m_GLState.useProgram(m_displayDepthProgram.glId());
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[GDepth]);
+            m_GLState.bindTexture(0, m_GBufferTextures[GDepth].glId());
 
             glUniform1i(m_uGDepthSamplerLocation, 0);
 
-            glBindVertexArray(m_TriangleVAO);
+            m_GLState.bindVertexArray(m_TriangleVAO.glId());
             glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(0);
         }
         else if (m_CurrentlyDisplayed == GPosition) // POSITION
         {
-            m_displayPositionProgram.use();
+            m_GLState.useProgram(m_displayPositionProgram.glId());
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[GPosition]);
+            m_GLState.bindTexture(0, m_GBufferTextures[GPosition].glId());
 
             glUniform1i(m_uGDepthSamplerLocation, 0);
 
@@ -215,40 +214,49 @@ int Application::run()
 
             glUniform3fv(m_uSceneSizeLocation, 1, glm::value_ptr(frustrumTopRight_view / frustrumTopRight_view.w));
 
-            glBindVertexArray(m_TriangleVAO);
+            m_GLState.bindVertexArray(m_TriangleVAO.glId());
             glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(0);
         }
 		else if (m_CurrentlyDisplayed == Display_DirectionalLightDepthMap)
 		{
-			m_displayDepthProgram.use();
+			m_GLState.useProgram(m_displayDepthProgram.glId());
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
+			m_GLState.bindTexture(0, m_directionalSMTexture.glId());
 
 			glUniform1i(m_uGDepthSamplerLocation, 0);
 
-			glBindVertexArray(m_TriangleVAO);
+			m_GLState.bindVertexArray(m_TriangleVAO.glId());
 			glDrawArrays(GL_TRIANGLES, 0, 3);
-			glBindVertexArray(0);
 		}
         else    // NORMAL / AMBIENT / GS
         {
             // GBuffer display
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO);
+            m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, m_GBufferFBO.glId());
 			glReadBuffer(GL_COLOR_ATTACHMENT0 + m_CurrentlyDisplayed);
 			glBlitFramebuffer(0, 0, m_nWindowWidth, m_nWindowHeight,
 				0, 0, m_nWindowWidth, m_nWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			m_GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         }
-        
+        m_GPUProfiler.popSection();
 
+		// ==== FRAME CAPTURE ==== //
+		// Before the GUI is drawn, so it does not appear on captured frames
+		{
+			glmlv::GPUProfiler::Scope profilerScope(m_GPUProfiler, "Frame capture");
+			if (m_CaptureSource == 0) {
+				m_FrameCapture.captureFrame(0, GL_BACK, viewportSize.x, viewportSize.y);
+			}
+			else {
+				m_FrameCapture.captureFrame(m_GBufferFBO.glId(), GL_COLOR_ATTACHMENT0 + m_CaptureSource - 1, m_nWindowWidth, m_nWindowHeight);
+			}
+		}
 
         // GUI code:
 		glmlv::imguiNewFrame();
 
         {
+            GLMLV_PROFILE_SCOPE("GUI");
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -279,6 +287,15 @@ int Application::run()
 				ImGui::InputFloat("DirShadowMap Spread", &m_DirLightSMSpread);
             }
 
+            if (ImGui::CollapsingHeader("Culling"))
+            {
+                if (ImGui::Checkbox("Frustum culling", &m_bFrustumCulling)) {
+                    directionalSMDirty = true;
+                }
+                ImGui::Text("Camera: %zu visible, %zu culled", m_cameraCullingStats.visibleCount, m_cameraCullingStats.culledCount);
+                ImGui::Text("Directional light: %zu visible, %zu culled", m_dirLightCullingStats.visibleCount, m_dirLightCullingStats.culledCount);
+            }
+
             if (ImGui::CollapsingHeader("GBuffer"))
             {
                 for (int32_t i = GPosition; i <= GBufferTextureCount; ++i)
@@ -288,10 +305,93 @@ int Application::run()
                 }
             }
 
+			if (ImGui::CollapsingHeader("GL state")) {
+				m_GLState.drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL debug output")) {
+				glmlv::drawGLDebugOutputGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL calls")) {
+				glmlv::drawGLCallStatsGUI(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gl_calls.json"));
+			}
+
+			if (ImGui::CollapsingHeader("GPU memory")) {
+				glmlv::GPUMemoryLedger::get().drawGUI();
+			}
+
+			if (ImGui::CollapsingHeader("GL trace")) {
+				if (glmlv::isGLCommandTraceCapturePending()) {
+					ImGui::Text("Capturing...");
+				}
+				else if (ImGui::Button("Capture next frame")) {
+					glmlv::requestGLCommandTraceCapture(m_AppPath.parent_path() / "profiles" / (m_AppName + ".gltrace"));
+				}
+			}
+
+			if (ImGui::CollapsingHeader("GPU profiler"))
+			{
+				m_GPUProfiler.drawGUI();
+				const auto profilesPath = m_AppPath.parent_path() / "profiles";
+				const bool exportCSV = ImGui::Button("Export CSV");
+				ImGui::SameLine();
+				const bool exportJSON = ImGui::Button("Export JSON");
+				ImGui::SameLine();
+				if (ImGui::Button("Clear history")) {
+					m_GPUProfiler.clearHistory();
+				}
+				if (exportCSV || exportJSON)
+				{
+					if (!glmlv::fs::exists(profilesPath)) {
+						glmlv::fs::create_directories(profilesPath);
+					}
+					if (exportCSV) {
+						m_GPUProfiler.writeCSV(profilesPath / (m_AppName + ".csv"));
+					}
+					if (exportJSON) {
+						m_GPUProfiler.writeJSON(profilesPath / (m_AppName + ".json"));
+					}
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Frame capture"))
+			{
+				ImGui::RadioButton("framebuffer", &m_CaptureSource, 0);
+				for (int32_t i = GPosition; i < GDepth; ++i)
+				{
+					ImGui::SameLine();
+					ImGui::RadioButton(m_GBufferTexNames[i], &m_CaptureSource, i + 1);
+				}
+				ImGui::Combo("Format", &m_CaptureExtension, m_CaptureExtensions, 3);
+				if (m_CaptureExtension == 0)
+				{
+					auto writeOptions = m_FrameCapture.getWriteOptions();
+					const bool changed = ImGui::Checkbox("Parallel PNG", &writeOptions.parallelPNG)
+						| (writeOptions.parallelPNG && ImGui::SliderInt("Compression level", &writeOptions.png.compressionLevel, 0, 9));
+					if (changed) {
+						m_FrameCapture.setWriteOptions(writeOptions);
+					}
+				}
+
+				if (!m_FrameCapture.isCapturing() && ImGui::Button("Start capture")) {
+					m_FrameCapture.start(m_AppPath.parent_path() / "captures" / m_AppName, m_CaptureExtensions[m_CaptureExtension]);
+				}
+				else if (m_FrameCapture.isCapturing() && ImGui::Button("Stop capture")) {
+					m_FrameCapture.stop();
+				}
+				m_FrameCapture.drawGUI();
+			}
+
             ImGui::End();
         }
 
-		glmlv::imguiRenderFrame();
+		{
+			glmlv::GPUProfiler::Scope profilerScope(m_GPUProfiler, "GUI");
+			glmlv::imguiRenderFrame();
+		}
+
+		m_GPUProfiler.endFrame();
 
         /* Poll for and process events */
         glfwPollEvents();
@@ -306,6 +406,8 @@ int Application::run()
         }
     }
 
+    GLMLV_PROFILE_WRITE_TRACE(m_AppPath.parent_path() / "profiles" / (m_AppName + ".trace.json")); // Last frames of the session
+
     return 0;
 }
 
@@ -338,7 +440,8 @@ Application::Application(int argc, char** argv):
     }
     const glmlv::fs::path gltfPath = m_AssetsRootPath / glmlv::fs::path{ argv[1] };
 
-    loadTinyGLTF(gltfPath);
+    loadTinyGLTF(gltfPath, glmlv::parseTextureLoadOptions(argc, argv));
+    FlattenModel(m_model);
 
     // 2 - CREATE SHADER PROGRAMS
     initShadersData();
@@ -346,49 +449,27 @@ Application::Application(int argc, char** argv):
     glEnable(GL_DEPTH_TEST);
 
     // Init GBuffer
-    glGenTextures(GBufferTextureCount, m_GBufferTextures);
-
     for (int32_t i = GPosition; i < GBufferTextureCount; ++i)
     {
-        glBindTexture(GL_TEXTURE_2D, m_GBufferTextures[i]);
-        glTexStorage2D(GL_TEXTURE_2D, 1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
+        m_GBufferTextures[i].setStorage2D(1, m_GBufferTextureFormat[i], m_nWindowWidth, m_nWindowHeight);
     }
 
-    glGenFramebuffers(1, &m_GBufferFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_GBufferFBO);
     for (int32_t i = GPosition; i < GDepth; ++i)
     {
-        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_GBufferTextures[i], 0);
+        m_GBufferFBO.attachTexture(GL_COLOR_ATTACHMENT0 + i, m_GBufferTextures[i].glId());
     }
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_GBufferTextures[GDepth], 0);
+    m_GBufferFBO.attachTexture(GL_DEPTH_ATTACHMENT, m_GBufferTextures[GDepth].glId());
 
     // we will write into 5 textures from the fragment shader
-    GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
-    glDrawBuffers(5, drawBuffers);
-
-    GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "FB error, status: " << status << std::endl;
-        throw std::runtime_error("FBO error");
-    }
-
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    m_GBufferFBO.setDrawBuffers({ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 });
+    m_GBufferFBO.checkComplete("GBuffer");
 
     // TRIANGLE COVERING THE SCREEN FOR SHADING PASS
-    glGenBuffers(1, &m_TriangleVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_TriangleVBO);
+    const GLfloat data[] = { -1, -1, 3, -1, -1, 3 };
+    m_TriangleVBO.setStorage(sizeof(data), data);
 
-    GLfloat data[] = { -1, -1, 3, -1, -1, 3 };
-    glBufferStorage(GL_ARRAY_BUFFER, sizeof(data), data, 0);
-
-    glGenVertexArrays(1, &m_TriangleVAO);
-    glBindVertexArray(m_TriangleVAO);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    m_TriangleVAO.setVertexBuffer(0, m_TriangleVBO.glId(), 0, 2 * sizeof(GLfloat));
+    m_TriangleVAO.setAttribute(0, 0, 2, GL_FLOAT, GL_FALSE, 0);
 
 
     // 3 - SET CAMERA POSTION
@@ -402,7 +483,7 @@ Application::Application(int argc, char** argv):
     glm::vec3 center2 = GetCenterOfBoundingBox(boundingBox);
     std::cout << "Center Method 2 : " << center2 << std::endl;
 
-    if (argc == 3)
+    if (argc >= 3)
     {
         if(!strcmp(argv[2], "c1"))
         {
@@ -436,7 +517,7 @@ Application::Application(int argc, char** argv):
 // ------ GLTF INITIALIZATION --------
 
 // Load an obj m_model with tinyGLTF
-void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
+void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath, const glmlv::TextureLoadOptions & textureOptions)
 {
     // 1 - LOAD
     //tinygltf::Model m_model;
@@ -448,7 +529,10 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
     std::cout << "Reading ASCII glTF" << std::endl;
     // assume ascii glTF.
 	std::cout << gltfPath.string() << std::endl;
-    ret = loader.LoadASCIIFromFile(&m_model, &err, &warn, gltfPath.string());
+    {
+        GLMLV_PROFILE_SCOPE("tinygltf::LoadASCIIFromFile");
+        ret = loader.LoadASCIIFromFile(&m_model, &err, &warn, gltfPath.string());
+    }
 
     // Catch errors
     if (!warn.empty()) {
@@ -463,21 +547,18 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
         printf("Failed to parse glTF\n");
     }
 
+    applyTextureLoadOptions(textureOptions);
+    m_GLTFTextures.resize(m_model.images.size()); // Created by AddTexture() for the images used by materials
+
 
     // 2 - BUFFERS (VBO / IBO)
     
-    std::vector<GLuint> buffers(m_model.buffers.size()); // un par tinygltf::Buffer
-    
-    glGenBuffers(buffers.size(), buffers.data());
-    for (size_t i = 0; i < buffers.size(); ++i)
-    {
-        const tinygltf::BufferView &bufferView = m_model.bufferViews[i];
-        glBindBuffer(bufferView.target, buffers[i]);
-        glBufferStorage(bufferView.target, m_model.buffers[i].data.size(), m_model.buffers[i].data.data(), 0);
-        glBindBuffer(bufferView.target, 0);
+    // un par tinygltf::Buffer, a buffer holds both vertices and indices
+    for (const auto & buffer : m_model.buffers) {
+        m_GLTFBuffers.emplace_back(buffer.data);
     }
 
-    std::cout << "# of buffers : " << buffers.size() << std::endl;
+    std::cout << "# of buffers : " << m_GLTFBuffers.size() << std::endl;
     std::cout << "# of meshes : " << m_model.meshes.size() << std::endl;
     
     // 3 - VAOs & Primitives
@@ -498,16 +579,12 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
             const tinygltf::Primitive &primitive = mesh.primitives[primId];
 
             // 3.1 - CREATE VAO FOR EACH PRIMITIVE
-            // Generate VAO
-            GLuint vaoId;
-            glGenVertexArrays(1, &vaoId);
-            glBindVertexArray(vaoId);
+            m_GLTFVertexArrays.emplace_back();
+            auto & vao = m_GLTFVertexArrays.back();
 
             // 3.2 - INDICES (IBO)
-            tinygltf::Accessor &indexAccessor = m_model.accessors[primitive.indices];
-            tinygltf::BufferView &bufferView = m_model.bufferViews[indexAccessor.bufferView];
-            int &bufferIndex = bufferView.buffer;
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[bufferIndex]); // Binding IBO
+            const tinygltf::Accessor &indexAccessor = m_model.accessors[primitive.indices];
+            vao.setElementBuffer(m_GLTFBuffers[m_model.bufferViews[indexAccessor.bufferView].buffer].glId());
             
             // 3.3 - ATTRIBUTS
             // Pour chaque attributes de la primitive
@@ -517,10 +594,8 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
             for (; it != itEnd; it++)
             {
                 assert(it->second >= 0);
-                tinygltf::Accessor &accessor = m_model.accessors[it->second];
-                bufferView = m_model.bufferViews[accessor.bufferView];
-                bufferIndex = bufferView.buffer;
-                glBindBuffer(GL_ARRAY_BUFFER, buffers[bufferIndex]);    // Binding VBO
+                const tinygltf::Accessor &accessor = m_model.accessors[it->second];
+                const tinygltf::BufferView &bufferView = m_model.bufferViews[accessor.bufferView];
                 
                 // Get number of component
                 int size = 1;
@@ -540,10 +615,13 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
                 if (m_attribs.count(it->first) > 0)
                 {
                     // Compute byteStride from Accessor + BufferView combination.
-                    int byteStride =  accessor.ByteStride(m_model.bufferViews[accessor.bufferView]);
+                    int byteStride =  accessor.ByteStride(bufferView);
                     assert(byteStride != -1);
-                    glEnableVertexAttribArray(m_attribs[it->first]);
-                    glVertexAttribPointer(m_attribs[it->first], size /*accessor.type*/, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, byteStride, (const GLvoid*) (bufferView.byteOffset + accessor.byteOffset));
+
+                    // Each attribute reads its own buffer binding, with the binding index equal to its location
+                    const GLuint location = m_attribs[it->first];
+                    vao.setVertexBuffer(location, m_GLTFBuffers[bufferView.buffer].glId(), bufferView.byteOffset + accessor.byteOffset, byteStride);
+                    vao.setAttribute(location, location, size /*accessor.type*/, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, 0);
 
                     // If it's the position attribute
                     if (it->first.compare("POSITION") == 0)
@@ -556,16 +634,12 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
                         meshInfos.max.push_back(glm::make_vec3(accessor.maxValues.data()));
                     }                        
                 }
-
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
             }
 
             // On rempli le vao et les primitives
-            meshInfos.vaos.push_back(vaoId);
+            meshInfos.vaos.push_back(vao.glId());
             meshInfos.primitives.push_back(primitive);
 
-            glBindVertexArray(0);
-
             // 3.4 - TEXTURES
             meshInfos.diffuseColor.push_back(glm::vec4(1));
             meshInfos.diffuseTexture.push_back(0);
@@ -623,20 +697,19 @@ void Application::loadTinyGLTF(const glmlv::fs::path & gltfPath)
     }
 
     // SAMPLER --> TODO --> Handle multiple samplers
-    glGenSamplers(1, &m_textureSampler);
     if (m_model.samplers.size() > 0)
     {
         tinygltf::Sampler sampler = m_model.samplers[0];
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_S, sampler.wrapS);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_T, sampler.wrapT);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_R, sampler.wrapR);
+        m_textureSampler.setParameter(GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+        m_textureSampler.setParameter(GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_S, sampler.wrapS);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_T, sampler.wrapT);
+        m_textureSampler.setParameter(GL_TEXTURE_WRAP_R, sampler.wrapR);
     }
     else
     {
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glSamplerParameteri(m_textureSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        m_textureSampler.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        m_textureSampler.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
 }
 
@@ -659,42 +732,57 @@ GLenum Application::getMode(int mode)
     }
 }
 
+// tinygltf decodes all images as RGBA8: downsample them right after loading to fit in the limits of textureOptions
+void Application::applyTextureLoadOptions(const glmlv::TextureLoadOptions & textureOptions)
+{
+    std::vector<glmlv::ImageInfo> infos(m_model.images.size());
+    for (size_t i = 0; i < m_model.images.size(); ++i) {
+        infos[i] = { size_t(m_model.images[i].width), size_t(m_model.images[i].height), glmlv::ImageFormat::RGBA8 };
+    }
+    const auto sizes = glmlv::computeBudgetedImageSizes(infos, textureOptions);
+
+    size_t fullResolutionByteSize = 0, residentByteSize = 0;
+    for (size_t i = 0; i < m_model.images.size(); ++i)
+    {
+        auto & image = m_model.images[i];
+        fullResolutionByteSize += infos[i].byteSize();
+        residentByteSize += sizes[i].byteSize();
+
+        if (image.image.empty() || image.component != 4 || (sizes[i].width == infos[i].width && sizes[i].height == infos[i].height)) {
+            continue;
+        }
+
+        std::cout << "Image " << i << " downsampled from " << image.width << "x" << image.height << " to " << sizes[i].width << "x" << sizes[i].height << std::endl;
+        std::vector<unsigned char> resized(sizes[i].byteSize());
+        glmlv::downsampleImage(image.image.data(), image.width, image.height, 4, resized.data(), sizes[i].width, sizes[i].height);
+        image.image.swap(resized);
+        image.width = int(sizes[i].width);
+        image.height = int(sizes[i].height);
+    }
+
+    std::cout << "Loaded " << m_model.images.size() << " images: " << residentByteSize / (1024. * 1024.) << " MB ("
+        << fullResolutionByteSize / (1024. * 1024.) << " MB at full resolution)" << std::endl;
+}
+
 void Application::AddTexture(tinygltf::Texture &tex, MeshInfos& meshInfos, bool diffuse, bool emissive)
 {
     if (tex.source > -1 && tex.source < m_model.images.size())
     {
         tinygltf::Image &image = m_model.images[tex.source];
 
-        if (emissive)
+        // One texture per image, shared by all the primitives using it
+        auto & texture = m_GLTFTextures[tex.source];
+        if (!texture)
         {
-            glActiveTexture(GL_TEXTURE0);
-        }
-        else if (diffuse)
-        {
-            glActiveTexture(GL_TEXTURE1);
-        }
-        
-
-        GLuint texId;
-        glGenTextures(1, &texId);
-        glBindTexture(GL_TEXTURE_2D, texId);
+            texture.reset(new glmlv::GLTexture(GL_TEXTURE_2D, 1, GL_RGBA8, image.width, image.height)); // tinygltf always decodes to RGBA8
+            texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        // Ignore Texture.fomat.
-        GLenum format = GL_RGBA;
-        if (image.component == 3) {
-            format = GL_RGB;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            texture->setSubImage2D(0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.image.at(0));
         }
-        
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
+        const auto texId = texture->glId();
 
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, image.width, image.height);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.image.at(0));
-        
-        glBindTexture(GL_TEXTURE_2D, 0);
-        
         if (emissive)
         {
             meshInfos.emissiveTexture.back() = texId;
@@ -709,24 +797,24 @@ void Application::AddTexture(tinygltf::Texture &tex, MeshInfos& meshInfos, bool
 // ------ GLTF DRAW --------
 
 
-void Application::DrawModel(tinygltf::Model &model) {
+void Application::FlattenModel(tinygltf::Model &model) {
+  GLMLV_PROFILE_FUNCTION();
   // If the glTF asset has at least one scene, and doesn't define a default one
   // just show the first one we can find
   assert(model.scenes.size() > 0);
   int scene_to_display = model.defaultScene > -1 ? model.defaultScene : 0;
   const tinygltf::Scene &scene = model.scenes[scene_to_display];
   
-  if (scene.nodes.size() != 0) {
-	  for (size_t i = 0; i < scene.nodes.size(); i++)
-	  {
-		  DrawNode(model, model.nodes[scene.nodes[i]], glm::mat4(1));
-	  }
+  for (size_t i = 0; i < scene.nodes.size(); i++)
+  {
+	  FlattenNode(model, model.nodes[scene.nodes[i]], glm::mat4(1));
   }
 
+  std::cout << "# of draw items : " << m_drawItems.size() << std::endl;
 }
 
-// Hierarchically draw nodes
-void Application::DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix) {
+// Hierarchically flatten nodes
+void Application::FlattenNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix) {
 
     // PUSH MATRIX
     glm::mat4 modelMatrix = currentMatrix;
@@ -763,54 +851,88 @@ void Application::DrawNode(tinygltf::Model &model, const tinygltf::Node &node, g
     if (node.mesh > -1)
     {
         assert(node.mesh < model.meshes.size());
-        DrawMesh(node.mesh, modelMatrix);
+        const auto & meshInfos = m_meshInfos[node.mesh];
+        for (size_t i = 0; i < meshInfos.vaos.size(); ++i)
+        {
+            m_drawItems.push_back({ node.mesh, i, modelMatrix });
+            m_drawItemBounds.push(meshInfos.min[i], meshInfos.max[i], modelMatrix); // glTF requires min / max on POSITION accessors
+        }
     }
 
-    // Draw child nodes.
+    // Flatten child nodes.
     for (size_t i = 0; i < node.children.size(); i++)
     {
         assert(node.children[i] < model.nodes.size());
-        DrawNode(model, model.nodes[node.children[i]], modelMatrix);
+        FlattenNode(model, model.nodes[node.children[i]], modelMatrix);
     }
 
     // POP MATRIX
 }
 
-void Application::DrawMesh(int meshIndex, glm::mat4 modelMatrix)
+glmlv::CullingStats Application::CullDrawItems(const glm::mat4 & viewProjMatrix, std::vector<uint8_t> & visibility)
 {
-    // OBJECT MATRIX
-    const auto mvMatrix = m_viewMatrix * modelMatrix;
-    const auto mvpMatrix = m_projMatrix * mvMatrix;
-    const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-
-    glUniformMatrix4fv(m_uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glUniformMatrix4fv(m_uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-    glUniformMatrix4fv(m_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-    // DRAW EACH VAO / PRIMITIVES of this mesh
-    for (size_t i = 0; i < m_meshInfos[meshIndex].vaos.size(); ++i)
-    {        
-        // Emissive
-        glUniform3fv(m_uKaLocation, 1, glm::value_ptr(m_meshInfos[meshIndex].emissiveColor[i]));
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_meshInfos[meshIndex].emissiveTexture[i]);
-        
-        // Diffuse
-        glm::vec3 diffuseColor(m_meshInfos[meshIndex].diffuseColor[i].x, m_meshInfos[meshIndex].diffuseColor[i].y, m_meshInfos[meshIndex].diffuseColor[i].z);
-        glUniform3fv(m_uKdLocation, 1, glm::value_ptr(diffuseColor));        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, m_meshInfos[meshIndex].diffuseTexture[i]);
+    if (m_bFrustumCulling) {
+        return glmlv::cullFrustum(m_drawItemBounds, viewProjMatrix, visibility);
+    }
+
+    visibility.assign(m_drawItems.size(), 1);
+    glmlv::CullingStats stats;
+    stats.visibleCount = m_drawItems.size();
+    return stats;
+}
+
+void Application::DrawItems(const std::vector<uint8_t> & visibility, bool shadowPass)
+{
+    GLMLV_PROFILE_FUNCTION();
+
+    const glm::mat4 * pCurrentModelMatrix = nullptr;
+    for (size_t itemIndex = 0; itemIndex < m_drawItems.size(); ++itemIndex)
+    {
+        if (!visibility[itemIndex]) {
+            continue;
+        }
+        const auto & item = m_drawItems[itemIndex];
+        const auto & meshInfos = m_meshInfos[item.meshIndex];
+        const auto i = item.primitiveIndex;
+
+        // OBJECT MATRIX, set once for the consecutive primitives of a node
+        if (!pCurrentModelMatrix || *pCurrentModelMatrix != item.modelMatrix)
+        {
+            if (shadowPass)
+            {
+                glUniformMatrix4fv(m_uDirLightModelMatrix, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+            }
+            else
+            {
+                const auto mvMatrix = m_viewMatrix * item.modelMatrix;
+                const auto mvpMatrix = m_projMatrix * mvMatrix;
+                const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
+
+                glUniformMatrix4fv(m_uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+                glUniformMatrix4fv(m_uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
+                glUniformMatrix4fv(m_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+            }
+            pCurrentModelMatrix = &item.modelMatrix;
+        }
+
+        if (!shadowPass)
+        {
+            // Emissive
+            glUniform3fv(m_uKaLocation, 1, glm::value_ptr(meshInfos.emissiveColor[i]));
+            m_GLState.bindTexture(0, meshInfos.emissiveTexture[i]);
+
+            // Diffuse
+            glm::vec3 diffuseColor(meshInfos.diffuseColor[i].x, meshInfos.diffuseColor[i].y, meshInfos.diffuseColor[i].z);
+            glUniform3fv(m_uKdLocation, 1, glm::value_ptr(diffuseColor));
+            m_GLState.bindTexture(1, meshInfos.diffuseTexture[i]);
+        }
 
         // Bind VAO
-        const tinygltf::Accessor &indexAccessor = m_model.accessors[m_meshInfos[meshIndex].primitives[i].indices];        
-        glBindVertexArray(m_meshInfos[meshIndex].vaos[i]);
+        const tinygltf::Accessor &indexAccessor = m_model.accessors[meshInfos.primitives[i].indices];
+        m_GLState.bindVertexArray(meshInfos.vaos[i]);
 
-        // Draw
-        glDrawElements(getMode(m_meshInfos[meshIndex].primitives[i].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid*) indexAccessor.byteOffset);
-        
-        // Unbind
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        // Draw, without unbinding: primitives sharing a texture or a VAO do not bind it again
+        glDrawElements(getMode(meshInfos.primitives[i].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid*) indexAccessor.byteOffset);
     }
 }
 
@@ -930,41 +1052,45 @@ glm::vec3 Application::GetCenterOfBoundingBox(const BoundingBox& boundingBox)
 //SHADOW MAP
 void Application::initShadowData()
 {
-	glGenTextures(1, &m_directionalSMTexture);
-
-	glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, m_nDirectionalSMResolution, m_nDirectionalSMResolution);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	glGenFramebuffers(1, &m_directionalSMFBO);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_directionalSMFBO);
-	glBindTexture(GL_TEXTURE_2D, m_directionalSMTexture);
-	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_directionalSMTexture, 0);
-
-	const auto fboStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-	if (fboStatus != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cerr << "Error on building directional shadow mapping framebuffer. Error code = " << fboStatus << std::endl;
-		throw std::runtime_error("Error on building directional shadow mapping framebuffer.");
-	}
-
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-
-	glGenSamplers(1, &m_directionalSMSampler);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-	glSamplerParameteri(m_directionalSMSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	m_directionalSMTexture.setStorage2D(1, GL_DEPTH_COMPONENT32F, m_nDirectionalSMResolution, m_nDirectionalSMResolution);
+
+	m_directionalSMFBO.attachTexture(GL_DEPTH_ATTACHMENT, m_directionalSMTexture.glId());
+	m_directionalSMFBO.checkComplete("directional shadow mapping");
+
+	m_directionalSMSampler.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	m_directionalSMSampler.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	m_directionalSMSampler.setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	m_directionalSMSampler.setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	m_directionalSMSampler.setParameter(GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	m_directionalSMSampler.setParameter(GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 }
 
 
 // SHADERS
+constexpr int Application::ShadingPassSampleCounts[];
+
 // Récupére les locations des uniformes
 void Application::initShadersData()
 {
-    m_geometryPassProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "geometryPass.vs.glsl", m_ShadersRootPath / m_AppName / "geometryPass.fs.glsl" });
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Submit every program before querying any of them, so that the driver compiles them all at once
+    glmlv::ProgramBuilder programBuilder(&m_ProgramCache);
+    const auto geometryPass = programBuilder.add({ m_ShadersRootPath / m_AppName / "geometryPass.vs.glsl", m_ShadersRootPath / m_AppName / "geometryPass.fs.glsl" });
+    const auto displayDepth = programBuilder.add({ m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "displayDepth.fs.glsl" });
+    const auto displayPosition = programBuilder.add({ m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "displayPosition.fs.glsl" });
+    const auto directionalSM = programBuilder.add({ m_ShadersRootPath / m_AppName / "directionalSM.vs.glsl", m_ShadersRootPath / m_AppName / "directionalSM.fs.glsl" });
+    programBuilder.linkAll();
+
+    // Shading pass variants are compiled while the driver works on the programs above
+    std::vector<glmlv::ShaderDefines> shadingPassVariants = { glmlv::ShaderDefines() };
+    for (const auto sampleCount : ShadingPassSampleCounts) {
+        shadingPassVariants.push_back({ { "SHADOW_SAMPLE_COUNT", std::to_string(sampleCount) } });
+    }
+    m_shadingPassVariants.prebuild(getShadingPassShaders(), shadingPassVariants);
+    selectShadingPassVariant();
+
+    m_geometryPassProgram = programBuilder.take(geometryPass);
 
     m_uModelViewProjMatrixLocation = glGetUniformLocation(m_geometryPassProgram.glId(), "uModelViewProjMatrix");
     m_uModelViewMatrixLocation = glGetUniformLocation(m_geometryPassProgram.glId(), "uModelViewMatrix");
@@ -979,36 +1105,31 @@ void Application::initShadersData()
     m_uKsSamplerLocation = glGetUniformLocation(m_geometryPassProgram.glId(), "uKsSampler");
     m_uShininessSamplerLocation = glGetUniformLocation(m_geometryPassProgram.glId(), "uShininessSampler");
 
-    m_shadingPassProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "shadingPass.fs.glsl" });
-
-    m_uGBufferSamplerLocations[GPosition] = glGetUniformLocation(m_shadingPassProgram.glId(), "uGPosition");
-    m_uGBufferSamplerLocations[GNormal] = glGetUniformLocation(m_shadingPassProgram.glId(), "uGNormal");
-    m_uGBufferSamplerLocations[GAmbient] = glGetUniformLocation(m_shadingPassProgram.glId(), "uGAmbient");
-    m_uGBufferSamplerLocations[GDiffuse] = glGetUniformLocation(m_shadingPassProgram.glId(), "uGDiffuse");
-    m_uGBufferSamplerLocations[GGlossyShininess] = glGetUniformLocation(m_shadingPassProgram.glId(), "uGGlossyShininess");
-
-	m_uDirLightViewProjMatrix_shadingPass = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirLightViewProjMatrix");
-	m_uDirLightShadowMap = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirLightShadowMap");
-	m_uDirLightShadowMapBias = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirLightShadowMapBias");
-	m_uDirLightShadowMapSampleCount = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirLightShadowMapSampleCount");
-	m_uDirLightShadowMapSpread = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirLightShadowMapSpread");
-
-    
-    m_uDirectionalLightDirLocation = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirectionalLightDir");
-    m_uDirectionalLightIntensityLocation = glGetUniformLocation(m_shadingPassProgram.glId(), "uDirectionalLightIntensity");
-
-    m_uPointLightPositionLocation = glGetUniformLocation(m_shadingPassProgram.glId(), "uPointLightPosition");
-    m_uPointLightIntensityLocation = glGetUniformLocation(m_shadingPassProgram.glId(), "uPointLightIntensity");
-
-    m_displayDepthProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "displayDepth.fs.glsl" });
+    m_displayDepthProgram = programBuilder.take(displayDepth);
 
     m_uGDepthSamplerLocation = glGetUniformLocation(m_displayDepthProgram.glId(), "uGDepth");
 
-    m_displayPositionProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "displayPosition.fs.glsl" });
+    m_displayPositionProgram = programBuilder.take(displayPosition);
 
     m_uGPositionSamplerLocation = glGetUniformLocation(m_displayPositionProgram.glId(), "uGPosition");
     m_uSceneSizeLocation = glGetUniformLocation(m_displayPositionProgram.glId(), "uSceneSize");
 
-	m_directionalSMProgram = glmlv::compileProgram({ m_ShadersRootPath / m_AppName / "directionalSM.vs.glsl", m_ShadersRootPath / m_AppName / "directionalSM.fs.glsl" });
+	m_directionalSMProgram = programBuilder.take(directionalSM);
 	m_uDirLightViewProjMatrix = glGetUniformLocation(m_directionalSMProgram.glId(), "uDirLightViewProjMatrix");
+	m_uDirLightModelMatrix = glGetUniformLocation(m_directionalSMProgram.glId(), "uModelMatrix");
+
+	m_ProgramCache.logStartupTime(m_AppName, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count());
+}
+
+void Application::selectShadingPassVariant()
+{
+    glmlv::ShaderDefines defines;
+    if (std::find(std::begin(ShadingPassSampleCounts), std::end(ShadingPassSampleCounts), m_DirLightSMSampleCount) != std::end(ShadingPassSampleCounts)) {
+        defines["SHADOW_SAMPLE_COUNT"] = std::to_string(m_DirLightSMSampleCount);
+    }
+    m_pShadingPassProgram = &m_shadingPassVariants.get(getShadingPassShaders(), defines);
+    m_ShadingPassSampleCount = m_DirLightSMSampleCount;
+#ifndef NDEBUG
+    m_bValidateShadingPassBindings = true;
+#endif
 }
@@ -5,13 +5,26 @@
 #include <glmlv/filesystem.hpp>
 #include <glmlv/GLFWHandle.hpp>
 #include <glmlv/GLProgram.hpp>
+#include <glmlv/GLStateCache.hpp>
+#include <glmlv/GLBuffer.hpp>
+#include <glmlv/GLTexture.hpp>
+#include <glmlv/GLSampler.hpp>
+#include <glmlv/GLVertexArray.hpp>
+#include <glmlv/GLFramebuffer.hpp>
+#include <glmlv/ProgramBuilder.hpp>
+#include <glmlv/ShaderVariants.hpp>
 #include <glmlv/ViewController.hpp>
 #include <glmlv/simple_geometry.hpp>
+#include <glmlv/Image2D.hpp>
+#include <glmlv/FrameCapture.hpp>
+#include <glmlv/GPUProfiler.hpp>
+#include <glmlv/frustum_culling.hpp>
 
 #include <glm/glm.hpp>
 
 #include <tiny_gltf.h>
 #include <limits>
+#include <memory>
 
 #include "Trackball.hpp"
 
@@ -23,6 +36,14 @@ public:
     int run();
 private:
     void initShadersData();
+    void selectShadingPassVariant(); // Use the shading pass variant for m_DirLightSMSampleCount
+
+    std::vector<glmlv::fs::path> getShadingPassShaders() const
+    {
+        return { m_ShadersRootPath / m_AppName / "shadingPass.vs.glsl", m_ShadersRootPath / m_AppName / "shadingPass.fs.glsl" };
+    }
+
+    static constexpr int ShadingPassSampleCounts[] = { 4, 8, 16 };
 	void initShadowData();
 
     static glm::vec3 computeDirectionVector(float phiRadians, float thetaRadians)
@@ -52,6 +73,7 @@ private:
     const glmlv::fs::path m_AssetsRootPath;
 
     glmlv::GLProgram m_program;
+    glmlv::GLStateCache m_GLState; // Programs, vertex arrays, textures, samplers and framebuffers of the render loop are bound through it
 
     // ====== CAMERA ======== //
 
@@ -85,8 +107,8 @@ private:
     // ========= DEFERRED RENDERING ============ //
 
     // Triangle covering the whole screen, for the shading pass:
-    GLuint m_TriangleVBO = 0;
-    GLuint m_TriangleVAO = 0;
+    glmlv::GLBuffer m_TriangleVBO;
+    glmlv::GLVertexArray m_TriangleVAO;
 
     // GBuffer:
     enum GBufferTextureType
@@ -102,8 +124,8 @@ private:
 
     const char * m_GBufferTexNames[GBufferTextureCount + 1] = { "position", "normal", "ambient", "diffuse", "glossyShininess", "depth", "beauty" }; // Tricks, since we cant blit depth, we use its value to draw the result of the shading pass
     const GLenum m_GBufferTextureFormat[GBufferTextureCount] = { GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGB32F, GL_RGBA32F, GL_DEPTH_COMPONENT32F };
-    GLuint m_GBufferTextures[GBufferTextureCount];
-    GLuint m_GBufferFBO; // Framebuffer object
+    glmlv::GLTexture m_GBufferTextures[GBufferTextureCount];
+    glmlv::GLFramebuffer m_GBufferFBO; // Framebuffer object
 
 	enum DisplayType
 	{
@@ -124,11 +146,17 @@ private:
 
     GBufferTextureType m_CurrentlyDisplayed = GBufferTextureCount; // Default to beauty
 
-    GLuint m_textureSampler = 0; // Only one sampler object since we will use the sample sampling parameters for the two textures
+    glmlv::GLSampler m_textureSampler; // Only one sampler object since we will use the sample sampling parameters for the two textures
 
     // GLSL programs
+    // Linked programs are cached next to the executable, keyed by their sources and the driver
+    glmlv::ProgramBinaryCache m_ProgramCache{ m_AppPath.parent_path() / "shader_cache" / m_AppName };
+
     glmlv::GLProgram m_geometryPassProgram;
-    glmlv::GLProgram m_shadingPassProgram;
+    // The shading pass has a variant specialized for each shadow map sample count in ShadingPassSampleCounts, and a generic one for other counts
+    glmlv::ShaderVariantCache m_shadingPassVariants{ { m_ShadersRootPath }, &m_ProgramCache };
+    const glmlv::GLProgram * m_pShadingPassProgram = nullptr;
+    int m_ShadingPassSampleCount = -1; // Value of m_DirLightSMSampleCount m_pShadingPassProgram has been selected for
     glmlv::GLProgram m_displayDepthProgram;
     glmlv::GLProgram m_displayPositionProgram;
 
@@ -145,17 +173,10 @@ private:
     GLint m_uKsSamplerLocation;
     GLint m_uShininessSamplerLocation;
 
-    // Shading pass uniforms
-    GLint m_uGBufferSamplerLocations[GDepth];
-    GLint m_uDirectionalLightDirLocation;
-    GLint m_uDirectionalLightIntensityLocation;
-    GLint m_uPointLightPositionLocation;
-    GLint m_uPointLightIntensityLocation;
-	GLint m_uDirLightViewProjMatrix_shadingPass; // Suffix because the variable m_uDirLightViewProjMatrix is already used for the uniform of m_directionalSMProgram.
-	GLint m_uDirLightShadowMap;
-	GLint m_uDirLightShadowMapBias;
-	GLint m_uDirLightShadowMapSampleCount;
-	GLint m_uDirLightShadowMapSpread;
+    // Shading pass uniforms are looked up by name in the reflection of the selected variant
+#ifndef NDEBUG
+    bool m_bValidateShadingPassBindings = true; // Check the bindings of the shading pass at its first draw with a new variant
+#endif
 
     // Display depth pass uniforms
     GLint m_uGDepthSamplerLocation;
@@ -170,18 +191,35 @@ private:
 	// Shadow mapping data
 	glmlv::GLProgram m_directionalSMProgram;
 	GLint m_uDirLightViewProjMatrix;
+	GLint m_uDirLightModelMatrix;
 
-	GLuint m_directionalSMSampler;
+	glmlv::GLSampler m_directionalSMSampler;
 
-	GLuint m_directionalSMFBO;
-	GLuint m_directionalSMTexture;
+	glmlv::GLFramebuffer m_directionalSMFBO;
+	glmlv::GLTexture m_directionalSMTexture;
 	int32_t m_nDirectionalSMResolution = 4096;
 
+	// ================ FRAME CAPTURE ================ //
+
+	glmlv::FrameCapture m_FrameCapture;
+	int m_CaptureSource = 0; // 0 for the default framebuffer, i + 1 for the GBuffer color attachment i
+	int m_CaptureExtension = 0; // Index in m_CaptureExtensions
+	const char * m_CaptureExtensions[3] = { ".png", ".bmp", ".tga" };
+
+	// ================ PROFILING ================ //
+
+	glmlv::GPUProfiler m_GPUProfiler; // One section per pass, exported to profiles/<app name>.csv / .json
+
 	// ================ FOR GLTF ================ //
 
     tinygltf::Model m_model;
     std::map<std::string, GLint> m_attribs;
 
+    // GL objects of the model, MeshInfos refer to them by name
+    std::vector<glmlv::GLBuffer> m_GLTFBuffers; // One per tinygltf::Buffer
+    std::vector<glmlv::GLVertexArray> m_GLTFVertexArrays; // One per primitive
+    std::vector<std::unique_ptr<glmlv::GLTexture>> m_GLTFTextures; // One per tinygltf::Image, null if no material uses it
+
     // TODO --> Maybe We can put all 3 into a structure because the same Index means the same element
     typedef struct {
         // Vertex
@@ -200,13 +238,37 @@ private:
 
     std::vector<MeshInfos> m_meshInfos;
 
-    void loadTinyGLTF(const glmlv::fs::path & gltfPath);
+    // Primitives of the default scene with the transform of their node, flattened once at load: each pass culls this list against
+    // its frustum and draws the visible items, instead of walking the node hierarchy every frame
+    struct DrawItem
+    {
+        int meshIndex;
+        size_t primitiveIndex; // In m_meshInfos[meshIndex]
+        glm::mat4 modelMatrix;
+    };
+
+    std::vector<DrawItem> m_drawItems;
+    glmlv::CullingBounds m_drawItemBounds; // World space box of each draw item
+
+    bool m_bFrustumCulling = true;
+    std::vector<uint8_t> m_cameraVisibility; // One per draw item
+    std::vector<uint8_t> m_dirLightVisibility;
+    glmlv::CullingStats m_cameraCullingStats;
+    glmlv::CullingStats m_dirLightCullingStats; // Of the last shadow map update
+
+    void loadTinyGLTF(const glmlv::fs::path & gltfPath, const glmlv::TextureLoadOptions & textureOptions);
+    void applyTextureLoadOptions(const glmlv::TextureLoadOptions & textureOptions);
     void drawGLTF();
     GLenum getMode(int mode);
 
-    void DrawModel(tinygltf::Model &model);
-    void DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix);
-    void DrawMesh(int meshIndex, glm::mat4 modelMatrix);
+    void FlattenModel(tinygltf::Model &model);
+    void FlattenNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 currentMatrix);
+
+    // Everything is visible when m_bFrustumCulling is off
+    glmlv::CullingStats CullDrawItems(const glm::mat4 & viewProjMatrix, std::vector<uint8_t> & visibility);
+
+    // The shadow pass only sets the model matrix, the geometry pass also sets the camera transforms and the material
+    void DrawItems(const std::vector<uint8_t> & visibility, bool shadowPass);
     void DrawMesh();
 
     void AddTexture(tinygltf::Texture &tex, MeshInfos& meshInfos, bool diffuse, bool emissive);
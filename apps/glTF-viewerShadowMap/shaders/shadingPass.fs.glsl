@@ -18,27 +18,12 @@ uniform vec3 uPointLightIntensity;
 uniform mat4 uDirLightViewProjMatrix;
 uniform sampler2DShadow uDirLightShadowMap;
 uniform float uDirLightShadowMapBias;
-uniform int uDirLightShadowMapSampleCount;
+#ifndef SHADOW_SAMPLE_COUNT
+uniform int uDirLightShadowMapSampleCount; // Generic variant only, specialized variants define SHADOW_SAMPLE_COUNT
+#endif
 uniform float uDirLightShadowMapSpread;
 
-vec2 poissonDisk[16] = vec2[](
-    vec2( -0.94201624, -0.39906216 ),
-    vec2( 0.94558609, -0.76890725 ),
-    vec2( -0.094184101, -0.92938870 ),
-    vec2( 0.34495938, 0.29387760 ),
-    vec2( -0.91588581, 0.45771432 ),
-    vec2( -0.81544232, -0.87912464 ),
-    vec2( -0.38277543, 0.27676845 ),
-    vec2( 0.97484398, 0.75648379 ),
-    vec2( 0.44323325, -0.97511554 ),
-    vec2( 0.53742981, -0.47373420 ),
-    vec2( -0.26496911, -0.41893023 ),
-    vec2( 0.79197514, 0.19090188 ),
-    vec2( -0.24188840, 0.99706507 ),
-    vec2( -0.81409955, 0.91437590 ),
-    vec2( 0.19984126, 0.78641367 ),
-    vec2( 0.14383161, -0.14100790 )
-);
+#include "glmlv/poissonDisk.glsl"
 
 float random(vec4 seed)
 {
@@ -80,16 +65,23 @@ void main()
     vec3 positionInDirLightNDC = vec3(positionInDirLightScreen / positionInDirLightScreen.w) * 0.5 + 0.5; // Homogeneize + put between 0 and 1
     //float dirLightVisibility = textureProj(uDirLightShadowMap, vec4(positionInDirLightNDC.xy, positionInDirLightNDC.z - uDirLightShadowMapBias, 1.0), 0.0);
 
+#ifdef SHADOW_SAMPLE_COUNT
+    // Constant loop count and indices: the loop is unrolled and the disk offsets folded
+    const int sampleCount = SHADOW_SAMPLE_COUNT;
+#else
+    int sampleCount = uDirLightShadowMapSampleCount;
+#endif
+
     float dirLightVisibility = 0.0;
-    float dirSampleCountf = float(uDirLightShadowMapSampleCount);
-    int step = max(1, 16 / uDirLightShadowMapSampleCount);
-    for (int i = 0; i < uDirLightShadowMapSampleCount; ++i)
+    float dirSampleCountf = float(sampleCount);
+    int step = max(1, 16 / sampleCount);
+    for (int i = 0; i < sampleCount; ++i)
     {
         // Noisy shadows:
-        // int index = int(dirSampleCountf * random(vec4(gl_FragCoord.xyy, i))) % uDirLightShadowMapSampleCount;
+        // int index = int(dirSampleCountf * random(vec4(gl_FragCoord.xyy, i))) % sampleCount;
 
         // Blurred shadows:
-        int index = (i + step) % uDirLightShadowMapSampleCount;
+        int index = (i + step) % sampleCount;
 
         dirLightVisibility += textureProj(uDirLightShadowMap, vec4(positionInDirLightNDC.xy + uDirLightShadowMapSpread * poissonDisk[index], positionInDirLightNDC.z - uDirLightShadowMapBias, 1.0), 0.0);
     }
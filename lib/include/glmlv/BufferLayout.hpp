@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <glm/glm.hpp>
+
+namespace glmlv
+{
+
+// Compile time description of the memory layout of GLSL interface blocks, to check that C++ structs uploaded to uniform
+// and shader storage buffers match them. A block is described by the GLSL types of its members, in declaration order:
+//
+//     layout(std140) uniform uMaterial { vec3 Ka; float shininess; vec4 Kd; };      // GLSL
+//
+//     struct MaterialData { glm::vec3 Ka; float shininess; glm::vec4 Kd; };          // C++
+//     using MaterialLayout = glmlv::BlockLayout<glmlv::BufferLayout::std140, glm::vec3, float, glm::vec4>;
+//     static_assert(MaterialLayout::matches({ offsetof(MaterialData, Ka), offsetof(MaterialData, shininess), offsetof(MaterialData, Kd) }, sizeof(MaterialData)),
+//         "MaterialData does not match its std140 block");
+//
+// Arrays are described with GLSLArray<T, N> and nested structs with their own BlockLayout. glm types are tightly packed, so C++ structs
+// usually need explicit padding members (e.g. a float after a vec3 that is not followed by a scalar); matches() tells when they are missing.
+enum class BufferLayout
+{
+    std140, // Uniform blocks: array strides and struct alignments rounded up to 16 bytes
+    std430 // Shader storage blocks only: arrays of scalars and vec2 are tightly packed
+};
+
+template<typename T, size_t Count>
+struct GLSLArray
+{
+};
+
+namespace detail
+{
+
+constexpr size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+constexpr size_t max(size_t lhs, size_t rhs)
+{
+    return lhs < rhs ? rhs : lhs;
+}
+
+}
+
+// Base alignment and size of a GLSL type. Not defined for bool, whose C++ size does not match (use int32_t / uint32_t).
+template<BufferLayout Layout, typename T>
+struct GLSLTypeLayout;
+
+template<BufferLayout Layout, typename T, size_t ComponentCount>
+struct GLSLVectorLayout
+{
+    static constexpr size_t alignment()
+    {
+        return sizeof(T) * (ComponentCount == 3 ? 4 : ComponentCount); // vec3 is aligned as vec4
+    }
+
+    static constexpr size_t size()
+    {
+        return sizeof(T) * ComponentCount;
+    }
+};
+
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, float> : GLSLVectorLayout<Layout, float, 1> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, int32_t> : GLSLVectorLayout<Layout, int32_t, 1> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, uint32_t> : GLSLVectorLayout<Layout, uint32_t, 1> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::vec2> : GLSLVectorLayout<Layout, float, 2> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::vec3> : GLSLVectorLayout<Layout, float, 3> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::vec4> : GLSLVectorLayout<Layout, float, 4> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::ivec2> : GLSLVectorLayout<Layout, int32_t, 2> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::ivec3> : GLSLVectorLayout<Layout, int32_t, 3> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::ivec4> : GLSLVectorLayout<Layout, int32_t, 4> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::uvec2> : GLSLVectorLayout<Layout, uint32_t, 2> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::uvec3> : GLSLVectorLayout<Layout, uint32_t, 3> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::uvec4> : GLSLVectorLayout<Layout, uint32_t, 4> {};
+
+template<BufferLayout Layout, typename T, size_t Count>
+struct GLSLTypeLayout<Layout, GLSLArray<T, Count>>
+{
+    static constexpr size_t alignment()
+    {
+        return Layout == BufferLayout::std140 ? detail::roundUp(GLSLTypeLayout<Layout, T>::alignment(), 16) : GLSLTypeLayout<Layout, T>::alignment();
+    }
+
+    static constexpr size_t stride()
+    {
+        return detail::roundUp(GLSLTypeLayout<Layout, T>::size(), alignment());
+    }
+
+    static constexpr size_t size()
+    {
+        return stride() * Count;
+    }
+};
+
+// Column major matrices are laid out as arrays of their columns
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::mat2> : GLSLTypeLayout<Layout, GLSLArray<glm::vec2, 2>> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::mat3> : GLSLTypeLayout<Layout, GLSLArray<glm::vec3, 3>> {};
+template<BufferLayout Layout> struct GLSLTypeLayout<Layout, glm::mat4> : GLSLTypeLayout<Layout, GLSLArray<glm::vec4, 4>> {};
+
+template<BufferLayout Layout, typename... Members>
+struct BlockLayout
+{
+    static constexpr size_t memberCount()
+    {
+        return sizeof...(Members);
+    }
+
+    // Offset of the member at index in the block
+    static constexpr size_t offset(size_t index)
+    {
+        const size_t alignments[] = { GLSLTypeLayout<Layout, Members>::alignment()... };
+        const size_t sizes[] = { GLSLTypeLayout<Layout, Members>::size()... };
+
+        size_t offset = 0;
+        for (size_t i = 0; i < index; ++i) {
+            offset = detail::roundUp(offset, alignments[i]) + sizes[i];
+        }
+        return detail::roundUp(offset, alignments[index]);
+    }
+
+    static constexpr size_t alignment()
+    {
+        const size_t alignments[] = { GLSLTypeLayout<Layout, Members>::alignment()... };
+
+        size_t alignment = Layout == BufferLayout::std140 ? 16 : 1;
+        for (const auto memberAlignment : alignments) {
+            alignment = detail::max(alignment, memberAlignment);
+        }
+        return alignment;
+    }
+
+    // Size of the block, rounded up to its alignment as for an element of an array of such structs
+    static constexpr size_t size()
+    {
+        const size_t sizes[] = { GLSLTypeLayout<Layout, Members>::size()... };
+        return detail::roundUp(offset(memberCount() - 1) + sizes[memberCount() - 1], alignment());
+    }
+
+    // True if offsets (offsetof() of each member of a C++ struct, in order) and the size of that struct match the block
+    static constexpr bool matches(std::initializer_list<size_t> offsets, size_t structSize)
+    {
+        if (offsets.size() != memberCount() || structSize != size()) {
+            return false;
+        }
+        size_t index = 0;
+        for (const auto memberOffset : offsets)
+        {
+            if (memberOffset != offset(index++)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Nested structs
+template<BufferLayout Layout, BufferLayout MembersLayout, typename... Members>
+struct GLSLTypeLayout<Layout, BlockLayout<MembersLayout, Members...>>
+{
+    static_assert(Layout == MembersLayout, "A nested struct must be described with the layout of its parent block");
+
+    static constexpr size_t alignment()
+    {
+        return BlockLayout<MembersLayout, Members...>::alignment();
+    }
+
+    static constexpr size_t size()
+    {
+        return BlockLayout<MembersLayout, Members...>::size();
+    }
+};
+
+template<typename... Members>
+using Std140Layout = BlockLayout<BufferLayout::std140, Members...>;
+
+template<typename... Members>
+using Std430Layout = BlockLayout<BufferLayout::std430, Members...>;
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+// CPU profiling markers, compiled only if GLMLV_ENABLE_CPU_PROFILER is defined (CMake option of the same name).
+// Without it the macros expand to nothing and this header declares nothing else.
+//
+//     void loadScene()
+//     {
+//         GLMLV_PROFILE_FUNCTION();
+//         {
+//             GLMLV_PROFILE_SCOPE("Parse");
+//             ...
+//         }
+//     }
+//
+//     for (;;) { GLMLV_PROFILE_FRAME(); ... }
+//     GLMLV_PROFILE_WRITE_TRACE(path); // Chrome trace event JSON, open it in chrome://tracing or ui.perfetto.dev
+//
+// Scope names must be string literals (or live as long as the profiler): only the pointer is recorded.
+
+#ifdef GLMLV_ENABLE_CPU_PROFILER
+
+#include <glmlv/filesystem.hpp>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace glmlv
+{
+
+// Each thread records its events in its own ring buffer, written only by that thread: recording a scope is two clock reads and
+// a store, without lock. When a ring is full the oldest events are overwritten, so a trace holds the last eventsPerThread
+// events of each thread. Rings are registered once per thread (under a mutex) and outlive their thread.
+class CPUProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char * name): m_pName(name), m_Start(Clock::now())
+        {
+        }
+
+        ~Scope()
+        {
+            CPUProfiler::get().record(m_pName, m_Start, Clock::now());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator =(const Scope&) = delete;
+
+    private:
+        const char * m_pName;
+        Clock::time_point m_Start;
+    };
+
+    // Profiler shared by the library and the apps, created on first use
+    static CPUProfiler& get();
+
+    explicit CPUProfiler(size_t eventsPerThread = 1 << 16);
+
+    CPUProfiler(const CPUProfiler&) = delete;
+    CPUProfiler& operator =(const CPUProfiler&) = delete;
+
+    void record(const char * name, Clock::time_point start, Clock::time_point end);
+
+    // Mark the start of a new frame: a global instant event in the trace
+    void frameBoundary();
+
+    // Name of the calling thread in the trace
+    void setThreadName(const std::string& name);
+
+    size_t getFrameCount() const
+    {
+        return m_nFrameCount;
+    }
+
+    // Write the events currently held by the rings in Chrome trace event format. Safe to call while other threads record:
+    // events they overwrite during the copy are skipped.
+    void writeTrace(const fs::path& path) const;
+
+private:
+    enum EventType : uint32_t
+    {
+        Complete,
+        FrameBoundary
+    };
+
+    struct Event
+    {
+        const char * pName;
+        int64_t startNs; // Relative to m_Origin
+        int64_t durationNs;
+        EventType type;
+    };
+
+    struct ThreadBuffer
+    {
+        std::vector<Event> events;
+        std::atomic<uint64_t> head{ 0 }; // Number of events ever written, only incremented by the owner thread
+        size_t threadId = 0; // Registration order, used as tid in the trace
+        std::string threadName;
+    };
+
+    ThreadBuffer& threadBuffer();
+    void push(ThreadBuffer& buffer, const Event& event);
+
+    const size_t m_nEventsPerThread;
+    const Clock::time_point m_Origin;
+    std::atomic<size_t> m_nFrameCount{ 0 };
+
+    mutable std::mutex m_RegistryMutex; // Protect m_ThreadBuffers and the thread names
+    std::vector<std::unique_ptr<ThreadBuffer>> m_ThreadBuffers;
+};
+
+}
+
+#define GLMLV_PROFILE_CONCAT_IMPL(a, b) a##b
+#define GLMLV_PROFILE_CONCAT(a, b) GLMLV_PROFILE_CONCAT_IMPL(a, b)
+#define GLMLV_PROFILE_SCOPE(name) ::glmlv::CPUProfiler::Scope GLMLV_PROFILE_CONCAT(glmlvProfileScope, __LINE__)(name)
+#define GLMLV_PROFILE_FUNCTION() GLMLV_PROFILE_SCOPE(__FUNCTION__)
+#define GLMLV_PROFILE_FRAME() ::glmlv::CPUProfiler::get().frameBoundary()
+#define GLMLV_PROFILE_THREAD_NAME(name) ::glmlv::CPUProfiler::get().setThreadName(name)
+#define GLMLV_PROFILE_WRITE_TRACE(path) ::glmlv::CPUProfiler::get().writeTrace(path)
+
+#else
+
+#define GLMLV_PROFILE_SCOPE(name) ((void)0)
+#define GLMLV_PROFILE_FUNCTION() ((void)0)
+#define GLMLV_PROFILE_FRAME() ((void)0)
+#define GLMLV_PROFILE_THREAD_NAME(name) ((void)0)
+#define GLMLV_PROFILE_WRITE_TRACE(path) ((void)0)
+
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/ThreadPool.hpp>
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace glmlv
+{
+
+// Capture a sequence of frames to image files without stalling the rendering loop.
+// Each captured frame is read into one of the pixel pack buffers of a ring, with a fence to know when the GPU is done with it.
+// Completed readbacks are copied to an Image2DRGBA and handed to a background thread that calls writeImage().
+// If every buffer of the ring is still in use by the GPU the frame is dropped; the render loop only blocks when the encoding queue is full.
+// Parallel PNG encoding runs on a thread pool owned by the capture, so it never waits on (or delays) the parallelFor calls of the render thread.
+class FrameCapture
+{
+public:
+    struct Stats
+    {
+        size_t capturedFrameCount = 0; // Frames read back and queued for encoding
+        size_t droppedFrameCount = 0; // Frames skipped because all pixel pack buffers were in flight
+        size_t encodedFrameCount = 0; // Frames written to disk
+        size_t queuedFrameCount = 0; // Frames waiting for the encoder thread
+        double encodeSeconds = 0.; // Total time spent in writeImage()
+        double encodedMegaBytes = 0.; // Total size of the encoded images (uncompressed)
+        double blockedSeconds = 0.; // Total time the render loop waited for the encoding queue
+    };
+
+    // ringSize: number of pixel pack buffers, i.e. frames that can be in flight between glReadPixels and the CPU copy
+    // maxQueuedFrameCount: number of frames waiting for the encoder before captureFrame() blocks
+    FrameCapture(size_t ringSize = 3, size_t maxQueuedFrameCount = 8);
+
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator =(const FrameCapture&) = delete;
+
+    // Start a new sequence, frames are written as outputDirectory/frame_000000<extension>. Supported extensions are .png, .bmp and .tga
+    void start(const fs::path& outputDirectory, const std::string& extension = ".png");
+
+    // Stop capturing, frames already read back are still encoded
+    void stop();
+
+    // Options passed to writeImage() for the frames read back from now on
+    void setWriteOptions(const ImageWriteOptions& options)
+    {
+        m_WriteOptions = options;
+    }
+
+    const ImageWriteOptions& getWriteOptions() const
+    {
+        return m_WriteOptions;
+    }
+
+    bool isCapturing() const
+    {
+        return m_bCapturing;
+    }
+
+    // Read the width x height bottom left region of readBuffer in framebuffer (0 for the default framebuffer, with GL_BACK as readBuffer).
+    // Call it once per frame, before swapping buffers. Does nothing if the capture is not started.
+    void captureFrame(GLuint framebuffer, GLenum readBuffer, size_t width, size_t height);
+
+    // Hand completed readbacks to the encoder thread. If waitForGPU is true, wait for all pending readbacks.
+    void update(bool waitForGPU = false);
+
+    Stats getStats() const;
+
+    // Display capture statistics in the current ImGui window
+    void drawGUI() const;
+
+private:
+    struct PixelPackBuffer
+    {
+        GLuint glId = 0;
+        GLsync fence = nullptr;
+        size_t byteSize = 0;
+        size_t width = 0;
+        size_t height = 0;
+        size_t frameIndex = 0;
+    };
+
+    struct EncodeJob
+    {
+        Image2DRGBA image;
+        fs::path path;
+        ImageWriteOptions options;
+    };
+
+    void readBack(PixelPackBuffer& buffer);
+    void pushJob(EncodeJob job);
+    void encoderLoop();
+
+    std::vector<PixelPackBuffer> m_PixelPackBuffers;
+    size_t m_nNextBuffer = 0; // Next buffer of the ring to use for glReadPixels
+    size_t m_nOldestBuffer = 0; // Oldest buffer with a readback in flight
+    size_t m_nPendingCount = 0; // Number of buffers with a readback in flight
+
+    bool m_bCapturing = false;
+    fs::path m_OutputDirectory;
+    std::string m_Extension;
+    ImageWriteOptions m_WriteOptions;
+    size_t m_nFrameIndex = 0;
+
+    const size_t m_nMaxQueuedFrameCount;
+    std::deque<EncodeJob> m_EncodeQueue;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_QueueNotEmpty;
+    std::condition_variable m_QueueNotFull;
+    bool m_bExitEncoder = false;
+    Stats m_Stats;
+
+    std::unique_ptr<ThreadPool> m_pEncoderThreadPool; // Created by the encoder thread for the first parallel PNG job
+    std::thread m_EncoderThread;
+};
+
+}
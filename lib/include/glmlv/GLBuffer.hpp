@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GPUMemoryLedger.hpp>
+#include <vector>
+
+namespace glmlv
+{
+
+// Buffer object created and updated with direct state access: none of these calls change the bound buffers.
+// Storage is immutable, GL_DYNAMIC_STORAGE_BIT must be in its flags for setSubData().
+class GLBuffer {
+    GLuint m_GLId;
+    GLsizeiptr m_ByteSize = 0;
+public:
+    GLBuffer() {
+        glCreateBuffers(1, &m_GLId);
+    }
+
+    GLBuffer(GLsizeiptr byteSize, const void* pData, GLbitfield storageFlags = 0) : GLBuffer() {
+        setStorage(byteSize, pData, storageFlags);
+    }
+
+    template<typename T>
+    explicit GLBuffer(const std::vector<T>& data, GLbitfield storageFlags = 0) : GLBuffer(GLsizeiptr(data.size() * sizeof(T)), data.data(), storageFlags) {
+    }
+
+    ~GLBuffer() {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, m_GLId);
+        glDeleteBuffers(1, &m_GLId);
+    }
+
+    GLBuffer(const GLBuffer&) = delete;
+
+    GLBuffer& operator =(const GLBuffer&) = delete;
+
+    GLBuffer(GLBuffer&& rvalue) : m_GLId(rvalue.m_GLId), m_ByteSize(rvalue.m_ByteSize) {
+        rvalue.m_GLId = 0;
+        rvalue.m_ByteSize = 0;
+    }
+
+    GLBuffer& operator =(GLBuffer&& rvalue) {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, m_GLId);
+        glDeleteBuffers(1, &m_GLId);
+        m_GLId = rvalue.m_GLId;
+        m_ByteSize = rvalue.m_ByteSize;
+        rvalue.m_GLId = 0;
+        rvalue.m_ByteSize = 0;
+        return *this;
+    }
+
+    GLuint glId() const {
+        return m_GLId;
+    }
+
+    GLsizeiptr byteSize() const {
+        return m_ByteSize;
+    }
+
+    // Can only be called once per buffer
+    void setStorage(GLsizeiptr byteSize, const void* pData, GLbitfield storageFlags = 0) {
+        glNamedBufferStorage(m_GLId, byteSize, pData, storageFlags);
+        m_ByteSize = byteSize;
+        GPUMemoryLedger::get().registerBuffer(m_GLId, size_t(byteSize));
+    }
+
+    void setSubData(GLintptr offset, GLsizeiptr byteSize, const void* pData) {
+        glNamedBufferSubData(m_GLId, offset, byteSize, pData);
+    }
+
+    void* mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        return glMapNamedBufferRange(m_GLId, offset, length, access);
+    }
+
+    void unmap() {
+        glUnmapNamedBuffer(m_GLId);
+    }
+};
+
+}
@@ -2,6 +2,10 @@
 
 #include <glmlv/glfw.hpp>
 #include <glmlv/gl_debug_output.hpp>
+#include <glmlv/gl_call_stats.hpp>
+#include <glmlv/gl_command_trace.hpp>
+#include <glmlv/indirect_draw.hpp>
+#include <glmlv/CPUProfiler.hpp>
 #include <glm/glm.hpp>
 
 #include <imgui.h>
@@ -18,7 +22,8 @@ namespace glmlv
 class GLFWHandle
 {
 public:
-    GLFWHandle(int width, int height, const char * title)
+    // A debug context is only requested if debugMode is not Disabled
+    GLFWHandle(int width, int height, const char * title, GLDebugMode debugMode = getDefaultGLDebugMode())
     {
         if (!glfwInit()) {
             std::cerr << "Unable to init GLFW.\n";
@@ -28,7 +33,7 @@ public:
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugMode != GLDebugMode::Disabled ? GL_TRUE : GL_FALSE);
         glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 		glfwWindowHint(GLFW_SAMPLES, 4);
 
@@ -48,7 +53,17 @@ public:
             throw std::runtime_error("Unable to init OpenGL.\n");
         }
 
-        glmlv::initGLDebugOutput();
+        // The GL wrappers use direct state access: core in OpenGL 4.5, an extension on top of the 4.4 context requested above
+        if (!GLAD_GL_ARB_direct_state_access) {
+            std::cerr << "OpenGL 4.5 or GL_ARB_direct_state_access is required (got " << glGetString(GL_VERSION) << ").\n";
+            glfwDestroyWindow(m_pWindow);
+            glfwTerminate();
+            throw std::runtime_error("GL_ARB_direct_state_access not supported.\n");
+        }
+
+        glmlv::loadIndirectDrawFunctions(); // Before the GL call statistics intercept it
+        glmlv::initGLDebugOutput(debugMode);
+        glmlv::initGLCallStats();
 
         // Setup ImGui
 		ImGui::CreateContext();
@@ -85,6 +100,11 @@ public:
 
     void swapBuffers() const
     {
+        GLMLV_PROFILE_FUNCTION();
+        processGLDebugMessages(); // Asynchronous debug output is logged here, once per frame
+        endGLCallStatsFrame();
+        const auto size = framebufferSize();
+        updateGLCommandTraceCapture(size.x, size.y);
         glfwSwapBuffers(m_pWindow);
     }
 
@@ -99,6 +119,7 @@ private:
 
 inline void imguiNewFrame()
 {
+	GLMLV_PROFILE_FUNCTION();
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
@@ -106,6 +127,7 @@ inline void imguiNewFrame()
 
 inline void imguiRenderFrame()
 {
+	GLMLV_PROFILE_FUNCTION();
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GPUMemoryLedger.hpp>
+#include <initializer_list>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <iostream>
+
+namespace glmlv
+{
+
+// Framebuffer object set up with direct state access: none of these calls change the bound framebuffers.
+class GLFramebuffer {
+    GLuint m_GLId;
+public:
+    GLFramebuffer() {
+        glCreateFramebuffers(1, &m_GLId);
+    }
+
+    ~GLFramebuffer() {
+        glDeleteFramebuffers(1, &m_GLId);
+    }
+
+    GLFramebuffer(const GLFramebuffer&) = delete;
+
+    GLFramebuffer& operator =(const GLFramebuffer&) = delete;
+
+    GLFramebuffer(GLFramebuffer&& rvalue) : m_GLId(rvalue.m_GLId) {
+        rvalue.m_GLId = 0;
+    }
+
+    GLFramebuffer& operator =(GLFramebuffer&& rvalue) {
+        glDeleteFramebuffers(1, &m_GLId);
+        m_GLId = rvalue.m_GLId;
+        rvalue.m_GLId = 0;
+        return *this;
+    }
+
+    GLuint glId() const {
+        return m_GLId;
+    }
+
+    void attachTexture(GLenum attachment, GLuint texture, GLint level = 0) {
+        glNamedFramebufferTexture(m_GLId, attachment, texture, level);
+        GPUMemoryLedger::get().setCategory(GPUMemoryLedger::ResourceType::Texture, texture, GPUMemoryLedger::Category::RenderTarget);
+    }
+
+    // One layer of an array, 3D or cube map texture
+    void attachTextureLayer(GLenum attachment, GLuint texture, GLint level, GLint layer) {
+        glNamedFramebufferTextureLayer(m_GLId, attachment, texture, level, layer);
+        GPUMemoryLedger::get().setCategory(GPUMemoryLedger::ResourceType::Texture, texture, GPUMemoryLedger::Category::RenderTarget);
+    }
+
+    void setDrawBuffers(std::initializer_list<GLenum> drawBuffers) {
+        const std::vector<GLenum> buffers(drawBuffers);
+        glNamedFramebufferDrawBuffers(m_GLId, GLsizei(buffers.size()), buffers.data());
+    }
+
+    void setReadBuffer(GLenum readBuffer) {
+        glNamedFramebufferReadBuffer(m_GLId, readBuffer);
+    }
+
+    GLenum getStatus(GLenum target = GL_DRAW_FRAMEBUFFER) const {
+        return glCheckNamedFramebufferStatus(m_GLId, target);
+    }
+
+    // Throw if the framebuffer is not complete, name is used in the error message
+    void checkComplete(const std::string& name, GLenum target = GL_DRAW_FRAMEBUFFER) const {
+        const auto status = getStatus(target);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Error on building " << name << " framebuffer. Error code = " << status << std::endl;
+            throw std::runtime_error("Error on building " + name + " framebuffer.");
+        }
+    }
+
+    void bind(GLenum target = GL_FRAMEBUFFER) const {
+        glBindFramebuffer(target, m_GLId);
+    }
+};
+
+}
@@ -1,14 +1,17 @@
 #pragma once
 
 #include "GLShader.hpp"
+#include "ProgramReflection.hpp"
 #include <glad/glad.h>
 #include <iostream>
+#include <memory>
 
 namespace glmlv
 {
 
 class GLProgram {
     GLuint m_GLId;
+    mutable std::unique_ptr<ProgramReflection> m_pReflection; // Built by reflect(), or on first use by reflection()
     typedef std::unique_ptr<char[]> CharBuffer;
 public:
     GLProgram() : m_GLId(glCreateProgram()) {
@@ -22,13 +25,14 @@ public:
 
     GLProgram& operator =(const GLProgram&) = delete;
 
-    GLProgram(GLProgram&& rvalue) : m_GLId(rvalue.m_GLId) {
+    GLProgram(GLProgram&& rvalue) : m_GLId(rvalue.m_GLId), m_pReflection(std::move(rvalue.m_pReflection)) {
         rvalue.m_GLId = 0;
     }
 
     GLProgram& operator =(GLProgram&& rvalue) {
-        this->~GLProgram();
+        glDeleteProgram(m_GLId);
         m_GLId = rvalue.m_GLId;
+        m_pReflection = std::move(rvalue.m_pReflection);
         rvalue.m_GLId = 0;
         return *this;
     }
@@ -43,7 +47,23 @@ public:
 
     bool link() {
         glLinkProgram(m_GLId);
-        return getLinkStatus();
+        if (!getLinkStatus()) {
+            return false;
+        }
+        reflect();
+        return true;
+    }
+
+    // (Re)build the table of active resources, done by link(). To be called after linking by other means (e.g. glProgramBinary).
+    void reflect() {
+        m_pReflection.reset(new ProgramReflection(m_GLId));
+    }
+
+    const ProgramReflection& reflection() const {
+        if (!m_pReflection) {
+            m_pReflection.reset(new ProgramReflection(m_GLId));
+        }
+        return *m_pReflection;
     }
 
     bool getLinkStatus() const {
@@ -71,6 +91,11 @@ public:
         return location;
     }
 
+    // Lookup in the reflection table, no GL call: getUniformLocation(hashResourceName("uName"))
+    GLint getUniformLocation(uint32_t nameHash) const {
+        return reflection().getUniformLocation(nameHash);
+    }
+
     GLint getAttribLocation(const GLchar* name) const {
         GLint location = glGetAttribLocation(m_GLId, name);
         return location;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <initializer_list>
+#include <utility>
+
+namespace glmlv
+{
+
+class GLSampler {
+    GLuint m_GLId;
+public:
+    GLSampler() {
+        glCreateSamplers(1, &m_GLId);
+    }
+
+    // e.g. GLSampler({ { GL_TEXTURE_MIN_FILTER, GL_LINEAR }, { GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE } })
+    explicit GLSampler(std::initializer_list<std::pair<GLenum, GLint>> parameters) : GLSampler() {
+        for (const auto& parameter : parameters) {
+            setParameter(parameter.first, parameter.second);
+        }
+    }
+
+    ~GLSampler() {
+        glDeleteSamplers(1, &m_GLId);
+    }
+
+    GLSampler(const GLSampler&) = delete;
+
+    GLSampler& operator =(const GLSampler&) = delete;
+
+    GLSampler(GLSampler&& rvalue) : m_GLId(rvalue.m_GLId) {
+        rvalue.m_GLId = 0;
+    }
+
+    GLSampler& operator =(GLSampler&& rvalue) {
+        glDeleteSamplers(1, &m_GLId);
+        m_GLId = rvalue.m_GLId;
+        rvalue.m_GLId = 0;
+        return *this;
+    }
+
+    GLuint glId() const {
+        return m_GLId;
+    }
+
+    void setParameter(GLenum pname, GLint value) {
+        glSamplerParameteri(m_GLId, pname, value);
+    }
+
+    void setParameter(GLenum pname, GLfloat value) {
+        glSamplerParameterf(m_GLId, pname, value);
+    }
+
+    void bind(GLuint unit) const {
+        glBindSampler(unit, m_GLId);
+    }
+};
+
+}
@@ -102,12 +102,12 @@ GLShader compileShader(GLenum type, StringType&& src) {
     return shader;
 }
 
-// Load and compile a shader according to the following naming convention:
+// Shader type according to the following naming convention:
 // *.vs.glsl -> vertex shader
 // *.fs.glsl -> fragment shader
 // *.gs.glsl -> geometry shader
 // *.cs.glsl -> compute shader
-inline GLShader loadShader(const fs::path& shaderPath)
+inline const std::pair<GLenum, std::string>& getShaderTypeAndName(const fs::path& shaderPath)
 {
     static auto extToShaderType = std::unordered_map<std::string, std::pair<GLenum, std::string>>({
         { ".vs",{ GL_VERTEX_SHADER, "vertex" } },
@@ -122,10 +122,22 @@ inline GLShader loadShader(const fs::path& shaderPath)
         std::cerr << "Unrecognized shader extension " << ext << std::endl;
         throw std::runtime_error("Unrecognized shader extension " + ext.string());
     }
+    return (*it).second;
+}
+
+inline GLenum getShaderType(const fs::path& shaderPath)
+{
+    return getShaderTypeAndName(shaderPath).first;
+}
+
+// Load and compile a shader, its type is deduced from its extension (see getShaderTypeAndName())
+inline GLShader loadShader(const fs::path& shaderPath)
+{
+    const auto & typeAndName = getShaderTypeAndName(shaderPath);
 
-    std::clog << "Compiling " << (*it).second.second << " shader " << shaderPath << "\n";
+    std::clog << "Compiling " << typeAndName.second << " shader " << shaderPath << "\n";
 
-    GLShader shader{ (*it).second.first };
+    GLShader shader{ typeAndName.first };
     shader.setSource(loadShaderSource(shaderPath));
     shader.compile();
     if (!shader.getCompileStatus()) {
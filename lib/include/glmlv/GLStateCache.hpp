@@ -0,0 +1,152 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstddef>
+
+namespace glmlv
+{
+
+// Shadow copy of the OpenGL bindings, to filter the calls that would bind again what is already bound.
+// Covers the current program, vertex array, texture and sampler of each unit, draw / read framebuffers,
+// generic buffer bindings and indexed uniform / shader storage / atomic counter / transform feedback bindings.
+//
+// The cache only knows what goes through it: code binding objects directly (ImGui, FrameCapture, glmlv objects
+// calling glBind* in their methods, glDelete* of a bound object) must be followed by invalidate(),
+// after which the next call for each binding is always issued. Apps call beginFrame() at the start of each frame for that.
+//
+// Textures are bound with glBindTextureUnit, so a unit is tracked as a whole and not per target.
+// GL_ELEMENT_ARRAY_BUFFER is part of the vertex array state: it is not cached and always issued.
+class GLStateCache
+{
+public:
+    enum Category
+    {
+        Program,
+        VertexArray,
+        Texture,
+        Sampler,
+        Framebuffer,
+        Buffer,
+        CategoryCount
+    };
+
+    struct Counters
+    {
+        size_t issued = 0; // Calls forwarded to OpenGL
+        size_t filtered = 0; // Calls dropped because the object was already bound
+    };
+
+    // Requires a current context: the number of texture units and indexed buffer bindings are queried
+    GLStateCache();
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator =(const GLStateCache&) = delete;
+
+    void useProgram(GLuint program)
+    {
+        if (filter(Program, m_Program, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (filter(VertexArray, m_VertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+        }
+    }
+
+    // 0 unbinds every target of the unit
+    void bindTexture(GLuint unit, GLuint texture)
+    {
+        if (unit >= m_Textures.size() || filter(Texture, m_Textures[unit], texture)) {
+            glBindTextureUnit(unit, texture);
+        }
+    }
+
+    void bindSampler(GLuint unit, GLuint sampler)
+    {
+        if (unit >= m_Samplers.size() || filter(Sampler, m_Samplers[unit], sampler)) {
+            glBindSampler(unit, sampler);
+        }
+    }
+
+    // target is GL_DRAW_FRAMEBUFFER, GL_READ_FRAMEBUFFER or GL_FRAMEBUFFER (both)
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    // Also set the generic binding of target, as glBindBufferBase does
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        bindBufferRange(target, index, buffer, 0, 0);
+    }
+
+    // size 0 binds the whole buffer
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Forget every binding, e.g. after code that binds objects without the cache
+    void invalidate();
+
+    // invalidate(), and keep the counters of the frame that ends to be displayed by drawGUI()
+    void beginFrame();
+
+    const Counters& getCounters(Category category) const
+    {
+        return m_Counters[category];
+    }
+
+    Counters getTotalCounters() const;
+
+    void resetCounters();
+
+    // Display the counters of the last complete frame in the current ImGui window
+    void drawGUI() const;
+
+private:
+    struct IndexedBufferBinding
+    {
+        GLuint buffer = 0;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    static const GLuint Unknown = ~0u; // Never a valid object name: the next bind is always issued
+
+    bool filter(Category category, GLuint & current, GLuint requested)
+    {
+        if (current == requested)
+        {
+            ++m_Counters[category].filtered;
+            return false;
+        }
+        ++m_Counters[category].issued;
+        current = requested;
+        return true;
+    }
+
+    GLuint * genericBufferBinding(GLenum target);
+    std::vector<IndexedBufferBinding> * indexedBufferBindings(GLenum target);
+
+    GLuint m_Program = Unknown;
+    GLuint m_VertexArray = Unknown;
+    GLuint m_DrawFramebuffer = Unknown;
+    GLuint m_ReadFramebuffer = Unknown;
+    std::vector<GLuint> m_Textures;
+    std::vector<GLuint> m_Samplers;
+
+    static const GLenum GenericBufferTargets[];
+    std::vector<GLuint> m_GenericBuffers; // Same order as GenericBufferTargets
+
+    std::vector<IndexedBufferBinding> m_UniformBuffers;
+    std::vector<IndexedBufferBinding> m_ShaderStorageBuffers;
+    std::vector<IndexedBufferBinding> m_AtomicCounterBuffers;
+    std::vector<IndexedBufferBinding> m_TransformFeedbackBuffers;
+
+    Counters m_Counters[CategoryCount];
+    Counters m_LastFrameCounters[CategoryCount];
+};
+
+}
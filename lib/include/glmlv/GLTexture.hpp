@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GPUMemoryLedger.hpp>
+
+namespace glmlv
+{
+
+// Texture object created and updated with direct state access: none of these calls change the active unit or the bound textures.
+// Storage is immutable (glTextureStorage*), its dimensions are given by the target (2D for GL_TEXTURE_2D, 3D for GL_TEXTURE_2D_ARRAY, ...).
+class GLTexture {
+    GLuint m_GLId;
+    GLenum m_Target;
+public:
+    explicit GLTexture(GLenum target = GL_TEXTURE_2D) : m_Target(target) {
+        glCreateTextures(target, 1, &m_GLId);
+    }
+
+    GLTexture(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) : GLTexture(target) {
+        setStorage2D(levels, internalFormat, width, height);
+    }
+
+    GLTexture(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth) : GLTexture(target) {
+        setStorage3D(levels, internalFormat, width, height, depth);
+    }
+
+    ~GLTexture() {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Texture, m_GLId);
+        glDeleteTextures(1, &m_GLId);
+    }
+
+    GLTexture(const GLTexture&) = delete;
+
+    GLTexture& operator =(const GLTexture&) = delete;
+
+    GLTexture(GLTexture&& rvalue) : m_GLId(rvalue.m_GLId), m_Target(rvalue.m_Target) {
+        rvalue.m_GLId = 0;
+    }
+
+    GLTexture& operator =(GLTexture&& rvalue) {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Texture, m_GLId);
+        glDeleteTextures(1, &m_GLId);
+        m_GLId = rvalue.m_GLId;
+        m_Target = rvalue.m_Target;
+        rvalue.m_GLId = 0;
+        return *this;
+    }
+
+    GLuint glId() const {
+        return m_GLId;
+    }
+
+    GLenum target() const {
+        return m_Target;
+    }
+
+    // GL_TEXTURE_2D, GL_TEXTURE_1D_ARRAY, GL_TEXTURE_RECTANGLE, GL_TEXTURE_CUBE_MAP
+    void setStorage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+        glTextureStorage2D(m_GLId, levels, internalFormat, width, height);
+        GPUMemoryLedger::get().registerTexture(m_GLId, internalFormat, width, height, m_Target == GL_TEXTURE_CUBE_MAP ? 6 : 1, levels);
+    }
+
+    // GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP_ARRAY
+    void setStorage3D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth) {
+        glTextureStorage3D(m_GLId, levels, internalFormat, width, height, depth);
+        GPUMemoryLedger::get().registerTexture(m_GLId, internalFormat, width, height, depth, levels);
+    }
+
+    // Rows of pixels are read with the current GL_UNPACK_ALIGNMENT
+    void setSubImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pPixels) {
+        glTextureSubImage2D(m_GLId, level, x, y, width, height, format, type, pPixels);
+    }
+
+    void setSubImage3D(GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pPixels) {
+        glTextureSubImage3D(m_GLId, level, x, y, z, width, height, depth, format, type, pPixels);
+    }
+
+    void generateMipmap() {
+        glGenerateTextureMipmap(m_GLId);
+    }
+
+    void setParameter(GLenum pname, GLint value) {
+        glTextureParameteri(m_GLId, pname, value);
+    }
+
+    void setParameter(GLenum pname, GLfloat value) {
+        glTextureParameterf(m_GLId, pname, value);
+    }
+
+    // Bind to a texture unit, without changing the active unit
+    void bind(GLuint unit) const {
+        glBindTextureUnit(unit, m_GLId);
+    }
+};
+
+}
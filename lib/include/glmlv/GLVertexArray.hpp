@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GPUMemoryLedger.hpp>
+
+namespace glmlv
+{
+
+// Vertex array object set up with direct state access (separate attribute format / buffer binding, GL 4.3 style):
+// buffers are attached to binding indices with setVertexBuffer(), each attribute reads from one binding index.
+// None of these calls change the bound vertex array or buffers.
+class GLVertexArray {
+    GLuint m_GLId;
+public:
+    GLVertexArray() {
+        glCreateVertexArrays(1, &m_GLId);
+    }
+
+    ~GLVertexArray() {
+        glDeleteVertexArrays(1, &m_GLId);
+    }
+
+    GLVertexArray(const GLVertexArray&) = delete;
+
+    GLVertexArray& operator =(const GLVertexArray&) = delete;
+
+    GLVertexArray(GLVertexArray&& rvalue) : m_GLId(rvalue.m_GLId) {
+        rvalue.m_GLId = 0;
+    }
+
+    GLVertexArray& operator =(GLVertexArray&& rvalue) {
+        glDeleteVertexArrays(1, &m_GLId);
+        m_GLId = rvalue.m_GLId;
+        rvalue.m_GLId = 0;
+        return *this;
+    }
+
+    GLuint glId() const {
+        return m_GLId;
+    }
+
+    void setVertexBuffer(GLuint bindingIndex, GLuint buffer, GLintptr offset, GLsizei stride) {
+        glVertexArrayVertexBuffer(m_GLId, bindingIndex, buffer, offset, stride);
+        GPUMemoryLedger::get().setCategory(GPUMemoryLedger::ResourceType::Buffer, buffer, GPUMemoryLedger::Category::VertexIndex);
+    }
+
+    void setElementBuffer(GLuint buffer) {
+        glVertexArrayElementBuffer(m_GLId, buffer);
+        GPUMemoryLedger::get().setCategory(GPUMemoryLedger::ResourceType::Buffer, buffer, GPUMemoryLedger::Category::VertexIndex);
+    }
+
+    // Enable attribute location, read from bindingIndex at relativeOffset of each vertex, converted to float
+    void setAttribute(GLuint location, GLuint bindingIndex, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset) {
+        glEnableVertexArrayAttrib(m_GLId, location);
+        glVertexArrayAttribFormat(m_GLId, location, size, type, normalized, relativeOffset);
+        glVertexArrayAttribBinding(m_GLId, location, bindingIndex);
+    }
+
+    // Same for an int / ivec* / uint / uvec* attribute
+    void setIntegerAttribute(GLuint location, GLuint bindingIndex, GLint size, GLenum type, GLuint relativeOffset) {
+        glEnableVertexArrayAttrib(m_GLId, location);
+        glVertexArrayAttribIFormat(m_GLId, location, size, type, relativeOffset);
+        glVertexArrayAttribBinding(m_GLId, location, bindingIndex);
+    }
+
+    // Attributes of bindingIndex advance once every divisor instances instead of once per vertex (0)
+    void setBindingDivisor(GLuint bindingIndex, GLuint divisor) {
+        glVertexArrayBindingDivisor(m_GLId, bindingIndex, divisor);
+    }
+
+    void bind() const {
+        glBindVertexArray(m_GLId);
+    }
+};
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+// Application side accounting of the GPU memory allocated for buffers and textures, by category.
+// The glmlv wrappers (GLBuffer, GLTexture, TypedBuffer, TexturePacker, ...) register their storage when it is allocated and
+// unregister it on deletion; raw GL objects can be registered by hand. Attaching a texture to a GLFramebuffer moves it to the
+// RenderTarget category, using a buffer as vertex or index buffer of a GLVertexArray moves it to VertexIndex.
+// Sizes are nominal (texels x bytes per texel, mip chain included): drivers add alignment and padding, see getDriverMemoryInfo().
+class GPUMemoryLedger
+{
+public:
+    enum class Category
+    {
+        Texture,
+        RenderTarget,
+        VertexIndex,
+        Uniform,
+        OtherBuffer, // Storage, readback, indirect, and buffers not used as vertex / index buffers yet
+        Count
+    };
+
+    enum class ResourceType
+    {
+        Buffer,
+        Texture
+    };
+
+    // Memory reported by GL_NVX_gpu_memory_info or GL_ATI_meminfo, in kilobytes
+    struct DriverMemoryInfo
+    {
+        const char * extension = nullptr; // nullptr if none is supported
+        int64_t totalKB = -1; // Dedicated video memory, -1 if unknown (ATI)
+        int64_t availableKB = -1;
+    };
+
+    // Ledger shared by the library and the apps
+    static GPUMemoryLedger& get();
+
+    static const char * getCategoryName(Category category);
+
+    // Bytes per texel of a sized internal format
+    static size_t getTexelByteSize(GLenum internalFormat);
+
+    // Size of the whole mip chain
+    static size_t computeTextureByteSize(GLenum internalFormat, size_t width, size_t height, size_t depth, size_t levels);
+
+    // Registering an already registered object replaces its entry (GL names are reused after deletion)
+    void registerBuffer(GLuint buffer, size_t byteSize, Category category = Category::OtherBuffer);
+
+    void registerTexture(GLuint texture, GLenum internalFormat, size_t width, size_t height, size_t depth, size_t levels, Category category = Category::Texture);
+
+    // Does nothing if the object is not registered
+    void unregisterResource(ResourceType type, GLuint id);
+
+    void setCategory(ResourceType type, GLuint id, Category category);
+
+    size_t getCategoryByteSize(Category category) const
+    {
+        return m_CategoryByteSizes[size_t(category)];
+    }
+
+    size_t getTotalByteSize() const
+    {
+        return m_nTotalByteSize;
+    }
+
+    size_t getPeakByteSize() const
+    {
+        return m_nPeakByteSize;
+    }
+
+    // A warning is logged each time the total goes over the budget, 0 to disable
+    void setBudget(size_t byteSize);
+
+    size_t getBudget() const
+    {
+        return m_nBudget;
+    }
+
+    // Must be called with a current context
+    DriverMemoryInfo getDriverMemoryInfo() const;
+
+    // Breakdown by category, budget and driver view in the current ImGui window
+    void drawGUI();
+
+private:
+    GPUMemoryLedger();
+
+    struct Entry
+    {
+        Category category;
+        size_t byteSize;
+    };
+
+    static uint64_t key(ResourceType type, GLuint id)
+    {
+        return (uint64_t(type) << 32) | id;
+    }
+
+    void add(uint64_t key, Category category, size_t byteSize);
+
+    std::unordered_map<uint64_t, Entry> m_Entries;
+    std::array<size_t, size_t(Category::Count)> m_CategoryByteSizes;
+    size_t m_nTotalByteSize = 0;
+    size_t m_nPeakByteSize = 0;
+    size_t m_nBudget = 0;
+    bool m_bOverBudget = false;
+};
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+
+#include <vector>
+#include <string>
+
+namespace glmlv
+{
+
+// Measure the GPU time of nested sections of the frame (render passes) with GL_TIMESTAMP queries.
+// Queries of a frame are only read back once the GPU has executed them, framesInFlight frames later at most: reading
+// them never stalls the pipeline. If all frames of the ring are still in flight, the results of the oldest one are dropped.
+// Each section is also wrapped in a glPushDebugGroup / glPopDebugGroup pair with the same name, for external debuggers and profilers.
+//
+//     profiler.beginFrame();
+//     {
+//         GPUProfiler::Scope scope(profiler, "Geometry pass");
+//         ... draw ...
+//     }
+//     profiler.endFrame();
+class GPUProfiler
+{
+public:
+    struct SectionStats
+    {
+        std::string name;
+        std::string path; // Names of the parent sections and of the section, separated with '/'
+        size_t depth = 0; // 0 for the whole frame
+        size_t sampleCount = 0; // Samples in the history, at most historySize
+        double lastMs = 0.;
+        double averageMs = 0.;
+        double minMs = 0.;
+        double maxMs = 0.;
+        double p50Ms = 0.;
+        double p95Ms = 0.;
+        double p99Ms = 0.;
+    };
+
+    // Push a section in its constructor, pop it in its destructor
+    class Scope
+    {
+    public:
+        Scope(GPUProfiler& profiler, const char * name): m_Profiler(profiler)
+        {
+            m_Profiler.pushSection(name);
+        }
+
+        ~Scope()
+        {
+            m_Profiler.popSection();
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator =(const Scope&) = delete;
+
+    private:
+        GPUProfiler& m_Profiler;
+    };
+
+    // framesInFlight: frames whose queries can be pending on the GPU
+    // historySize: number of frames kept per section for averages and percentiles
+    GPUProfiler(size_t framesInFlight = 4, size_t historySize = 240);
+
+    ~GPUProfiler();
+
+    GPUProfiler(const GPUProfiler&) = delete;
+    GPUProfiler& operator =(const GPUProfiler&) = delete;
+
+    // Read back the results of completed frames, then open the root "Frame" section
+    void beginFrame();
+
+    // Close the root section, all pushed sections must have been popped
+    void endFrame();
+
+    // Sections are identified by their name and their parent: pushing the same name twice in a frame accumulates the time
+    void pushSection(const char * name);
+
+    void popSection();
+
+    // Sections in depth first order (a section is followed by its children), with the statistics of their history
+    std::vector<SectionStats> getStats() const;
+
+    size_t getResolvedFrameCount() const
+    {
+        return m_nResolvedFrameCount;
+    }
+
+    // Frames whose results were not available when their queries had to be reused
+    size_t getDroppedFrameCount() const
+    {
+        return m_nDroppedFrameCount;
+    }
+
+    // Forget the history of all sections
+    void clearHistory();
+
+    // One line per section with the values of SectionStats, times in milliseconds
+    void writeCSV(const fs::path& path) const;
+
+    // Statistics and raw history (oldest first) of each section
+    void writeJSON(const fs::path& path) const;
+
+    // Display a table of the sections in the current ImGui window
+    void drawGUI() const;
+
+private:
+    static const size_t NoParent;
+
+    struct Section
+    {
+        std::string name;
+        size_t parent = NoParent;
+        size_t depth = 0;
+        std::vector<float> history; // Ring of historySize samples, in milliseconds
+        size_t historyHead = 0; // Next sample to write
+        size_t sampleCount = 0;
+        float lastMs = 0.f;
+    };
+
+    struct Marker
+    {
+        size_t section;
+        size_t beginQuery; // Indices in the query pool of the frame
+        size_t endQuery = 0; // Set when the section is popped
+    };
+
+    struct Frame
+    {
+        std::vector<GLuint> queries; // Pool, grown when a frame has more sections than the previous ones
+        size_t usedQueryCount = 0;
+        std::vector<Marker> markers;
+    };
+
+    size_t findOrAddSection(size_t parent, const char * name);
+    size_t timestamp(Frame& frame); // Return the index of the query in the pool of the frame
+    bool isAvailable(const Frame& frame) const;
+    void resolve(Frame& frame);
+    std::vector<size_t> depthFirstOrder() const;
+    SectionStats computeStats(size_t section) const;
+
+    std::vector<Frame> m_Frames;
+    const size_t m_nHistorySize;
+    size_t m_nFrameCount = 0; // Frames begun
+    size_t m_nResolvedFrameCount = 0; // Frames read back or dropped, the others are in flight
+    size_t m_nDroppedFrameCount = 0;
+    bool m_bInFrame = false;
+
+    std::vector<Section> m_Sections;
+    std::vector<size_t> m_MarkerStack; // Open markers of the current frame
+};
+
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/Image2DRGBA.hpp>
+
+namespace glmlv
+{
+
+// Storage type for 16 bits floating point components. Use glm::packHalf1x16 / glm::unpackHalf1x16 to convert from/to float
+struct half
+{
+    uint16_t bits;
+};
+
+enum class ImageFormat
+{
+    Undefined = 0,
+    R8,
+    RG8,
+    RGB8,
+    RGBA8,
+    RGBA16F,
+    RGBA32F
+};
+
+size_t getComponentCount(ImageFormat format);
+
+size_t getBytesPerPixel(ImageFormat format);
+
+const char * getImageFormatName(ImageFormat format);
+
+// Arguments to use with glTexStorage2D / glTexSubImage2D for a given image format.
+// The swizzle mask expands one and two channels images (grayscale, grayscale + alpha) to a shader visible RGBA.
+struct GLImageFormat
+{
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    GLint swizzleMask[4];
+};
+
+GLImageFormat getGLImageFormat(ImageFormat format);
+
+template<typename ComponentType, size_t ComponentCount>
+struct ImageFormatOf
+{
+    static const ImageFormat value = ImageFormat::Undefined;
+};
+
+template<> struct ImageFormatOf<uint8_t, 1> { static const ImageFormat value = ImageFormat::R8; };
+template<> struct ImageFormatOf<uint8_t, 2> { static const ImageFormat value = ImageFormat::RG8; };
+template<> struct ImageFormatOf<uint8_t, 3> { static const ImageFormat value = ImageFormat::RGB8; };
+template<> struct ImageFormatOf<uint8_t, 4> { static const ImageFormat value = ImageFormat::RGBA8; };
+template<> struct ImageFormatOf<half, 4> { static const ImageFormat value = ImageFormat::RGBA16F; };
+template<> struct ImageFormatOf<float, 4> { static const ImageFormat value = ImageFormat::RGBA32F; };
+
+// Allocation functions shared by all images, compatible with the memory returned by stb_image
+void * allocateImageData(size_t byteSize);
+void freeImageData(void * ptr);
+
+// An image storing ComponentCount components of type ComponentType per pixel.
+// Unlike Image2DRGBA, the pixel format is not forced to RGBA8, which allows to keep one channel masks or HDR data as they are.
+template<typename ComponentType, size_t ComponentCount>
+class Image2D
+{
+public:
+    using Component = ComponentType;
+    static const size_t NumComponents = ComponentCount;
+    static const ImageFormat Format = ImageFormatOf<ComponentType, ComponentCount>::value;
+
+    static_assert(Format != ImageFormat::Undefined, "Unsupported image component type / count");
+
+    Image2D() = default;
+
+    Image2D(size_t width, size_t height):
+        m_pData((ComponentType *) allocateImageData(width * height * NumComponents * sizeof(ComponentType))),
+        m_nWidth(width), m_nHeight(height)
+    {
+    }
+
+    // Take ownership of pData, that must have been allocated with allocateImageData() or returned by stb_image
+    Image2D(size_t width, size_t height, ComponentType * pData):
+        m_pData(pData), m_nWidth(width), m_nHeight(height)
+    {
+    }
+
+    Image2D(const Image2D&) = delete;
+    Image2D& operator =(const Image2D&) = delete;
+
+    Image2D(Image2D&&) = default;
+    Image2D& operator =(Image2D&&) = default;
+
+    size_t width() const
+    {
+        return m_nWidth;
+    }
+
+    size_t height() const
+    {
+        return m_nHeight;
+    }
+
+    size_t size() const
+    {
+        return width() * height();
+    }
+
+    size_t byteSize() const
+    {
+        return size() * NumComponents * sizeof(ComponentType);
+    }
+
+    const ComponentType * data() const
+    {
+        return m_pData.get();
+    }
+
+    ComponentType * data()
+    {
+        return m_pData.get();
+    }
+
+    const ComponentType * operator ()(size_t x, size_t y) const
+    {
+        return m_pData.get() + (x + y * m_nWidth) * NumComponents;
+    }
+
+    ComponentType * operator ()(size_t x, size_t y)
+    {
+        return const_cast<ComponentType*>((*this)(x, y));
+    }
+
+    void flipY() // Flip the image along its y axis
+    {
+        const auto lineSize = m_nWidth * NumComponents;
+        ComponentType * pFirstLine = m_pData.get();
+        ComponentType * pLastLine = m_pData.get() + (m_nHeight - 1) * lineSize;
+
+        while (pFirstLine < pLastLine)
+        {
+            std::swap_ranges(pFirstLine, pFirstLine + lineSize, pLastLine);
+            pFirstLine += lineSize;
+            pLastLine -= lineSize;
+        }
+    }
+
+    // Give up ownership of the pixels, that must then be freed with freeImageData()
+    ComponentType * release()
+    {
+        m_nWidth = m_nHeight = 0;
+        return m_pData.release();
+    }
+
+private:
+    struct Deleter
+    {
+        void operator ()(ComponentType * ptr) const
+        {
+            freeImageData(ptr);
+        }
+    };
+
+    std::unique_ptr<ComponentType[], Deleter> m_pData;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+};
+
+using Image2DR8 = Image2D<uint8_t, 1>;
+using Image2DRG8 = Image2D<uint8_t, 2>;
+using Image2DRGB8 = Image2D<uint8_t, 3>;
+using Image2DRGBA8 = Image2D<uint8_t, 4>;
+using Image2DRGBA16F = Image2D<half, 4>;
+using Image2DRGBA32F = Image2D<float, 4>;
+
+// An image whose format is only known at runtime, typically the format of the file it has been read from.
+// Any Image2D can be moved into it without copying its pixels.
+class AnyImage2D
+{
+public:
+    AnyImage2D() = default;
+
+    template<typename ComponentType, size_t ComponentCount>
+    AnyImage2D(Image2D<ComponentType, ComponentCount>&& image):
+        m_Format(Image2D<ComponentType, ComponentCount>::Format),
+        m_nWidth(image.width()), m_nHeight(image.height()),
+        m_pData((unsigned char *) image.release())
+    {
+    }
+
+    AnyImage2D(const AnyImage2D&) = delete;
+    AnyImage2D& operator =(const AnyImage2D&) = delete;
+
+    AnyImage2D(AnyImage2D&&) = default;
+    AnyImage2D& operator =(AnyImage2D&&) = default;
+
+    ImageFormat format() const
+    {
+        return m_Format;
+    }
+
+    size_t width() const
+    {
+        return m_nWidth;
+    }
+
+    size_t height() const
+    {
+        return m_nHeight;
+    }
+
+    size_t size() const
+    {
+        return width() * height();
+    }
+
+    size_t componentCount() const
+    {
+        return getComponentCount(m_Format);
+    }
+
+    size_t bytesPerPixel() const
+    {
+        return getBytesPerPixel(m_Format);
+    }
+
+    size_t byteSize() const
+    {
+        return size() * bytesPerPixel();
+    }
+
+    const unsigned char * data() const
+    {
+        return m_pData.get();
+    }
+
+    unsigned char * data()
+    {
+        return m_pData.get();
+    }
+
+    void flipY(); // Flip the image along its y axis
+
+private:
+    struct Deleter
+    {
+        void operator ()(unsigned char * ptr) const
+        {
+            freeImageData(ptr);
+        }
+    };
+
+    ImageFormat m_Format = ImageFormat::Undefined;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+    std::unique_ptr<unsigned char[], Deleter> m_pData;
+};
+
+// Read an image and convert it to the format of ImageType (one of the Image2D aliases above).
+// 8 bits formats are read with stbi_load, floating point formats with stbi_loadf so HDR files keep their range.
+template<typename ImageType>
+ImageType readImage(const fs::path& path);
+
+template<> Image2DR8 readImage<Image2DR8>(const fs::path& path);
+template<> Image2DRG8 readImage<Image2DRG8>(const fs::path& path);
+template<> Image2DRGB8 readImage<Image2DRGB8>(const fs::path& path);
+template<> Image2DRGBA8 readImage<Image2DRGBA8>(const fs::path& path);
+template<> Image2DRGBA16F readImage<Image2DRGBA16F>(const fs::path& path);
+template<> Image2DRGBA32F readImage<Image2DRGBA32F>(const fs::path& path);
+
+// Read an image in the format closest to the file content: one or two channels files stay one or two channels,
+// HDR files are read as RGBA16F. If collapseGrayscale is true, RGB(A) images whose color channels are all equal
+// are stored as R8 (or RG8 if their alpha is not opaque).
+AnyImage2D readAnyImage(const fs::path& path, bool collapseGrayscale = true);
+
+struct ImageInfo
+{
+    size_t width = 0;
+    size_t height = 0;
+    ImageFormat format = ImageFormat::Undefined;
+
+    size_t byteSize() const
+    {
+        return width * height * getBytesPerPixel(format);
+    }
+};
+
+// Read the size and format of an image from its header, without decoding it. The format is the one readAnyImage() returns
+// without grayscale collapse. Return false if the file can't be read.
+bool readImageInfo(const fs::path& path, ImageInfo& info);
+
+// Size limits applied to the textures of a scene when they are loaded
+struct TextureLoadOptions
+{
+    size_t maxDimension = 0; // Images wider or taller than this are downsampled, keeping their aspect ratio. 0 for no limit
+    size_t memoryBudget = 0; // Maximum total size in bytes of the images, reached by halving the biggest ones. 0 for no limit
+};
+
+// Read "--max-texture-size <pixels>" and "--texture-budget <megabytes>" from the command line arguments, other arguments are ignored
+TextureLoadOptions parseTextureLoadOptions(int argc, const char * const * argv);
+
+// Size of each image once options are applied
+std::vector<ImageInfo> computeBudgetedImageSizes(const std::vector<ImageInfo>& images, const TextureLoadOptions& options);
+
+// Resample an image to a smaller size, each destination texel being the average of the source texels it covers (weighted by coverage
+// for non integer ratios). Also works for upsampling, as a nearest filter.
+AnyImage2D downsampleImage(const AnyImage2D& image, size_t width, size_t height);
+
+// Same for 8 bits per component data, pDst must hold dstWidth * dstHeight * componentCount bytes
+void downsampleImage(const uint8_t * pSrc, size_t srcWidth, size_t srcHeight, size_t componentCount, uint8_t * pDst, size_t dstWidth, size_t dstHeight);
+
+// Conversion to Image2DRGBA for code that only handle RGBA8 images. Floating point data is clamped to [0, 1] and gamma corrected.
+Image2DRGBA toImage2DRGBA(ImageFormat format, size_t width, size_t height, const void * pData);
+
+inline Image2DRGBA toImage2DRGBA(const AnyImage2D& image)
+{
+    return toImage2DRGBA(image.format(), image.width(), image.height(), image.data());
+}
+
+template<typename ComponentType, size_t ComponentCount>
+Image2DRGBA toImage2DRGBA(const Image2D<ComponentType, ComponentCount>& image)
+{
+    return toImage2DRGBA(image.Format, image.width(), image.height(), image.data());
+}
+
+}
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <glmlv/filesystem.hpp>
+#include <glmlv/parallel_png.hpp>
 
 namespace glmlv
 {
@@ -87,7 +88,15 @@ private:
 ////    PNM(PPM and PGM binary only)
 Image2DRGBA readImage(const fs::path& path);
 
+struct ImageWriteOptions
+{
+    bool parallelPNG = false; // Encode .png files with encodePNGParallel() instead of stb_image_write
+    PNGEncodeOptions png;
+};
+
 // Supported formats for writing are png, bmp and tga
 void writeImage(const Image2DRGBA& image, const fs::path& path);
 
+void writeImage(const Image2DRGBA& image, const fs::path& path, const ImageWriteOptions& options);
+
 }
\ No newline at end of file
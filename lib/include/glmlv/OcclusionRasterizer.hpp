@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glmlv/frustum_culling.hpp>
+#include <glmlv/simple_geometry.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+class ThreadPool;
+
+// Occlusion culling on the CPU: a few occluder meshes are rasterized into a small depth buffer, then the boxes of the objects
+// are tested against it before they are submitted. Nothing here touches OpenGL.
+//
+//     rasterizer.addOccluder(vertices, indices, indexCount, localToWorldMatrix); // Once, at load
+//     ...
+//     rasterizer.render(viewProjMatrix); // Each frame
+//     rasterizer.cullOccluded(bounds, visibility); // After cullFrustum()
+//
+// The occluders are transformed, clipped against the near plane and binned to the screen tiles by the calling thread, then the tiles
+// are rasterized in parallel over a ThreadPool, 4 pixels at a time with SSE (scalar code elsewhere). Pixels are covered when their
+// center is inside a triangle, as in OpenGL. The depth buffer holds window depths in [0, 1] like the default GL depth range.
+//
+// The test is conservative with respect to the box, not to the occluders: an occluder must lie inside the object it comes from
+// (its own mesh, or a simplified mesh inside it). A proxy larger than its object hides objects that are visible. At the low
+// resolution of the buffer, objects seen through gaps thinner than a pixel between occluders can be culled as well.
+class OcclusionRasterizer
+{
+public:
+    // Tiles rasterized by one task of the thread pool, TileWidth is a multiple of 4
+    static const size_t TileWidth = 32;
+    static const size_t TileHeight = 16;
+
+    struct RenderStats
+    {
+        size_t occluderTriangleCount = 0; // Triangles given to render()
+        size_t rasterizedTriangleCount = 0; // After clipping, back face and off screen rejection
+        size_t binnedTriangleCount = 0; // Sum over the tiles of the triangles overlapping them
+    };
+
+    OcclusionRasterizer(size_t width = 320, size_t height = 192);
+
+    size_t width() const
+    {
+        return m_nWidth;
+    }
+
+    size_t height() const
+    {
+        return m_nHeight;
+    }
+
+    // Append the triangles indices[0 .. indexCount) of a mesh, stored in world space. Counter-clockwise triangles are front facing,
+    // back facing ones are skipped by render().
+    void addOccluder(const std::vector<Vertex3f3f2f> & vertices, const uint32_t * indices, size_t indexCount, const glm::mat4 & localToWorldMatrix);
+
+    void clearOccluders();
+
+    size_t occluderTriangleCount() const
+    {
+        return m_OccluderVertices.size() / 3;
+    }
+
+    // Rasterize the occluders seen from viewProjMatrix, replacing the depth of the previous call. pThreadPool: ThreadPool::getDefault() if null.
+    void render(const glm::mat4 & viewProjMatrix, ThreadPool * pThreadPool = nullptr);
+
+    // False if the box is behind the occluders everywhere it covers, seen from the matrix of the last render(). Boxes crossing the
+    // near plane or entirely out of the screen are visible.
+    bool isVisible(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax) const;
+
+    // Set visibility[i] to 0 for the boxes with visibility[i] != 0 that are occluded. visibility must have one element per box, as
+    // written by cullFrustum(). The stats count the boxes tested: still visible, or occluded.
+    CullingStats cullOccluded(const CullingBounds & bounds, std::vector<uint8_t> & visibility, ThreadPool * pThreadPool = nullptr) const;
+
+    const RenderStats & lastRenderStats() const
+    {
+        return m_RenderStats;
+    }
+
+    // Nearest occluder depth of each pixel, 1 where there is none. Rows of rowPitch() floats, bottom row first.
+    const std::vector<float> & depth() const
+    {
+        return m_Depth;
+    }
+
+    size_t rowPitch() const
+    {
+        return m_nRowPitch;
+    }
+
+private:
+    // Screen space triangle, counter-clockwise, with the edge functions and the depth plane evaluated as a * x + b * y + c
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int32_t minX, minY, maxX, maxY; // Pixels whose center may be covered, clamped to the screen
+    };
+
+    void setupTriangle(const glm::vec4 & clip0, const glm::vec4 & clip1, const glm::vec4 & clip2);
+    void rasterizeTile(size_t tile);
+
+    size_t m_nWidth;
+    size_t m_nHeight;
+    size_t m_nRowPitch; // m_nWidth rounded up to a multiple of TileWidth
+    size_t m_nTileCountX;
+    size_t m_nTileCountY;
+
+    std::vector<glm::vec3> m_OccluderVertices; // World space, 3 per triangle
+
+    glm::mat4 m_ViewProjMatrix = glm::mat4(1);
+    std::vector<glm::vec4> m_ClipVertices;
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<uint32_t>> m_TileBins; // Indices in m_Triangles of the triangles overlapping each tile
+    std::vector<float> m_Depth;
+    std::vector<float> m_TileMaxDepth; // Farthest depth of each tile, lets most tests of occluded boxes skip the pixels
+    RenderStats m_RenderStats;
+};
+
+}
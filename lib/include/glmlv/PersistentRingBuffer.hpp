@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+namespace glmlv
+{
+
+// Stream per-frame data (uniform / storage blocks, dynamic vertices) through a buffer mapped once for its whole lifetime
+// (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT): allocations are written directly by the CPU, without glBufferSubData or glMap* calls.
+// The buffer is split in framesInFlight regions, one per frame. A fence is inserted at the end of each frame, and beginFrame()
+// waits for the fence of the frame that last used the region before handing it out again: the CPU only blocks (a stall)
+// if it gets more than framesInFlight frames ahead of the GPU.
+//
+//     ring.beginFrame();
+//     const auto allocation = ring.allocateUniform(sizeof(ObjectUniforms));
+//     std::memcpy(allocation.pData, &objectUniforms, sizeof(ObjectUniforms));
+//     allocation.bind(GL_UNIFORM_BUFFER, ObjectUniformBinding);
+//     ... draw ...
+//     ring.endFrame();
+class PersistentRingBuffer
+{
+public:
+    struct Allocation
+    {
+        void * pData = nullptr; // Mapped memory, write only
+        GLuint buffer = 0;
+        GLintptr offset = 0; // In buffer
+        GLsizeiptr size = 0;
+
+        void bind(GLenum target, GLuint index) const
+        {
+            glBindBufferRange(target, index, buffer, offset, size);
+        }
+    };
+
+    struct Stats
+    {
+        size_t frameCount = 0;
+        size_t stallCount = 0; // Frames for which beginFrame() had to wait for the GPU
+        double stallSeconds = 0.; // Total time spent waiting
+        size_t lastFrameByteSize = 0; // Bytes allocated during the last complete frame, alignment padding included
+        size_t peakFrameByteSize = 0;
+    };
+
+    PersistentRingBuffer() = default;
+
+    // frameByteSize: capacity of each region, i.e. maximum number of bytes allocated between beginFrame() and endFrame()
+    PersistentRingBuffer(size_t frameByteSize, size_t framesInFlight = 3);
+
+    ~PersistentRingBuffer();
+
+    PersistentRingBuffer(const PersistentRingBuffer&) = delete;
+    PersistentRingBuffer& operator =(const PersistentRingBuffer&) = delete;
+
+    PersistentRingBuffer(PersistentRingBuffer&& rvalue);
+    PersistentRingBuffer& operator =(PersistentRingBuffer&& rvalue);
+
+    // Select the next region, waiting for the GPU to be done with it
+    void beginFrame();
+
+    // Insert the fence protecting the region of the current frame, after its last draw call
+    void endFrame();
+
+    // Throw if the region of the current frame is full. The offset in the buffer is a multiple of alignment.
+    Allocation allocate(size_t byteSize, size_t alignment);
+
+    // Aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, to be bound with glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    Allocation allocateUniform(size_t byteSize)
+    {
+        return allocate(byteSize, m_UniformAlignment);
+    }
+
+    // Aligned to GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+    Allocation allocateStorage(size_t byteSize)
+    {
+        return allocate(byteSize, m_StorageAlignment);
+    }
+
+    template<typename T>
+    Allocation pushUniform(const T& value)
+    {
+        const auto allocation = allocateUniform(sizeof(T));
+        std::memcpy(allocation.pData, &value, sizeof(T));
+        return allocation;
+    }
+
+    // Vertices or indices, aligned on the size of T: offset / sizeof(T) is the base vertex / first index to draw them
+    template<typename T>
+    Allocation pushArray(const T * pData, size_t count)
+    {
+        const auto allocation = allocate(count * sizeof(T), sizeof(T));
+        std::memcpy(allocation.pData, pData, count * sizeof(T));
+        return allocation;
+    }
+
+    GLuint glId() const
+    {
+        return m_GLId;
+    }
+
+    const Stats& getStats() const
+    {
+        return m_Stats;
+    }
+
+    // Display statistics in the current ImGui window
+    void drawGUI() const;
+
+private:
+    void release();
+
+    GLuint m_GLId = 0;
+    unsigned char * m_pMapped = nullptr;
+    size_t m_FrameByteSize = 0;
+    std::vector<GLsync> m_Fences; // One per region, null if the region has not been used yet
+    size_t m_nRegion = 0; // Region of the current frame
+    size_t m_nHead = 0; // Next free byte in the region of the current frame
+    size_t m_UniformAlignment = 256;
+    size_t m_StorageAlignment = 256;
+    Stats m_Stats;
+};
+
+}
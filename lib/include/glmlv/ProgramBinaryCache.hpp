@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glmlv/GLProgram.hpp>
+#include <glmlv/filesystem.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace glmlv
+{
+
+struct ShaderSource
+{
+    GLenum type;
+    std::string source;
+    std::string name; // For error messages, usually the file the source has been read from
+};
+
+// Read a shader file, its type is deduced from its extension as in loadShader()
+ShaderSource loadShaderSourceFile(const fs::path& shaderPath);
+
+// 64 bits FNV-1a hash
+uint64_t hashFNV1a(const void * pData, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// On-disk cache of linked programs, using glGetProgramBinary / glProgramBinary.
+// A program is identified by a hash of the complete source of its shaders (so defines injected in the sources are part of the key)
+// and of the GL_VENDOR, GL_RENDERER and GL_VERSION strings, since binaries are only valid for the driver that produced them.
+// When the driver rejects a cached binary (e.g. after an update that kept the version string), the program is compiled from source
+// and the cache entry is replaced.
+class ProgramBinaryCache
+{
+public:
+    struct Stats
+    {
+        size_t loadedCount = 0; // Programs created from a cached binary
+        size_t compiledCount = 0; // Programs compiled from source (cache miss)
+        size_t rejectedCount = 0; // Cached binaries refused by the driver, included in compiledCount
+        double seconds = 0.; // Total time spent in buildProgram()
+    };
+
+    // directory is created if it does not exist. The cache is disabled if the driver supports no binary format.
+    explicit ProgramBinaryCache(const fs::path& directory);
+
+    bool isEnabled() const
+    {
+        return m_bEnabled;
+    }
+
+    // Same as glmlv::compileProgram(), going through the cache
+    GLProgram compileProgram(const std::vector<fs::path>& shaderPaths);
+
+    GLProgram buildProgram(const std::vector<ShaderSource>& sources);
+
+    // Lower level interface, for builders that compile programs themselves (see ProgramBuilder):
+    // load() fills program with the cached binary for sources if there is one the driver accepts,
+    // otherwise the program must be compiled, linked after a call to prepareForStore(), then given to store().
+    bool load(const std::vector<ShaderSource>& sources, GLProgram& program);
+    void prepareForStore(const GLProgram& program) const;
+    void store(const std::vector<ShaderSource>& sources, const GLProgram& program);
+
+    const Stats& getStats() const
+    {
+        return m_Stats;
+    }
+
+    // Print the statistics of the programs built so far and the startup time measured by the caller, with the times of the previous
+    // cold (only compiled) and warm (only loaded) runs of the same label, then record this run.
+    // Typically called once after all programs of an application have been built.
+    void logStartupTime(const std::string& label, double seconds) const;
+
+private:
+    uint64_t computeKey(const std::vector<ShaderSource>& sources) const;
+    fs::path getBinaryPath(uint64_t key) const;
+    bool loadBinary(uint64_t key, GLProgram& program) const;
+    void storeBinary(uint64_t key, const GLProgram& program) const;
+
+    fs::path m_Directory;
+    bool m_bEnabled = false;
+    uint64_t m_nDriverHash = 0;
+    Stats m_Stats;
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glmlv/GLProgram.hpp>
+#include <glmlv/ProgramBinaryCache.hpp>
+#include <glmlv/filesystem.hpp>
+
+#include <vector>
+
+namespace glmlv
+{
+
+// Build many programs without waiting on the driver between them: add() submits the compilation of every shader of a program,
+// linkAll() submits the links, and the compile and link statuses are only queried by take(), when the program is actually needed.
+// Drivers compile in the background between submission and the first status query, on several threads when GL_KHR_parallel_shader_compile
+// (or GL_ARB_parallel_shader_compile) is available; in that case isReady() tells if take() would block.
+// With a ProgramBinaryCache, programs with a cached binary are loaded in add() and never compiled.
+class ProgramBuilder
+{
+public:
+    using Handle = size_t;
+
+    explicit ProgramBuilder(ProgramBinaryCache * pCache = nullptr);
+
+    ProgramBuilder(const ProgramBuilder&) = delete;
+    ProgramBuilder& operator =(const ProgramBuilder&) = delete;
+
+    // Shader types are deduced from the file extensions, as in compileProgram()
+    Handle add(const std::vector<fs::path>& shaderPaths);
+
+    Handle add(std::vector<ShaderSource> sources);
+
+    // Submit the link of every program added so far. Called by take() if needed, but calling it once after the last add() lets
+    // the driver work on all programs while the application does something else.
+    void linkAll();
+
+    // True if take(handle) would not block on the driver. False before linkAll(), always true after it without parallel shader compilation support.
+    bool isReady(Handle handle) const;
+
+    // Wait for the program to be linked and return it; throw std::runtime_error with the compilation or link log on failure.
+    // Each handle can only be taken once.
+    GLProgram take(Handle handle);
+
+    // True if the driver compiles shaders on its own threads (GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile)
+    static bool isParallelCompileSupported();
+
+private:
+    struct PendingProgram
+    {
+        std::vector<ShaderSource> sources;
+        std::vector<GLShader> shaders; // Empty once linked or for a program loaded from the cache
+        GLProgram program;
+        bool bFromCache = false;
+        bool bLinkSubmitted = false;
+        bool bTaken = false;
+    };
+
+    ProgramBinaryCache * m_pCache = nullptr;
+    std::vector<PendingProgram> m_Programs;
+};
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+namespace glmlv
+{
+
+// 32 bits FNV-1a hash of a GLSL resource name. constexpr so that a lookup by a string literal costs no hashing at runtime:
+//     program.getUniformLocation(hashResourceName("uModelViewMatrix"))
+constexpr uint32_t hashResourceName(const char * name, uint32_t hash = 2166136261u)
+{
+    return *name ? hashResourceName(name + 1, (hash ^ uint32_t((unsigned char) *name)) * 16777619u) : hash;
+}
+
+// Active resources of a linked program, read with the program interface queries (glGetProgramInterfaceiv / glGetProgramResource*):
+// uniforms of the default block (samplers included), uniform blocks and shader storage blocks.
+// Resources are found by the hash of their name in open addressing tables; for arrays both "name" and "name[0]" are registered.
+class ProgramReflection
+{
+public:
+    struct Uniform
+    {
+        std::string name;
+        uint32_t nameHash = 0;
+        GLint location = -1;
+        GLenum type = 0;
+        GLint arraySize = 1;
+        bool isSampler = false;
+    };
+
+    struct Block
+    {
+        std::string name;
+        uint32_t nameHash = 0;
+        GLuint index = GL_INVALID_INDEX;
+        GLint binding = 0;
+        GLint dataSize = 0; // Minimum size of the buffer range bound to the block, an unsized array at the end of a storage block counts as one element
+    };
+
+    ProgramReflection() = default;
+
+    explicit ProgramReflection(GLuint programId);
+
+    const Uniform * findUniform(uint32_t nameHash) const
+    {
+        const auto index = m_UniformIndex.find(nameHash);
+        return index < 0 ? nullptr : &m_Uniforms[index];
+    }
+
+    const Block * findUniformBlock(uint32_t nameHash) const
+    {
+        const auto index = m_UniformBlockIndex.find(nameHash);
+        return index < 0 ? nullptr : &m_UniformBlocks[index];
+    }
+
+    const Block * findStorageBlock(uint32_t nameHash) const
+    {
+        const auto index = m_StorageBlockIndex.find(nameHash);
+        return index < 0 ? nullptr : &m_StorageBlocks[index];
+    }
+
+    // -1 if the uniform is not active, which glUniform* ignores
+    GLint getUniformLocation(uint32_t nameHash) const
+    {
+        const auto pUniform = findUniform(nameHash);
+        return pUniform ? pUniform->location : -1;
+    }
+
+    const std::vector<Uniform>& uniforms() const
+    {
+        return m_Uniforms;
+    }
+
+    const std::vector<Block>& uniformBlocks() const
+    {
+        return m_UniformBlocks;
+    }
+
+    const std::vector<Block>& storageBlocks() const
+    {
+        return m_StorageBlocks;
+    }
+
+    // Check the current GL state against the program, to be called right before a draw with the program in use:
+    // each sampler must have a texture of the matching target bound to its unit, each block a buffer large enough bound to its binding point.
+    // Problems are printed on std::cerr, returns false if there is any. Meant for debug builds: it queries a lot of state.
+    bool validateBindings() const;
+
+    void print(std::ostream& out) const;
+
+private:
+    // Open addressing table from name hash to index in the resource vector, linear probing
+    class HashIndex
+    {
+    public:
+        void build(const std::vector<uint32_t>& hashes, const std::vector<int32_t>& indices);
+
+        int32_t find(uint32_t hash) const
+        {
+            if (m_Indices.empty()) {
+                return -1;
+            }
+            for (auto slot = hash & m_nMask; m_Indices[slot] >= 0; slot = (slot + 1) & m_nMask)
+            {
+                if (m_Hashes[slot] == hash) {
+                    return m_Indices[slot];
+                }
+            }
+            return -1;
+        }
+
+    private:
+        std::vector<uint32_t> m_Hashes;
+        std::vector<int32_t> m_Indices; // -1 for an empty slot
+        uint32_t m_nMask = 0;
+    };
+
+    std::vector<Uniform> m_Uniforms;
+    std::vector<Block> m_UniformBlocks;
+    std::vector<Block> m_StorageBlocks;
+    HashIndex m_UniformIndex;
+    HashIndex m_UniformBlockIndex;
+    HashIndex m_StorageBlockIndex;
+};
+
+}
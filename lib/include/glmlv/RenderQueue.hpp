@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+// Draws submitted in any order with a 64-bit sort key, then sorted once per frame with an LSD radix sort.
+// The key packs, from the most significant bits:
+//
+//     pass (4 bits) | program (10) | material (14) | depth (24) | vertex array (12)
+//
+// so that draws are grouped by pass, then by program and material (fewer state changes), then ordered by depth: front to back for
+// opaque passes, which lets early depth testing reject hidden fragments, back to front for blended passes. Program, material and
+// vertex array are small indices chosen by the application (not GL names). A field that does not matter, e.g. the material when
+// draws are submitted with one multi-draw, can be left at 0 so that the next fields decide the order.
+//
+//     queue.clear();
+//     for (each visible object)
+//         queue.push(RenderQueue::makeKey(0, program, material, RenderQueue::quantizeDepth(depth, zNear, zFar), vao), objectIndex);
+//     queue.sort();
+//     for (const auto & draw : queue.draws())
+//         ... draw object draw.payload ...
+class RenderQueue
+{
+public:
+    static const unsigned PassBits = 4;
+    static const unsigned ProgramBits = 10;
+    static const unsigned MaterialBits = 14;
+    static const unsigned DepthBits = 24;
+    static const unsigned VertexArrayBits = 12;
+
+    enum class DepthOrder
+    {
+        FrontToBack, // Opaque geometry
+        BackToFront // Blended geometry
+    };
+
+    struct Draw
+    {
+        uint64_t key;
+        uint32_t payload; // Chosen by the application, typically the index of the object to draw
+    };
+
+    // Throw if a field does not fit in its bits
+    static uint64_t makeKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t depth, uint32_t vertexArray);
+
+    // Depth field of a view space distance in [zNear, zFar], clamped, with a linear quantization
+    static uint32_t quantizeDepth(float distance, float zNear, float zFar, DepthOrder order = DepthOrder::FrontToBack);
+
+    void clear()
+    {
+        m_Draws.clear();
+    }
+
+    void reserve(size_t count)
+    {
+        m_Draws.reserve(count);
+        m_Scratch.reserve(count);
+    }
+
+    void push(uint64_t key, uint32_t payload)
+    {
+        m_Draws.push_back({ key, payload });
+    }
+
+    // Stable sort by key, 8 bits per pass. Passes on a byte shared by all keys are skipped: with few passes, programs and
+    // materials, most of the upper bytes are.
+    void sort();
+
+    const std::vector<Draw>& draws() const
+    {
+        return m_Draws;
+    }
+
+    size_t size() const
+    {
+        return m_Draws.size();
+    }
+
+    // Radix passes done by the last sort(), at most 8
+    size_t lastSortPassCount() const
+    {
+        return m_nLastSortPassCount;
+    }
+
+private:
+    std::vector<Draw> m_Draws;
+    std::vector<Draw> m_Scratch;
+    size_t m_nLastSortPassCount = 0;
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glmlv/GLProgram.hpp>
+#include <glmlv/ProgramBinaryCache.hpp>
+#include <glmlv/filesystem.hpp>
+
+#include <map>
+#include <vector>
+#include <string>
+
+namespace glmlv
+{
+
+// Preprocessor definitions of a shader variant: name -> value, an empty value gives a plain "#define NAME".
+// Ordered, so that two equal sets of defines always give the same source and the same cache keys.
+using ShaderDefines = std::map<std::string, std::string>;
+
+// Replace each line #include "file" of source by the content of file, recursively. file is searched relative to the directory
+// of the including file first, then in each of includeDirectories. Included text is surrounded by #line directives so that
+// compilation errors point to the right line: the source string number of a file is its index in pIncludedFiles (0 is sourcePath).
+// Throw std::runtime_error if a file is not found or includes itself.
+std::string resolveShaderIncludes(const std::string& source, const fs::path& sourcePath, const std::vector<fs::path>& includeDirectories,
+    std::vector<fs::path> * pIncludedFiles = nullptr);
+
+// Insert defines right after the #version directive, which GLSL requires to come first, or at the beginning if there is none.
+// A #line directive follows them so that line numbers of the original source are kept.
+std::string injectShaderDefines(const std::string& source, const ShaderDefines& defines);
+
+// loadShaderSourceFile() followed by resolveShaderIncludes() and injectShaderDefines()
+ShaderSource loadShaderVariant(const fs::path& shaderPath, const ShaderDefines& defines, const std::vector<fs::path>& includeDirectories = {});
+
+// Programs compiled from the same shader files with different sets of defines, e.g. a loop count fixed at compile time so that
+// the compiler can unroll it. Each variant is compiled once, on first request or with prebuild(), then returned from memory;
+// files are read and their includes resolved only once. With a ProgramBinaryCache, variants are also cached on disk.
+class ShaderVariantCache
+{
+public:
+    explicit ShaderVariantCache(std::vector<fs::path> includeDirectories = {}, ProgramBinaryCache * pBinaryCache = nullptr);
+
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator =(const ShaderVariantCache&) = delete;
+
+    // The returned reference stays valid as long as the cache
+    const GLProgram& get(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines = ShaderDefines());
+
+    // Build all the variants that are not already there at once, with a ProgramBuilder so that the driver can compile them in parallel
+    void prebuild(const std::vector<fs::path>& shaderPaths, const std::vector<ShaderDefines>& definesList);
+
+    size_t variantCount() const
+    {
+        return m_Programs.size();
+    }
+
+private:
+    using VariantKey = std::pair<std::vector<std::string>, ShaderDefines>;
+
+    static VariantKey makeKey(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines);
+    std::vector<ShaderSource> makeSources(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines);
+
+    std::vector<fs::path> m_IncludeDirectories;
+    ProgramBinaryCache * m_pBinaryCache = nullptr;
+    std::map<std::string, ShaderSource> m_ResolvedSources; // Per file, includes resolved, defines not injected
+    std::map<VariantKey, GLProgram> m_Programs;
+};
+
+}
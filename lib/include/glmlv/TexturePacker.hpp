@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glmlv/Image2D.hpp>
+
+namespace glmlv
+{
+
+// Where a packed texture ended up: layer of a GL_TEXTURE_2D_ARRAY, and the rectangle it covers in that layer.
+// A texture coordinate uv of the original texture maps to fract(uv) * uvScale + uvOffset in the layer; sample it with
+// textureGrad() and the derivatives of uv * uvScale so the mip level does not jump where fract() wraps.
+struct PackedTextureRef
+{
+    int32_t arrayIndex = -1; // Index in TexturePacker::arrays(), -1 for an image that has not been packed
+    int32_t layer = 0;
+    glm::vec2 uvScale = glm::vec2(1);
+    glm::vec2 uvOffset = glm::vec2(0);
+};
+
+struct TexturePackerOptions
+{
+    // Length of the sampler2DArray arrays declared by the shaders sampling the packed textures
+    static const size_t DefaultMaxArrayCount = 16;
+
+    size_t minSameSizeCount = 2; // Images sharing their size and format with at least that many others get their own array, one layer each
+    size_t maxAtlasedSize = 512; // Remaining images up to that size are packed in atlases, bigger ones get a single layer array
+    size_t atlasSize = 2048; // Width and maximum height of the atlas layers
+    size_t padding = 8; // Texels repeated around each atlased image so that bilinear filtering and the first mip levels don't bleed between neighbours
+    size_t maxArrayCount = DefaultMaxArrayCount; // Arrays of the packer after pack(), images of the smallest same size groups go to atlases to stay below
+};
+
+// Group many small textures in a few GL_TEXTURE_2D_ARRAY so that a whole scene can be drawn with a handful of texture binds.
+// Images with the same size and format become layers of the same array. Odd-sized images are shelf packed in atlas layers, one atlas array per format;
+// their mip chain is limited to the levels where the padding is still at least one texel.
+class TexturePacker
+{
+public:
+    struct TextureArray
+    {
+        GLuint glId = 0;
+        ImageFormat format = ImageFormat::Undefined;
+        size_t width = 0;
+        size_t height = 0;
+        size_t layerCount = 0;
+        size_t mipLevelCount = 0;
+        bool isAtlas = false;
+    };
+
+    TexturePacker() = default;
+
+    ~TexturePacker();
+
+    TexturePacker(const TexturePacker&) = delete;
+    TexturePacker& operator =(const TexturePacker&) = delete;
+
+    TexturePacker(TexturePacker&& rvalue);
+    TexturePacker& operator =(TexturePacker&& rvalue);
+
+    // Upload images to new texture arrays, returns the reference of each image in the same order.
+    // Throw if the images need more than options.maxArrayCount arrays, counting those of previous calls.
+    std::vector<PackedTextureRef> pack(const std::vector<AnyImage2D>& images, const TexturePackerOptions& options = TexturePackerOptions());
+
+    const std::vector<TextureArray>& arrays() const
+    {
+        return m_Arrays;
+    }
+
+    // Bind array i to texture unit firstUnit + i
+    void bindArrays(GLuint firstUnit = 0) const;
+
+    // GPU memory of all arrays, mip levels included
+    size_t byteSize() const;
+
+private:
+    void release();
+
+    std::vector<TextureArray> m_Arrays;
+};
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace glmlv
+{
+
+// Fixed set of worker threads executing the iterations of parallelFor().
+// The calling thread also takes part in the work, so a pool of N threads runs up to N + 1 iterations concurrently.
+class ThreadPool
+{
+public:
+    // threadCount == 0 means one worker per hardware thread, minus the calling thread
+    explicit ThreadPool(size_t threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    size_t threadCount() const
+    {
+        return m_Threads.size();
+    }
+
+    // Call task(i) for each i in [0, count) and return when all calls are done. Iterations are distributed dynamically.
+    // Calls from several threads are serialized; a task must not call parallelFor() on the same pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // Pool shared by the library, created on first use
+    static ThreadPool& getDefault();
+
+private:
+    void workerLoop();
+    void runIterations();
+
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_SubmitMutex; // Serialize parallelFor() calls
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkDone;
+
+    const std::function<void(size_t)> * m_pTask = nullptr;
+    size_t m_nCount = 0;
+    std::atomic<size_t> m_nNextIndex{ 0 };
+    size_t m_nActiveWorkerCount = 0;
+    size_t m_nGeneration = 0; // Incremented for each parallelFor() so workers know there is new work
+    bool m_bExit = false;
+};
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GPUMemoryLedger.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+namespace glmlv
+{
+
+// A uniform or shader storage buffer holding count elements of T, a struct matching a std140 / std430 block (see BufferLayout.hpp).
+// Each element starts at a multiple of the offset alignment of the target so that any of them can be bound alone with bindElement():
+// typically one element per material, uploaded once and selected at draw time, or one element per object, uploaded once per frame.
+// Storage is immutable (glNamedBufferStorage), content is updated with glNamedBufferSubData.
+template<typename T>
+class TypedBuffer
+{
+public:
+    TypedBuffer() = default;
+
+    // target is GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER, pData (optional) holds count elements
+    TypedBuffer(GLenum target, size_t count, const T * pData = nullptr, GLbitfield storageFlags = GL_DYNAMIC_STORAGE_BIT):
+        m_Target(target), m_Count(count)
+    {
+        GLint offsetAlignment = 0;
+        glGetIntegerv(target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        const auto alignment = size_t(offsetAlignment > 0 ? offsetAlignment : 1);
+        m_Stride = (sizeof(T) + alignment - 1) / alignment * alignment;
+
+        glCreateBuffers(1, &m_GLId);
+        GPUMemoryLedger::get().registerBuffer(m_GLId, m_Stride * count, target == GL_UNIFORM_BUFFER ? GPUMemoryLedger::Category::Uniform : GPUMemoryLedger::Category::OtherBuffer);
+        if (!pData || m_Stride == sizeof(T))
+        {
+            glNamedBufferStorage(m_GLId, GLsizeiptr(m_Stride * count), pData, storageFlags);
+            return;
+        }
+
+        std::vector<unsigned char> strided(m_Stride * count);
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(strided.data() + i * m_Stride, pData + i, sizeof(T));
+        }
+        glNamedBufferStorage(m_GLId, GLsizeiptr(strided.size()), strided.data(), storageFlags);
+    }
+
+    TypedBuffer(GLenum target, const std::vector<T>& elements, GLbitfield storageFlags = GL_DYNAMIC_STORAGE_BIT):
+        TypedBuffer(target, elements.size(), elements.data(), storageFlags)
+    {
+    }
+
+    ~TypedBuffer()
+    {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, m_GLId);
+        glDeleteBuffers(1, &m_GLId);
+    }
+
+    TypedBuffer(const TypedBuffer&) = delete;
+    TypedBuffer& operator =(const TypedBuffer&) = delete;
+
+    TypedBuffer(TypedBuffer&& rvalue):
+        m_GLId(rvalue.m_GLId), m_Target(rvalue.m_Target), m_Count(rvalue.m_Count), m_Stride(rvalue.m_Stride),
+        m_Staging(std::move(rvalue.m_Staging))
+    {
+        rvalue.m_GLId = 0;
+    }
+
+    TypedBuffer& operator =(TypedBuffer&& rvalue)
+    {
+        if (this != &rvalue)
+        {
+            GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, m_GLId);
+            glDeleteBuffers(1, &m_GLId);
+            m_GLId = rvalue.m_GLId;
+            m_Target = rvalue.m_Target;
+            m_Count = rvalue.m_Count;
+            m_Stride = rvalue.m_Stride;
+            m_Staging = std::move(rvalue.m_Staging);
+            rvalue.m_GLId = 0;
+        }
+        return *this;
+    }
+
+    // Requires GL_DYNAMIC_STORAGE_BIT
+    void set(size_t index, const T& value)
+    {
+        glNamedBufferSubData(m_GLId, GLintptr(index * m_Stride), sizeof(T), &value);
+    }
+
+    // Update the first count elements. The driver copies them: a single call when elements are not padded to the stride,
+    // otherwise they are first gathered in a staging vector kept between calls.
+    void set(const T * pData, size_t count)
+    {
+        if (m_Stride == sizeof(T))
+        {
+            glNamedBufferSubData(m_GLId, 0, GLsizeiptr(count * sizeof(T)), pData);
+            return;
+        }
+        m_Staging.resize(m_Stride * count);
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(m_Staging.data() + i * m_Stride, pData + i, sizeof(T));
+        }
+        glNamedBufferSubData(m_GLId, 0, GLsizeiptr(m_Staging.size()), m_Staging.data());
+    }
+
+    // Bind element index alone to a binding point, for a block declaring a single T
+    void bindElement(GLuint binding, size_t index) const
+    {
+        glBindBufferRange(m_Target, binding, m_GLId, GLintptr(index * m_Stride), sizeof(T));
+    }
+
+    // Bind the whole buffer, for a block declaring an array of T (whose stride must then be sizeof(T), see stride())
+    void bindAll(GLuint binding) const
+    {
+        glBindBufferBase(m_Target, binding, m_GLId);
+    }
+
+    GLuint glId() const
+    {
+        return m_GLId;
+    }
+
+    size_t size() const
+    {
+        return m_Count;
+    }
+
+    // Distance in bytes between two elements: sizeof(T) rounded up to the offset alignment of the target
+    size_t stride() const
+    {
+        return m_Stride;
+    }
+
+private:
+    GLuint m_GLId = 0;
+    GLenum m_Target = GL_UNIFORM_BUFFER;
+    size_t m_Count = 0;
+    size_t m_Stride = 0;
+    std::vector<unsigned char> m_Staging;
+};
+
+}
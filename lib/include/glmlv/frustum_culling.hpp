@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glmlv/simple_geometry.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+class ThreadPool;
+
+// World space axis aligned boxes, stored as a structure of arrays (one array per component of the centers and half sizes)
+// so that the culling loop loads the same component of 4 boxes at once and tests them together against each plane.
+struct CullingBounds
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ; // Half sizes
+
+    size_t size() const
+    {
+        return centerX.size();
+    }
+
+    void clear();
+
+    void reserve(size_t count);
+
+    void push(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax);
+
+    // World space box enclosing the local box [bboxMin, bboxMax] transformed by localToWorldMatrix
+    void push(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax, const glm::mat4 & localToWorldMatrix);
+};
+
+// Planes of the frustum of a view-projection matrix (left, right, bottom, top, near, far), with dot(plane.xyz, p) + plane.w >= 0 inside.
+// Works for perspective and orthographic projections, the planes are not normalized.
+struct FrustumPlanes
+{
+    glm::vec4 planes[6];
+};
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4 & viewProjMatrix);
+
+struct CullingStats
+{
+    size_t visibleCount = 0;
+    size_t culledCount = 0;
+};
+
+// visibility[i] = 1 if box i may be visible from viewProjMatrix, 0 if it is entirely outside one of the planes. Conservative: a box
+// crossing the extension of two planes near a corner of the frustum is kept.
+// The boxes are tested 4 at a time with SSE (scalar code elsewhere). Above a few thousand boxes the work is split in chunks over
+// pThreadPool, ThreadPool::getDefault() if null.
+CullingStats cullFrustum(const CullingBounds & bounds, const glm::mat4 & viewProjMatrix, std::vector<uint8_t> & visibility, ThreadPool * pThreadPool = nullptr);
+
+// Cone bounding the world space face normals of a mesh, for back-face culling of whole meshes: seen from a point p, every triangle
+// is back facing when dot(center - p, axis) > sinHalfAngle * |center - p| + radius * (1 + sinHalfAngle), with center and radius
+// a bounding sphere of the mesh. sinHalfAngle is 1 (never culled) when the normals span a half space or more.
+struct NormalCone
+{
+    glm::vec3 axis = glm::vec3(0, 0, 1);
+    float sinHalfAngle = 1.f;
+};
+
+// Cone of the triangles indices[0 .. indexCount), the area weighted mean normal as axis. Degenerate triangles are ignored.
+NormalCone computeNormalCone(const std::vector<Vertex3f3f2f> & vertices, const uint32_t * indices, size_t indexCount, const glm::mat4 & localToWorldMatrix);
+
+}
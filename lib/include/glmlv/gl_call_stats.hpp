@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glmlv/filesystem.hpp>
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+// Per frame statistics of the GL calls of the application, gathered by replacing the glad function pointers of the
+// intercepted entry points with counting trampolines. Nothing is replaced unless the interceptor is installed, so the
+// layer costs nothing when disabled. Every caller is counted, including ImGui and the glmlv classes.
+// Bytes are the sizes of the data passed to the upload (and readback) calls; writes through mapped pointers are not seen.
+
+enum class GLCallCategory
+{
+    Draw, // Draws, dispatches, clears and blits
+    State, // Binds, enable / disable and fixed function state
+    Uniform,
+    BufferUpload,
+    TextureUpload,
+    Resource, // Object creation and deletion
+    Sync, // Fences, queries, readbacks, flush / finish and glGet*
+    Count
+};
+
+const char * getGLCallCategoryName(GLCallCategory category);
+
+// Bytes of one pixel of client data in format / type, as passed to glTexSubImage* or glReadPixels (packed types are one pixel)
+size_t getGLPixelByteSize(GLenum format, GLenum type);
+
+// Must be called after gladLoadGL(), with the context current
+void installGLCallInterceptor();
+
+// Restore the glad function pointers
+void uninstallGLCallInterceptor();
+
+bool isGLCallInterceptorInstalled();
+
+// Install the interceptor if the GLMLV_GL_CALL_STATS environment variable is set to 1. Called by GLFWHandle.
+void initGLCallStats();
+
+// Close the current frame: its counters become the last frame counters. Called by GLFWHandle::swapBuffers().
+void endGLCallStatsFrame();
+
+struct GLCallCounters
+{
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+};
+
+// Counters of the last complete frame
+GLCallCounters getLastFrameGLCallCounters(GLCallCategory category);
+
+// Number of frames since installation
+size_t getGLCallStatsFrameCount();
+
+// Last frame and average per frame counters, by category and by entry point
+void writeGLCallStatsJSON(const fs::path& path);
+
+// Counters of the last frame by category, with the called entry points of each category. The export button writes jsonPath.
+void drawGLCallStatsGUI(const fs::path& jsonPath);
+
+}
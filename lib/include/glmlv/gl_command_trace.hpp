@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glmlv/filesystem.hpp>
+#include <glad/glad.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+namespace glmlv
+{
+
+// Recording of the GL calls of one frame to a binary trace, and replay of that trace in a loop for driver benchmarks
+// (see apps/gl-replay).
+//
+// The recorder replaces the glad function pointers of the recorded entry points for the duration of one frame, like the
+// call statistics layer (gl_call_stats.hpp). Objects that exist before the frame are saved when the frame references them
+// for the first time: buffer and texture contents, sampler parameters, program binaries and uniform values, vertex array
+// and framebuffer setups. Buffers still persistently mapped at the end of the frame are saved again at that point,
+// since writes through mapped pointers are not seen by the recorder. The GL state at the start of the frame
+// (bindings, enables, blend / depth / viewport state) is saved too and restored before each replayed frame.
+//
+// Not recorded: queries, fences, readbacks and glGet* (instrumentation, not rendering work), and any entry point outside
+// the recorded list (see gl_command_trace.cpp). Program binaries tie a trace to the driver and GPU that recorded it.
+// Textures are recreated with immutable storage, multisample textures and renderbuffers are not supported.
+
+// Record the next frame to path. The frame starts and ends at the next two calls of updateGLCommandTraceCapture().
+void requestGLCommandTraceCapture(const fs::path& path);
+
+// True from the request until the trace is written
+bool isGLCommandTraceCapturePending();
+
+// Frame boundary, called by GLFWHandle::swapBuffers() with the size of the default framebuffer
+void updateGLCommandTraceCapture(int framebufferWidth, int framebufferHeight);
+
+// A recorded frame, loaded from a trace file
+class GLCommandTrace
+{
+public:
+    // Throw if the file is not a trace or if it uses entry points this build does not know. Does not need a context.
+    explicit GLCommandTrace(const fs::path& path);
+
+    // Delete the objects created by createObjects() and replayFrame()
+    ~GLCommandTrace();
+
+    GLCommandTrace(const GLCommandTrace&) = delete;
+    GLCommandTrace& operator =(const GLCommandTrace&) = delete;
+
+    // Size of the default framebuffer when the trace was recorded
+    int framebufferWidth() const
+    {
+        return m_nFramebufferWidth;
+    }
+
+    int framebufferHeight() const
+    {
+        return m_nFramebufferHeight;
+    }
+
+    size_t commandCount() const
+    {
+        return m_nCommandCount;
+    }
+
+    size_t objectCount() const
+    {
+        return m_nObjectCount;
+    }
+
+    // Size of the saved contents (buffers, textures, program binaries) and of the commands
+    size_t objectByteSize() const
+    {
+        return m_Objects.size();
+    }
+
+    size_t commandByteSize() const
+    {
+        return m_Commands.size();
+    }
+
+    // Create the objects saved in the trace. Must be called once with a current context, before replayFrame().
+    // Throw if a program binary is rejected by the driver.
+    void createObjects();
+
+    // Delete the objects, with the context still current (the destructor calls it too)
+    void destroyObjects();
+
+    // Restore the state of the start of the frame, then issue the recorded commands
+    void replayFrame();
+
+    // Names of the trace mapped to the names of the replay, per object type
+    using NameMap = std::unordered_map<GLuint, GLuint>;
+
+private:
+    int m_nFramebufferWidth = 0;
+    int m_nFramebufferHeight = 0;
+    size_t m_nObjectCount = 0;
+    size_t m_nCommandCount = 0;
+    std::vector<uint16_t> m_EntryRemap; // Entry index of the file -> entry index of this build
+    std::vector<unsigned char> m_Objects;
+    std::vector<unsigned char> m_State;
+    std::vector<unsigned char> m_Commands;
+    std::vector<NameMap> m_Names; // One per object type
+    bool m_bObjectsCreated = false;
+};
+
+}
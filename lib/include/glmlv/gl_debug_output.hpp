@@ -1,8 +1,41 @@
 #pragma once
 
+#include <cstddef>
+
 namespace glmlv
 {
 
-void initGLDebugOutput();
+enum class GLDebugMode
+{
+    Disabled, // No debug context, no callback: nothing is paid at runtime
+    Synchronous, // GL_DEBUG_OUTPUT_SYNCHRONOUS, each message is logged from the faulty GL call (put a breakpoint in the callback)
+    Asynchronous // Messages are copied to a lock-free queue by the driver and logged by processGLDebugMessages()
+};
+
+// Mode given by the GLMLV_GL_DEBUG environment variable ("off", "sync" or "async") if defined.
+// Otherwise Disabled if glmlv is compiled with NDEBUG (release builds), Asynchronous if not.
+GLDebugMode getDefaultGLDebugMode();
+
+// Must be called with the context current. The context must have been created with the debug flag unless mode is Disabled.
+void initGLDebugOutput(GLDebugMode mode = GLDebugMode::Synchronous);
+
+GLDebugMode getGLDebugMode();
+
+// Asynchronous mode: drain the queue. Messages are aggregated by (source, type, id), only the first occurrence of each is logged.
+// Called by GLFWHandle::swapBuffers(), returns immediately when the queue is empty.
+void processGLDebugMessages();
+
+struct GLDebugStats
+{
+    size_t messageCount = 0; // Received since initGLDebugOutput(), including the dropped ones
+    size_t uniqueMessageCount = 0; // Distinct (source, type, id)
+    size_t performanceMessageCount = 0; // GL_DEBUG_TYPE_PERFORMANCE messages
+    size_t droppedMessageCount = 0; // Lost because the queue was full (asynchronous mode)
+};
+
+GLDebugStats getGLDebugStats();
+
+// Aggregated messages (performance warnings first), and selection of the sources / types / severities reported by the driver
+void drawGLDebugOutputGUI();
 
-}
\ No newline at end of file
+}
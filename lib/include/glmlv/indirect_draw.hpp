@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+
+// GL_ARB_indirect_parameters is not part of our glad loader
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+
+namespace glmlv
+{
+
+// Command read by glDrawElementsIndirect / glMultiDrawElementsIndirect from the buffer bound to GL_DRAW_INDIRECT_BUFFER.
+// gl_DrawID needs GL 4.6 (or ARB_shader_draw_parameters): to find the data of a draw, give each command its index as baseInstance
+// and read it back with an instanced vertex attribute (divisor 1) sourced from a buffer holding 0, 1, 2, ...
+struct DrawElementsIndirectCommand
+{
+    uint32_t count = 0; // Number of indices
+    uint32_t instanceCount = 1;
+    uint32_t firstIndex = 0; // In indices, not bytes
+    int32_t baseVertex = 0;
+    uint32_t baseInstance = 0;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(uint32_t), "DrawElementsIndirectCommand must be tightly packed");
+
+// glMultiDrawElementsIndirectCount: like glMultiDrawElementsIndirect, with the number of draws read by the GPU at byte offset drawCount
+// of the buffer bound to GL_PARAMETER_BUFFER_ARB (and clamped to maxDrawCount), so that a compute shader can decide how many commands to draw.
+using MultiDrawElementsIndirectCountFunction = void (APIENTRYP)(GLenum mode, GLenum type, const void * indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+
+// Load glMultiDrawElementsIndirectCount, from GL 4.6 or GL_ARB_indirect_parameters, through GLFW. Called by GLFWHandle after gladLoadGL().
+void loadIndirectDrawFunctions();
+
+}
+
+// Not part of our glad loader, declared the way glad declares its entry points: the GL call statistics (gl_call_stats.hpp) and trace
+// (gl_command_trace.hpp) layers replace the pointer while they are installed, so always call through it instead of keeping a copy.
+// Null if the context supports neither GL 4.6 nor GL_ARB_indirect_parameters.
+extern glmlv::MultiDrawElementsIndirectCountFunction glad_glMultiDrawElementsIndirectCount;
+#define glMultiDrawElementsIndirectCount glad_glMultiDrawElementsIndirectCount
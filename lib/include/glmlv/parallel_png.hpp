@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glmlv/filesystem.hpp>
+
+namespace glmlv
+{
+
+class ThreadPool;
+
+struct PNGEncodeOptions
+{
+    // Number of rows compressed by each task, 0 to choose it from the image size and the number of threads
+    size_t bandHeight = 0;
+
+    // From 0 (Huffman coding only) to 9 (longest match search), 1 is much faster than stb_image_write for a slightly bigger file
+    int compressionLevel = 1;
+
+    // Pool running the band compression tasks, nullptr for ThreadPool::getDefault()
+    ThreadPool * pThreadPool = nullptr;
+};
+
+// Encode an 8 bits per component image (1 to 4 components, rows stored top to bottom) to a PNG file in memory.
+// Rows are filtered in parallel, then split into bands deflated independently on the thread pool.
+// Each band ends on a byte boundary with an empty stored block so the bands can be concatenated into a single zlib stream;
+// a band can still reference the 32KB of data preceding it, so the compression ratio is close to a single threaded deflate.
+std::vector<unsigned char> encodePNGParallel(size_t width, size_t height, size_t componentCount, const unsigned char * pData,
+    const PNGEncodeOptions& options = PNGEncodeOptions());
+
+void writePNGParallel(const fs::path& path, size_t width, size_t height, size_t componentCount, const unsigned char * pData,
+    const PNGEncodeOptions& options = PNGEncodeOptions());
+
+}
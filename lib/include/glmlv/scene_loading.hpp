@@ -1,7 +1,7 @@
 #pragma once
 
 #include <glmlv/simple_geometry.hpp>
-#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/Image2D.hpp>
 #include <glmlv/filesystem.hpp>
 #include <glm/vec3.hpp>
 
@@ -36,38 +36,40 @@ namespace glmlv
         std::vector<uint32_t> indexCountPerShape; // Nomber d'index de sommets pour chaque objet
 		std::vector<glm::mat4> localToWorldMatrixPerShape; // Matrice localToWorld de chaque objet
         std::vector<int32_t> materialIDPerShape; // Index du materiau de chaque objet (-1 si pas de materiaux)
+        std::vector<glm::vec3> bboxMinPerShape; // Points min et max de la bounding box de chaque objet, dans son repere local
+        std::vector<glm::vec3> bboxMaxPerShape;
 
         std::vector<PhongMaterial> materials; // Tableau des materiaux
-        std::vector<Image2DRGBA> textures; // Tableau des textures rfrencs par les materiaux
+        std::vector<AnyImage2D> textures; // Tableau des textures rfrencs par les materiaux
     };
 
 #ifdef GLMLV_USE_ASSIMP
-    void loadAssimpScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true);
+    void loadAssimpScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions());
 
-    inline void loadAssimpScene(const fs::path & path, SceneData & data, bool loadTextures = true)
+    inline void loadAssimpScene(const fs::path & path, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions())
     {
-        return loadAssimpScene(path, path.parent_path(), data, loadTextures);
+        return loadAssimpScene(path, path.parent_path(), data, loadTextures, textureOptions);
     }
 #endif
 
-    void loadTinyObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true);
+    void loadTinyObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions());
 
-    inline void loadTinyObjScene(const fs::path & path, SceneData & data, bool loadTextures = true)
+    inline void loadTinyObjScene(const fs::path & path, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions())
     {
-        return loadTinyObjScene(path, path.parent_path(), data, loadTextures);
+        return loadTinyObjScene(path, path.parent_path(), data, loadTextures, textureOptions);
     }
 
-    inline void loadObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true)
+    inline void loadObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions())
     {
 #ifdef GLMLV_USE_ASSIMP
-        return loadAssimpScene(path, mtlBaseDir, data, loadTextures);
+        return loadAssimpScene(path, mtlBaseDir, data, loadTextures, textureOptions);
 #else
-        return loadTinyObjScene(path, mtlBaseDir, data, loadTextures);
+        return loadTinyObjScene(path, mtlBaseDir, data, loadTextures, textureOptions);
 #endif
     }
 
-    inline void loadObjScene(const fs::path & path, SceneData & data, bool loadTextures = true)
+    inline void loadObjScene(const fs::path & path, SceneData & data, bool loadTextures = true, const TextureLoadOptions & textureOptions = TextureLoadOptions())
     {
-        return loadObjScene(path, path.parent_path(), data, loadTextures);
+        return loadObjScene(path, path.parent_path(), data, loadTextures, textureOptions);
     }
 }
\ No newline at end of file
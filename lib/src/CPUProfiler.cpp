@@ -0,0 +1,173 @@
+#include <glmlv/CPUProfiler.hpp>
+
+#ifdef GLMLV_ENABLE_CPU_PROFILER
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+namespace glmlv
+{
+
+static void writeEscaped(std::ostream& out, const char * str)
+{
+    for (; *str; ++str)
+    {
+        if (*str == '"' || *str == '\\') {
+            out << '\\';
+        }
+        out << *str;
+    }
+}
+
+CPUProfiler& CPUProfiler::get()
+{
+    static CPUProfiler profiler;
+    return profiler;
+}
+
+CPUProfiler::CPUProfiler(size_t eventsPerThread):
+    m_nEventsPerThread(std::max(eventsPerThread, size_t(1))), m_Origin(Clock::now())
+{
+}
+
+CPUProfiler::ThreadBuffer& CPUProfiler::threadBuffer()
+{
+    // Cache of the ring of the calling thread, for the last profiler it recorded to
+    struct ThreadCache
+    {
+        const CPUProfiler * pProfiler = nullptr;
+        ThreadBuffer * pBuffer = nullptr;
+    };
+    thread_local ThreadCache cache;
+
+    if (cache.pProfiler != this)
+    {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->events.resize(m_nEventsPerThread);
+
+        std::unique_lock<std::mutex> lock(m_RegistryMutex);
+        buffer->threadId = m_ThreadBuffers.size();
+        buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+        cache.pProfiler = this;
+        cache.pBuffer = buffer.get();
+        m_ThreadBuffers.emplace_back(std::move(buffer));
+    }
+    return *cache.pBuffer;
+}
+
+void CPUProfiler::push(ThreadBuffer& buffer, const Event& event)
+{
+    const auto head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % m_nEventsPerThread] = event;
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CPUProfiler::record(const char * name, Clock::time_point start, Clock::time_point end)
+{
+    Event event;
+    event.pName = name;
+    event.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_Origin).count();
+    event.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    event.type = Complete;
+    push(threadBuffer(), event);
+}
+
+void CPUProfiler::frameBoundary()
+{
+    Event event;
+    event.pName = "Frame";
+    event.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_Origin).count();
+    event.durationNs = int64_t(m_nFrameCount++); // Frame index for boundaries
+    event.type = FrameBoundary;
+    push(threadBuffer(), event);
+}
+
+void CPUProfiler::setThreadName(const std::string& name)
+{
+    auto & buffer = threadBuffer();
+    std::unique_lock<std::mutex> lock(m_RegistryMutex);
+    buffer.threadName = name;
+}
+
+void CPUProfiler::writeTrace(const fs::path& path) const
+{
+    if (path.has_parent_path() && !fs::exists(path.parent_path())) {
+        fs::create_directories(path.parent_path());
+    }
+
+    std::ofstream out(path.string());
+    if (!out)
+    {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        throw std::runtime_error("Unable to open " + path.string() + " for writing");
+    }
+
+    std::unique_lock<std::mutex> lock(m_RegistryMutex);
+
+    out << std::fixed << std::setprecision(3); // Microseconds with nanosecond resolution
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    const auto separator = [&]() -> std::ostream&
+    {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+        return out;
+    };
+
+    size_t writtenCount = 0;
+    size_t skippedCount = 0;
+    std::vector<Event> events;
+    for (const auto & buffer : m_ThreadBuffers)
+    {
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+        writeEscaped(out, buffer->threadName.c_str());
+        out << "\"}}";
+
+        // Copy the events, then discard those the owner thread may have overwritten in the meantime
+        const auto headBefore = buffer->head.load(std::memory_order_acquire);
+        const auto firstIndex = headBefore > m_nEventsPerThread ? headBefore - m_nEventsPerThread : 0;
+        events.clear();
+        for (auto i = firstIndex; i < headBefore; ++i) {
+            events.emplace_back(buffer->events[i % m_nEventsPerThread]);
+        }
+        const auto headAfter = buffer->head.load(std::memory_order_acquire);
+        const auto firstValidIndex = headAfter >= m_nEventsPerThread ? headAfter - m_nEventsPerThread + 1 : 0;
+
+        for (auto i = firstIndex; i < headBefore; ++i)
+        {
+            if (i < firstValidIndex)
+            {
+                ++skippedCount;
+                continue;
+            }
+            const auto & event = events[i - firstIndex];
+            separator() << "{\"name\":\"";
+            writeEscaped(out, event.pName);
+            // Timestamps and durations are in microseconds
+            if (event.type == Complete) {
+                out << "\",\"cat\":\"glmlv\",\"ph\":\"X\",\"ts\":" << event.startNs * 1e-3 << ",\"dur\":" << event.durationNs * 1e-3;
+            }
+            else {
+                out << "\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << event.startNs * 1e-3 << ",\"args\":{\"frame\":" << event.durationNs << "}";
+            }
+            out << ",\"pid\":0,\"tid\":" << buffer->threadId << "}";
+            ++writtenCount;
+        }
+    }
+    out << "\n]}" << std::endl;
+
+    std::cout << "CPU trace written to " << path << ": " << writtenCount << " events from " << m_ThreadBuffers.size() << " threads";
+    if (skippedCount) {
+        std::cout << " (" << skippedCount << " overwritten during the copy)";
+    }
+    std::cout << std::endl;
+}
+
+}
+
+#endif
@@ -0,0 +1,249 @@
+#include <glmlv/FrameCapture.hpp>
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <imgui.h>
+
+namespace glmlv
+{
+
+FrameCapture::FrameCapture(size_t ringSize, size_t maxQueuedFrameCount):
+    m_PixelPackBuffers(std::max(ringSize, size_t(1))),
+    m_nMaxQueuedFrameCount(std::max(maxQueuedFrameCount, size_t(1))),
+    m_EncoderThread([this]() { encoderLoop(); })
+{
+    for (auto & buffer : m_PixelPackBuffers) {
+        glGenBuffers(1, &buffer.glId);
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    update(true);
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_bExitEncoder = true;
+    }
+    m_QueueNotEmpty.notify_all();
+    m_EncoderThread.join();
+
+    for (auto & buffer : m_PixelPackBuffers)
+    {
+        if (buffer.fence) {
+            glDeleteSync(buffer.fence);
+        }
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, buffer.glId);
+        glDeleteBuffers(1, &buffer.glId);
+    }
+}
+
+void FrameCapture::start(const fs::path& outputDirectory, const std::string& extension)
+{
+    if (!fs::exists(outputDirectory)) {
+        fs::create_directories(outputDirectory);
+    }
+
+    m_OutputDirectory = outputDirectory;
+    m_Extension = extension;
+    m_nFrameIndex = 0;
+    m_bCapturing = true;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Stats = Stats();
+    m_Stats.queuedFrameCount = m_EncodeQueue.size();
+}
+
+void FrameCapture::stop()
+{
+    m_bCapturing = false;
+}
+
+void FrameCapture::captureFrame(GLuint framebuffer, GLenum readBuffer, size_t width, size_t height)
+{
+    update();
+
+    if (!m_bCapturing) {
+        return;
+    }
+
+    if (m_nPendingCount == m_PixelPackBuffers.size())
+    {
+        // The GPU has not finished the readbacks of the previous frames, waiting for it would stall the pipeline
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        ++m_Stats.droppedFrameCount;
+        ++m_nFrameIndex;
+        return;
+    }
+
+    auto & buffer = m_PixelPackBuffers[m_nNextBuffer];
+    m_nNextBuffer = (m_nNextBuffer + 1) % m_PixelPackBuffers.size();
+    ++m_nPendingCount;
+
+    buffer.width = width;
+    buffer.height = height;
+    buffer.frameIndex = m_nFrameIndex++;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.glId);
+
+    const auto byteSize = width * height * Image2DRGBA::NumComponents;
+    if (buffer.byteSize != byteSize)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_STREAM_READ);
+        buffer.byteSize = byteSize;
+        GPUMemoryLedger::get().registerBuffer(buffer.glId, byteSize);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(readBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // Asynchronous since a pixel pack buffer is bound
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameCapture::update(bool waitForGPU)
+{
+    while (m_nPendingCount > 0)
+    {
+        auto & buffer = m_PixelPackBuffers[m_nOldestBuffer];
+
+        // Flush on the first wait so the fence is guaranteed to be signaled eventually
+        const GLuint64 timeout = waitForGPU ? GLuint64(1e9) : 0;
+        const auto status = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            if (status == GL_WAIT_FAILED) {
+                std::cerr << "FrameCapture: glClientWaitSync failed" << std::endl;
+            }
+            if (status == GL_WAIT_FAILED || !waitForGPU) {
+                return; // Readbacks complete in order, no need to check the next ones
+            }
+            continue;
+        }
+
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+
+        readBack(buffer);
+
+        m_nOldestBuffer = (m_nOldestBuffer + 1) % m_PixelPackBuffers.size();
+        --m_nPendingCount;
+    }
+}
+
+void FrameCapture::readBack(PixelPackBuffer& buffer)
+{
+    Image2DRGBA image(buffer.width, buffer.height);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.glId);
+    const auto pMapped = (const unsigned char *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer.byteSize, GL_MAP_READ_BIT);
+    if (pMapped)
+    {
+        std::copy(pMapped, pMapped + buffer.byteSize, image.data());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!pMapped)
+    {
+        std::cerr << "FrameCapture: unable to map pixel pack buffer" << std::endl;
+        return;
+    }
+
+    image.flipY(); // OpenGL origin is the bottom left corner, image files start at the top left
+
+    std::stringstream filename;
+    filename << "frame_" << std::setw(6) << std::setfill('0') << buffer.frameIndex << m_Extension;
+
+    pushJob({ std::move(image), m_OutputDirectory / filename.str(), m_WriteOptions });
+}
+
+void FrameCapture::pushJob(EncodeJob job)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    if (m_EncodeQueue.size() >= m_nMaxQueuedFrameCount)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        m_QueueNotFull.wait(lock, [&]() { return m_EncodeQueue.size() < m_nMaxQueuedFrameCount; });
+        m_Stats.blockedSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    m_EncodeQueue.emplace_back(std::move(job));
+    ++m_Stats.capturedFrameCount;
+    m_Stats.queuedFrameCount = m_EncodeQueue.size();
+
+    lock.unlock();
+    m_QueueNotEmpty.notify_one();
+}
+
+void FrameCapture::encoderLoop()
+{
+    GLMLV_PROFILE_THREAD_NAME("FrameCapture encoder");
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_QueueNotEmpty.wait(lock, [&]() { return m_bExitEncoder || !m_EncodeQueue.empty(); });
+        if (m_EncodeQueue.empty()) {
+            return; // Exit requested and nothing left to encode
+        }
+
+        auto job = std::move(m_EncodeQueue.front());
+        m_EncodeQueue.pop_front();
+        lock.unlock();
+        m_QueueNotFull.notify_one();
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            GLMLV_PROFILE_SCOPE("FrameCapture writeImage");
+            if (job.options.parallelPNG && !job.options.png.pThreadPool)
+            {
+                if (!m_pEncoderThreadPool) {
+                    m_pEncoderThreadPool.reset(new ThreadPool());
+                }
+                job.options.png.pThreadPool = m_pEncoderThreadPool.get();
+            }
+            writeImage(job.image, job.path, job.options);
+        }
+        catch (const std::exception&)
+        {
+            // writeImage already logged the error, keep encoding the next frames
+        }
+        const auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        lock.lock();
+        ++m_Stats.encodedFrameCount;
+        m_Stats.queuedFrameCount = m_EncodeQueue.size();
+        m_Stats.encodeSeconds += seconds;
+        m_Stats.encodedMegaBytes += job.image.size() * Image2DRGBA::NumComponents / (1024. * 1024.);
+    }
+}
+
+FrameCapture::Stats FrameCapture::getStats() const
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+void FrameCapture::drawGUI() const
+{
+    const auto stats = getStats();
+    ImGui::Text("Captured %zu, dropped %zu, encoded %zu, queued %zu", stats.capturedFrameCount, stats.droppedFrameCount, stats.encodedFrameCount, stats.queuedFrameCount);
+    if (stats.encodeSeconds > 0.) {
+        ImGui::Text("Encoding: %.1f frames/s, %.1f MB/s", stats.encodedFrameCount / stats.encodeSeconds, stats.encodedMegaBytes / stats.encodeSeconds);
+    }
+    ImGui::Text("Render loop blocked %.3f s on full queue", stats.blockedSeconds);
+}
+
+}
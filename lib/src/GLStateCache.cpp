@@ -0,0 +1,194 @@
+#include <glmlv/GLStateCache.hpp>
+
+#include <imgui.h>
+
+#include <algorithm>
+
+namespace glmlv
+{
+
+const GLuint GLStateCache::Unknown;
+
+const GLenum GLStateCache::GenericBufferTargets[] = {
+    GL_ARRAY_BUFFER, GL_ATOMIC_COUNTER_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+    GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_QUERY_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER, GL_UNIFORM_BUFFER
+};
+
+GLStateCache::GLStateCache():
+    m_GenericBuffers(sizeof(GenericBufferTargets) / sizeof(GenericBufferTargets[0]))
+{
+    const auto getInteger = [](GLenum pname)
+    {
+        GLint value = 0;
+        glGetIntegerv(pname, &value);
+        return size_t(value > 0 ? value : 0);
+    };
+
+    m_Textures.resize(getInteger(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS));
+    m_Samplers.resize(m_Textures.size());
+    m_UniformBuffers.resize(getInteger(GL_MAX_UNIFORM_BUFFER_BINDINGS));
+    m_ShaderStorageBuffers.resize(getInteger(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS));
+    m_AtomicCounterBuffers.resize(getInteger(GL_MAX_ATOMIC_COUNTER_BUFFER_BINDINGS));
+    m_TransformFeedbackBuffers.resize(getInteger(GL_MAX_TRANSFORM_FEEDBACK_BUFFERS));
+
+    invalidate();
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    if (target == GL_FRAMEBUFFER)
+    {
+        if (m_DrawFramebuffer == framebuffer && m_ReadFramebuffer == framebuffer)
+        {
+            ++m_Counters[Framebuffer].filtered;
+            return;
+        }
+        ++m_Counters[Framebuffer].issued;
+        m_DrawFramebuffer = m_ReadFramebuffer = framebuffer;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        return;
+    }
+
+    if (filter(Framebuffer, target == GL_DRAW_FRAMEBUFFER ? m_DrawFramebuffer : m_ReadFramebuffer, framebuffer)) {
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    const auto pBinding = genericBufferBinding(target);
+    if (!pBinding)
+    {
+        ++m_Counters[Buffer].issued;
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if (filter(Buffer, *pBinding, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    const auto pBindings = indexedBufferBindings(target);
+    const auto pGenericBinding = genericBufferBinding(target);
+    if (pBindings && index < pBindings->size())
+    {
+        auto & binding = (*pBindings)[index];
+        if (binding.buffer == buffer && binding.offset == offset && binding.size == size && *pGenericBinding == buffer)
+        {
+            ++m_Counters[Buffer].filtered;
+            return;
+        }
+        binding.buffer = buffer;
+        binding.offset = offset;
+        binding.size = size;
+    }
+
+    ++m_Counters[Buffer].issued;
+    if (pGenericBinding) {
+        *pGenericBinding = buffer;
+    }
+
+    if (size == 0) {
+        glBindBufferBase(target, index, buffer);
+    }
+    else {
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+}
+
+void GLStateCache::invalidate()
+{
+    m_Program = Unknown;
+    m_VertexArray = Unknown;
+    m_DrawFramebuffer = Unknown;
+    m_ReadFramebuffer = Unknown;
+    std::fill(begin(m_Textures), end(m_Textures), Unknown);
+    std::fill(begin(m_Samplers), end(m_Samplers), Unknown);
+    std::fill(begin(m_GenericBuffers), end(m_GenericBuffers), Unknown);
+
+    for (auto pBindings : { &m_UniformBuffers, &m_ShaderStorageBuffers, &m_AtomicCounterBuffers, &m_TransformFeedbackBuffers })
+    {
+        for (auto & binding : *pBindings) {
+            binding.buffer = Unknown;
+        }
+    }
+}
+
+void GLStateCache::beginFrame()
+{
+    std::copy(m_Counters, m_Counters + CategoryCount, m_LastFrameCounters);
+    resetCounters();
+    invalidate();
+}
+
+GLStateCache::Counters GLStateCache::getTotalCounters() const
+{
+    Counters total;
+    for (const auto & counters : m_Counters)
+    {
+        total.issued += counters.issued;
+        total.filtered += counters.filtered;
+    }
+    return total;
+}
+
+void GLStateCache::resetCounters()
+{
+    std::fill(m_Counters, m_Counters + CategoryCount, Counters{});
+}
+
+void GLStateCache::drawGUI() const
+{
+    static const char * categoryNames[CategoryCount] = { "Program", "Vertex array", "Texture", "Sampler", "Framebuffer", "Buffer" };
+
+    Counters total;
+    ImGui::Columns(3, "GLStateCache");
+    ImGui::Text("Binding"); ImGui::NextColumn();
+    ImGui::Text("Issued"); ImGui::NextColumn();
+    ImGui::Text("Filtered"); ImGui::NextColumn();
+    for (size_t i = 0; i < CategoryCount; ++i)
+    {
+        ImGui::Text("%s", categoryNames[i]); ImGui::NextColumn();
+        ImGui::Text("%zu", m_LastFrameCounters[i].issued); ImGui::NextColumn();
+        ImGui::Text("%zu", m_LastFrameCounters[i].filtered); ImGui::NextColumn();
+        total.issued += m_LastFrameCounters[i].issued;
+        total.filtered += m_LastFrameCounters[i].filtered;
+    }
+    ImGui::Columns(1);
+
+    const auto callCount = total.issued + total.filtered;
+    ImGui::Text("%zu of %zu bind calls filtered (%.1f %%)", total.filtered, callCount, callCount ? 100. * total.filtered / callCount : 0.);
+}
+
+GLuint * GLStateCache::genericBufferBinding(GLenum target)
+{
+    for (size_t i = 0; i < m_GenericBuffers.size(); ++i)
+    {
+        if (GenericBufferTargets[i] == target) {
+            return &m_GenericBuffers[i];
+        }
+    }
+    return nullptr;
+}
+
+std::vector<GLStateCache::IndexedBufferBinding> * GLStateCache::indexedBufferBindings(GLenum target)
+{
+    switch (target)
+    {
+    case GL_UNIFORM_BUFFER:
+        return &m_UniformBuffers;
+    case GL_SHADER_STORAGE_BUFFER:
+        return &m_ShaderStorageBuffers;
+    case GL_ATOMIC_COUNTER_BUFFER:
+        return &m_AtomicCounterBuffers;
+    case GL_TRANSFORM_FEEDBACK_BUFFER:
+        return &m_TransformFeedbackBuffers;
+    default:
+        return nullptr;
+    }
+}
+
+}
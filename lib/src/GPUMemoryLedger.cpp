@@ -0,0 +1,211 @@
+#include <glmlv/GPUMemoryLedger.hpp>
+
+#include <imgui.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+// Not in the glad loader, the values come from the extension specifications
+#define GLMLV_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GLMLV_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GLMLV_TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+namespace glmlv
+{
+
+static bool hasExtension(const char * name)
+{
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i)
+    {
+        const auto extension = (const char *) glGetStringi(GL_EXTENSIONS, GLuint(i));
+        if (extension && std::strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+GPUMemoryLedger& GPUMemoryLedger::get()
+{
+    static GPUMemoryLedger ledger;
+    return ledger;
+}
+
+GPUMemoryLedger::GPUMemoryLedger()
+{
+    m_CategoryByteSizes.fill(0);
+
+    if (const auto budget = std::getenv("GLMLV_GPU_MEMORY_BUDGET_MB")) {
+        m_nBudget = size_t(std::atoll(budget)) * 1024 * 1024;
+    }
+}
+
+const char * GPUMemoryLedger::getCategoryName(Category category)
+{
+    static const char * names[] = { "Textures", "Render targets", "Vertex / index buffers", "Uniform buffers", "Other buffers" };
+    return names[size_t(category)];
+}
+
+size_t GPUMemoryLedger::getTexelByteSize(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8: case GL_R8UI: case GL_R8I: case GL_STENCIL_INDEX8:
+        return 1;
+    case GL_RG8: case GL_RG8UI: case GL_RG8I: case GL_R16: case GL_R16F: case GL_R16UI: case GL_R16I: case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RGB8: case GL_SRGB8:
+        return 3; // Usually padded to 4 by drivers
+    case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGBA8UI: case GL_RGBA8I: case GL_RG16: case GL_RG16F: case GL_RG16UI: case GL_RG16I:
+    case GL_R32F: case GL_R32UI: case GL_R32I: case GL_RGB10_A2: case GL_R11F_G11F_B10F: case GL_RGB9_E5:
+    case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8:
+        return 4;
+    case GL_RGB16: case GL_RGB16F: case GL_RGB16UI: case GL_RGB16I:
+        return 6;
+    case GL_RGBA16: case GL_RGBA16F: case GL_RGBA16UI: case GL_RGBA16I: case GL_RG32F: case GL_RG32UI: case GL_RG32I: case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGB32F: case GL_RGB32UI: case GL_RGB32I:
+        return 12;
+    case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+        return 16;
+    }
+    std::cerr << "GPUMemoryLedger: unknown internal format " << internalFormat << ", counted as 4 bytes per texel" << std::endl;
+    return 4;
+}
+
+size_t GPUMemoryLedger::computeTextureByteSize(GLenum internalFormat, size_t width, size_t height, size_t depth, size_t levels)
+{
+    // Array layers (depth of 2D arrays) are not halved with the levels, unlike 3D textures: counting them as layers is the common case
+    size_t texelCount = 0;
+    for (size_t level = 0; level < std::max(levels, size_t(1)); ++level) {
+        texelCount += std::max(width >> level, size_t(1)) * std::max(height >> level, size_t(1)) * std::max(depth, size_t(1));
+    }
+    return texelCount * getTexelByteSize(internalFormat);
+}
+
+void GPUMemoryLedger::add(uint64_t entryKey, Category category, size_t byteSize)
+{
+    const auto it = m_Entries.find(entryKey);
+    if (it != end(m_Entries))
+    {
+        m_CategoryByteSizes[size_t((*it).second.category)] -= (*it).second.byteSize;
+        m_nTotalByteSize -= (*it).second.byteSize;
+        m_Entries.erase(it);
+    }
+
+    m_Entries.emplace(entryKey, Entry{ category, byteSize });
+    m_CategoryByteSizes[size_t(category)] += byteSize;
+    m_nTotalByteSize += byteSize;
+    m_nPeakByteSize = std::max(m_nPeakByteSize, m_nTotalByteSize);
+
+    const bool overBudget = m_nBudget && m_nTotalByteSize > m_nBudget;
+    if (overBudget && !m_bOverBudget)
+    {
+        std::cerr << "GPUMemoryLedger: " << m_nTotalByteSize / (1024 * 1024) << " MB allocated, over the budget of " << m_nBudget / (1024 * 1024) << " MB" << std::endl;
+    }
+    m_bOverBudget = overBudget;
+}
+
+void GPUMemoryLedger::registerBuffer(GLuint buffer, size_t byteSize, Category category)
+{
+    if (buffer) {
+        add(key(ResourceType::Buffer, buffer), category, byteSize);
+    }
+}
+
+void GPUMemoryLedger::registerTexture(GLuint texture, GLenum internalFormat, size_t width, size_t height, size_t depth, size_t levels, Category category)
+{
+    if (texture) {
+        add(key(ResourceType::Texture, texture), category, computeTextureByteSize(internalFormat, width, height, depth, levels));
+    }
+}
+
+void GPUMemoryLedger::unregisterResource(ResourceType type, GLuint id)
+{
+    const auto it = m_Entries.find(key(type, id));
+    if (it == end(m_Entries)) {
+        return;
+    }
+    m_CategoryByteSizes[size_t((*it).second.category)] -= (*it).second.byteSize;
+    m_nTotalByteSize -= (*it).second.byteSize;
+    m_Entries.erase(it);
+    m_bOverBudget = m_nBudget && m_nTotalByteSize > m_nBudget;
+}
+
+void GPUMemoryLedger::setCategory(ResourceType type, GLuint id, Category category)
+{
+    const auto it = m_Entries.find(key(type, id));
+    if (it == end(m_Entries) || (*it).second.category == category) {
+        return;
+    }
+    m_CategoryByteSizes[size_t((*it).second.category)] -= (*it).second.byteSize;
+    m_CategoryByteSizes[size_t(category)] += (*it).second.byteSize;
+    (*it).second.category = category;
+}
+
+void GPUMemoryLedger::setBudget(size_t byteSize)
+{
+    m_nBudget = byteSize;
+    m_bOverBudget = m_nBudget && m_nTotalByteSize > m_nBudget;
+}
+
+GPUMemoryLedger::DriverMemoryInfo GPUMemoryLedger::getDriverMemoryInfo() const
+{
+    static const bool hasNVX = hasExtension("GL_NVX_gpu_memory_info");
+    static const bool hasATI = !hasNVX && hasExtension("GL_ATI_meminfo");
+
+    DriverMemoryInfo info;
+    if (hasNVX)
+    {
+        GLint total = 0, available = 0;
+        glGetIntegerv(GLMLV_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total);
+        glGetIntegerv(GLMLV_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+        info.extension = "GL_NVX_gpu_memory_info";
+        info.totalKB = total;
+        info.availableKB = available;
+    }
+    else if (hasATI)
+    {
+        GLint textureFree[4] = { 0, 0, 0, 0 }; // Total free, largest free block, total auxiliary free, largest auxiliary free block
+        glGetIntegerv(GLMLV_TEXTURE_FREE_MEMORY_ATI, textureFree);
+        info.extension = "GL_ATI_meminfo";
+        info.availableKB = textureFree[0];
+    }
+    return info;
+}
+
+void GPUMemoryLedger::drawGUI()
+{
+    const auto toMB = [](size_t byteSize) { return byteSize / (1024. * 1024.); };
+
+    for (size_t i = 0; i < size_t(Category::Count); ++i) {
+        ImGui::Text("%-24s %9.2f MB", getCategoryName(Category(i)), toMB(m_CategoryByteSizes[i]));
+    }
+    const auto totalColor = m_bOverBudget ? ImVec4(1.f, 0.4f, 0.4f, 1.f) : ImGui::GetStyle().Colors[ImGuiCol_Text];
+    ImGui::TextColored(totalColor, "%-24s %9.2f MB (peak %.2f MB, %zu objects)", "Total", toMB(m_nTotalByteSize), toMB(m_nPeakByteSize), m_Entries.size());
+
+    int budgetMB = int(m_nBudget / (1024 * 1024));
+    if (ImGui::InputInt("Budget (MB, 0 = none)", &budgetMB)) {
+        setBudget(size_t(std::max(budgetMB, 0)) * 1024 * 1024);
+    }
+    if (m_nBudget) {
+        ImGui::ProgressBar(float(std::min(double(m_nTotalByteSize) / m_nBudget, 1.)), ImVec2(-1.f, 0.f));
+    }
+
+    const auto driverInfo = getDriverMemoryInfo();
+    if (!driverInfo.extension) {
+        ImGui::Text("Driver: no memory info extension");
+    }
+    else if (driverInfo.totalKB >= 0) {
+        ImGui::Text("Driver (%s): %.1f / %.1f MB available", driverInfo.extension, driverInfo.availableKB / 1024., driverInfo.totalKB / 1024.);
+    }
+    else {
+        ImGui::Text("Driver (%s): %.1f MB available for textures", driverInfo.extension, driverInfo.availableKB / 1024.);
+    }
+}
+
+}
@@ -0,0 +1,357 @@
+#include <glmlv/GPUProfiler.hpp>
+
+#include <imgui.h>
+#include <json.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+
+namespace glmlv
+{
+
+const size_t GPUProfiler::NoParent = ~size_t(0);
+
+GPUProfiler::GPUProfiler(size_t framesInFlight, size_t historySize):
+    m_Frames(std::max(framesInFlight, size_t(1))),
+    m_nHistorySize(std::max(historySize, size_t(1)))
+{
+}
+
+GPUProfiler::~GPUProfiler()
+{
+    for (auto & frame : m_Frames)
+    {
+        if (!frame.queries.empty()) {
+            glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+        }
+    }
+}
+
+void GPUProfiler::beginFrame()
+{
+    if (m_bInFrame)
+    {
+        std::cerr << "GPUProfiler: beginFrame() called twice without endFrame()" << std::endl;
+        throw std::runtime_error("GPUProfiler: beginFrame() called twice without endFrame()");
+    }
+
+    // Results come back in submission order, stop at the first frame still executing
+    while (m_nResolvedFrameCount < m_nFrameCount)
+    {
+        auto & frame = m_Frames[m_nResolvedFrameCount % m_Frames.size()];
+        if (!isAvailable(frame)) {
+            break;
+        }
+        resolve(frame);
+        ++m_nResolvedFrameCount;
+    }
+
+    if (m_nFrameCount - m_nResolvedFrameCount == m_Frames.size())
+    {
+        // Reading the oldest frame now would wait for the GPU: forget it and reuse its queries
+        ++m_nDroppedFrameCount;
+        ++m_nResolvedFrameCount;
+    }
+
+    auto & frame = m_Frames[m_nFrameCount % m_Frames.size()];
+    frame.usedQueryCount = 0;
+    frame.markers.clear();
+
+    m_bInFrame = true;
+    pushSection("Frame");
+}
+
+void GPUProfiler::endFrame()
+{
+    if (m_MarkerStack.size() != 1)
+    {
+        std::cerr << "GPUProfiler: endFrame() called with " << m_MarkerStack.size() << " open sections (expected only the frame)" << std::endl;
+        throw std::runtime_error("GPUProfiler: unbalanced sections");
+    }
+    popSection();
+
+    m_bInFrame = false;
+    ++m_nFrameCount;
+}
+
+void GPUProfiler::pushSection(const char * name)
+{
+    if (!m_bInFrame)
+    {
+        std::cerr << "GPUProfiler: section " << name << " pushed outside of beginFrame() / endFrame()" << std::endl;
+        throw std::runtime_error("GPUProfiler: section pushed outside of a frame");
+    }
+
+    auto & frame = m_Frames[m_nFrameCount % m_Frames.size()];
+    const auto parent = m_MarkerStack.empty() ? NoParent : frame.markers[m_MarkerStack.back()].section;
+    const auto section = findOrAddSection(parent, name);
+
+    if (glPushDebugGroup) {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GLuint(section), -1, name);
+    }
+
+    Marker marker;
+    marker.section = section;
+    marker.beginQuery = timestamp(frame);
+    m_MarkerStack.emplace_back(frame.markers.size());
+    frame.markers.emplace_back(marker);
+}
+
+void GPUProfiler::popSection()
+{
+    if (m_MarkerStack.empty())
+    {
+        std::cerr << "GPUProfiler: popSection() without matching pushSection()" << std::endl;
+        throw std::runtime_error("GPUProfiler: popSection() without matching pushSection()");
+    }
+
+    auto & frame = m_Frames[m_nFrameCount % m_Frames.size()];
+    frame.markers[m_MarkerStack.back()].endQuery = timestamp(frame);
+    m_MarkerStack.pop_back();
+
+    if (glPopDebugGroup) {
+        glPopDebugGroup();
+    }
+}
+
+size_t GPUProfiler::findOrAddSection(size_t parent, const char * name)
+{
+    for (size_t i = 0; i < m_Sections.size(); ++i)
+    {
+        if (m_Sections[i].parent == parent && m_Sections[i].name == name) {
+            return i;
+        }
+    }
+
+    Section section;
+    section.name = name;
+    section.parent = parent;
+    section.depth = parent == NoParent ? 0 : m_Sections[parent].depth + 1;
+    section.history.resize(m_nHistorySize);
+    m_Sections.emplace_back(std::move(section));
+    return m_Sections.size() - 1;
+}
+
+size_t GPUProfiler::timestamp(Frame& frame)
+{
+    if (frame.usedQueryCount == frame.queries.size())
+    {
+        const auto newCount = std::max(frame.queries.size() * 2, size_t(16));
+        const auto oldCount = frame.queries.size();
+        frame.queries.resize(newCount);
+        glGenQueries(GLsizei(newCount - oldCount), frame.queries.data() + oldCount);
+    }
+    glQueryCounter(frame.queries[frame.usedQueryCount], GL_TIMESTAMP);
+    return frame.usedQueryCount++;
+}
+
+bool GPUProfiler::isAvailable(const Frame& frame) const
+{
+    if (!frame.usedQueryCount) {
+        return true;
+    }
+    // The end of the frame section is the last query issued, the others are available before it
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[frame.usedQueryCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+void GPUProfiler::resolve(Frame& frame)
+{
+    std::vector<GLuint64> timestamps(frame.usedQueryCount);
+    for (size_t i = 0; i < frame.usedQueryCount; ++i) {
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+    std::vector<double> sectionMs(m_Sections.size(), -1.);
+    for (const auto & marker : frame.markers)
+    {
+        const auto nanoseconds = timestamps[marker.endQuery] - timestamps[marker.beginQuery];
+        auto & ms = sectionMs[marker.section];
+        ms = std::max(ms, 0.) + double(nanoseconds) * 1e-6;
+    }
+
+    for (size_t i = 0; i < m_Sections.size(); ++i)
+    {
+        if (sectionMs[i] < 0.) {
+            continue; // Not drawn this frame
+        }
+        auto & section = m_Sections[i];
+        section.lastMs = float(sectionMs[i]);
+        section.history[section.historyHead] = section.lastMs;
+        section.historyHead = (section.historyHead + 1) % m_nHistorySize;
+        section.sampleCount = std::min(section.sampleCount + 1, m_nHistorySize);
+    }
+}
+
+std::vector<size_t> GPUProfiler::depthFirstOrder() const
+{
+    // Children are pushed in reverse so that they come out in creation order
+    std::vector<size_t> order;
+    std::vector<size_t> stack;
+    const auto pushChildren = [&](size_t parent)
+    {
+        for (size_t i = m_Sections.size(); i > 0; --i)
+        {
+            if (m_Sections[i - 1].parent == parent) {
+                stack.emplace_back(i - 1);
+            }
+        }
+    };
+
+    pushChildren(NoParent);
+    while (!stack.empty())
+    {
+        const auto current = stack.back();
+        stack.pop_back();
+        order.emplace_back(current);
+        pushChildren(current);
+    }
+    return order;
+}
+
+GPUProfiler::SectionStats GPUProfiler::computeStats(size_t index) const
+{
+    const auto & section = m_Sections[index];
+
+    SectionStats stats;
+    stats.name = section.name;
+    stats.path = section.name;
+    for (auto parent = section.parent; parent != NoParent; parent = m_Sections[parent].parent) {
+        stats.path = m_Sections[parent].name + "/" + stats.path;
+    }
+    stats.depth = section.depth;
+    stats.sampleCount = section.sampleCount;
+    stats.lastMs = section.lastMs;
+
+    if (!section.sampleCount) {
+        return stats;
+    }
+
+    std::vector<float> samples(begin(section.history), begin(section.history) + section.sampleCount);
+    std::sort(begin(samples), end(samples));
+    const auto percentile = [&](double p)
+    {
+        return double(samples[std::min(size_t(p * samples.size()), samples.size() - 1)]);
+    };
+
+    stats.averageMs = std::accumulate(begin(samples), end(samples), 0.) / samples.size();
+    stats.minMs = samples.front();
+    stats.maxMs = samples.back();
+    stats.p50Ms = percentile(0.50);
+    stats.p95Ms = percentile(0.95);
+    stats.p99Ms = percentile(0.99);
+    return stats;
+}
+
+std::vector<GPUProfiler::SectionStats> GPUProfiler::getStats() const
+{
+    std::vector<SectionStats> stats;
+    for (const auto index : depthFirstOrder()) {
+        stats.emplace_back(computeStats(index));
+    }
+    return stats;
+}
+
+void GPUProfiler::clearHistory()
+{
+    for (auto & section : m_Sections)
+    {
+        section.historyHead = 0;
+        section.sampleCount = 0;
+    }
+}
+
+void GPUProfiler::writeCSV(const fs::path& path) const
+{
+    std::ofstream out(path.string());
+    if (!out)
+    {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        throw std::runtime_error("Unable to open " + path.string() + " for writing");
+    }
+
+    out << "section,depth,samples,last_ms,average_ms,min_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    for (const auto & section : getStats())
+    {
+        out << '"' << section.path << "\"," << section.depth << ',' << section.sampleCount << ',' << section.lastMs << ',' << section.averageMs << ','
+            << section.minMs << ',' << section.p50Ms << ',' << section.p95Ms << ',' << section.p99Ms << ',' << section.maxMs << '\n';
+    }
+}
+
+void GPUProfiler::writeJSON(const fs::path& path) const
+{
+    std::ofstream out(path.string());
+    if (!out)
+    {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        throw std::runtime_error("Unable to open " + path.string() + " for writing");
+    }
+
+    nlohmann::json json;
+    json["resolvedFrameCount"] = m_nResolvedFrameCount;
+    json["droppedFrameCount"] = m_nDroppedFrameCount;
+
+    auto & sections = json["sections"];
+    sections = nlohmann::json::array();
+    for (const auto index : depthFirstOrder())
+    {
+        const auto stats = computeStats(index);
+
+        nlohmann::json section;
+        section["name"] = stats.name;
+        section["path"] = stats.path;
+        section["depth"] = stats.depth;
+        section["samples"] = stats.sampleCount;
+        section["lastMs"] = stats.lastMs;
+        section["averageMs"] = stats.averageMs;
+        section["minMs"] = stats.minMs;
+        section["p50Ms"] = stats.p50Ms;
+        section["p95Ms"] = stats.p95Ms;
+        section["p99Ms"] = stats.p99Ms;
+        section["maxMs"] = stats.maxMs;
+
+        // Raw samples, oldest first
+        const auto & history = m_Sections[index].history;
+        const auto first = (m_Sections[index].historyHead + m_nHistorySize - stats.sampleCount) % m_nHistorySize;
+        auto & historyMs = section["historyMs"];
+        historyMs = nlohmann::json::array();
+        for (size_t i = 0; i < stats.sampleCount; ++i) {
+            historyMs.push_back(history[(first + i) % m_nHistorySize]);
+        }
+
+        sections.push_back(section);
+    }
+
+    out << json.dump(2) << std::endl;
+}
+
+void GPUProfiler::drawGUI() const
+{
+    ImGui::Text("%zu frames measured, %zu dropped (results not ready in %zu frames)", m_nResolvedFrameCount - m_nDroppedFrameCount, m_nDroppedFrameCount, m_Frames.size());
+
+    ImGui::Columns(6, "GPUProfilerSections");
+    ImGui::Separator();
+    for (const auto header : { "Section", "last (ms)", "avg (ms)", "p50 (ms)", "p95 (ms)", "p99 (ms)" })
+    {
+        ImGui::Text("%s", header);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    for (const auto & section : getStats())
+    {
+        ImGui::Text("%*s%s", int(2 * section.depth), "", section.name.c_str());
+        ImGui::NextColumn();
+        for (const auto value : { section.lastMs, section.averageMs, section.p50Ms, section.p95Ms, section.p99Ms })
+        {
+            ImGui::Text("%.3f", value);
+            ImGui::NextColumn();
+        }
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+}
+
+}
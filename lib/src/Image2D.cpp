@@ -0,0 +1,542 @@
+#include <glmlv/Image2D.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+#include <queue>
+#include <cstring>
+
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <stb_image.h>
+
+namespace glmlv
+{
+
+size_t getComponentCount(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+        return 1;
+    case ImageFormat::RG8:
+        return 2;
+    case ImageFormat::RGB8:
+        return 3;
+    case ImageFormat::RGBA8:
+    case ImageFormat::RGBA16F:
+    case ImageFormat::RGBA32F:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+size_t getBytesPerPixel(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::RGBA16F:
+        return 4 * sizeof(half);
+    case ImageFormat::RGBA32F:
+        return 4 * sizeof(float);
+    default:
+        return getComponentCount(format);
+    }
+}
+
+const char * getImageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+        return "R8";
+    case ImageFormat::RG8:
+        return "RG8";
+    case ImageFormat::RGB8:
+        return "RGB8";
+    case ImageFormat::RGBA8:
+        return "RGBA8";
+    case ImageFormat::RGBA16F:
+        return "RGBA16F";
+    case ImageFormat::RGBA32F:
+        return "RGBA32F";
+    default:
+        return "Undefined";
+    }
+}
+
+GLImageFormat getGLImageFormat(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+        return { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_RED, GL_RED, GL_RED, GL_ONE } };
+    case ImageFormat::RG8:
+        return { GL_RG8, GL_RG, GL_UNSIGNED_BYTE, { GL_RED, GL_RED, GL_RED, GL_GREEN } };
+    case ImageFormat::RGB8:
+        return { GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, { GL_RED, GL_GREEN, GL_BLUE, GL_ONE } };
+    case ImageFormat::RGBA8:
+        return { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } };
+    case ImageFormat::RGBA16F:
+        return { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } };
+    case ImageFormat::RGBA32F:
+        return { GL_RGBA32F, GL_RGBA, GL_FLOAT, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } };
+    default:
+        std::cerr << "Undefined image format" << std::endl;
+        throw std::runtime_error("Undefined image format");
+    }
+}
+
+void * allocateImageData(size_t byteSize)
+{
+    return std::malloc(byteSize); // stb_image default allocator, released with stbi_image_free
+}
+
+void freeImageData(void * ptr)
+{
+    stbi_image_free(ptr);
+}
+
+void AnyImage2D::flipY()
+{
+    const auto lineSize = m_nWidth * bytesPerPixel();
+    unsigned char * pFirstLine = m_pData.get();
+    unsigned char * pLastLine = m_pData.get() + (m_nHeight - 1) * lineSize;
+
+    while (pFirstLine < pLastLine)
+    {
+        std::swap_ranges(pFirstLine, pFirstLine + lineSize, pLastLine);
+        pFirstLine += lineSize;
+        pLastLine -= lineSize;
+    }
+}
+
+static void onReadFailure(const fs::path& path)
+{
+    std::cerr << "Unable to load image " << path << ": " << stbi_failure_reason() << std::endl;
+    throw std::runtime_error(stbi_failure_reason());
+}
+
+template<size_t ComponentCount>
+static Image2D<uint8_t, ComponentCount> readImage8(const fs::path& path)
+{
+    int w, h, n;
+    const auto pData = stbi_load(path.string().c_str(), &w, &h, &n, ComponentCount);
+    if (!pData) {
+        onReadFailure(path);
+    }
+    return Image2D<uint8_t, ComponentCount>(w, h, pData);
+}
+
+static Image2DRGBA32F readImage32F(const fs::path& path)
+{
+    int w, h, n;
+    const auto pData = stbi_loadf(path.string().c_str(), &w, &h, &n, 4);
+    if (!pData) {
+        onReadFailure(path);
+    }
+    return Image2DRGBA32F(w, h, pData);
+}
+
+template<>
+Image2DR8 readImage<Image2DR8>(const fs::path& path)
+{
+    return readImage8<1>(path);
+}
+
+template<>
+Image2DRG8 readImage<Image2DRG8>(const fs::path& path)
+{
+    return readImage8<2>(path);
+}
+
+template<>
+Image2DRGB8 readImage<Image2DRGB8>(const fs::path& path)
+{
+    return readImage8<3>(path);
+}
+
+template<>
+Image2DRGBA8 readImage<Image2DRGBA8>(const fs::path& path)
+{
+    return readImage8<4>(path);
+}
+
+template<>
+Image2DRGBA32F readImage<Image2DRGBA32F>(const fs::path& path)
+{
+    return readImage32F(path);
+}
+
+template<>
+Image2DRGBA16F readImage<Image2DRGBA16F>(const fs::path& path)
+{
+    const auto source = readImage32F(path);
+
+    Image2DRGBA16F image(source.width(), source.height());
+    const auto componentCount = source.size() * source.NumComponents;
+    for (size_t i = 0; i < componentCount; ++i) {
+        image.data()[i].bits = glm::packHalf1x16(source.data()[i]);
+    }
+    return image;
+}
+
+// Return true if all pixels of an 8 bits image have equal color channels
+template<size_t ComponentCount>
+static bool isGrayscale(const Image2D<uint8_t, ComponentCount>& image)
+{
+    const uint8_t * pPixel = image.data();
+    for (size_t i = 0, count = image.size(); i < count; ++i, pPixel += ComponentCount)
+    {
+        if (pPixel[0] != pPixel[1] || pPixel[0] != pPixel[2]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isOpaque(const Image2DRGBA8& image)
+{
+    const uint8_t * pPixel = image.data();
+    for (size_t i = 0, count = image.size(); i < count; ++i, pPixel += 4)
+    {
+        if (pPixel[3] != 255) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keep the first channel (and the alpha channel if OutComponentCount == 2) of an 8 bits image
+template<size_t OutComponentCount, size_t InComponentCount>
+static Image2D<uint8_t, OutComponentCount> extractGrayscale(const Image2D<uint8_t, InComponentCount>& image)
+{
+    Image2D<uint8_t, OutComponentCount> result(image.width(), image.height());
+    const uint8_t * pIn = image.data();
+    uint8_t * pOut = result.data();
+    for (size_t i = 0, count = image.size(); i < count; ++i, pIn += InComponentCount, pOut += OutComponentCount)
+    {
+        pOut[0] = pIn[0];
+        if (OutComponentCount == 2) {
+            pOut[1] = pIn[InComponentCount - 1];
+        }
+    }
+    return result;
+}
+
+AnyImage2D readAnyImage(const fs::path& path, bool collapseGrayscale)
+{
+    GLMLV_PROFILE_FUNCTION();
+    const auto pathString = path.string();
+
+    int w, h, n;
+    if (!stbi_info(pathString.c_str(), &w, &h, &n)) {
+        onReadFailure(path);
+    }
+
+    if (stbi_is_hdr(pathString.c_str())) {
+        return readImage<Image2DRGBA16F>(path);
+    }
+
+    switch (n)
+    {
+    case 1:
+        return readImage<Image2DR8>(path);
+    case 2:
+        return readImage<Image2DRG8>(path);
+    case 3:
+    {
+        auto image = readImage<Image2DRGB8>(path);
+        if (collapseGrayscale && isGrayscale(image)) {
+            return extractGrayscale<1>(image);
+        }
+        return image;
+    }
+    default:
+    {
+        auto image = readImage<Image2DRGBA8>(path);
+        if (collapseGrayscale && isGrayscale(image)) {
+            if (isOpaque(image)) {
+                return extractGrayscale<1>(image);
+            }
+            return extractGrayscale<2>(image);
+        }
+        return image;
+    }
+    }
+}
+
+bool readImageInfo(const fs::path& path, ImageInfo& info)
+{
+    const auto pathString = path.string();
+
+    int w, h, n;
+    if (!stbi_info(pathString.c_str(), &w, &h, &n)) {
+        return false;
+    }
+
+    static const ImageFormat ldrFormats[] = { ImageFormat::R8, ImageFormat::RG8, ImageFormat::RGB8, ImageFormat::RGBA8 };
+    info.width = w;
+    info.height = h;
+    info.format = stbi_is_hdr(pathString.c_str()) ? ImageFormat::RGBA16F : ldrFormats[glm::clamp(n, 1, 4) - 1];
+    return true;
+}
+
+TextureLoadOptions parseTextureLoadOptions(int argc, const char * const * argv)
+{
+    TextureLoadOptions options;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--max-texture-size")) {
+            options.maxDimension = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--texture-budget")) {
+            options.memoryBudget = size_t(std::strtod(argv[++i], nullptr) * 1024 * 1024);
+        }
+    }
+    return options;
+}
+
+std::vector<ImageInfo> computeBudgetedImageSizes(const std::vector<ImageInfo>& images, const TextureLoadOptions& options)
+{
+    auto sizes = images;
+
+    if (options.maxDimension > 0)
+    {
+        for (auto & size : sizes)
+        {
+            const auto maxSize = std::max(size.width, size.height);
+            if (maxSize > options.maxDimension)
+            {
+                size.width = std::max(size_t(1), (size.width * options.maxDimension + maxSize / 2) / maxSize);
+                size.height = std::max(size_t(1), (size.height * options.maxDimension + maxSize / 2) / maxSize);
+            }
+        }
+    }
+
+    if (options.memoryBudget > 0)
+    {
+        size_t totalByteSize = 0;
+        std::priority_queue<std::pair<size_t, size_t>> biggestImages; // (byte size, index)
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            totalByteSize += sizes[i].byteSize();
+            biggestImages.emplace(sizes[i].byteSize(), i);
+        }
+
+        // Halve the biggest image until everything fits, so that small textures keep their resolution as long as possible
+        while (totalByteSize > options.memoryBudget && !biggestImages.empty())
+        {
+            auto & size = sizes[biggestImages.top().second];
+            biggestImages.pop();
+            if (size.width <= 1 && size.height <= 1) {
+                continue;
+            }
+
+            const auto byteSize = size.byteSize();
+            size.width = std::max(size_t(1), size.width / 2);
+            size.height = std::max(size_t(1), size.height / 2);
+            totalByteSize -= byteSize - size.byteSize();
+            biggestImages.emplace(size.byteSize(), &size - sizes.data());
+        }
+    }
+
+    return sizes;
+}
+
+namespace
+{
+
+struct ResampleTap
+{
+    size_t index;
+    float weight;
+};
+
+// Source texels covered by each destination texel along one axis, with their normalized coverage
+std::vector<std::vector<ResampleTap>> computeResampleTaps(size_t srcSize, size_t dstSize)
+{
+    std::vector<std::vector<ResampleTap>> taps(dstSize);
+    const double scale = double(srcSize) / dstSize;
+    for (size_t d = 0; d < dstSize; ++d)
+    {
+        if (scale <= 1.)
+        {
+            taps[d].push_back({ std::min(srcSize - 1, size_t((d + 0.5) * scale)), 1.f });
+            continue;
+        }
+
+        const double begin = d * scale, end = (d + 1) * scale;
+        for (auto s = size_t(begin); s < srcSize && double(s) < end; ++s)
+        {
+            const auto coverage = std::min(end, double(s + 1)) - std::max(begin, double(s));
+            if (coverage > 0.) {
+                taps[d].push_back({ s, float(coverage / scale) });
+            }
+        }
+    }
+    return taps;
+}
+
+inline float componentToFloat(uint8_t value) { return value; }
+inline float componentToFloat(half value) { return glm::unpackHalf1x16(value.bits); }
+inline float componentToFloat(float value) { return value; }
+
+template<typename ComponentType> ComponentType floatToComponent(float value);
+template<> inline uint8_t floatToComponent<uint8_t>(float value) { return uint8_t(glm::clamp(value + 0.5f, 0.f, 255.f)); }
+template<> inline half floatToComponent<half>(float value) { return half{ glm::packHalf1x16(value) }; }
+template<> inline float floatToComponent<float>(float value) { return value; }
+
+// Box filter, separable: each destination row accumulates the source rows it covers, then is filtered horizontally
+template<typename ComponentType>
+void resample(const ComponentType * pSrc, size_t srcWidth, size_t srcHeight, size_t componentCount, ComponentType * pDst, size_t dstWidth, size_t dstHeight)
+{
+    const auto xTaps = computeResampleTaps(srcWidth, dstWidth);
+    const auto yTaps = computeResampleTaps(srcHeight, dstHeight);
+
+    const auto srcRowSize = srcWidth * componentCount;
+    std::vector<float> row(srcRowSize);
+    for (size_t y = 0; y < dstHeight; ++y)
+    {
+        std::fill(begin(row), end(row), 0.f);
+        for (const auto & yTap : yTaps[y])
+        {
+            const auto pSrcRow = pSrc + yTap.index * srcRowSize;
+            for (size_t i = 0; i < srcRowSize; ++i) {
+                row[i] += yTap.weight * componentToFloat(pSrcRow[i]);
+            }
+        }
+
+        auto pDstRow = pDst + y * dstWidth * componentCount;
+        for (size_t x = 0; x < dstWidth; ++x)
+        {
+            for (size_t c = 0; c < componentCount; ++c)
+            {
+                float value = 0.f;
+                for (const auto & xTap : xTaps[x]) {
+                    value += xTap.weight * row[xTap.index * componentCount + c];
+                }
+                pDstRow[x * componentCount + c] = floatToComponent<ComponentType>(value);
+            }
+        }
+    }
+}
+
+template<typename ImageType>
+AnyImage2D resampleAnyImage(const AnyImage2D& image, size_t width, size_t height)
+{
+    using Component = typename ImageType::Component;
+
+    ImageType result(width, height);
+    resample((const Component *) image.data(), image.width(), image.height(), ImageType::NumComponents, result.data(), width, height);
+    return result;
+}
+
+}
+
+AnyImage2D downsampleImage(const AnyImage2D& image, size_t width, size_t height)
+{
+    GLMLV_PROFILE_FUNCTION();
+    switch (image.format())
+    {
+    case ImageFormat::R8:
+        return resampleAnyImage<Image2DR8>(image, width, height);
+    case ImageFormat::RG8:
+        return resampleAnyImage<Image2DRG8>(image, width, height);
+    case ImageFormat::RGB8:
+        return resampleAnyImage<Image2DRGB8>(image, width, height);
+    case ImageFormat::RGBA8:
+        return resampleAnyImage<Image2DRGBA8>(image, width, height);
+    case ImageFormat::RGBA16F:
+        return resampleAnyImage<Image2DRGBA16F>(image, width, height);
+    case ImageFormat::RGBA32F:
+        return resampleAnyImage<Image2DRGBA32F>(image, width, height);
+    default:
+        return AnyImage2D();
+    }
+}
+
+void downsampleImage(const uint8_t * pSrc, size_t srcWidth, size_t srcHeight, size_t componentCount, uint8_t * pDst, size_t dstWidth, size_t dstHeight)
+{
+    resample(pSrc, srcWidth, srcHeight, componentCount, pDst, dstWidth, dstHeight);
+}
+
+static unsigned char floatToUnorm8(float value)
+{
+    // Same tone mapping as stb_image HDR to LDR conversion
+    const auto ldr = std::pow(glm::clamp(value, 0.f, 1.f), 1.f / 2.2f);
+    return (unsigned char) (ldr * 255.f + 0.5f);
+}
+
+Image2DRGBA toImage2DRGBA(ImageFormat format, size_t width, size_t height, const void * pData)
+{
+    Image2DRGBA result(width, height);
+    unsigned char * pOut = result.data();
+    const auto count = result.size();
+
+    switch (format)
+    {
+    case ImageFormat::R8:
+    case ImageFormat::RG8:
+    {
+        const auto componentCount = getComponentCount(format);
+        const auto pIn = (const uint8_t *) pData;
+        for (size_t i = 0; i < count; ++i, pOut += 4)
+        {
+            const auto pPixel = pIn + i * componentCount;
+            pOut[0] = pOut[1] = pOut[2] = pPixel[0];
+            pOut[3] = componentCount == 2 ? pPixel[1] : 255;
+        }
+        break;
+    }
+    case ImageFormat::RGB8:
+    {
+        const auto pIn = (const uint8_t *) pData;
+        for (size_t i = 0; i < count; ++i, pOut += 4)
+        {
+            std::copy(pIn + 3 * i, pIn + 3 * i + 3, pOut);
+            pOut[3] = 255;
+        }
+        break;
+    }
+    case ImageFormat::RGBA8:
+        std::copy((const uint8_t *) pData, (const uint8_t *) pData + 4 * count, pOut);
+        break;
+    case ImageFormat::RGBA16F:
+    {
+        const auto pIn = (const half *) pData;
+        for (size_t i = 0; i < 4 * count; i += 4)
+        {
+            for (size_t c = 0; c < 3; ++c) {
+                pOut[i + c] = floatToUnorm8(glm::unpackHalf1x16(pIn[i + c].bits));
+            }
+            pOut[i + 3] = (unsigned char) (glm::clamp(glm::unpackHalf1x16(pIn[i + 3].bits), 0.f, 1.f) * 255.f + 0.5f);
+        }
+        break;
+    }
+    case ImageFormat::RGBA32F:
+    {
+        const auto pIn = (const float *) pData;
+        for (size_t i = 0; i < 4 * count; i += 4)
+        {
+            for (size_t c = 0; c < 3; ++c) {
+                pOut[i + c] = floatToUnorm8(pIn[i + c]);
+            }
+            pOut[i + 3] = (unsigned char) (glm::clamp(pIn[i + 3], 0.f, 1.f) * 255.f + 0.5f);
+        }
+        break;
+    }
+    default:
+        std::cerr << "Undefined image format" << std::endl;
+        throw std::runtime_error("Undefined image format");
+    }
+
+    return result;
+}
+
+}
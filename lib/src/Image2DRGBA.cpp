@@ -19,7 +19,8 @@ void Image2DRGBA::Deleter::operator ()(unsigned char * ptr) const
 }
 
 Image2DRGBA::Image2DRGBA(size_t width, size_t height):
-    m_pData((unsigned char*) STBI_MALLOC(width * height * NumComponents * sizeof(unsigned char)))
+    m_pData((unsigned char*) STBI_MALLOC(width * height * NumComponents * sizeof(unsigned char))),
+    m_nWidth(width), m_nHeight(height)
 {
 }
 
@@ -69,6 +70,11 @@ Image2DRGBA readImage(const fs::path& path)
 }
 
 void writeImage(const Image2DRGBA& image, const fs::path& path)
+{
+    writeImage(image, path, ImageWriteOptions());
+}
+
+void writeImage(const Image2DRGBA& image, const fs::path& path, const ImageWriteOptions& options)
 {
     const auto onFailure = []()
     {
@@ -77,21 +83,25 @@ void writeImage(const Image2DRGBA& image, const fs::path& path)
     };
 
     const auto ext = path.extension();
-    if (ext == ".png")
+    if (ext == ".png" && options.parallelPNG)
+    {
+        writePNGParallel(path, image.width(), image.height(), Image2DRGBA::NumComponents, image.data(), options.png);
+    }
+    else if (ext == ".png")
     {
-        if (stbi_write_png(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data(), 0)) {
+        if (!stbi_write_png(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data(), 0)) {
             onFailure();
         }
     }
     if (ext == ".bmp")
     {
-        if (stbi_write_bmp(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data())) {
+        if (!stbi_write_bmp(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data())) {
             onFailure();
         }
     }
     if (ext == ".tga")
     {
-        if (stbi_write_tga(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data())) {
+        if (!stbi_write_tga(path.string().c_str(), image.width(), image.height(), Image2DRGBA::NumComponents, image.data())) {
             onFailure();
         }
     }
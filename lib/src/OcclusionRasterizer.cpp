@@ -0,0 +1,369 @@
+#include <glmlv/OcclusionRasterizer.hpp>
+#include <glmlv/ThreadPool.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GLMLV_RASTERIZER_SSE 1
+#endif
+
+namespace glmlv
+{
+
+// Boxes per task of the thread pool in cullOccluded(). Below two chunks the calling thread tests everything alone.
+static const size_t OcclusionChunkSize = 1024;
+
+OcclusionRasterizer::OcclusionRasterizer(size_t width, size_t height):
+    m_nWidth(std::max(width, size_t(1))),
+    m_nHeight(std::max(height, size_t(1))),
+    m_nRowPitch((m_nWidth + TileWidth - 1) / TileWidth * TileWidth),
+    m_nTileCountX(m_nRowPitch / TileWidth),
+    m_nTileCountY((m_nHeight + TileHeight - 1) / TileHeight),
+    m_TileBins(m_nTileCountX * m_nTileCountY),
+    m_Depth(m_nRowPitch * m_nTileCountY * TileHeight, 1.f),
+    m_TileMaxDepth(m_nTileCountX * m_nTileCountY, 1.f)
+{
+}
+
+void OcclusionRasterizer::addOccluder(const std::vector<Vertex3f3f2f> & vertices, const uint32_t * indices, size_t indexCount, const glm::mat4 & localToWorldMatrix)
+{
+    m_OccluderVertices.reserve(m_OccluderVertices.size() + indexCount / 3 * 3);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        for (size_t corner = 0; corner < 3; ++corner) {
+            m_OccluderVertices.emplace_back(glm::vec3(localToWorldMatrix * glm::vec4(vertices[indices[i + corner]].position, 1)));
+        }
+    }
+}
+
+void OcclusionRasterizer::clearOccluders()
+{
+    m_OccluderVertices.clear();
+}
+
+void OcclusionRasterizer::setupTriangle(const glm::vec4 & clip0, const glm::vec4 & clip1, const glm::vec4 & clip2)
+{
+    // Window coordinates: pixel (x, y) has its center at (x + 0.5, y + 0.5), depth in [0, 1]
+    const auto toWindow = [&](const glm::vec4 & clip)
+    {
+        const auto ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((0.5f * ndc.x + 0.5f) * m_nWidth, (0.5f * ndc.y + 0.5f) * m_nHeight, 0.5f * ndc.z + 0.5f);
+    };
+    const glm::vec3 v[3] = { toWindow(clip0), toWindow(clip1), toWindow(clip2) };
+
+    // Twice the signed area, positive for counter-clockwise (front facing) triangles
+    const auto area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (!(area > 0.f)) {
+        return;
+    }
+
+    const auto minX = std::max(std::ceil(std::min({ v[0].x, v[1].x, v[2].x }) - 0.5f), 0.f);
+    const auto minY = std::max(std::ceil(std::min({ v[0].y, v[1].y, v[2].y }) - 0.5f), 0.f);
+    const auto maxX = std::min(std::floor(std::max({ v[0].x, v[1].x, v[2].x }) - 0.5f), float(m_nWidth - 1));
+    const auto maxY = std::min(std::floor(std::max({ v[0].y, v[1].y, v[2].y }) - 0.5f), float(m_nHeight - 1));
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+
+    Triangle triangle;
+    triangle.minX = int32_t(minX);
+    triangle.minY = int32_t(minY);
+    triangle.maxX = int32_t(maxX);
+    triangle.maxY = int32_t(maxY);
+
+    // Edge i goes from v[i] to v[i + 1], it is positive on the inner side. Divided by the area, it is the barycentric weight of the opposite vertex.
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const auto & a = v[i];
+        const auto & b = v[(i + 1) % 3];
+        triangle.edgeA[i] = a.y - b.y;
+        triangle.edgeB[i] = b.x - a.x;
+        triangle.edgeC[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+    }
+
+    // Window depth is affine in window space
+    const auto rcpArea = 1.f / area;
+    triangle.depthA = (triangle.edgeA[1] * v[0].z + triangle.edgeA[2] * v[1].z + triangle.edgeA[0] * v[2].z) * rcpArea;
+    triangle.depthB = (triangle.edgeB[1] * v[0].z + triangle.edgeB[2] * v[1].z + triangle.edgeB[0] * v[2].z) * rcpArea;
+    triangle.depthC = (triangle.edgeC[1] * v[0].z + triangle.edgeC[2] * v[1].z + triangle.edgeC[0] * v[2].z) * rcpArea;
+
+    const auto index = uint32_t(m_Triangles.size());
+    m_Triangles.emplace_back(triangle);
+    for (auto tileY = size_t(triangle.minY) / TileHeight; tileY <= size_t(triangle.maxY) / TileHeight; ++tileY)
+    {
+        for (auto tileX = size_t(triangle.minX) / TileWidth; tileX <= size_t(triangle.maxX) / TileWidth; ++tileX)
+        {
+            m_TileBins[tileY * m_nTileCountX + tileX].emplace_back(index);
+            ++m_RenderStats.binnedTriangleCount;
+        }
+    }
+}
+
+void OcclusionRasterizer::rasterizeTile(size_t tile)
+{
+    const auto tileX = int32_t(tile % m_nTileCountX * TileWidth);
+    const auto tileY = int32_t(tile / m_nTileCountX * TileHeight);
+
+    for (auto y = tileY; y < tileY + int32_t(TileHeight); ++y) {
+        std::fill_n(m_Depth.data() + y * m_nRowPitch + tileX, TileWidth, 1.f);
+    }
+
+    for (const auto index : m_TileBins[tile])
+    {
+        const auto & triangle = m_Triangles[index];
+
+        // Groups of 4 pixels start on a multiple of 4, like the tiles
+        const auto beginX = std::max(triangle.minX, tileX) & ~3;
+        const auto endX = std::min(triangle.maxX + 1, tileX + int32_t(TileWidth));
+        const auto beginY = std::max(triangle.minY, tileY);
+        const auto endY = std::min(triangle.maxY + 1, tileY + int32_t(TileHeight));
+
+        for (auto y = beginY; y < endY; ++y)
+        {
+            const auto centerY = y + 0.5f;
+            float rowEdges[3];
+            for (size_t i = 0; i < 3; ++i) {
+                rowEdges[i] = triangle.edgeB[i] * centerY + triangle.edgeC[i];
+            }
+            const auto rowDepth = triangle.depthB * centerY + triangle.depthC;
+            auto pRow = m_Depth.data() + y * m_nRowPitch;
+
+#ifdef GLMLV_RASTERIZER_SSE
+            const auto zero = _mm_setzero_ps();
+            const auto four = _mm_set1_ps(4.f);
+            const __m128 edgeA[3] = { _mm_set1_ps(triangle.edgeA[0]), _mm_set1_ps(triangle.edgeA[1]), _mm_set1_ps(triangle.edgeA[2]) };
+            const __m128 edgeRow[3] = { _mm_set1_ps(rowEdges[0]), _mm_set1_ps(rowEdges[1]), _mm_set1_ps(rowEdges[2]) };
+            const auto depthA = _mm_set1_ps(triangle.depthA);
+            const auto depthRow = _mm_set1_ps(rowDepth);
+
+            auto centerX = _mm_add_ps(_mm_set1_ps(float(beginX)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+            for (auto x = beginX; x < endX; x += 4)
+            {
+                const auto e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]);
+                const auto e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]);
+                const auto e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]);
+                const auto inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(inside))
+                {
+                    const auto depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow);
+                    const auto current = _mm_loadu_ps(pRow + x);
+                    const auto nearest = _mm_min_ps(current, depth);
+                    _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+                centerX = _mm_add_ps(centerX, four);
+            }
+#else
+            for (auto x = beginX; x < endX; ++x)
+            {
+                const auto centerX = x + 0.5f;
+                if (triangle.edgeA[0] * centerX + rowEdges[0] >= 0.f && triangle.edgeA[1] * centerX + rowEdges[1] >= 0.f
+                    && triangle.edgeA[2] * centerX + rowEdges[2] >= 0.f) {
+                    pRow[x] = std::min(pRow[x], triangle.depthA * centerX + rowDepth);
+                }
+            }
+#endif
+        }
+    }
+
+    // Only the pixels of the screen count, not the padding of the last tiles
+    auto maxDepth = 0.f;
+    const auto endX = std::min(tileX + int32_t(TileWidth), int32_t(m_nWidth));
+    const auto endY = std::min(tileY + int32_t(TileHeight), int32_t(m_nHeight));
+    for (auto y = tileY; y < endY; ++y)
+    {
+        const auto pRow = m_Depth.data() + y * m_nRowPitch;
+        maxDepth = std::max(maxDepth, *std::max_element(pRow + tileX, pRow + endX));
+    }
+    m_TileMaxDepth[tile] = maxDepth;
+}
+
+void OcclusionRasterizer::render(const glm::mat4 & viewProjMatrix, ThreadPool * pThreadPool)
+{
+    GLMLV_PROFILE_FUNCTION();
+
+    m_ViewProjMatrix = viewProjMatrix;
+    m_RenderStats = RenderStats();
+    m_RenderStats.occluderTriangleCount = occluderTriangleCount();
+    m_Triangles.clear();
+    for (auto & bin : m_TileBins) {
+        bin.clear();
+    }
+
+    {
+        GLMLV_PROFILE_SCOPE("Occluder setup");
+
+        m_ClipVertices.resize(m_OccluderVertices.size());
+        for (size_t i = 0; i < m_OccluderVertices.size(); ++i) {
+            m_ClipVertices[i] = viewProjMatrix * glm::vec4(m_OccluderVertices[i], 1);
+        }
+
+        for (size_t i = 0; i < m_ClipVertices.size(); i += 3)
+        {
+            const glm::vec4 clip[3] = { m_ClipVertices[i], m_ClipVertices[i + 1], m_ClipVertices[i + 2] };
+
+            // Entirely out of one of the side planes or of the far plane (the near plane is clipped below)
+            bool outside = clip[0].z > clip[0].w && clip[1].z > clip[1].w && clip[2].z > clip[2].w;
+            for (auto axis = 0; axis < 2 && !outside; ++axis)
+            {
+                outside = (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+                    || (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w);
+            }
+            if (outside) {
+                continue;
+            }
+
+            // Clip against the near plane (z >= -w), which leaves a polygon of at most 4 vertices
+            glm::vec4 polygon[4];
+            size_t vertexCount = 0;
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const auto & a = clip[corner];
+                const auto & b = clip[(corner + 1) % 3];
+                const auto distanceA = a.z + a.w;
+                const auto distanceB = b.z + b.w;
+                if (distanceA >= 0.f) {
+                    polygon[vertexCount++] = a;
+                }
+                if ((distanceA >= 0.f) != (distanceB >= 0.f)) {
+                    polygon[vertexCount++] = a + (b - a) * (distanceA / (distanceA - distanceB));
+                }
+            }
+            for (size_t corner = 2; corner < vertexCount; ++corner) {
+                setupTriangle(polygon[0], polygon[corner - 1], polygon[corner]);
+            }
+        }
+        m_RenderStats.rasterizedTriangleCount = m_Triangles.size();
+    }
+
+    {
+        GLMLV_PROFILE_SCOPE("Occluder tiles");
+
+        auto & threadPool = pThreadPool ? *pThreadPool : ThreadPool::getDefault();
+        threadPool.parallelFor(m_TileBins.size(), [&](size_t tile)
+        {
+            rasterizeTile(tile);
+        });
+    }
+}
+
+bool OcclusionRasterizer::isVisible(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax) const
+{
+    auto windowMin = glm::vec2(std::numeric_limits<float>::max());
+    auto windowMax = glm::vec2(std::numeric_limits<float>::lowest());
+    auto nearestDepth = 1.f;
+    for (auto corner = 0; corner < 8; ++corner)
+    {
+        const auto position = glm::vec3(corner & 1 ? bboxMax.x : bboxMin.x, corner & 2 ? bboxMax.y : bboxMin.y, corner & 4 ? bboxMax.z : bboxMin.z);
+        const auto clip = m_ViewProjMatrix * glm::vec4(position, 1);
+        if (clip.w <= 0.f || clip.z < -clip.w) {
+            return true;
+        }
+        const auto ndc = glm::vec3(clip) / clip.w;
+        const auto window = glm::vec2((0.5f * ndc.x + 0.5f) * m_nWidth, (0.5f * ndc.y + 0.5f) * m_nHeight);
+        windowMin = glm::min(windowMin, window);
+        windowMax = glm::max(windowMax, window);
+        nearestDepth = std::min(nearestDepth, 0.5f * ndc.z + 0.5f);
+    }
+    if (windowMax.x < 0.f || windowMax.y < 0.f || windowMin.x >= m_nWidth || windowMin.y >= m_nHeight) {
+        return true;
+    }
+
+    // Every pixel touched by the projected box
+    const auto minX = int32_t(std::max(std::floor(windowMin.x), 0.f));
+    const auto minY = int32_t(std::max(std::floor(windowMin.y), 0.f));
+    const auto maxX = int32_t(std::min(std::floor(windowMax.x), float(m_nWidth - 1)));
+    const auto maxY = int32_t(std::min(std::floor(windowMax.y), float(m_nHeight - 1)));
+
+    for (auto tileY = size_t(minY) / TileHeight; tileY <= size_t(maxY) / TileHeight; ++tileY)
+    {
+        for (auto tileX = size_t(minX) / TileWidth; tileX <= size_t(maxX) / TileWidth; ++tileX)
+        {
+            // Behind the farthest depth of the tile: hidden in the whole tile
+            if (nearestDepth > m_TileMaxDepth[tileY * m_nTileCountX + tileX]) {
+                continue;
+            }
+
+            const auto beginX = std::max(minX, int32_t(tileX * TileWidth));
+            const auto endX = std::min(maxX + 1, int32_t((tileX + 1) * TileWidth));
+            const auto beginY = std::max(minY, int32_t(tileY * TileHeight));
+            const auto endY = std::min(maxY + 1, int32_t((tileY + 1) * TileHeight));
+            for (auto y = beginY; y < endY; ++y)
+            {
+                const auto pRow = m_Depth.data() + y * m_nRowPitch;
+                auto x = beginX;
+#ifdef GLMLV_RASTERIZER_SSE
+                const auto boxDepth = _mm_set1_ps(nearestDepth);
+                for (; x + 4 <= endX; x += 4)
+                {
+                    if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + x), boxDepth))) {
+                        return true;
+                    }
+                }
+#endif
+                for (; x < endX; ++x)
+                {
+                    if (pRow[x] >= nearestDepth) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+CullingStats OcclusionRasterizer::cullOccluded(const CullingBounds & bounds, std::vector<uint8_t> & visibility, ThreadPool * pThreadPool) const
+{
+    GLMLV_PROFILE_FUNCTION();
+
+    // Returns the number of boxes tested and the number of them still visible
+    const auto cullRange = [&](size_t begin, size_t end)
+    {
+        CullingStats stats;
+        for (auto i = begin; i < end; ++i)
+        {
+            if (!visibility[i]) {
+                continue;
+            }
+            const auto center = glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+            const auto extent = glm::vec3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+            if (isVisible(center - extent, center + extent)) {
+                ++stats.visibleCount;
+            }
+            else {
+                visibility[i] = 0;
+                ++stats.culledCount;
+            }
+        }
+        return stats;
+    };
+
+    const auto count = bounds.size();
+    const auto chunkCount = (count + OcclusionChunkSize - 1) / OcclusionChunkSize;
+    if (chunkCount < 2) {
+        return cullRange(0, count);
+    }
+
+    // Each chunk writes its own range of visibility and its own counts
+    std::vector<CullingStats> chunkStats(chunkCount);
+    auto & threadPool = pThreadPool ? *pThreadPool : ThreadPool::getDefault();
+    threadPool.parallelFor(chunkCount, [&](size_t chunk)
+    {
+        const auto begin = chunk * OcclusionChunkSize;
+        chunkStats[chunk] = cullRange(begin, std::min(begin + OcclusionChunkSize, count));
+    });
+
+    CullingStats stats;
+    for (const auto & chunk : chunkStats)
+    {
+        stats.visibleCount += chunk.visibleCount;
+        stats.culledCount += chunk.culledCount;
+    }
+    return stats;
+}
+
+}
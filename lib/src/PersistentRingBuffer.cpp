@@ -0,0 +1,170 @@
+#include <glmlv/PersistentRingBuffer.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
+#include <imgui.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+namespace glmlv
+{
+
+PersistentRingBuffer::PersistentRingBuffer(size_t frameByteSize, size_t framesInFlight):
+    m_FrameByteSize(frameByteSize), m_Fences(std::max(framesInFlight, size_t(1)), nullptr)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_UniformAlignment = size_t(std::max(alignment, 1));
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_StorageAlignment = size_t(std::max(alignment, 1));
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const auto byteSize = GLsizeiptr(m_FrameByteSize * m_Fences.size());
+
+    glCreateBuffers(1, &m_GLId);
+    glNamedBufferStorage(m_GLId, byteSize, nullptr, flags);
+    GPUMemoryLedger::get().registerBuffer(m_GLId, size_t(byteSize), GPUMemoryLedger::Category::Uniform);
+    m_pMapped = static_cast<unsigned char*>(glMapNamedBufferRange(m_GLId, 0, byteSize, flags));
+    if (!m_pMapped)
+    {
+        std::cerr << "Unable to map persistent ring buffer of " << byteSize << " bytes" << std::endl;
+        throw std::runtime_error("Unable to map persistent ring buffer");
+    }
+
+    m_nHead = m_FrameByteSize; // No allocation before the first beginFrame()
+}
+
+PersistentRingBuffer::~PersistentRingBuffer()
+{
+    release();
+}
+
+PersistentRingBuffer::PersistentRingBuffer(PersistentRingBuffer&& rvalue):
+    m_GLId(rvalue.m_GLId), m_pMapped(rvalue.m_pMapped), m_FrameByteSize(rvalue.m_FrameByteSize), m_Fences(std::move(rvalue.m_Fences)),
+    m_nRegion(rvalue.m_nRegion), m_nHead(rvalue.m_nHead), m_UniformAlignment(rvalue.m_UniformAlignment), m_StorageAlignment(rvalue.m_StorageAlignment),
+    m_Stats(rvalue.m_Stats)
+{
+    rvalue.m_GLId = 0;
+    rvalue.m_pMapped = nullptr;
+    rvalue.m_Fences.clear();
+}
+
+PersistentRingBuffer& PersistentRingBuffer::operator =(PersistentRingBuffer&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_GLId = rvalue.m_GLId;
+        m_pMapped = rvalue.m_pMapped;
+        m_FrameByteSize = rvalue.m_FrameByteSize;
+        m_Fences = std::move(rvalue.m_Fences);
+        m_nRegion = rvalue.m_nRegion;
+        m_nHead = rvalue.m_nHead;
+        m_UniformAlignment = rvalue.m_UniformAlignment;
+        m_StorageAlignment = rvalue.m_StorageAlignment;
+        m_Stats = rvalue.m_Stats;
+
+        rvalue.m_GLId = 0;
+        rvalue.m_pMapped = nullptr;
+        rvalue.m_Fences.clear();
+    }
+    return *this;
+}
+
+void PersistentRingBuffer::release()
+{
+    for (auto fence : m_Fences) {
+        glDeleteSync(fence);
+    }
+    m_Fences.clear();
+
+    if (m_GLId)
+    {
+        glUnmapNamedBuffer(m_GLId);
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Buffer, m_GLId);
+        glDeleteBuffers(1, &m_GLId);
+        m_GLId = 0;
+    }
+    m_pMapped = nullptr;
+}
+
+void PersistentRingBuffer::beginFrame()
+{
+    // Default constructed or moved from: there is no region to hand out
+    if (m_Fences.empty()) {
+        return;
+    }
+
+    m_nRegion = m_Stats.frameCount % m_Fences.size();
+    m_nHead = 0;
+
+    auto & fence = m_Fences[m_nRegion];
+    if (!fence) {
+        return;
+    }
+
+    // Poll first: most of the time the GPU is done with the region and there is nothing to wait for
+    auto status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        ++m_Stats.stallCount;
+        const auto start = std::chrono::high_resolution_clock::now();
+        const GLuint64 timeout = 1000000000; // 1 second, in nanoseconds
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        m_Stats.stallSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    if (status == GL_WAIT_FAILED) {
+        std::cerr << "PersistentRingBuffer: glClientWaitSync failed, the region may still be in use by the GPU" << std::endl;
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void PersistentRingBuffer::endFrame()
+{
+    if (m_Fences.empty()) {
+        return;
+    }
+
+    auto & fence = m_Fences[m_nRegion];
+    glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_Stats.lastFrameByteSize = m_nHead;
+    m_Stats.peakFrameByteSize = std::max(m_Stats.peakFrameByteSize, m_nHead);
+    ++m_Stats.frameCount;
+    m_nHead = m_FrameByteSize;
+}
+
+PersistentRingBuffer::Allocation PersistentRingBuffer::allocate(size_t byteSize, size_t alignment)
+{
+    // Align the offset in the whole buffer, the regions themselves are not aligned
+    const auto regionOffset = m_nRegion * m_FrameByteSize;
+    const auto offset = (regionOffset + m_nHead + alignment - 1) / alignment * alignment;
+    if (m_nHead > m_FrameByteSize || offset + byteSize > regionOffset + m_FrameByteSize)
+    {
+        std::cerr << "PersistentRingBuffer: cannot allocate " << byteSize << " bytes, " << m_FrameByteSize << " bytes per frame (missing beginFrame() ?)" << std::endl;
+        throw std::runtime_error("PersistentRingBuffer frame capacity exceeded");
+    }
+    m_nHead = offset + byteSize - regionOffset;
+
+    Allocation allocation;
+    allocation.pData = m_pMapped + offset;
+    allocation.buffer = m_GLId;
+    allocation.offset = GLintptr(offset);
+    allocation.size = GLsizeiptr(byteSize);
+    return allocation;
+}
+
+void PersistentRingBuffer::drawGUI() const
+{
+    ImGui::Text("Frame data: %zu / %zu bytes (peak %zu), %zu frames in flight", m_Stats.lastFrameByteSize, m_FrameByteSize, m_Stats.peakFrameByteSize, m_Fences.size());
+    ImGui::Text("CPU waited for the GPU %zu times in %zu frames (%.3f ms)", m_Stats.stallCount, m_Stats.frameCount, m_Stats.stallSeconds * 1000.);
+}
+
+}
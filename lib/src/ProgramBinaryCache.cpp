@@ -0,0 +1,240 @@
+#include <glmlv/ProgramBinaryCache.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const uint32_t BinaryFileMagic = 0x42505447; // "GTPB"
+
+struct BinaryFileHeader
+{
+    uint32_t magic;
+    uint32_t binaryFormat;
+    uint64_t key; // Checked on load, in case two keys end up in the same file name
+    uint64_t binarySize;
+};
+
+std::string getGLString(GLenum name)
+{
+    const auto str = (const char *) glGetString(name);
+    return str ? str : "";
+}
+
+}
+
+ShaderSource loadShaderSourceFile(const fs::path& shaderPath)
+{
+    return { getShaderType(shaderPath), loadShaderSource(shaderPath), shaderPath.string() };
+}
+
+uint64_t hashFNV1a(const void * pData, size_t size, uint64_t hash)
+{
+    const auto pBytes = (const unsigned char *) pData;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= pBytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const fs::path& directory):
+    m_Directory(directory)
+{
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    m_bEnabled = formatCount > 0;
+    if (!m_bEnabled)
+    {
+        std::clog << "ProgramBinaryCache: the driver supports no program binary format, programs will always be compiled" << std::endl;
+        return;
+    }
+
+    if (!fs::exists(m_Directory)) {
+        fs::create_directories(m_Directory);
+    }
+
+    const auto driver = getGLString(GL_VENDOR) + '\n' + getGLString(GL_RENDERER) + '\n' + getGLString(GL_VERSION);
+    m_nDriverHash = hashFNV1a(driver.data(), driver.size());
+}
+
+GLProgram ProgramBinaryCache::compileProgram(const std::vector<fs::path>& shaderPaths)
+{
+    std::vector<ShaderSource> sources;
+    for (const auto & path : shaderPaths) {
+        sources.emplace_back(loadShaderSourceFile(path));
+    }
+    return buildProgram(sources);
+}
+
+GLProgram ProgramBinaryCache::buildProgram(const std::vector<ShaderSource>& sources)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    GLProgram program;
+    if (!load(sources, program))
+    {
+        std::vector<GLShader> shaders;
+        for (const auto & source : sources)
+        {
+            std::clog << "Compiling shader " << source.name << "\n";
+            shaders.emplace_back(source.type);
+            shaders.back().setSource(source.source);
+            if (!shaders.back().compile())
+            {
+                std::cerr << "Shader compilation error:" << shaders.back().getInfoLog() << std::endl;
+                throw std::runtime_error("Shader compilation error:" + shaders.back().getInfoLog());
+            }
+            program.attachShader(shaders.back());
+        }
+
+        prepareForStore(program);
+        if (!program.link())
+        {
+            std::cerr << "Program link error:" << program.getInfoLog() << std::endl;
+            throw std::runtime_error("Program link error:" + program.getInfoLog());
+        }
+        store(sources, program);
+    }
+
+    m_Stats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    return program;
+}
+
+bool ProgramBinaryCache::load(const std::vector<ShaderSource>& sources, GLProgram& program)
+{
+    if (!m_bEnabled) {
+        return false;
+    }
+
+    const auto key = computeKey(sources);
+    if (!fs::exists(getBinaryPath(key))) {
+        return false;
+    }
+
+    if (loadBinary(key, program))
+    {
+        program.reflect();
+        ++m_Stats.loadedCount;
+        return true;
+    }
+
+    std::clog << "ProgramBinaryCache: cached binary rejected by the driver, compiling from source" << std::endl;
+    ++m_Stats.rejectedCount;
+    program = GLProgram(); // A program whose glProgramBinary failed can still be linked, but start from a clean state
+    return false;
+}
+
+void ProgramBinaryCache::prepareForStore(const GLProgram& program) const
+{
+    if (m_bEnabled) {
+        glProgramParameteri(program.glId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+void ProgramBinaryCache::store(const std::vector<ShaderSource>& sources, const GLProgram& program)
+{
+    ++m_Stats.compiledCount;
+    if (m_bEnabled) {
+        storeBinary(computeKey(sources), program);
+    }
+}
+
+uint64_t ProgramBinaryCache::computeKey(const std::vector<ShaderSource>& sources) const
+{
+    auto hash = m_nDriverHash;
+    for (const auto & source : sources)
+    {
+        hash = hashFNV1a(&source.type, sizeof(source.type), hash);
+        hash = hashFNV1a(source.source.data(), source.source.size(), hash);
+    }
+    return hash;
+}
+
+fs::path ProgramBinaryCache::getBinaryPath(uint64_t key) const
+{
+    std::stringstream filename;
+    filename << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return m_Directory / filename.str();
+}
+
+bool ProgramBinaryCache::loadBinary(uint64_t key, GLProgram& program) const
+{
+    std::ifstream file(getBinaryPath(key).string(), std::ios::binary);
+
+    BinaryFileHeader header;
+    if (!file.read((char *) &header, sizeof(header)) || header.magic != BinaryFileMagic || header.key != key) {
+        return false;
+    }
+
+    std::vector<char> binary(header.binarySize);
+    if (!file.read(binary.data(), binary.size())) {
+        return false;
+    }
+
+    glProgramBinary(program.glId(), header.binaryFormat, binary.data(), GLsizei(binary.size()));
+    return program.getLinkStatus();
+}
+
+void ProgramBinaryCache::storeBinary(uint64_t key, const GLProgram& program) const
+{
+    GLint binarySize = 0;
+    glGetProgramiv(program.glId(), GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(binarySize);
+    GLenum binaryFormat = 0;
+    GLsizei writtenSize = 0;
+    glGetProgramBinary(program.glId(), binarySize, &writtenSize, &binaryFormat, binary.data());
+
+    const BinaryFileHeader header = { BinaryFileMagic, binaryFormat, key, uint64_t(writtenSize) };
+    std::ofstream file(getBinaryPath(key).string(), std::ios::binary);
+    if (!file.write((const char *) &header, sizeof(header)) || !file.write(binary.data(), writtenSize)) {
+        std::cerr << "ProgramBinaryCache: unable to write " << getBinaryPath(key) << std::endl;
+    }
+}
+
+void ProgramBinaryCache::logStartupTime(const std::string& label, double seconds) const
+{
+    const auto timingsPath = m_Directory / (label + ".timings");
+
+    // Previous timings: cold (every program compiled) then warm (every program loaded from the cache), negative if unknown
+    double coldSeconds = -1., warmSeconds = -1.;
+    {
+        std::ifstream file(timingsPath.string());
+        file >> coldSeconds >> warmSeconds;
+    }
+
+    std::clog << label << ": " << m_Stats.loadedCount + m_Stats.compiledCount << " programs built in " << seconds * 1000. << " ms ("
+        << m_Stats.loadedCount << " from cache, " << m_Stats.compiledCount << " compiled, " << m_Stats.rejectedCount << " rejected binaries)" << std::endl;
+    if (coldSeconds >= 0.) {
+        std::clog << "    last cold cache startup: " << coldSeconds * 1000. << " ms" << std::endl;
+    }
+    if (warmSeconds >= 0.) {
+        std::clog << "    last warm cache startup: " << warmSeconds * 1000. << " ms" << std::endl;
+    }
+
+    if (!m_bEnabled) {
+        return;
+    }
+    if (m_Stats.loadedCount == 0) {
+        coldSeconds = seconds;
+    }
+    else if (m_Stats.compiledCount == 0) {
+        warmSeconds = seconds;
+    }
+    std::ofstream file(timingsPath.string());
+    file << coldSeconds << " " << warmSeconds << std::endl;
+}
+
+}
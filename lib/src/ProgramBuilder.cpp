@@ -0,0 +1,164 @@
+#include <glmlv/ProgramBuilder.hpp>
+#include <glmlv/glfw.hpp>
+
+#include <iostream>
+#include <stdexcept>
+
+// GL_KHR_parallel_shader_compile is not part of our glad loader, GL_ARB_parallel_shader_compile uses the same values
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace glmlv
+{
+
+namespace
+{
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+// Returns true if the extension is supported, and lets the driver choose its number of compiler threads the first time
+bool initParallelCompile()
+{
+    static const bool bSupported = []()
+    {
+        PFNGLMAXSHADERCOMPILERTHREADSPROC pMaxShaderCompilerThreads = nullptr;
+        if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+            pMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        }
+        else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+            pMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+        }
+        if (!pMaxShaderCompilerThreads) {
+            return false;
+        }
+        pMaxShaderCompilerThreads(0xFFFFFFFF); // Implementation-dependent maximum
+        return true;
+    }();
+    return bSupported;
+}
+
+}
+
+ProgramBuilder::ProgramBuilder(ProgramBinaryCache * pCache):
+    m_pCache(pCache)
+{
+    initParallelCompile();
+}
+
+bool ProgramBuilder::isParallelCompileSupported()
+{
+    return initParallelCompile();
+}
+
+ProgramBuilder::Handle ProgramBuilder::add(const std::vector<fs::path>& shaderPaths)
+{
+    std::vector<ShaderSource> sources;
+    for (const auto & path : shaderPaths) {
+        sources.emplace_back(loadShaderSourceFile(path));
+    }
+    return add(std::move(sources));
+}
+
+ProgramBuilder::Handle ProgramBuilder::add(std::vector<ShaderSource> sources)
+{
+    m_Programs.emplace_back();
+    auto & pending = m_Programs.back();
+    pending.sources = std::move(sources);
+
+    if (m_pCache && m_pCache->load(pending.sources, pending.program))
+    {
+        pending.bFromCache = true;
+        pending.bLinkSubmitted = true;
+        return m_Programs.size() - 1;
+    }
+
+    for (const auto & source : pending.sources)
+    {
+        std::clog << "Compiling shader " << source.name << "\n";
+        pending.shaders.emplace_back(source.type);
+        pending.shaders.back().setSource(source.source);
+        glCompileShader(pending.shaders.back().glId()); // No status query here, that would wait for the compilation
+    }
+    return m_Programs.size() - 1;
+}
+
+void ProgramBuilder::linkAll()
+{
+    for (auto & pending : m_Programs)
+    {
+        if (pending.bLinkSubmitted) {
+            continue;
+        }
+        for (const auto & shader : pending.shaders) {
+            pending.program.attachShader(shader);
+        }
+        if (m_pCache) {
+            m_pCache->prepareForStore(pending.program);
+        }
+        glLinkProgram(pending.program.glId());
+        pending.bLinkSubmitted = true;
+    }
+}
+
+bool ProgramBuilder::isReady(Handle handle) const
+{
+    const auto & pending = m_Programs[handle];
+    if (pending.bTaken || pending.bFromCache) {
+        return true;
+    }
+    if (!pending.bLinkSubmitted) {
+        return false;
+    }
+    if (!initParallelCompile()) {
+        return true; // No way to know without blocking
+    }
+    GLint completed = GL_FALSE;
+    glGetProgramiv(pending.program.glId(), GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+GLProgram ProgramBuilder::take(Handle handle)
+{
+    auto & pending = m_Programs[handle];
+    if (pending.bTaken) {
+        throw std::runtime_error("ProgramBuilder: program already taken");
+    }
+    if (!pending.bLinkSubmitted) {
+        linkAll();
+    }
+    pending.bTaken = true;
+
+    if (!pending.bFromCache)
+    {
+        if (!pending.program.getLinkStatus())
+        {
+            // Report the first shader that failed to compile, if any, since the link log is usually not helpful in that case
+            for (size_t i = 0; i < pending.shaders.size(); ++i)
+            {
+                if (!pending.shaders[i].getCompileStatus())
+                {
+                    const auto log = pending.sources[i].name + ": " + pending.shaders[i].getInfoLog();
+                    std::cerr << "Shader compilation error:" << log << std::endl;
+                    throw std::runtime_error("Shader compilation error:" + log);
+                }
+            }
+            std::cerr << "Program link error:" << pending.program.getInfoLog() << std::endl;
+            throw std::runtime_error("Program link error:" + pending.program.getInfoLog());
+        }
+
+        pending.program.reflect();
+        if (m_pCache) {
+            m_pCache->store(pending.sources, pending.program);
+        }
+        for (const auto & shader : pending.shaders) {
+            glDetachShader(pending.program.glId(), shader.glId());
+        }
+        pending.shaders.clear();
+    }
+
+    pending.sources.clear();
+    return std::move(pending.program);
+}
+
+}
@@ -0,0 +1,270 @@
+#include <glmlv/ProgramReflection.hpp>
+
+#include <iostream>
+#include <algorithm>
+
+namespace glmlv
+{
+
+namespace
+{
+
+std::string getResourceName(GLuint programId, GLenum interface, GLuint index, GLint nameLength)
+{
+    std::string name(std::max(nameLength, 1), '\0');
+    GLsizei length = 0;
+    glGetProgramResourceName(programId, interface, index, GLsizei(name.size()), &length, &name[0]);
+    name.resize(length);
+    return name;
+}
+
+bool isSamplerType(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+    case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+    case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT:
+    case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Texture target a sampler type reads from, paired with the query giving the texture bound to that target
+std::pair<GLenum, GLenum> getSamplerTarget(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D: case GL_SAMPLER_1D_SHADOW: case GL_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_1D:
+        return { GL_TEXTURE_1D, GL_TEXTURE_BINDING_1D };
+    case GL_SAMPLER_3D: case GL_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_3D:
+        return { GL_TEXTURE_3D, GL_TEXTURE_BINDING_3D };
+    case GL_SAMPLER_CUBE: case GL_SAMPLER_CUBE_SHADOW: case GL_INT_SAMPLER_CUBE: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+        return { GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP };
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        return { GL_TEXTURE_1D_ARRAY, GL_TEXTURE_BINDING_1D_ARRAY };
+    case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        return { GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BINDING_2D_ARRAY };
+    case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW: case GL_INT_SAMPLER_CUBE_MAP_ARRAY: case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+        return { GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP_ARRAY };
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        return { GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_BINDING_2D_MULTISAMPLE };
+    case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        return { GL_TEXTURE_2D_MULTISAMPLE_ARRAY, GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY };
+    case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return { GL_TEXTURE_BUFFER, GL_TEXTURE_BINDING_BUFFER };
+    case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW: case GL_INT_SAMPLER_2D_RECT: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+        return { GL_TEXTURE_RECTANGLE, GL_TEXTURE_BINDING_RECTANGLE };
+    default:
+        return { GL_TEXTURE_2D, GL_TEXTURE_BINDING_2D };
+    }
+}
+
+std::vector<ProgramReflection::Block> readBlocks(GLuint programId, GLenum interface)
+{
+    GLint blockCount = 0, maxNameLength = 0;
+    glGetProgramInterfaceiv(programId, interface, GL_ACTIVE_RESOURCES, &blockCount);
+    glGetProgramInterfaceiv(programId, interface, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+    std::vector<ProgramReflection::Block> blocks;
+    const GLenum properties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+    for (GLint i = 0; i < blockCount; ++i)
+    {
+        GLint values[2] = { 0, 0 };
+        glGetProgramResourceiv(programId, interface, GLuint(i), 2, properties, 2, nullptr, values);
+
+        ProgramReflection::Block block;
+        block.name = getResourceName(programId, interface, GLuint(i), maxNameLength);
+        block.nameHash = hashResourceName(block.name.c_str());
+        block.index = GLuint(i);
+        block.binding = values[0];
+        block.dataSize = values[1];
+        blocks.emplace_back(std::move(block));
+    }
+    return blocks;
+}
+
+// Hashes of the names resources can be looked up with: for "name[0]", also "name"
+void collectNameHashes(const std::string& name, int32_t index, std::vector<uint32_t>& hashes, std::vector<int32_t>& indices)
+{
+    hashes.emplace_back(hashResourceName(name.c_str()));
+    indices.emplace_back(index);
+
+    const std::string arraySuffix = "[0]";
+    if (name.size() > arraySuffix.size() && name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0)
+    {
+        hashes.emplace_back(hashResourceName(name.substr(0, name.size() - arraySuffix.size()).c_str()));
+        indices.emplace_back(index);
+    }
+}
+
+}
+
+void ProgramReflection::HashIndex::build(const std::vector<uint32_t>& hashes, const std::vector<int32_t>& indices)
+{
+    // At most half full, so that probe sequences stay short
+    uint32_t capacity = 1;
+    while (capacity < 2 * hashes.size()) {
+        capacity <<= 1;
+    }
+
+    m_nMask = capacity - 1;
+    m_Hashes.assign(capacity, 0);
+    m_Indices.assign(capacity, -1);
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        if (find(hashes[i]) >= 0) {
+            continue; // Same hash as a previous name: reported by the caller
+        }
+        auto slot = hashes[i] & m_nMask;
+        while (m_Indices[slot] >= 0) {
+            slot = (slot + 1) & m_nMask;
+        }
+        m_Hashes[slot] = hashes[i];
+        m_Indices[slot] = indices[i];
+    }
+}
+
+ProgramReflection::ProgramReflection(GLuint programId)
+{
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramInterfaceiv(programId, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    glGetProgramInterfaceiv(programId, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+    const GLenum properties[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        GLint values[4] = { -1, -1, 0, 1 };
+        glGetProgramResourceiv(programId, GL_UNIFORM, GLuint(i), 4, properties, 4, nullptr, values);
+        if (values[0] != -1) {
+            continue; // Member of a uniform block, it has no location
+        }
+
+        Uniform uniform;
+        uniform.name = getResourceName(programId, GL_UNIFORM, GLuint(i), maxNameLength);
+        uniform.nameHash = hashResourceName(uniform.name.c_str());
+        uniform.location = values[1];
+        uniform.type = GLenum(values[2]);
+        uniform.arraySize = values[3];
+        uniform.isSampler = isSamplerType(uniform.type);
+        m_Uniforms.emplace_back(std::move(uniform));
+    }
+
+    m_UniformBlocks = readBlocks(programId, GL_UNIFORM_BLOCK);
+    m_StorageBlocks = readBlocks(programId, GL_SHADER_STORAGE_BLOCK);
+
+    const auto buildIndex = [programId](const auto& resources, const char * kind, HashIndex& index)
+    {
+        std::vector<uint32_t> hashes;
+        std::vector<int32_t> indices;
+        for (size_t i = 0; i < resources.size(); ++i) {
+            collectNameHashes(resources[i].name, int32_t(i), hashes, indices);
+        }
+
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            for (size_t j = i + 1; j < hashes.size(); ++j)
+            {
+                if (hashes[i] == hashes[j] && indices[i] != indices[j]) {
+                    std::cerr << "ProgramReflection: program " << programId << ", " << kind << " names " << resources[indices[i]].name << " and "
+                        << resources[indices[j]].name << " have the same hash, only the first one can be found" << std::endl;
+                }
+            }
+        }
+
+        index.build(hashes, indices);
+    };
+    buildIndex(m_Uniforms, "uniform", m_UniformIndex);
+    buildIndex(m_UniformBlocks, "uniform block", m_UniformBlockIndex);
+    buildIndex(m_StorageBlocks, "storage block", m_StorageBlockIndex);
+}
+
+bool ProgramReflection::validateBindings() const
+{
+    bool bValid = true;
+
+    GLint currentProgram = 0, activeTexture = GL_TEXTURE0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+
+    for (const auto & uniform : m_Uniforms)
+    {
+        if (!uniform.isSampler) {
+            continue;
+        }
+
+        const auto target = getSamplerTarget(uniform.type);
+        for (GLint element = 0; element < uniform.arraySize; ++element)
+        {
+            GLint unit = 0;
+            glGetUniformiv(GLuint(currentProgram), uniform.location + element, &unit);
+
+            GLint texture = 0;
+            glActiveTexture(GLenum(GL_TEXTURE0 + unit));
+            glGetIntegerv(target.second, &texture);
+            if (!texture)
+            {
+                std::cerr << "ProgramReflection: sampler " << uniform.name << " (unit " << unit << ") has no texture bound to its target" << std::endl;
+                bValid = false;
+            }
+        }
+    }
+    glActiveTexture(GLenum(activeTexture));
+
+    const auto validateBlocks = [&](const std::vector<Block>& blocks, GLenum bindingQuery, GLenum sizeQuery, const char * kind)
+    {
+        for (const auto & block : blocks)
+        {
+            GLint buffer = 0;
+            GLint64 size = 0;
+            glGetIntegeri_v(bindingQuery, GLuint(block.binding), &buffer);
+            glGetInteger64i_v(sizeQuery, GLuint(block.binding), &size);
+            if (!buffer)
+            {
+                std::cerr << "ProgramReflection: " << kind << " " << block.name << " has no buffer bound to binding " << block.binding << std::endl;
+                bValid = false;
+                continue;
+            }
+            if (size == 0) { // Whole buffer bound with glBindBufferBase
+                glGetNamedBufferParameteri64v(GLuint(buffer), GL_BUFFER_SIZE, &size);
+            }
+            if (size < block.dataSize)
+            {
+                std::cerr << "ProgramReflection: " << kind << " " << block.name << " needs " << block.dataSize << " bytes, only " << size
+                    << " are bound to binding " << block.binding << std::endl;
+                bValid = false;
+            }
+        }
+    };
+    validateBlocks(m_UniformBlocks, GL_UNIFORM_BUFFER_BINDING, GL_UNIFORM_BUFFER_SIZE, "uniform block");
+    validateBlocks(m_StorageBlocks, GL_SHADER_STORAGE_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_SIZE, "storage block");
+
+    return bValid;
+}
+
+void ProgramReflection::print(std::ostream& out) const
+{
+    for (const auto & uniform : m_Uniforms) {
+        out << (uniform.isSampler ? "sampler " : "uniform ") << uniform.name << ": location " << uniform.location << ", type 0x" << std::hex << uniform.type << std::dec
+            << (uniform.arraySize > 1 ? ", array of " + std::to_string(uniform.arraySize) : std::string()) << "\n";
+    }
+    for (const auto & block : m_UniformBlocks) {
+        out << "uniform block " << block.name << ": binding " << block.binding << ", " << block.dataSize << " bytes\n";
+    }
+    for (const auto & block : m_StorageBlocks) {
+        out << "storage block " << block.name << ": binding " << block.binding << ", " << block.dataSize << " bytes\n";
+    }
+}
+
+}
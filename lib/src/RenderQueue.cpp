@@ -0,0 +1,93 @@
+#include <glmlv/RenderQueue.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <array>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace glmlv
+{
+
+static uint64_t packKeyField(uint64_t key, uint32_t value, unsigned bitCount, const char * name)
+{
+    if (value >> bitCount)
+    {
+        std::cerr << "RenderQueue: " << name << " " << value << " does not fit in " << bitCount << " bits" << std::endl;
+        throw std::runtime_error(std::string("RenderQueue: ") + name + " out of range");
+    }
+    return (key << bitCount) | value;
+}
+
+uint64_t RenderQueue::makeKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t depth, uint32_t vertexArray)
+{
+    static_assert(PassBits + ProgramBits + MaterialBits + DepthBits + VertexArrayBits == 64, "The key fields must fill 64 bits");
+
+    uint64_t key = 0;
+    key = packKeyField(key, pass, PassBits, "pass");
+    key = packKeyField(key, program, ProgramBits, "program");
+    key = packKeyField(key, material, MaterialBits, "material");
+    key = packKeyField(key, depth, DepthBits, "depth");
+    key = packKeyField(key, vertexArray, VertexArrayBits, "vertex array");
+    return key;
+}
+
+uint32_t RenderQueue::quantizeDepth(float distance, float zNear, float zFar, DepthOrder order)
+{
+    const uint32_t maxDepth = (1u << DepthBits) - 1;
+    const auto normalized = zFar > zNear ? (distance - zNear) / (zFar - zNear) : 0.f;
+    const auto clamped = normalized > 0.f ? std::min(normalized, 1.f) : 0.f; // Also maps NaN to 0
+    const auto depth = uint32_t(std::lround(double(clamped) * maxDepth));
+    return order == DepthOrder::FrontToBack ? depth : maxDepth - depth;
+}
+
+void RenderQueue::sort()
+{
+    GLMLV_PROFILE_FUNCTION();
+
+    m_nLastSortPassCount = 0;
+    const auto count = m_Draws.size();
+    if (count < 2) {
+        return;
+    }
+
+    // Histograms of the 8 bytes in a single read of the keys
+    std::array<std::array<uint32_t, 256>, 8> histograms;
+    for (auto & histogram : histograms) {
+        histogram.fill(0);
+    }
+    for (const auto & draw : m_Draws)
+    {
+        for (size_t byte = 0; byte < 8; ++byte) {
+            ++histograms[byte][(draw.key >> (8 * byte)) & 0xFF];
+        }
+    }
+
+    m_Scratch.resize(count);
+    for (size_t byte = 0; byte < 8; ++byte)
+    {
+        auto & histogram = histograms[byte];
+        if (histogram[(m_Draws.front().key >> (8 * byte)) & 0xFF] == count) {
+            continue; // Same byte for all keys, the order is kept as it is
+        }
+
+        // Exclusive prefix sum: first output index of each byte value
+        uint32_t offset = 0;
+        for (auto & bucket : histogram)
+        {
+            const auto bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (const auto & draw : m_Draws) {
+            m_Scratch[histogram[(draw.key >> (8 * byte)) & 0xFF]++] = draw;
+        }
+        std::swap(m_Draws, m_Scratch);
+        ++m_nLastSortPassCount;
+    }
+}
+
+}
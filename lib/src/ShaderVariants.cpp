@@ -0,0 +1,220 @@
+#include <glmlv/ShaderVariants.hpp>
+#include <glmlv/ProgramBuilder.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Position of the first non blank character of line if it starts the given directive, std::string::npos otherwise
+size_t findDirective(const std::string& line, const std::string& directive)
+{
+    const auto start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, directive.size(), directive) != 0) {
+        return std::string::npos;
+    }
+    return start;
+}
+
+void resolveIncludes(const std::string& source, const fs::path& sourcePath, const std::vector<fs::path>& includeDirectories,
+    std::vector<fs::path>& includedFiles, std::vector<fs::path>& includeStack, std::ostream& output)
+{
+    const auto sourceIndex = std::find(begin(includedFiles), end(includedFiles), sourcePath) - begin(includedFiles);
+
+    std::istringstream input(source);
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(input, line))
+    {
+        ++lineNumber;
+
+        const auto directive = findDirective(line, "#include");
+        if (directive == std::string::npos)
+        {
+            output << line << "\n";
+            continue;
+        }
+
+        const auto nameBegin = line.find_first_of("\"<", directive);
+        const auto nameEnd = nameBegin == std::string::npos ? std::string::npos : line.find_first_of("\">", nameBegin + 1);
+        if (nameEnd == std::string::npos)
+        {
+            std::stringstream ss;
+            ss << sourcePath << "(" << lineNumber << "): malformed #include";
+            throw std::runtime_error(ss.str());
+        }
+        const fs::path includeName = line.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+
+        auto includePath = sourcePath.parent_path() / includeName;
+        for (size_t i = 0; i < includeDirectories.size() && !fs::exists(includePath); ++i) {
+            includePath = includeDirectories[i] / includeName;
+        }
+        if (!fs::exists(includePath))
+        {
+            std::stringstream ss;
+            ss << sourcePath << "(" << lineNumber << "): included file " << includeName << " not found";
+            throw std::runtime_error(ss.str());
+        }
+        includePath = fs::canonical(includePath);
+
+        if (std::find(begin(includeStack), end(includeStack), includePath) != end(includeStack))
+        {
+            std::stringstream ss;
+            ss << sourcePath << "(" << lineNumber << "): recursive inclusion of " << includePath;
+            throw std::runtime_error(ss.str());
+        }
+
+        auto includeIndex = std::find(begin(includedFiles), end(includedFiles), includePath) - begin(includedFiles);
+        if (size_t(includeIndex) == includedFiles.size()) {
+            includedFiles.emplace_back(includePath);
+        }
+
+        output << "#line 1 " << includeIndex << "\n";
+        includeStack.emplace_back(includePath);
+        resolveIncludes(loadShaderSource(includePath), includePath, includeDirectories, includedFiles, includeStack, output);
+        includeStack.pop_back();
+        output << "#line " << lineNumber + 1 << " " << sourceIndex << "\n";
+    }
+}
+
+}
+
+std::string resolveShaderIncludes(const std::string& source, const fs::path& sourcePath, const std::vector<fs::path>& includeDirectories,
+    std::vector<fs::path> * pIncludedFiles)
+{
+    const auto mainPath = fs::exists(sourcePath) ? fs::canonical(sourcePath) : sourcePath;
+
+    std::vector<fs::path> includedFiles = { mainPath };
+    std::vector<fs::path> includeStack = { mainPath };
+    std::ostringstream output;
+    resolveIncludes(source, mainPath, includeDirectories, includedFiles, includeStack, output);
+
+    if (pIncludedFiles) {
+        *pIncludedFiles = std::move(includedFiles);
+    }
+    return output.str();
+}
+
+std::string injectShaderDefines(const std::string& source, const ShaderDefines& defines)
+{
+    if (defines.empty()) {
+        return source;
+    }
+
+    std::ostringstream defineLines;
+    for (const auto & define : defines) {
+        defineLines << "#define " << define.first << (define.second.empty() ? "" : " ") << define.second << "\n";
+    }
+
+    // Look for #version on each line until the first one that is not blank, a comment or a directive
+    size_t lineBegin = 0, lineNumber = 1;
+    while (lineBegin < source.size())
+    {
+        auto lineEnd = source.find('\n', lineBegin);
+        if (lineEnd == std::string::npos) {
+            lineEnd = source.size();
+        }
+        const auto line = source.substr(lineBegin, lineEnd - lineBegin);
+
+        if (findDirective(line, "#version") != std::string::npos)
+        {
+            const auto insertPosition = std::min(lineEnd + 1, source.size());
+            const auto versionLine = source.substr(0, insertPosition) + (lineEnd == source.size() ? "\n" : "");
+            defineLines << "#line " << lineNumber + 1 << " 0\n";
+            return versionLine + defineLines.str() + source.substr(insertPosition);
+        }
+
+        const auto start = line.find_first_not_of(" \t\r");
+        if (start != std::string::npos && line[start] != '#' && line.compare(start, 2, "//") != 0) {
+            break;
+        }
+
+        lineBegin = lineEnd + 1;
+        ++lineNumber;
+    }
+
+    defineLines << "#line 1 0\n";
+    return defineLines.str() + source;
+}
+
+ShaderSource loadShaderVariant(const fs::path& shaderPath, const ShaderDefines& defines, const std::vector<fs::path>& includeDirectories)
+{
+    auto shaderSource = loadShaderSourceFile(shaderPath);
+    shaderSource.source = injectShaderDefines(resolveShaderIncludes(shaderSource.source, shaderPath, includeDirectories), defines);
+    return shaderSource;
+}
+
+ShaderVariantCache::ShaderVariantCache(std::vector<fs::path> includeDirectories, ProgramBinaryCache * pBinaryCache):
+    m_IncludeDirectories(std::move(includeDirectories)), m_pBinaryCache(pBinaryCache)
+{
+}
+
+const GLProgram& ShaderVariantCache::get(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines)
+{
+    auto key = makeKey(shaderPaths, defines);
+    auto it = m_Programs.find(key);
+    if (it == end(m_Programs))
+    {
+        ProgramBuilder builder(m_pBinaryCache);
+        const auto handle = builder.add(makeSources(shaderPaths, defines));
+        it = m_Programs.emplace(std::move(key), builder.take(handle)).first;
+    }
+    return it->second;
+}
+
+void ShaderVariantCache::prebuild(const std::vector<fs::path>& shaderPaths, const std::vector<ShaderDefines>& definesList)
+{
+    ProgramBuilder builder(m_pBinaryCache);
+    std::vector<std::pair<VariantKey, ProgramBuilder::Handle>> pending;
+    for (const auto & defines : definesList)
+    {
+        auto key = makeKey(shaderPaths, defines);
+        if (m_Programs.find(key) != end(m_Programs)) {
+            continue;
+        }
+        const auto handle = builder.add(makeSources(shaderPaths, defines));
+        pending.emplace_back(std::move(key), handle);
+    }
+    builder.linkAll();
+
+    for (auto & variant : pending) {
+        m_Programs.emplace(std::move(variant.first), builder.take(variant.second));
+    }
+}
+
+ShaderVariantCache::VariantKey ShaderVariantCache::makeKey(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines)
+{
+    VariantKey key;
+    for (const auto & path : shaderPaths) {
+        key.first.emplace_back(path.string());
+    }
+    key.second = defines;
+    return key;
+}
+
+std::vector<ShaderSource> ShaderVariantCache::makeSources(const std::vector<fs::path>& shaderPaths, const ShaderDefines& defines)
+{
+    std::vector<ShaderSource> sources;
+    for (const auto & path : shaderPaths)
+    {
+        auto it = m_ResolvedSources.find(path.string());
+        if (it == end(m_ResolvedSources))
+        {
+            auto shaderSource = loadShaderSourceFile(path);
+            shaderSource.source = resolveShaderIncludes(shaderSource.source, path, m_IncludeDirectories);
+            it = m_ResolvedSources.emplace(path.string(), std::move(shaderSource)).first;
+        }
+
+        sources.emplace_back(it->second);
+        sources.back().source = injectShaderDefines(sources.back().source, defines);
+    }
+    return sources;
+}
+
+}
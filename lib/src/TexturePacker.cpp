@@ -0,0 +1,321 @@
+#include <glmlv/TexturePacker.hpp>
+#include <glmlv/CPUProfiler.hpp>
+#include <glmlv/GPUMemoryLedger.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+namespace glmlv
+{
+
+namespace
+{
+
+size_t computeMipLevelCount(size_t width, size_t height)
+{
+    size_t count = 1;
+    for (auto size = std::max(width, height); size > 1; size >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Create an immutable array texture and leave it bound to GL_TEXTURE_2D_ARRAY
+TexturePacker::TextureArray createTextureArray(ImageFormat format, size_t width, size_t height, size_t layerCount, size_t mipLevelCount, bool isAtlas)
+{
+    const auto glFormat = getGLImageFormat(format);
+
+    TexturePacker::TextureArray array;
+    array.format = format;
+    array.width = width;
+    array.height = height;
+    array.layerCount = layerCount;
+    array.mipLevelCount = mipLevelCount;
+    array.isAtlas = isAtlas;
+
+    glGenTextures(1, &array.glId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.glId);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, GLsizei(mipLevelCount), glFormat.internalFormat, GLsizei(width), GLsizei(height), GLsizei(layerCount));
+    GPUMemoryLedger::get().registerTexture(array.glId, glFormat.internalFormat, width, height, layerCount, mipLevelCount);
+    glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, glFormat.swizzleMask);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(mipLevelCount - 1));
+
+    return array;
+}
+
+// Copy image to (x, y) in a layer of width atlasWidth, surrounded by padding texels taken from the opposite side of the image
+// since material textures are usually repeated
+void copyWithPadding(const AnyImage2D& image, size_t padding, unsigned char * pLayer, size_t atlasWidth, size_t x, size_t y)
+{
+    const auto bpp = image.bytesPerPixel();
+    const auto width = image.width(), height = image.height();
+
+    for (size_t py = 0; py < height + 2 * padding; ++py)
+    {
+        const auto sy = (py + height - padding % height) % height;
+        const auto pSrcRow = image.data() + sy * width * bpp;
+        const auto pDstRow = pLayer + ((y - padding + py) * atlasWidth + x - padding) * bpp;
+
+        std::copy(pSrcRow, pSrcRow + width * bpp, pDstRow + padding * bpp);
+        for (size_t px = 0; px < padding; ++px)
+        {
+            const auto leftSrc = (px + width - padding % width) % width;
+            std::copy(pSrcRow + leftSrc * bpp, pSrcRow + (leftSrc + 1) * bpp, pDstRow + px * bpp);
+
+            const auto rightSrc = px % width;
+            std::copy(pSrcRow + rightSrc * bpp, pSrcRow + (rightSrc + 1) * bpp, pDstRow + (padding + width + px) * bpp);
+        }
+    }
+}
+
+}
+
+TexturePacker::~TexturePacker()
+{
+    release();
+}
+
+TexturePacker::TexturePacker(TexturePacker&& rvalue):
+    m_Arrays(std::move(rvalue.m_Arrays))
+{
+    rvalue.m_Arrays.clear();
+}
+
+TexturePacker& TexturePacker::operator =(TexturePacker&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_Arrays = std::move(rvalue.m_Arrays);
+        rvalue.m_Arrays.clear();
+    }
+    return *this;
+}
+
+void TexturePacker::release()
+{
+    for (auto & array : m_Arrays)
+    {
+        GPUMemoryLedger::get().unregisterResource(GPUMemoryLedger::ResourceType::Texture, array.glId);
+        glDeleteTextures(1, &array.glId);
+    }
+    m_Arrays.clear();
+}
+
+std::vector<PackedTextureRef> TexturePacker::pack(const std::vector<AnyImage2D>& images, const TexturePackerOptions& options)
+{
+    GLMLV_PROFILE_FUNCTION();
+    std::vector<PackedTextureRef> refs(images.size());
+    const auto firstArray = m_Arrays.size();
+
+    // Mip level k of an atlas has padding >> k texels around each image: stop at one texel, and align the images
+    // on the size of a texel of the last level so that no texel of the chain is shared by two images
+    size_t atlasMipLevelCount = 1;
+    while ((size_t(1) << atlasMipLevelCount) <= options.padding) {
+        ++atlasMipLevelCount;
+    }
+    const size_t atlasAlignment = size_t(1) << (atlasMipLevelCount - 1);
+    const size_t padding = roundUp(options.padding, atlasAlignment);
+
+    std::map<std::tuple<ImageFormat, size_t, size_t>, std::vector<size_t>> sameSizeGroups;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        if (images[i].data() && images[i].format() != ImageFormat::Undefined) {
+            sameSizeGroups[std::make_tuple(images[i].format(), images[i].width(), images[i].height())].push_back(i);
+        }
+    }
+
+    const auto fitsInAtlas = [&](size_t width, size_t height)
+    {
+        return std::max(width, height) <= options.maxAtlasedSize && std::max(width, height) + 2 * padding <= options.atlasSize;
+    };
+
+    // Groups uploaded as their own array, the others are packed in the atlas of their format
+    std::map<std::tuple<ImageFormat, size_t, size_t>, std::vector<size_t>> arrayGroups;
+    std::map<ImageFormat, std::vector<size_t>> atlasGroups;
+    for (const auto & group : sameSizeGroups)
+    {
+        if (group.second.size() < options.minSameSizeCount && fitsInAtlas(std::get<1>(group.first), std::get<2>(group.first)))
+        {
+            auto & atlasGroup = atlasGroups[std::get<0>(group.first)];
+            atlasGroup.insert(end(atlasGroup), begin(group.second), end(group.second));
+        }
+        else
+        {
+            arrayGroups.insert(group);
+        }
+    }
+
+    // Over the limit: move the smallest groups that fit to the atlas of their format
+    const auto arrayCount = [&]()
+    {
+        return firstArray + arrayGroups.size() + atlasGroups.size();
+    };
+    if (arrayCount() > options.maxArrayCount)
+    {
+        std::vector<std::tuple<ImageFormat, size_t, size_t>> candidates;
+        for (const auto & group : arrayGroups)
+        {
+            if (fitsInAtlas(std::get<1>(group.first), std::get<2>(group.first))) {
+                candidates.push_back(group.first);
+            }
+        }
+        std::stable_sort(begin(candidates), end(candidates), [&](const std::tuple<ImageFormat, size_t, size_t> & lhs, const std::tuple<ImageFormat, size_t, size_t> & rhs)
+        {
+            return arrayGroups[lhs].size() < arrayGroups[rhs].size();
+        });
+
+        for (size_t i = 0; i < candidates.size() && arrayCount() > options.maxArrayCount; ++i)
+        {
+            const auto & indices = arrayGroups[candidates[i]];
+            auto & atlasGroup = atlasGroups[std::get<0>(candidates[i])];
+            atlasGroup.insert(end(atlasGroup), begin(indices), end(indices));
+            arrayGroups.erase(candidates[i]);
+        }
+    }
+    if (arrayCount() > options.maxArrayCount)
+    {
+        std::cerr << "TexturePacker: " << arrayCount() << " texture arrays needed, at most " << options.maxArrayCount << " allowed" << std::endl;
+        throw std::runtime_error("TexturePacker: too many texture arrays");
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of R8 / RGB8 images are not 4 bytes aligned
+
+    for (const auto & group : arrayGroups)
+    {
+        ImageFormat format;
+        size_t width, height;
+        std::tie(format, width, height) = group.first;
+        const auto & indices = group.second;
+
+        const auto glFormat = getGLImageFormat(format);
+        const auto arrayIndex = int32_t(m_Arrays.size());
+        m_Arrays.emplace_back(createTextureArray(format, width, height, indices.size(), computeMipLevelCount(width, height), false));
+
+        for (size_t layer = 0; layer < indices.size(); ++layer)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(layer), GLsizei(width), GLsizei(height), 1, glFormat.format, glFormat.type, images[indices[layer]].data());
+            refs[indices[layer]].arrayIndex = arrayIndex;
+            refs[indices[layer]].layer = int32_t(layer);
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    for (auto & group : atlasGroups)
+    {
+        const auto format = group.first;
+        auto & indices = group.second;
+
+        // Shelf packing: images sorted by decreasing height are placed left to right, a new shelf starts when the current one is full
+        std::sort(begin(indices), end(indices), [&](size_t lhs, size_t rhs)
+        {
+            return std::make_pair(images[lhs].height(), images[lhs].width()) > std::make_pair(images[rhs].height(), images[rhs].width());
+        });
+
+        struct Placement
+        {
+            size_t layer, x, y; // Top left corner of the image, padding excluded
+        };
+        std::vector<Placement> placements;
+
+        size_t layer = 0, shelfX = 0, shelfY = 0, shelfHeight = 0;
+        size_t usedWidth = 0, usedHeight = 0;
+        for (const auto i : indices)
+        {
+            const auto footprintWidth = roundUp(images[i].width() + 2 * padding, atlasAlignment);
+            const auto footprintHeight = roundUp(images[i].height() + 2 * padding, atlasAlignment);
+
+            if (shelfX + footprintWidth > options.atlasSize)
+            {
+                shelfY += shelfHeight;
+                shelfX = shelfHeight = 0;
+            }
+            if (shelfY + footprintHeight > options.atlasSize)
+            {
+                ++layer;
+                shelfX = shelfY = shelfHeight = 0;
+            }
+
+            placements.push_back({ layer, shelfX + padding, shelfY + padding });
+
+            shelfX += footprintWidth;
+            shelfHeight = std::max(shelfHeight, footprintHeight);
+            usedWidth = std::max(usedWidth, shelfX);
+            usedHeight = std::max(usedHeight, shelfY + footprintHeight);
+        }
+
+        const auto layerCount = layer + 1;
+        const auto bpp = getBytesPerPixel(format);
+        std::vector<unsigned char> atlasData(layerCount * usedWidth * usedHeight * bpp, 0);
+
+        const auto arrayIndex = int32_t(m_Arrays.size());
+        for (size_t k = 0; k < indices.size(); ++k)
+        {
+            const auto & image = images[indices[k]];
+            const auto & placement = placements[k];
+            copyWithPadding(image, padding, atlasData.data() + placement.layer * usedWidth * usedHeight * bpp, usedWidth, placement.x, placement.y);
+
+            auto & ref = refs[indices[k]];
+            ref.arrayIndex = arrayIndex;
+            ref.layer = int32_t(placement.layer);
+            ref.uvScale = glm::vec2(float(image.width()) / usedWidth, float(image.height()) / usedHeight);
+            ref.uvOffset = glm::vec2(float(placement.x) / usedWidth, float(placement.y) / usedHeight);
+        }
+
+        const auto glFormat = getGLImageFormat(format);
+        m_Arrays.emplace_back(createTextureArray(format, usedWidth, usedHeight, layerCount, std::min(atlasMipLevelCount, computeMipLevelCount(usedWidth, usedHeight)), true));
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, GLsizei(usedWidth), GLsizei(usedHeight), GLsizei(layerCount), glFormat.format, glFormat.type, atlasData.data());
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    GLint maxTextureUnits = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
+    if (m_Arrays.size() > size_t(maxTextureUnits)) {
+        std::cerr << "TexturePacker: " << m_Arrays.size() << " arrays but only " << maxTextureUnits << " texture units, increase atlasSize or minSameSizeCount" << std::endl;
+    }
+
+    std::cout << "TexturePacker: " << images.size() << " images packed in " << m_Arrays.size() - firstArray << " texture arrays" << std::endl;
+    for (auto i = firstArray; i < m_Arrays.size(); ++i)
+    {
+        const auto & array = m_Arrays[i];
+        std::cout << "    " << (array.isAtlas ? "atlas " : "array ") << getImageFormatName(array.format) << " " << array.width << "x" << array.height
+            << " x " << array.layerCount << " layers, " << array.mipLevelCount << " mip levels" << std::endl;
+    }
+
+    return refs;
+}
+
+void TexturePacker::bindArrays(GLuint firstUnit) const
+{
+    for (size_t i = 0; i < m_Arrays.size(); ++i)
+    {
+        glActiveTexture(GLenum(GL_TEXTURE0 + firstUnit + i));
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_Arrays[i].glId);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+size_t TexturePacker::byteSize() const
+{
+    size_t byteSize = 0;
+    for (const auto & array : m_Arrays)
+    {
+        for (size_t level = 0; level < array.mipLevelCount; ++level) {
+            byteSize += std::max(array.width >> level, size_t(1)) * std::max(array.height >> level, size_t(1)) * array.layerCount * getBytesPerPixel(array.format);
+        }
+    }
+    return byteSize;
+}
+
+}
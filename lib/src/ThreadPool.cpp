@@ -0,0 +1,105 @@
+#include <glmlv/ThreadPool.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <algorithm>
+
+namespace glmlv
+{
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        m_Threads.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_bExit = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (auto & thread : m_Threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0) {
+        return;
+    }
+
+    if (count == 1 || m_Threads.empty())
+    {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> submitLock(m_SubmitMutex);
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_pTask = &task;
+        m_nCount = count;
+        m_nNextIndex = 0;
+        m_nActiveWorkerCount = m_Threads.size();
+        ++m_nGeneration;
+    }
+    m_WorkAvailable.notify_all();
+
+    runIterations();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_WorkDone.wait(lock, [&]() { return m_nActiveWorkerCount == 0; });
+    m_pTask = nullptr;
+}
+
+void ThreadPool::runIterations()
+{
+    GLMLV_PROFILE_SCOPE("ThreadPool::parallelFor iterations");
+    for (auto i = m_nNextIndex++; i < m_nCount; i = m_nNextIndex++) {
+        (*m_pTask)(i);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    GLMLV_PROFILE_THREAD_NAME("ThreadPool worker");
+    size_t lastGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkAvailable.wait(lock, [&]() { return m_bExit || m_nGeneration != lastGeneration; });
+            if (m_bExit) {
+                return;
+            }
+            lastGeneration = m_nGeneration;
+        }
+
+        runIterations();
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            --m_nActiveWorkerCount;
+        }
+        m_WorkDone.notify_one();
+    }
+}
+
+ThreadPool& ThreadPool::getDefault()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+}
@@ -0,0 +1,204 @@
+#include <glmlv/frustum_culling.hpp>
+#include <glmlv/ThreadPool.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GLMLV_CULLING_SSE 1
+#endif
+
+namespace glmlv
+{
+
+// Boxes per task of the thread pool, a multiple of 4. Below two chunks the calling thread culls everything alone.
+static const size_t CullingChunkSize = 2048;
+
+void CullingBounds::clear()
+{
+    for (auto * component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+        component->clear();
+    }
+}
+
+void CullingBounds::reserve(size_t count)
+{
+    for (auto * component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+        component->reserve(count);
+    }
+}
+
+void CullingBounds::push(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax)
+{
+    const auto center = 0.5f * (bboxMin + bboxMax);
+    const auto extent = 0.5f * (bboxMax - bboxMin);
+    centerX.emplace_back(center.x);
+    centerY.emplace_back(center.y);
+    centerZ.emplace_back(center.z);
+    extentX.emplace_back(extent.x);
+    extentY.emplace_back(extent.y);
+    extentZ.emplace_back(extent.z);
+}
+
+void CullingBounds::push(const glm::vec3 & bboxMin, const glm::vec3 & bboxMax, const glm::mat4 & localToWorldMatrix)
+{
+    // The half sizes of the transformed box are the absolute values of the linear part applied to the local half sizes
+    const auto center = glm::vec3(localToWorldMatrix * glm::vec4(0.5f * (bboxMin + bboxMax), 1));
+    const auto localExtent = 0.5f * (bboxMax - bboxMin);
+    const auto linear = glm::mat3(localToWorldMatrix);
+    const auto extent = glm::abs(linear[0]) * localExtent.x + glm::abs(linear[1]) * localExtent.y + glm::abs(linear[2]) * localExtent.z;
+    push(center - extent, center + extent);
+}
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4 & viewProjMatrix)
+{
+    // Rows of the matrix (glm is column major): a clip space point is inside if -w <= x, y, z <= w
+    glm::vec4 rows[4];
+    for (auto i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjMatrix[0][i], viewProjMatrix[1][i], viewProjMatrix[2][i], viewProjMatrix[3][i]);
+    }
+
+    FrustumPlanes frustum;
+    for (auto i = 0; i < 3; ++i)
+    {
+        frustum.planes[2 * i] = rows[3] + rows[i];
+        frustum.planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    return frustum;
+}
+
+// Visibility of the boxes [begin, end), returns the number of visible boxes
+static size_t cullRange(const CullingBounds & bounds, const FrustumPlanes & frustum, size_t begin, size_t end, uint8_t * pVisibility)
+{
+    size_t visibleCount = 0;
+    auto i = begin;
+
+#ifdef GLMLV_CULLING_SSE
+    // One register per plane coefficient, broadcast, and |normal| for the projected radius of the boxes
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+    for (auto p = 0; p < 6; ++p)
+    {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        absPlaneX[p] = _mm_set1_ps(std::abs(frustum.planes[p].x));
+        absPlaneY[p] = _mm_set1_ps(std::abs(frustum.planes[p].y));
+        absPlaneZ[p] = _mm_set1_ps(std::abs(frustum.planes[p].z));
+    }
+    const auto zero = _mm_setzero_ps();
+
+    for (; i + 4 <= end; i += 4)
+    {
+        const auto cx = _mm_loadu_ps(&bounds.centerX[i]), cy = _mm_loadu_ps(&bounds.centerY[i]), cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        const auto ex = _mm_loadu_ps(&bounds.extentX[i]), ey = _mm_loadu_ps(&bounds.extentY[i]), ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+        // A box is outside if, for one plane, the signed distance of its center plus its projected radius is negative
+        auto outside = _mm_setzero_ps();
+        for (auto p = 0; p < 6; ++p)
+        {
+            const auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, planeX[p]), _mm_mul_ps(cy, planeY[p])), _mm_add_ps(_mm_mul_ps(cz, planeZ[p]), planeW[p]));
+            const auto radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absPlaneX[p]), _mm_mul_ps(ey, absPlaneY[p])), _mm_mul_ps(ez, absPlaneZ[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        const auto outsideMask = _mm_movemask_ps(outside);
+        for (auto lane = 0; lane < 4; ++lane)
+        {
+            const auto visible = uint8_t(((outsideMask >> lane) & 1) ^ 1);
+            pVisibility[i + lane] = visible;
+            visibleCount += visible;
+        }
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        bool outside = false;
+        for (auto p = 0; p < 6 && !outside; ++p)
+        {
+            const auto & plane = frustum.planes[p];
+            const auto distance = bounds.centerX[i] * plane.x + bounds.centerY[i] * plane.y + bounds.centerZ[i] * plane.z + plane.w;
+            const auto radius = bounds.extentX[i] * std::abs(plane.x) + bounds.extentY[i] * std::abs(plane.y) + bounds.extentZ[i] * std::abs(plane.z);
+            outside = distance + radius < 0.f;
+        }
+        pVisibility[i] = outside ? 0 : 1;
+        visibleCount += outside ? 0 : 1;
+    }
+
+    return visibleCount;
+}
+
+CullingStats cullFrustum(const CullingBounds & bounds, const glm::mat4 & viewProjMatrix, std::vector<uint8_t> & visibility, ThreadPool * pThreadPool)
+{
+    GLMLV_PROFILE_FUNCTION();
+
+    const auto count = bounds.size();
+    const auto frustum = extractFrustumPlanes(viewProjMatrix);
+    visibility.resize(count);
+
+    CullingStats stats;
+    const auto chunkCount = (count + CullingChunkSize - 1) / CullingChunkSize;
+    if (chunkCount < 2)
+    {
+        stats.visibleCount = cullRange(bounds, frustum, 0, count, visibility.data());
+    }
+    else
+    {
+        // Each chunk writes its own range of visibility and its own count
+        std::vector<size_t> visibleCounts(chunkCount);
+        auto & threadPool = pThreadPool ? *pThreadPool : ThreadPool::getDefault();
+        threadPool.parallelFor(chunkCount, [&](size_t chunk)
+        {
+            const auto begin = chunk * CullingChunkSize;
+            visibleCounts[chunk] = cullRange(bounds, frustum, begin, std::min(begin + CullingChunkSize, count), visibility.data());
+        });
+        for (const auto visibleCount : visibleCounts) {
+            stats.visibleCount += visibleCount;
+        }
+    }
+
+    stats.culledCount = count - stats.visibleCount;
+    return stats;
+}
+
+NormalCone computeNormalCone(const std::vector<Vertex3f3f2f> & vertices, const uint32_t * indices, size_t indexCount, const glm::mat4 & localToWorldMatrix)
+{
+    // Face normals are computed from the world space positions: no normal matrix needed, and mirroring transforms flip the winding as they should
+    std::vector<glm::vec3> faceNormals;
+    faceNormals.reserve(indexCount / 3);
+    auto normalSum = glm::vec3(0);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const auto p0 = glm::vec3(localToWorldMatrix * glm::vec4(vertices[indices[i]].position, 1));
+        const auto p1 = glm::vec3(localToWorldMatrix * glm::vec4(vertices[indices[i + 1]].position, 1));
+        const auto p2 = glm::vec3(localToWorldMatrix * glm::vec4(vertices[indices[i + 2]].position, 1));
+        const auto areaNormal = glm::cross(p1 - p0, p2 - p0); // Length is twice the area
+        const auto length = glm::length(areaNormal);
+        if (!(length > 0.f)) {
+            continue;
+        }
+        normalSum += areaNormal;
+        faceNormals.emplace_back(areaNormal / length);
+    }
+
+    NormalCone cone;
+    const auto sumLength = glm::length(normalSum);
+    if (faceNormals.empty() || !(sumLength > 0.f)) {
+        return cone;
+    }
+    cone.axis = normalSum / sumLength;
+
+    auto minCosAngle = 1.f;
+    for (const auto & normal : faceNormals) {
+        minCosAngle = std::min(minCosAngle, glm::dot(normal, cone.axis));
+    }
+    if (minCosAngle > 0.f) {
+        cone.sinHalfAngle = std::sqrt(std::max(1.f - minCosAngle * minCosAngle, 0.f));
+    }
+    return cone;
+}
+
+}
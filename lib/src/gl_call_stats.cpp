@@ -0,0 +1,496 @@
+#include <glmlv/gl_call_stats.hpp>
+#include <glmlv/indirect_draw.hpp>
+#include <glad/glad.h>
+
+#include <imgui.h>
+#include <json.hpp>
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+namespace glmlv
+{
+
+// X(entry point, category)
+#define GLMLV_INTERCEPTED_GL_CALLS(X) \
+    X(glDrawArrays, Draw) \
+    X(glDrawElements, Draw) \
+    X(glDrawArraysInstanced, Draw) \
+    X(glDrawElementsInstanced, Draw) \
+    X(glDrawElementsBaseVertex, Draw) \
+    X(glDrawRangeElements, Draw) \
+    X(glDrawElementsInstancedBaseVertex, Draw) \
+    X(glDrawElementsInstancedBaseInstance, Draw) \
+    X(glDrawArraysInstancedBaseInstance, Draw) \
+    X(glDrawElementsInstancedBaseVertexBaseInstance, Draw) \
+    X(glDrawArraysIndirect, Draw) \
+    X(glDrawElementsIndirect, Draw) \
+    X(glMultiDrawArrays, Draw) \
+    X(glMultiDrawElements, Draw) \
+    X(glMultiDrawArraysIndirect, Draw) \
+    X(glMultiDrawElementsIndirect, Draw) \
+    X(glMultiDrawElementsIndirectCount, Draw) \
+    X(glDispatchCompute, Draw) \
+    X(glDispatchComputeIndirect, Draw) \
+    X(glClear, Draw) \
+    X(glBlitFramebuffer, Draw) \
+    X(glUseProgram, State) \
+    X(glBindVertexArray, State) \
+    X(glBindBuffer, State) \
+    X(glBindBufferBase, State) \
+    X(glBindBufferRange, State) \
+    X(glBindBuffersRange, State) \
+    X(glBindVertexBuffers, State) \
+    X(glBindTexture, State) \
+    X(glBindTextureUnit, State) \
+    X(glBindTextures, State) \
+    X(glActiveTexture, State) \
+    X(glBindSampler, State) \
+    X(glBindSamplers, State) \
+    X(glBindFramebuffer, State) \
+    X(glEnable, State) \
+    X(glDisable, State) \
+    X(glViewport, State) \
+    X(glBlendFunc, State) \
+    X(glDepthFunc, State) \
+    X(glDepthMask, State) \
+    X(glColorMask, State) \
+    X(glCullFace, State) \
+    X(glPolygonOffset, State) \
+    X(glReadBuffer, State) \
+    X(glDrawBuffers, State) \
+    X(glPixelStorei, State) \
+    X(glUniform1i, Uniform) \
+    X(glUniform1ui, Uniform) \
+    X(glUniform1f, Uniform) \
+    X(glUniform2f, Uniform) \
+    X(glUniform3f, Uniform) \
+    X(glUniform4f, Uniform) \
+    X(glUniform1iv, Uniform) \
+    X(glUniform1fv, Uniform) \
+    X(glUniform2fv, Uniform) \
+    X(glUniform3fv, Uniform) \
+    X(glUniform4fv, Uniform) \
+    X(glUniformMatrix3fv, Uniform) \
+    X(glUniformMatrix4fv, Uniform) \
+    X(glProgramUniform1i, Uniform) \
+    X(glProgramUniform1f, Uniform) \
+    X(glProgramUniform3fv, Uniform) \
+    X(glProgramUniformMatrix4fv, Uniform) \
+    X(glBufferData, BufferUpload) \
+    X(glBufferSubData, BufferUpload) \
+    X(glBufferStorage, BufferUpload) \
+    X(glNamedBufferData, BufferUpload) \
+    X(glNamedBufferSubData, BufferUpload) \
+    X(glNamedBufferStorage, BufferUpload) \
+    X(glCopyNamedBufferSubData, BufferUpload) \
+    X(glMapBufferRange, BufferUpload) \
+    X(glMapNamedBufferRange, BufferUpload) \
+    X(glUnmapBuffer, BufferUpload) \
+    X(glUnmapNamedBuffer, BufferUpload) \
+    X(glTexImage2D, TextureUpload) \
+    X(glTexSubImage2D, TextureUpload) \
+    X(glTexImage3D, TextureUpload) \
+    X(glTexSubImage3D, TextureUpload) \
+    X(glTextureSubImage2D, TextureUpload) \
+    X(glTextureSubImage3D, TextureUpload) \
+    X(glGenerateMipmap, TextureUpload) \
+    X(glGenerateTextureMipmap, TextureUpload) \
+    X(glGenBuffers, Resource) \
+    X(glCreateBuffers, Resource) \
+    X(glDeleteBuffers, Resource) \
+    X(glGenTextures, Resource) \
+    X(glCreateTextures, Resource) \
+    X(glDeleteTextures, Resource) \
+    X(glTexStorage2D, Resource) \
+    X(glTexStorage3D, Resource) \
+    X(glTextureStorage2D, Resource) \
+    X(glTextureStorage3D, Resource) \
+    X(glGenFramebuffers, Resource) \
+    X(glCreateFramebuffers, Resource) \
+    X(glDeleteFramebuffers, Resource) \
+    X(glGenVertexArrays, Resource) \
+    X(glCreateVertexArrays, Resource) \
+    X(glDeleteVertexArrays, Resource) \
+    X(glFenceSync, Sync) \
+    X(glClientWaitSync, Sync) \
+    X(glDeleteSync, Sync) \
+    X(glQueryCounter, Sync) \
+    X(glGetQueryObjectuiv, Sync) \
+    X(glGetQueryObjectui64v, Sync) \
+    X(glFinish, Sync) \
+    X(glFlush, Sync) \
+    X(glReadPixels, Sync) \
+    X(glGetIntegerv, Sync)
+
+size_t getGLPixelByteSize(GLenum format, GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+        return 4; // Packed
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    }
+
+    size_t componentCount = 4;
+    switch (format)
+    {
+    case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+        componentCount = 1;
+        break;
+    case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+        componentCount = 2;
+        break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER:
+        componentCount = 3;
+        break;
+    }
+
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE: case GL_BYTE:
+        return componentCount;
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+        return 2 * componentCount;
+    default:
+        return 4 * componentCount;
+    }
+}
+
+namespace
+{
+
+enum Entry
+{
+#define GLMLV_ENTRY_ENUM(name, category) Entry_##name,
+    GLMLV_INTERCEPTED_GL_CALLS(GLMLV_ENTRY_ENUM)
+#undef GLMLV_ENTRY_ENUM
+    EntryCount
+};
+
+const char * const entryNames[EntryCount] =
+{
+#define GLMLV_ENTRY_NAME(name, category) #name,
+    GLMLV_INTERCEPTED_GL_CALLS(GLMLV_ENTRY_NAME)
+#undef GLMLV_ENTRY_NAME
+};
+
+const GLCallCategory entryCategories[EntryCount] =
+{
+#define GLMLV_ENTRY_CATEGORY(name, category) GLCallCategory::category,
+    GLMLV_INTERCEPTED_GL_CALLS(GLMLV_ENTRY_CATEGORY)
+#undef GLMLV_ENTRY_CATEGORY
+};
+
+struct FrameCounters
+{
+    std::array<GLCallCounters, EntryCount> entries;
+
+    void clear()
+    {
+        entries.fill(GLCallCounters());
+    }
+};
+
+FrameCounters currentFrame;
+FrameCounters lastFrame;
+FrameCounters totalCounters; // Sum of the complete frames
+size_t frameCount = 0;
+bool installed = false;
+
+// Bytes passed to an entry point, 0 if it does not transfer data
+template<size_t Index>
+struct TransferSize
+{
+    template<typename... Args>
+    static uint64_t get(Args...)
+    {
+        return 0;
+    }
+};
+
+#define GLMLV_TRANSFER_SIZE(name, parameters, expression) \
+    template<> struct TransferSize<Entry_##name> { static uint64_t get parameters { return uint64_t(expression); } };
+
+GLMLV_TRANSFER_SIZE(glBufferData, (GLenum, GLsizeiptr size, const void * data, GLenum), data ? size : 0)
+GLMLV_TRANSFER_SIZE(glBufferSubData, (GLenum, GLintptr, GLsizeiptr size, const void *), size)
+GLMLV_TRANSFER_SIZE(glBufferStorage, (GLenum, GLsizeiptr size, const void * data, GLbitfield), data ? size : 0)
+GLMLV_TRANSFER_SIZE(glNamedBufferData, (GLuint, GLsizeiptr size, const void * data, GLenum), data ? size : 0)
+GLMLV_TRANSFER_SIZE(glNamedBufferSubData, (GLuint, GLintptr, GLsizeiptr size, const void *), size)
+GLMLV_TRANSFER_SIZE(glNamedBufferStorage, (GLuint, GLsizeiptr size, const void * data, GLbitfield), data ? size : 0)
+GLMLV_TRANSFER_SIZE(glCopyNamedBufferSubData, (GLuint, GLuint, GLintptr, GLintptr, GLsizeiptr size), size)
+GLMLV_TRANSFER_SIZE(glTexImage2D, (GLenum, GLint, GLint, GLsizei w, GLsizei h, GLint, GLenum format, GLenum type, const void * pixels),
+    pixels ? w * h * getGLPixelByteSize(format, type) : 0)
+GLMLV_TRANSFER_SIZE(glTexSubImage2D, (GLenum, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, const void *),
+    w * h * getGLPixelByteSize(format, type))
+GLMLV_TRANSFER_SIZE(glTexImage3D, (GLenum, GLint, GLint, GLsizei w, GLsizei h, GLsizei d, GLint, GLenum format, GLenum type, const void * pixels),
+    pixels ? w * h * d * getGLPixelByteSize(format, type) : 0)
+GLMLV_TRANSFER_SIZE(glTexSubImage3D, (GLenum, GLint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLsizei d, GLenum format, GLenum type, const void *),
+    w * h * d * getGLPixelByteSize(format, type))
+GLMLV_TRANSFER_SIZE(glTextureSubImage2D, (GLuint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, const void *),
+    w * h * getGLPixelByteSize(format, type))
+GLMLV_TRANSFER_SIZE(glTextureSubImage3D, (GLuint, GLint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLsizei d, GLenum format, GLenum type, const void *),
+    w * h * d * getGLPixelByteSize(format, type))
+GLMLV_TRANSFER_SIZE(glReadPixels, (GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, void *), w * h * getGLPixelByteSize(format, type))
+GLMLV_TRANSFER_SIZE(glUniform1i, (GLint, GLint), 4)
+GLMLV_TRANSFER_SIZE(glUniform1ui, (GLint, GLuint), 4)
+GLMLV_TRANSFER_SIZE(glUniform1f, (GLint, GLfloat), 4)
+GLMLV_TRANSFER_SIZE(glUniform2f, (GLint, GLfloat, GLfloat), 8)
+GLMLV_TRANSFER_SIZE(glUniform3f, (GLint, GLfloat, GLfloat, GLfloat), 12)
+GLMLV_TRANSFER_SIZE(glUniform4f, (GLint, GLfloat, GLfloat, GLfloat, GLfloat), 16)
+GLMLV_TRANSFER_SIZE(glUniform1iv, (GLint, GLsizei count, const GLint *), 4 * count)
+GLMLV_TRANSFER_SIZE(glUniform1fv, (GLint, GLsizei count, const GLfloat *), 4 * count)
+GLMLV_TRANSFER_SIZE(glUniform2fv, (GLint, GLsizei count, const GLfloat *), 8 * count)
+GLMLV_TRANSFER_SIZE(glUniform3fv, (GLint, GLsizei count, const GLfloat *), 12 * count)
+GLMLV_TRANSFER_SIZE(glUniform4fv, (GLint, GLsizei count, const GLfloat *), 16 * count)
+GLMLV_TRANSFER_SIZE(glUniformMatrix3fv, (GLint, GLsizei count, GLboolean, const GLfloat *), 36 * count)
+GLMLV_TRANSFER_SIZE(glUniformMatrix4fv, (GLint, GLsizei count, GLboolean, const GLfloat *), 64 * count)
+GLMLV_TRANSFER_SIZE(glProgramUniform1i, (GLuint, GLint, GLint), 4)
+GLMLV_TRANSFER_SIZE(glProgramUniform1f, (GLuint, GLint, GLfloat), 4)
+GLMLV_TRANSFER_SIZE(glProgramUniform3fv, (GLuint, GLint, GLsizei count, const GLfloat *), 12 * count)
+GLMLV_TRANSFER_SIZE(glProgramUniformMatrix4fv, (GLuint, GLint, GLsizei count, GLboolean, const GLfloat *), 64 * count)
+
+#undef GLMLV_TRANSFER_SIZE
+
+// One instantiation per entry point: counts the call then forwards it to the function loaded by glad
+template<size_t Index, typename R, typename... Args>
+struct Trampoline
+{
+    static R (APIENTRYP original)(Args...);
+
+    static R APIENTRY call(Args... args)
+    {
+        auto & counters = currentFrame.entries[Index];
+        ++counters.calls;
+        counters.bytes += TransferSize<Index>::get(args...);
+        return original(args...);
+    }
+};
+
+template<size_t Index, typename R, typename... Args>
+R (APIENTRYP Trampoline<Index, R, Args...>::original)(Args...) = nullptr;
+
+template<size_t Index, typename R, typename... Args>
+void intercept(R (APIENTRYP & pointer)(Args...))
+{
+    using T = Trampoline<Index, R, Args...>;
+    if (!pointer || pointer == &T::call) {
+        return; // Not provided by the context, or already intercepted
+    }
+    T::original = pointer;
+    pointer = &T::call;
+}
+
+template<size_t Index, typename R, typename... Args>
+void restore(R (APIENTRYP & pointer)(Args...))
+{
+    using T = Trampoline<Index, R, Args...>;
+    if (pointer == &T::call) {
+        pointer = T::original;
+    }
+}
+
+GLCallCounters categoryCounters(const FrameCounters& counters, GLCallCategory category)
+{
+    GLCallCounters result;
+    for (size_t i = 0; i < EntryCount; ++i)
+    {
+        if (entryCategories[i] == category)
+        {
+            result.calls += counters.entries[i].calls;
+            result.bytes += counters.entries[i].bytes;
+        }
+    }
+    return result;
+}
+
+}
+
+const char * getGLCallCategoryName(GLCallCategory category)
+{
+    static const char * names[] = { "Draw", "State", "Uniform", "BufferUpload", "TextureUpload", "Resource", "Sync" };
+    return names[size_t(category)];
+}
+
+void installGLCallInterceptor()
+{
+#define GLMLV_INTERCEPT(name, category) intercept<Entry_##name>(glad_##name);
+    GLMLV_INTERCEPTED_GL_CALLS(GLMLV_INTERCEPT)
+#undef GLMLV_INTERCEPT
+
+    currentFrame.clear();
+    lastFrame.clear();
+    totalCounters.clear();
+    frameCount = 0;
+    installed = true;
+}
+
+void uninstallGLCallInterceptor()
+{
+#define GLMLV_RESTORE(name, category) restore<Entry_##name>(glad_##name);
+    GLMLV_INTERCEPTED_GL_CALLS(GLMLV_RESTORE)
+#undef GLMLV_RESTORE
+
+    installed = false;
+}
+
+bool isGLCallInterceptorInstalled()
+{
+    return installed;
+}
+
+void initGLCallStats()
+{
+    const auto value = std::getenv("GLMLV_GL_CALL_STATS");
+    if (value && std::strcmp(value, "1") == 0)
+    {
+        installGLCallInterceptor();
+        std::clog << "GL call statistics enabled (" << size_t(EntryCount) << " entry points intercepted)" << std::endl;
+    }
+}
+
+void endGLCallStatsFrame()
+{
+    if (!installed) {
+        return;
+    }
+
+    for (size_t i = 0; i < EntryCount; ++i)
+    {
+        totalCounters.entries[i].calls += currentFrame.entries[i].calls;
+        totalCounters.entries[i].bytes += currentFrame.entries[i].bytes;
+    }
+    lastFrame = currentFrame;
+    currentFrame.clear();
+    ++frameCount;
+}
+
+GLCallCounters getLastFrameGLCallCounters(GLCallCategory category)
+{
+    return categoryCounters(lastFrame, category);
+}
+
+size_t getGLCallStatsFrameCount()
+{
+    return frameCount;
+}
+
+void writeGLCallStatsJSON(const fs::path& path)
+{
+    if (path.has_parent_path() && !fs::exists(path.parent_path())) {
+        fs::create_directories(path.parent_path());
+    }
+
+    std::ofstream out(path.string());
+    if (!out)
+    {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        throw std::runtime_error("Unable to open " + path.string() + " for writing");
+    }
+
+    const auto averageDivisor = double(std::max(frameCount, size_t(1)));
+    const auto toJSON = [&](const GLCallCounters& last, const GLCallCounters& total)
+    {
+        nlohmann::json json;
+        json["calls"] = last.calls;
+        json["bytes"] = last.bytes;
+        json["averageCalls"] = total.calls / averageDivisor;
+        json["averageBytes"] = total.bytes / averageDivisor;
+        return json;
+    };
+
+    nlohmann::json json;
+    json["frameCount"] = frameCount;
+
+    auto & categories = json["categories"];
+    for (size_t i = 0; i < size_t(GLCallCategory::Count); ++i)
+    {
+        const auto category = GLCallCategory(i);
+        categories[getGLCallCategoryName(category)] = toJSON(categoryCounters(lastFrame, category), categoryCounters(totalCounters, category));
+    }
+
+    auto & entries = json["entryPoints"];
+    for (size_t i = 0; i < EntryCount; ++i)
+    {
+        if (!totalCounters.entries[i].calls) {
+            continue;
+        }
+        auto entry = toJSON(lastFrame.entries[i], totalCounters.entries[i]);
+        entry["category"] = getGLCallCategoryName(entryCategories[i]);
+        entries[entryNames[i]] = entry;
+    }
+
+    out << json.dump(2) << std::endl;
+}
+
+void drawGLCallStatsGUI(const fs::path& jsonPath)
+{
+    if (!installed)
+    {
+        ImGui::TextWrapped("GL calls are not intercepted, set GLMLV_GL_CALL_STATS=1 to enable it.");
+        return;
+    }
+
+    ImGui::Text("Last frame (%zu frames recorded)", frameCount);
+    ImGui::Columns(4, "GLCallStats");
+    ImGui::Separator();
+    for (const auto header : { "Category", "calls", "KB", "avg calls" })
+    {
+        ImGui::Text("%s", header);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    const auto averageDivisor = double(std::max(frameCount, size_t(1)));
+    for (size_t i = 0; i < size_t(GLCallCategory::Count); ++i)
+    {
+        const auto category = GLCallCategory(i);
+        const auto last = categoryCounters(lastFrame, category);
+        ImGui::Text("%s", getGLCallCategoryName(category));
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long) last.calls);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", last.bytes / 1024.);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", categoryCounters(totalCounters, category).calls / averageDivisor);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    if (ImGui::TreeNode("Entry points"))
+    {
+        // Called entry points of the last frame, most called first
+        std::vector<size_t> called;
+        for (size_t i = 0; i < EntryCount; ++i)
+        {
+            if (lastFrame.entries[i].calls) {
+                called.emplace_back(i);
+            }
+        }
+        std::sort(begin(called), end(called), [&](size_t lhs, size_t rhs)
+        {
+            return lastFrame.entries[lhs].calls > lastFrame.entries[rhs].calls;
+        });
+        for (const auto i : called) {
+            ImGui::Text("%6llu %s (%s)", (unsigned long long) lastFrame.entries[i].calls, entryNames[i], getGLCallCategoryName(entryCategories[i]));
+        }
+        ImGui::TreePop();
+    }
+
+    if (ImGui::Button("Export JSON")) {
+        writeGLCallStatsJSON(jsonPath);
+    }
+}
+
+}
@@ -0,0 +1,1957 @@
+#include <glmlv/gl_command_trace.hpp>
+#include <glmlv/gl_call_stats.hpp>
+#include <glmlv/indirect_draw.hpp>
+
+#include <array>
+#include <tuple>
+#include <utility>
+#include <unordered_set>
+#include <type_traits>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+namespace glmlv
+{
+
+// X(entry point, (argument kinds)): one kind per parameter, see the codecs below.
+// Every recorded entry point returns void: calls whose result is used by the application (glMapBufferRange, glFenceSync, ...)
+// cannot be replayed faithfully and are not recorded.
+#define GLMLV_RECORDED_GL_CALLS(X) \
+    X(glDrawArrays, (Value, Value, Value)) \
+    X(glDrawElements, (Value, Value, Value, Offset)) \
+    X(glDrawArraysInstanced, (Value, Value, Value, Value)) \
+    X(glDrawElementsInstanced, (Value, Value, Value, Offset, Value)) \
+    X(glDrawElementsBaseVertex, (Value, Value, Value, Offset, Value)) \
+    X(glDrawElementsInstancedBaseVertex, (Value, Value, Value, Offset, Value, Value)) \
+    X(glDrawElementsInstancedBaseInstance, (Value, Value, Value, Offset, Value, Value)) \
+    X(glDrawArraysInstancedBaseInstance, (Value, Value, Value, Value, Value)) \
+    X(glDrawElementsInstancedBaseVertexBaseInstance, (Value, Value, Value, Offset, Value, Value, Value)) \
+    X(glDrawArraysIndirect, (Value, Offset)) \
+    X(glDrawElementsIndirect, (Value, Value, Offset)) \
+    X(glMultiDrawArraysIndirect, (Value, Offset, Value, Value)) \
+    X(glMultiDrawElementsIndirect, (Value, Value, Offset, Value, Value)) \
+    X(glMultiDrawElementsIndirectCount, (Value, Value, Offset, Value, Value, Value)) \
+    X(glDispatchCompute, (Value, Value, Value)) \
+    X(glDispatchComputeIndirect, (Value)) \
+    X(glMemoryBarrier, (Value)) \
+    X(glClear, (Value)) \
+    X(glClearBufferfv, (Value, Value, Data)) \
+    X(glClearNamedFramebufferfv, (FramebufferName, Value, Value, Data)) \
+    X(glBlitFramebuffer, (Value, Value, Value, Value, Value, Value, Value, Value, Value, Value)) \
+    X(glBlitNamedFramebuffer, (FramebufferName, FramebufferName, Value, Value, Value, Value, Value, Value, Value, Value, Value, Value)) \
+    X(glUseProgram, (ProgramName)) \
+    X(glBindVertexArray, (VertexArrayName)) \
+    X(glBindBuffer, (Value, BufferName)) \
+    X(glBindBufferBase, (Value, Value, BufferName)) \
+    X(glBindBufferRange, (Value, Value, BufferName, Value, Value)) \
+    X(glBindTexture, (Value, TextureName)) \
+    X(glBindTextureUnit, (Value, TextureName)) \
+    X(glActiveTexture, (Value)) \
+    X(glBindSampler, (Value, SamplerName)) \
+    X(glBindImageTexture, (Value, TextureName, Value, Value, Value, Value, Value)) \
+    X(glBindFramebuffer, (Value, FramebufferName)) \
+    X(glEnable, (Value)) \
+    X(glDisable, (Value)) \
+    X(glViewport, (Value, Value, Value, Value)) \
+    X(glScissor, (Value, Value, Value, Value)) \
+    X(glBlendFunc, (Value, Value)) \
+    X(glBlendFuncSeparate, (Value, Value, Value, Value)) \
+    X(glBlendEquation, (Value)) \
+    X(glBlendEquationSeparate, (Value, Value)) \
+    X(glDepthFunc, (Value)) \
+    X(glDepthMask, (Value)) \
+    X(glColorMask, (Value, Value, Value, Value)) \
+    X(glCullFace, (Value)) \
+    X(glFrontFace, (Value)) \
+    X(glPolygonMode, (Value, Value)) \
+    X(glPolygonOffset, (Value, Value)) \
+    X(glClearColor, (Value, Value, Value, Value)) \
+    X(glClearDepth, (Value)) \
+    X(glPixelStorei, (Value, Value)) \
+    X(glReadBuffer, (Value)) \
+    X(glDrawBuffers, (Value, Data)) \
+    X(glNamedFramebufferDrawBuffers, (FramebufferName, Value, Data)) \
+    X(glNamedFramebufferReadBuffer, (FramebufferName, Value)) \
+    X(glNamedFramebufferTexture, (FramebufferName, Value, TextureName, Value)) \
+    X(glNamedFramebufferTextureLayer, (FramebufferName, Value, TextureName, Value, Value)) \
+    X(glFramebufferTexture2D, (Value, Value, Value, TextureName, Value)) \
+    X(glPushDebugGroup, (Value, Value, Value, Data)) \
+    X(glPopDebugGroup, ()) \
+    X(glEnableVertexAttribArray, (Value)) \
+    X(glDisableVertexAttribArray, (Value)) \
+    X(glVertexAttribPointer, (Value, Value, Value, Value, Value, Offset)) \
+    X(glVertexAttribIPointer, (Value, Value, Value, Value, Offset)) \
+    X(glVertexAttribDivisor, (Value, Value)) \
+    X(glVertexArrayVertexBuffer, (VertexArrayName, Value, BufferName, Value, Value)) \
+    X(glVertexArrayElementBuffer, (VertexArrayName, BufferName)) \
+    X(glEnableVertexArrayAttrib, (VertexArrayName, Value)) \
+    X(glDisableVertexArrayAttrib, (VertexArrayName, Value)) \
+    X(glVertexArrayAttribFormat, (VertexArrayName, Value, Value, Value, Value, Value)) \
+    X(glVertexArrayAttribIFormat, (VertexArrayName, Value, Value, Value, Value)) \
+    X(glVertexArrayAttribBinding, (VertexArrayName, Value, Value)) \
+    X(glVertexArrayBindingDivisor, (VertexArrayName, Value, Value)) \
+    X(glUniform1i, (Value, Value)) \
+    X(glUniform1ui, (Value, Value)) \
+    X(glUniform1f, (Value, Value)) \
+    X(glUniform2f, (Value, Value, Value)) \
+    X(glUniform3f, (Value, Value, Value, Value)) \
+    X(glUniform4f, (Value, Value, Value, Value, Value)) \
+    X(glUniform1iv, (Value, Value, Data)) \
+    X(glUniform1fv, (Value, Value, Data)) \
+    X(glUniform2fv, (Value, Value, Data)) \
+    X(glUniform3fv, (Value, Value, Data)) \
+    X(glUniform4fv, (Value, Value, Data)) \
+    X(glUniformMatrix3fv, (Value, Value, Value, Data)) \
+    X(glUniformMatrix4fv, (Value, Value, Value, Data)) \
+    X(glProgramUniform1i, (ProgramName, Value, Value)) \
+    X(glProgramUniform1f, (ProgramName, Value, Value)) \
+    X(glProgramUniform3fv, (ProgramName, Value, Value, Data)) \
+    X(glProgramUniformMatrix4fv, (ProgramName, Value, Value, Value, Data)) \
+    X(glUniformBlockBinding, (ProgramName, Value, Value)) \
+    X(glShaderStorageBlockBinding, (ProgramName, Value, Value)) \
+    X(glBufferData, (Value, Value, Data, Value)) \
+    X(glBufferSubData, (Value, Value, Value, Data)) \
+    X(glBufferStorage, (Value, Value, Data, Value)) \
+    X(glNamedBufferData, (BufferName, Value, Data, Value)) \
+    X(glNamedBufferSubData, (BufferName, Value, Value, Data)) \
+    X(glNamedBufferStorage, (BufferName, Value, Data, Value)) \
+    X(glCopyBufferSubData, (Value, Value, Value, Value, Value)) \
+    X(glCopyNamedBufferSubData, (BufferName, BufferName, Value, Value, Value)) \
+    X(glClearNamedBufferSubData, (BufferName, Value, Value, Value, Value, Value, Data)) \
+    X(glTexImage2D, (Value, Value, Value, Value, Value, Value, Value, Value, Data)) \
+    X(glTexSubImage2D, (Value, Value, Value, Value, Value, Value, Value, Value, Data)) \
+    X(glTexSubImage3D, (Value, Value, Value, Value, Value, Value, Value, Value, Value, Value, Data)) \
+    X(glTextureSubImage2D, (TextureName, Value, Value, Value, Value, Value, Value, Value, Data)) \
+    X(glTextureSubImage3D, (TextureName, Value, Value, Value, Value, Value, Value, Value, Value, Value, Data)) \
+    X(glGenerateMipmap, (Value)) \
+    X(glGenerateTextureMipmap, (TextureName)) \
+    X(glTexParameteri, (Value, Value, Value)) \
+    X(glTexParameteriv, (Value, Value, Data)) \
+    X(glTextureParameteri, (TextureName, Value, Value)) \
+    X(glTextureParameterf, (TextureName, Value, Value)) \
+    X(glSamplerParameteri, (SamplerName, Value, Value)) \
+    X(glSamplerParameterf, (SamplerName, Value, Value)) \
+    X(glTexStorage2D, (Value, Value, Value, Value, Value)) \
+    X(glTexStorage3D, (Value, Value, Value, Value, Value, Value)) \
+    X(glTextureStorage2D, (TextureName, Value, Value, Value, Value)) \
+    X(glTextureStorage3D, (TextureName, Value, Value, Value, Value, Value)) \
+    X(glGenBuffers, (Value, NewNames<ObjectType::Buffer, 0>)) \
+    X(glCreateBuffers, (Value, NewNames<ObjectType::Buffer, 0>)) \
+    X(glDeleteBuffers, (Value, DeletedNames<ObjectType::Buffer, 0>)) \
+    X(glGenTextures, (Value, NewNames<ObjectType::Texture, 0>)) \
+    X(glCreateTextures, (Value, Value, NewNames<ObjectType::Texture, 1>)) \
+    X(glDeleteTextures, (Value, DeletedNames<ObjectType::Texture, 0>)) \
+    X(glGenSamplers, (Value, NewNames<ObjectType::Sampler, 0>)) \
+    X(glCreateSamplers, (Value, NewNames<ObjectType::Sampler, 0>)) \
+    X(glDeleteSamplers, (Value, DeletedNames<ObjectType::Sampler, 0>)) \
+    X(glGenVertexArrays, (Value, NewNames<ObjectType::VertexArray, 0>)) \
+    X(glCreateVertexArrays, (Value, NewNames<ObjectType::VertexArray, 0>)) \
+    X(glDeleteVertexArrays, (Value, DeletedNames<ObjectType::VertexArray, 0>)) \
+    X(glGenFramebuffers, (Value, NewNames<ObjectType::Framebuffer, 0>)) \
+    X(glCreateFramebuffers, (Value, NewNames<ObjectType::Framebuffer, 0>)) \
+    X(glDeleteFramebuffers, (Value, DeletedNames<ObjectType::Framebuffer, 0>))
+
+namespace
+{
+
+const char traceMagic[8] = { 'G', 'L', 'M', 'L', 'V', 'T', 'R', 'C' };
+const uint32_t traceVersion = 1;
+
+enum class ObjectType : uint8_t
+{
+    Buffer,
+    Texture,
+    Sampler,
+    Program,
+    VertexArray,
+    Framebuffer,
+    Count
+};
+
+// Argument kinds
+struct Value {}; // Copied as is
+struct Offset {}; // Pointer parameter holding an offset in the bound buffer (indices, indirect commands, vertex attributes)
+struct Data {}; // Client memory read by the call, of DataSize<Entry>::get(arguments...) bytes
+template<ObjectType Type> struct Name {}; // Object name, remapped to the name created by the replay
+template<ObjectType Type, size_t CountParameter> struct NewNames {}; // Names written by glGen* / glCreate*
+template<ObjectType Type, size_t CountParameter> struct DeletedNames {}; // Names read by glDelete*
+
+using BufferName = Name<ObjectType::Buffer>;
+using TextureName = Name<ObjectType::Texture>;
+using SamplerName = Name<ObjectType::Sampler>;
+using ProgramName = Name<ObjectType::Program>;
+using VertexArrayName = Name<ObjectType::VertexArray>;
+using FramebufferName = Name<ObjectType::Framebuffer>;
+
+enum Entry
+{
+#define GLMLV_ENTRY_ENUM(name, kinds) Entry_##name,
+    GLMLV_RECORDED_GL_CALLS(GLMLV_ENTRY_ENUM)
+#undef GLMLV_ENTRY_ENUM
+    EntryCount
+};
+
+const char * const entryNames[EntryCount] =
+{
+#define GLMLV_ENTRY_NAME(name, kinds) #name,
+    GLMLV_RECORDED_GL_CALLS(GLMLV_ENTRY_NAME)
+#undef GLMLV_ENTRY_NAME
+};
+
+template<size_t Index>
+struct EntryKinds;
+
+#define GLMLV_KIND_TUPLE(...) std::tuple<__VA_ARGS__>
+#define GLMLV_ENTRY_KINDS(name, kinds) template<> struct EntryKinds<Entry_##name> { using type = GLMLV_KIND_TUPLE kinds; };
+GLMLV_RECORDED_GL_CALLS(GLMLV_ENTRY_KINDS)
+#undef GLMLV_ENTRY_KINDS
+#undef GLMLV_KIND_TUPLE
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Size of an image read from client memory with the current unpack parameters
+size_t unpackedImageByteSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+    if (width <= 0 || height <= 0 || depth <= 0) {
+        return 0;
+    }
+    GLint alignment = 4, rowLength = 0, imageHeight = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+    glGetIntegerv(GL_UNPACK_IMAGE_HEIGHT, &imageHeight);
+
+    const auto pixelByteSize = getGLPixelByteSize(format, type);
+    const auto rowByteSize = roundUp(size_t(rowLength > 0 ? rowLength : width) * pixelByteSize, size_t(std::max(alignment, 1)));
+    const auto imageRowCount = size_t(imageHeight > 0 ? imageHeight : height);
+    return rowByteSize * (imageRowCount * (depth - 1) + (height - 1)) + width * pixelByteSize;
+}
+
+// Bytes read by an entry point from its Data parameter
+template<size_t Index>
+struct DataSize;
+
+#define GLMLV_DATA_SIZE(name, parameters, expression) \
+    template<> struct DataSize<Entry_##name> { static size_t get parameters { return size_t(expression); } };
+
+GLMLV_DATA_SIZE(glClearBufferfv, (GLenum buffer, GLint, const GLfloat *), buffer == GL_COLOR ? 16 : 4)
+GLMLV_DATA_SIZE(glClearNamedFramebufferfv, (GLuint, GLenum buffer, GLint, const GLfloat *), buffer == GL_COLOR ? 16 : 4)
+GLMLV_DATA_SIZE(glDrawBuffers, (GLsizei n, const GLenum *), n * sizeof(GLenum))
+GLMLV_DATA_SIZE(glNamedFramebufferDrawBuffers, (GLuint, GLsizei n, const GLenum *), n * sizeof(GLenum))
+GLMLV_DATA_SIZE(glPushDebugGroup, (GLenum, GLuint, GLsizei length, const GLchar * message), length < 0 ? std::strlen(message) + 1 : length)
+GLMLV_DATA_SIZE(glUniform1iv, (GLint, GLsizei count, const GLint *), 4 * count)
+GLMLV_DATA_SIZE(glUniform1fv, (GLint, GLsizei count, const GLfloat *), 4 * count)
+GLMLV_DATA_SIZE(glUniform2fv, (GLint, GLsizei count, const GLfloat *), 8 * count)
+GLMLV_DATA_SIZE(glUniform3fv, (GLint, GLsizei count, const GLfloat *), 12 * count)
+GLMLV_DATA_SIZE(glUniform4fv, (GLint, GLsizei count, const GLfloat *), 16 * count)
+GLMLV_DATA_SIZE(glUniformMatrix3fv, (GLint, GLsizei count, GLboolean, const GLfloat *), 36 * count)
+GLMLV_DATA_SIZE(glUniformMatrix4fv, (GLint, GLsizei count, GLboolean, const GLfloat *), 64 * count)
+GLMLV_DATA_SIZE(glProgramUniform3fv, (GLuint, GLint, GLsizei count, const GLfloat *), 12 * count)
+GLMLV_DATA_SIZE(glProgramUniformMatrix4fv, (GLuint, GLint, GLsizei count, GLboolean, const GLfloat *), 64 * count)
+GLMLV_DATA_SIZE(glBufferData, (GLenum, GLsizeiptr size, const void *, GLenum), size)
+GLMLV_DATA_SIZE(glBufferSubData, (GLenum, GLintptr, GLsizeiptr size, const void *), size)
+GLMLV_DATA_SIZE(glBufferStorage, (GLenum, GLsizeiptr size, const void *, GLbitfield), size)
+GLMLV_DATA_SIZE(glNamedBufferData, (GLuint, GLsizeiptr size, const void *, GLenum), size)
+GLMLV_DATA_SIZE(glNamedBufferSubData, (GLuint, GLintptr, GLsizeiptr size, const void *), size)
+GLMLV_DATA_SIZE(glNamedBufferStorage, (GLuint, GLsizeiptr size, const void *, GLbitfield), size)
+GLMLV_DATA_SIZE(glClearNamedBufferSubData, (GLuint, GLenum, GLintptr, GLsizeiptr, GLenum format, GLenum type, const void *),
+    getGLPixelByteSize(format, type))
+GLMLV_DATA_SIZE(glTexImage2D, (GLenum, GLint, GLint, GLsizei w, GLsizei h, GLint, GLenum format, GLenum type, const void *),
+    unpackedImageByteSize(w, h, 1, format, type))
+GLMLV_DATA_SIZE(glTexSubImage2D, (GLenum, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, const void *),
+    unpackedImageByteSize(w, h, 1, format, type))
+GLMLV_DATA_SIZE(glTexSubImage3D, (GLenum, GLint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLsizei d, GLenum format, GLenum type, const void *),
+    unpackedImageByteSize(w, h, d, format, type))
+GLMLV_DATA_SIZE(glTextureSubImage2D, (GLuint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, const void *),
+    unpackedImageByteSize(w, h, 1, format, type))
+GLMLV_DATA_SIZE(glTextureSubImage3D, (GLuint, GLint, GLint, GLint, GLint, GLsizei w, GLsizei h, GLsizei d, GLenum format, GLenum type, const void *),
+    unpackedImageByteSize(w, h, d, format, type))
+GLMLV_DATA_SIZE(glTexParameteriv, (GLenum, GLenum pname, const GLint *),
+    pname == GL_TEXTURE_SWIZZLE_RGBA || pname == GL_TEXTURE_BORDER_COLOR ? 4 * sizeof(GLint) : sizeof(GLint))
+
+#undef GLMLV_DATA_SIZE
+
+// Blobs (Data arguments, buffer and texture contents, program binaries) start at a multiple of 8 bytes from the start of
+// their section, so that the replay can give the driver pointers into the loaded trace
+class ByteWriter
+{
+public:
+    template<typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written");
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(const void * pData, size_t byteSize)
+    {
+        const auto pBytes = static_cast<const unsigned char *>(pData);
+        m_Bytes.insert(end(m_Bytes), pBytes, pBytes + byteSize);
+    }
+
+    // Size, then the bytes (zeros if pData is null). Return the offset of the bytes, to fill them later.
+    size_t writeBlob(const void * pData, size_t byteSize)
+    {
+        write(uint64_t(byteSize));
+        m_Bytes.resize(roundUp(m_Bytes.size(), 8));
+        const auto offset = m_Bytes.size();
+        if (pData) {
+            writeBytes(pData, byteSize);
+        }
+        else {
+            m_Bytes.resize(offset + byteSize);
+        }
+        return offset;
+    }
+
+    std::vector<unsigned char>& bytes()
+    {
+        return m_Bytes;
+    }
+
+private:
+    std::vector<unsigned char> m_Bytes;
+};
+
+class ByteReader
+{
+public:
+    explicit ByteReader(const std::vector<unsigned char>& bytes): m_Bytes(bytes)
+    {
+    }
+
+    template<typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, advance(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    const void * readBlob(size_t& byteSize)
+    {
+        byteSize = size_t(read<uint64_t>());
+        m_nOffset = roundUp(m_nOffset, 8);
+        return advance(byteSize);
+    }
+
+    const void * readBlob()
+    {
+        size_t byteSize;
+        return readBlob(byteSize);
+    }
+
+    bool atEnd() const
+    {
+        return m_nOffset >= m_Bytes.size();
+    }
+
+private:
+    const unsigned char * advance(size_t byteSize)
+    {
+        if (m_nOffset + byteSize > m_Bytes.size())
+        {
+            std::cerr << "Truncated GL trace" << std::endl;
+            throw std::runtime_error("Truncated GL trace");
+        }
+        const auto pBytes = m_Bytes.data() + m_nOffset;
+        m_nOffset += byteSize;
+        return pBytes;
+    }
+
+    const std::vector<unsigned char>& m_Bytes;
+    size_t m_nOffset = 0;
+};
+
+// Parameters saved for textures and samplers
+const GLenum textureIntParameters[] = {
+    GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R, GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC,
+    GL_TEXTURE_BASE_LEVEL, GL_TEXTURE_MAX_LEVEL, GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A
+};
+const GLenum samplerIntParameters[] = {
+    GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R, GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC
+};
+const GLenum floatParameters[] = { GL_TEXTURE_MIN_LOD, GL_TEXTURE_MAX_LOD, GL_TEXTURE_LOD_BIAS };
+
+const size_t maxVertexAttribCount = 16;
+const size_t maxFramebufferDrawBufferCount = 8;
+const GLenum framebufferAttachments[] = {
+    GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5,
+    GL_COLOR_ATTACHMENT6, GL_COLOR_ATTACHMENT7, GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT
+};
+
+// Default block uniforms: scalar type ('f', 'i' or 'u') and number of components. Samplers and images are one int.
+struct UniformType
+{
+    GLenum type;
+    char scalar;
+    GLint componentCount;
+};
+
+const UniformType uniformTypes[] = {
+    { GL_FLOAT, 'f', 1 }, { GL_FLOAT_VEC2, 'f', 2 }, { GL_FLOAT_VEC3, 'f', 3 }, { GL_FLOAT_VEC4, 'f', 4 },
+    { GL_FLOAT_MAT2, 'f', 4 }, { GL_FLOAT_MAT3, 'f', 9 }, { GL_FLOAT_MAT4, 'f', 16 }, { GL_FLOAT_MAT2x3, 'f', 6 }, { GL_FLOAT_MAT2x4, 'f', 8 },
+    { GL_FLOAT_MAT3x2, 'f', 6 }, { GL_FLOAT_MAT3x4, 'f', 12 }, { GL_FLOAT_MAT4x2, 'f', 8 }, { GL_FLOAT_MAT4x3, 'f', 12 },
+    { GL_INT, 'i', 1 }, { GL_INT_VEC2, 'i', 2 }, { GL_INT_VEC3, 'i', 3 }, { GL_INT_VEC4, 'i', 4 },
+    { GL_BOOL, 'i', 1 }, { GL_BOOL_VEC2, 'i', 2 }, { GL_BOOL_VEC3, 'i', 3 }, { GL_BOOL_VEC4, 'i', 4 },
+    { GL_UNSIGNED_INT, 'u', 1 }, { GL_UNSIGNED_INT_VEC2, 'u', 2 }, { GL_UNSIGNED_INT_VEC3, 'u', 3 }, { GL_UNSIGNED_INT_VEC4, 'u', 4 },
+    { GL_DOUBLE, 0, 0 }, { GL_DOUBLE_VEC2, 0, 0 }, { GL_DOUBLE_VEC3, 0, 0 }, { GL_DOUBLE_VEC4, 0, 0 },
+    { GL_DOUBLE_MAT2, 0, 0 }, { GL_DOUBLE_MAT3, 0, 0 }, { GL_DOUBLE_MAT4, 0, 0 } // Not supported
+};
+
+UniformType getUniformType(GLenum type)
+{
+    for (const auto & uniformType : uniformTypes)
+    {
+        if (uniformType.type == type) {
+            return uniformType;
+        }
+    }
+    return { type, 'i', 1 };
+}
+
+void setUniform(GLuint program, GLint location, const UniformType& type, const void * pValues)
+{
+    const auto pFloats = static_cast<const GLfloat *>(pValues);
+    const auto pInts = static_cast<const GLint *>(pValues);
+    const auto pUints = static_cast<const GLuint *>(pValues);
+    switch (type.type)
+    {
+    case GL_FLOAT_MAT2: glProgramUniformMatrix2fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT2x3: glProgramUniformMatrix2x3fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT2x4: glProgramUniformMatrix2x4fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT3x2: glProgramUniformMatrix3x2fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT3x4: glProgramUniformMatrix3x4fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT4x2: glProgramUniformMatrix4x2fv(program, location, 1, GL_FALSE, pFloats); return;
+    case GL_FLOAT_MAT4x3: glProgramUniformMatrix4x3fv(program, location, 1, GL_FALSE, pFloats); return;
+    }
+
+    switch (type.scalar * 8 + type.componentCount)
+    {
+    case 'f' * 8 + 1: glProgramUniform1fv(program, location, 1, pFloats); break;
+    case 'f' * 8 + 2: glProgramUniform2fv(program, location, 1, pFloats); break;
+    case 'f' * 8 + 3: glProgramUniform3fv(program, location, 1, pFloats); break;
+    case 'f' * 8 + 4: glProgramUniform4fv(program, location, 1, pFloats); break;
+    case 'i' * 8 + 1: glProgramUniform1iv(program, location, 1, pInts); break;
+    case 'i' * 8 + 2: glProgramUniform2iv(program, location, 1, pInts); break;
+    case 'i' * 8 + 3: glProgramUniform3iv(program, location, 1, pInts); break;
+    case 'i' * 8 + 4: glProgramUniform4iv(program, location, 1, pInts); break;
+    case 'u' * 8 + 1: glProgramUniform1uiv(program, location, 1, pUints); break;
+    case 'u' * 8 + 2: glProgramUniform2uiv(program, location, 1, pUints); break;
+    case 'u' * 8 + 3: glProgramUniform3uiv(program, location, 1, pUints); break;
+    case 'u' * 8 + 4: glProgramUniform4uiv(program, location, 1, pUints); break;
+    }
+}
+
+// GL state saved at the start of the recorded frame and restored before each replayed frame
+const GLenum stateCapabilities[] = {
+    GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE,
+    GL_PRIMITIVE_RESTART, GL_PROGRAM_POINT_SIZE, GL_TEXTURE_CUBE_MAP_SEAMLESS, GL_RASTERIZER_DISCARD
+};
+const GLenum stateBufferTargets[] = {
+    GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+    GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER
+};
+const GLenum stateBufferBindings[] = {
+    GL_ARRAY_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING, GL_DISPATCH_INDIRECT_BUFFER_BINDING, GL_DRAW_INDIRECT_BUFFER_BINDING,
+    GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING
+};
+const GLenum stateTextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP };
+const GLenum stateTextureBindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_CUBE_MAP };
+
+const size_t stateTextureUnitCount = 32;
+const size_t stateIndexedBindingCount = 32;
+const size_t stateCapabilityCount = sizeof(stateCapabilities) / sizeof(stateCapabilities[0]);
+const size_t stateBufferTargetCount = sizeof(stateBufferTargets) / sizeof(stateBufferTargets[0]);
+const size_t stateTextureTargetCount = sizeof(stateTextureTargets) / sizeof(stateTextureTargets[0]);
+
+struct IndexedBufferBinding
+{
+    GLint buffer;
+    GLint64 offset;
+    GLint64 size; // 0 if bound with glBindBufferBase
+};
+
+struct GLStateSnapshot
+{
+    GLboolean capabilities[stateCapabilityCount];
+    GLint viewport[4];
+    GLint scissorBox[4];
+    GLfloat clearColor[4];
+    GLfloat clearDepth;
+    GLint depthFunc;
+    GLboolean depthMask;
+    GLboolean colorMask[4];
+    GLint blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+    GLint blendEquationRGB, blendEquationAlpha;
+    GLint cullFaceMode;
+    GLint frontFace;
+    GLint polygonMode[2];
+    GLfloat polygonOffsetFactor, polygonOffsetUnits;
+    GLint unpackAlignment, packAlignment;
+    GLint program;
+    GLint vertexArray;
+    GLint drawFramebuffer, readFramebuffer;
+    GLint buffers[stateBufferTargetCount];
+    GLint activeTexture;
+    GLint textures[stateTextureUnitCount][stateTextureTargetCount];
+    GLint samplers[stateTextureUnitCount];
+    IndexedBufferBinding uniformBuffers[stateIndexedBindingCount];
+    IndexedBufferBinding storageBuffers[stateIndexedBindingCount];
+};
+
+size_t getIntegerMin(GLenum pname, size_t maxValue)
+{
+    GLint value = 0;
+    glGetIntegerv(pname, &value);
+    return std::min(size_t(std::max(value, 0)), maxValue);
+}
+
+struct Recorder
+{
+    fs::path path;
+    bool pending = false;
+    bool recording = false;
+    int pauseDepth = 0; // > 0 while the recorder issues its own GL calls
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+
+    ByteWriter objects;
+    ByteWriter state;
+    ByteWriter commands;
+    size_t objectCount = 0;
+    size_t commandCount = 0;
+
+    std::unordered_set<uint64_t> knownObjects; // Saved, or created during the frame
+    std::vector<std::pair<GLuint, size_t>> mappedBuffers; // Persistently mapped buffers and the offset of their contents in objects
+
+    bool isActive() const
+    {
+        return recording && !pauseDepth;
+    }
+
+    void reference(ObjectType type, GLuint name);
+
+    void markCreated(ObjectType type, GLuint name)
+    {
+        knownObjects.insert(key(type, name));
+    }
+
+    static uint64_t key(ObjectType type, GLuint name)
+    {
+        return (uint64_t(type) << 32) | name;
+    }
+
+private:
+    void beginObject(ObjectType type, GLuint name, bool exists)
+    {
+        objects.write(uint8_t(type));
+        objects.write(uint32_t(name));
+        objects.write(uint8_t(exists));
+        ++objectCount;
+    }
+
+    void saveBuffer(GLuint name);
+    void saveTexture(GLuint name);
+    void saveSampler(GLuint name);
+    void saveProgram(GLuint name);
+    void saveVertexArray(GLuint name);
+    void saveFramebuffer(GLuint name);
+};
+
+Recorder recorder;
+
+// The GL calls of the recorder itself (queries, temporary bindings) go through the trampolines without being recorded
+struct PauseRecording
+{
+    PauseRecording()
+    {
+        ++recorder.pauseDepth;
+    }
+
+    ~PauseRecording()
+    {
+        --recorder.pauseDepth;
+    }
+};
+
+void Recorder::reference(ObjectType type, GLuint name)
+{
+    if (!name || !knownObjects.insert(key(type, name)).second) {
+        return;
+    }
+
+    PauseRecording pause;
+    switch (type)
+    {
+    case ObjectType::Buffer: saveBuffer(name); break;
+    case ObjectType::Texture: saveTexture(name); break;
+    case ObjectType::Sampler: saveSampler(name); break;
+    case ObjectType::Program: saveProgram(name); break;
+    case ObjectType::VertexArray: saveVertexArray(name); break;
+    case ObjectType::Framebuffer: saveFramebuffer(name); break;
+    default: break;
+    }
+}
+
+void Recorder::saveBuffer(GLuint name)
+{
+    // A name returned by glGenBuffers but never bound is not an object yet: the replay only generates a name
+    if (!glIsBuffer(name))
+    {
+        beginObject(ObjectType::Buffer, name, false);
+        return;
+    }
+
+    GLint64 byteSize = 0;
+    GLint immutable = 0, storageFlags = 0, usage = 0, mapped = 0, accessFlags = 0;
+    glGetNamedBufferParameteri64v(name, GL_BUFFER_SIZE, &byteSize);
+    glGetNamedBufferParameteriv(name, GL_BUFFER_IMMUTABLE_STORAGE, &immutable);
+    glGetNamedBufferParameteriv(name, GL_BUFFER_STORAGE_FLAGS, &storageFlags);
+    glGetNamedBufferParameteriv(name, GL_BUFFER_USAGE, &usage);
+    glGetNamedBufferParameteriv(name, GL_BUFFER_MAPPED, &mapped);
+    glGetNamedBufferParameteriv(name, GL_BUFFER_ACCESS_FLAGS, &accessFlags);
+
+    beginObject(ObjectType::Buffer, name, true);
+    objects.write(int32_t(immutable));
+    objects.write(uint32_t(storageFlags));
+    objects.write(uint32_t(usage));
+    const auto offset = objects.writeBlob(nullptr, size_t(byteSize));
+
+    const bool persistent = (accessFlags & GL_MAP_PERSISTENT_BIT) != 0;
+    if (mapped && !persistent)
+    {
+        std::cerr << "GL trace: buffer " << name << " is mapped, its contents are not saved" << std::endl;
+        return;
+    }
+    if (byteSize) {
+        glGetNamedBufferSubData(name, 0, GLsizeiptr(byteSize), objects.bytes().data() + offset);
+    }
+    if (mapped) {
+        mappedBuffers.emplace_back(name, offset);
+    }
+}
+
+void Recorder::saveTexture(GLuint name)
+{
+    GLint target = 0;
+    if (glIsTexture(name)) {
+        glGetTextureParameteriv(name, GL_TEXTURE_TARGET, &target);
+    }
+    if (!target)
+    {
+        beginObject(ObjectType::Texture, name, false);
+        return;
+    }
+    if (target != GL_TEXTURE_2D && target != GL_TEXTURE_2D_ARRAY && target != GL_TEXTURE_3D && target != GL_TEXTURE_CUBE_MAP)
+    {
+        std::cerr << "GL trace: texture " << name << " has an unsupported target (" << target << "), it is not saved" << std::endl;
+        beginObject(ObjectType::Texture, name, false);
+        return;
+    }
+
+    GLint internalFormat = 0, width = 0, height = 0, depth = 0, depthSize = 0, stencilSize = 0;
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_DEPTH, &depth);
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_DEPTH_SIZE, &depthSize);
+    glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_STENCIL_SIZE, &stencilSize);
+    if (target == GL_TEXTURE_CUBE_MAP) {
+        depth = 6; // Faces are read and written as the layers of a 2D array
+    }
+
+    GLint immutable = 0, levelCount = 0;
+    glGetTextureParameteriv(name, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+    if (immutable) {
+        glGetTextureParameteriv(name, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+    }
+    else
+    {
+        for (GLint levelWidth = width; levelCount < 16 && levelWidth > 0; ++levelCount) {
+            glGetTextureLevelParameteriv(name, levelCount + 1, GL_TEXTURE_WIDTH, &levelWidth);
+        }
+    }
+
+    // Read back in the format the driver prefers for this internal format
+    GLint format = 0, type = 0;
+    glGetInternalformativ(target, internalFormat, GL_GET_TEXTURE_IMAGE_FORMAT, 1, &format);
+    glGetInternalformativ(target, internalFormat, GL_GET_TEXTURE_IMAGE_TYPE, 1, &type);
+    if (!format || !type)
+    {
+        format = depthSize ? (stencilSize ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT) : GL_RGBA;
+        type = depthSize && stencilSize ? GL_UNSIGNED_INT_24_8 : GL_FLOAT;
+    }
+
+    beginObject(ObjectType::Texture, name, true);
+    objects.write(uint32_t(target));
+    objects.write(uint32_t(internalFormat));
+    objects.write(int32_t(levelCount));
+    objects.write(int32_t(width));
+    objects.write(int32_t(height));
+    objects.write(int32_t(depth));
+    objects.write(uint32_t(format));
+    objects.write(uint32_t(type));
+    for (const auto pname : textureIntParameters)
+    {
+        GLint value = 0;
+        glGetTextureParameteriv(name, pname, &value);
+        objects.write(value);
+    }
+    for (const auto pname : floatParameters)
+    {
+        GLfloat value = 0.f;
+        glGetTextureParameterfv(name, pname, &value);
+        objects.write(value);
+    }
+    std::array<GLfloat, 4> borderColor;
+    glGetTextureParameterfv(name, GL_TEXTURE_BORDER_COLOR, borderColor.data());
+    objects.write(borderColor);
+
+    GLint packAlignment = 4, packBuffer = 0;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    const auto pixelByteSize = getGLPixelByteSize(GLenum(format), GLenum(type));
+    for (GLint level = 0; level < levelCount; ++level)
+    {
+        const auto levelWidth = std::max(width >> level, 1);
+        const auto levelHeight = std::max(height >> level, 1);
+        const auto levelDepth = target == GL_TEXTURE_3D ? std::max(depth >> level, 1) : depth;
+        const auto byteSize = size_t(levelWidth) * levelHeight * levelDepth * pixelByteSize;
+        const auto offset = objects.writeBlob(nullptr, byteSize);
+        glGetTextureImage(name, level, GLenum(format), GLenum(type), GLsizei(byteSize), objects.bytes().data() + offset);
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, GLuint(packBuffer));
+}
+
+void Recorder::saveSampler(GLuint name)
+{
+    if (!glIsSampler(name))
+    {
+        beginObject(ObjectType::Sampler, name, false);
+        return;
+    }
+
+    beginObject(ObjectType::Sampler, name, true);
+    for (const auto pname : samplerIntParameters)
+    {
+        GLint value = 0;
+        glGetSamplerParameteriv(name, pname, &value);
+        objects.write(value);
+    }
+    for (const auto pname : floatParameters)
+    {
+        GLfloat value = 0.f;
+        glGetSamplerParameterfv(name, pname, &value);
+        objects.write(value);
+    }
+    std::array<GLfloat, 4> borderColor;
+    glGetSamplerParameterfv(name, GL_TEXTURE_BORDER_COLOR, borderColor.data());
+    objects.write(borderColor);
+}
+
+void Recorder::saveProgram(GLuint name)
+{
+    GLint linked = 0, binaryLength = 0;
+    if (glIsProgram(name))
+    {
+        glGetProgramiv(name, GL_LINK_STATUS, &linked);
+        glGetProgramiv(name, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    }
+    if (!linked || !binaryLength)
+    {
+        std::cerr << "GL trace: no binary for program " << name << ", it is replaced by program 0" << std::endl;
+        beginObject(ObjectType::Program, name, false);
+        return;
+    }
+
+    std::vector<unsigned char> binary(binaryLength);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(name, binaryLength, nullptr, &binaryFormat, binary.data());
+
+    // glProgramBinary resets the uniforms to their initial values: the current ones are saved with the binary
+    struct Uniform
+    {
+        GLint location;
+        GLenum type;
+        std::array<GLint, 16> values;
+    };
+    std::vector<Uniform> uniforms;
+
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(name, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(name, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+    for (GLuint i = 0; i < GLuint(uniformCount); ++i)
+    {
+        GLint blockIndex = -1;
+        glGetActiveUniformsiv(name, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if (blockIndex >= 0) {
+            continue; // Stored in a buffer
+        }
+
+        GLint arraySize = 0;
+        GLenum type = 0;
+        glGetActiveUniform(name, i, GLsizei(nameBuffer.size()), nullptr, &arraySize, &type, nameBuffer.data());
+        const auto uniformType = getUniformType(type);
+        if (!uniformType.scalar) {
+            continue;
+        }
+
+        std::string baseName = nameBuffer.data();
+        if (baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0) {
+            baseName.resize(baseName.size() - 3);
+        }
+        for (GLint element = 0; element < arraySize; ++element)
+        {
+            const auto elementName = arraySize > 1 ? baseName + "[" + std::to_string(element) + "]" : std::string(nameBuffer.data());
+            Uniform uniform;
+            uniform.location = glGetUniformLocation(name, elementName.c_str());
+            uniform.type = type;
+            uniform.values.fill(0);
+            if (uniform.location < 0) {
+                continue;
+            }
+            if (uniformType.scalar == 'f') {
+                glGetUniformfv(name, uniform.location, reinterpret_cast<GLfloat *>(uniform.values.data()));
+            }
+            else if (uniformType.scalar == 'u') {
+                glGetUniformuiv(name, uniform.location, reinterpret_cast<GLuint *>(uniform.values.data()));
+            }
+            else {
+                glGetUniformiv(name, uniform.location, uniform.values.data());
+            }
+            uniforms.emplace_back(uniform);
+        }
+    }
+
+    GLint uniformBlockCount = 0, storageBlockCount = 0;
+    glGetProgramiv(name, GL_ACTIVE_UNIFORM_BLOCKS, &uniformBlockCount);
+    glGetProgramInterfaceiv(name, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &storageBlockCount);
+
+    beginObject(ObjectType::Program, name, true);
+    objects.write(uint32_t(binaryFormat));
+    objects.writeBlob(binary.data(), binary.size());
+    objects.write(uint32_t(uniforms.size()));
+    for (const auto & uniform : uniforms)
+    {
+        objects.write(int32_t(uniform.location));
+        objects.write(uint32_t(uniform.type));
+        objects.write(uniform.values);
+    }
+    objects.write(uint32_t(uniformBlockCount));
+    for (GLint i = 0; i < uniformBlockCount; ++i)
+    {
+        GLint binding = 0;
+        glGetActiveUniformBlockiv(name, GLuint(i), GL_UNIFORM_BLOCK_BINDING, &binding);
+        objects.write(int32_t(binding));
+    }
+    objects.write(uint32_t(storageBlockCount));
+    for (GLint i = 0; i < storageBlockCount; ++i)
+    {
+        const GLenum property = GL_BUFFER_BINDING;
+        GLint binding = 0;
+        glGetProgramResourceiv(name, GL_SHADER_STORAGE_BLOCK, GLuint(i), 1, &property, 1, nullptr, &binding);
+        objects.write(int32_t(binding));
+    }
+}
+
+void Recorder::saveVertexArray(GLuint name)
+{
+    if (!glIsVertexArray(name))
+    {
+        beginObject(ObjectType::VertexArray, name, false);
+        return;
+    }
+
+    struct Attrib
+    {
+        GLint enabled, size, type, normalized, integer, relativeOffset, binding;
+    };
+    struct Binding
+    {
+        GLint buffer, stride, divisor;
+        GLint64 offset;
+    };
+    std::array<Attrib, maxVertexAttribCount> attribs;
+    std::array<Binding, maxVertexAttribCount> bindings;
+    GLint elementBuffer = 0;
+
+    // The binding of an attribute can only be queried from the bound vertex array
+    GLint previousVertexArray = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glBindVertexArray(name);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+    const auto attribCount = getIntegerMin(GL_MAX_VERTEX_ATTRIBS, maxVertexAttribCount);
+    const auto bindingCount = getIntegerMin(GL_MAX_VERTEX_ATTRIB_BINDINGS, maxVertexAttribCount);
+    for (size_t i = 0; i < maxVertexAttribCount; ++i)
+    {
+        auto & attrib = attribs[i];
+        attrib = { 0, 4, GL_FLOAT, 0, 0, 0, GLint(i) };
+        if (i < attribCount)
+        {
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attrib.enabled);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_ARRAY_SIZE, &attrib.size);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_ARRAY_TYPE, &attrib.type);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attrib.normalized);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attrib.integer);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_RELATIVE_OFFSET, &attrib.relativeOffset);
+            glGetVertexAttribiv(GLuint(i), GL_VERTEX_ATTRIB_BINDING, &attrib.binding);
+        }
+
+        auto & binding = bindings[i];
+        binding = { 0, 16, 0, 0 };
+        if (i < bindingCount)
+        {
+            glGetIntegeri_v(GL_VERTEX_BINDING_BUFFER, GLuint(i), &binding.buffer);
+            glGetIntegeri_v(GL_VERTEX_BINDING_STRIDE, GLuint(i), &binding.stride);
+            glGetIntegeri_v(GL_VERTEX_BINDING_DIVISOR, GLuint(i), &binding.divisor);
+            glGetInteger64i_v(GL_VERTEX_BINDING_OFFSET, GLuint(i), &binding.offset);
+        }
+    }
+    glBindVertexArray(GLuint(previousVertexArray));
+
+    // Buffers are saved before the vertex array so that the replay can create objects in the order of the trace
+    reference(ObjectType::Buffer, GLuint(elementBuffer));
+    for (const auto & binding : bindings) {
+        reference(ObjectType::Buffer, GLuint(binding.buffer));
+    }
+
+    beginObject(ObjectType::VertexArray, name, true);
+    objects.write(uint32_t(elementBuffer));
+    for (const auto & attrib : attribs) {
+        objects.write(attrib);
+    }
+    for (const auto & binding : bindings) {
+        objects.write(binding);
+    }
+}
+
+void Recorder::saveFramebuffer(GLuint name)
+{
+    if (!glIsFramebuffer(name))
+    {
+        beginObject(ObjectType::Framebuffer, name, false);
+        return;
+    }
+
+    struct Attachment
+    {
+        GLint texture, level, layer; // layer is -1 when the whole level (or all layers) is attached
+    };
+    std::array<Attachment, sizeof(framebufferAttachments) / sizeof(framebufferAttachments[0])> attachments;
+    for (size_t i = 0; i < attachments.size(); ++i)
+    {
+        auto & attachment = attachments[i];
+        attachment = { 0, 0, -1 };
+
+        GLint objectType = GL_NONE;
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &objectType);
+        if (objectType == GL_RENDERBUFFER) {
+            std::cerr << "GL trace: renderbuffer attachments are not supported (framebuffer " << name << ")" << std::endl;
+        }
+        if (objectType != GL_TEXTURE) {
+            continue;
+        }
+
+        GLint layered = 0, layer = 0, cubeMapFace = 0, textureTarget = 0;
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &attachment.texture);
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &attachment.level);
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_LAYERED, &layered);
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER, &layer);
+        glGetNamedFramebufferAttachmentParameteriv(name, framebufferAttachments[i], GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE, &cubeMapFace);
+        glGetTextureParameteriv(GLuint(attachment.texture), GL_TEXTURE_TARGET, &textureTarget);
+        if (!layered)
+        {
+            if (cubeMapFace) {
+                attachment.layer = cubeMapFace - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+            }
+            else if (textureTarget == GL_TEXTURE_2D_ARRAY || textureTarget == GL_TEXTURE_3D) {
+                attachment.layer = layer;
+            }
+        }
+    }
+
+    // Draw and read buffers can only be queried from the bound framebuffers
+    std::array<GLint, maxFramebufferDrawBufferCount> drawBuffers;
+    drawBuffers.fill(GL_NONE);
+    GLint readBuffer = GL_NONE, previousDrawFramebuffer = 0, previousReadFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, name);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, name);
+    const auto drawBufferCount = getIntegerMin(GL_MAX_DRAW_BUFFERS, maxFramebufferDrawBufferCount);
+    for (size_t i = 0; i < drawBufferCount; ++i) {
+        glGetIntegerv(GLenum(GL_DRAW_BUFFER0 + i), &drawBuffers[i]);
+    }
+    glGetIntegerv(GL_READ_BUFFER, &readBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousDrawFramebuffer));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousReadFramebuffer));
+
+    for (const auto & attachment : attachments) {
+        reference(ObjectType::Texture, GLuint(attachment.texture));
+    }
+
+    beginObject(ObjectType::Framebuffer, name, true);
+    for (const auto & attachment : attachments) {
+        objects.write(attachment);
+    }
+    objects.write(drawBuffers);
+    objects.write(int32_t(readBuffer));
+}
+
+GLStateSnapshot captureGLState()
+{
+    GLStateSnapshot state;
+    std::memset(&state, 0, sizeof(state));
+
+    for (size_t i = 0; i < stateCapabilityCount; ++i) {
+        state.capabilities[i] = glIsEnabled(stateCapabilities[i]);
+    }
+    glGetIntegerv(GL_VIEWPORT, state.viewport);
+    glGetIntegerv(GL_SCISSOR_BOX, state.scissorBox);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, state.clearColor);
+    glGetFloatv(GL_DEPTH_CLEAR_VALUE, &state.clearDepth);
+    glGetIntegerv(GL_DEPTH_FUNC, &state.depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &state.depthMask);
+    glGetBooleanv(GL_COLOR_WRITEMASK, state.colorMask);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &state.blendSrcRGB);
+    glGetIntegerv(GL_BLEND_DST_RGB, &state.blendDstRGB);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &state.blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &state.blendDstAlpha);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB, &state.blendEquationRGB);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &state.blendEquationAlpha);
+    glGetIntegerv(GL_CULL_FACE_MODE, &state.cullFaceMode);
+    glGetIntegerv(GL_FRONT_FACE, &state.frontFace);
+    glGetIntegerv(GL_POLYGON_MODE, state.polygonMode);
+    glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &state.polygonOffsetFactor);
+    glGetFloatv(GL_POLYGON_OFFSET_UNITS, &state.polygonOffsetUnits);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &state.unpackAlignment);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &state.packAlignment);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &state.program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &state.vertexArray);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &state.drawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &state.readFramebuffer);
+    for (size_t i = 0; i < stateBufferTargetCount; ++i) {
+        glGetIntegerv(stateBufferBindings[i], &state.buffers[i]);
+    }
+
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &state.activeTexture);
+    const auto unitCount = getIntegerMin(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, stateTextureUnitCount);
+    for (size_t unit = 0; unit < unitCount; ++unit)
+    {
+        glActiveTexture(GLenum(GL_TEXTURE0 + unit));
+        for (size_t i = 0; i < stateTextureTargetCount; ++i) {
+            glGetIntegerv(stateTextureBindings[i], &state.textures[unit][i]);
+        }
+        glGetIntegerv(GL_SAMPLER_BINDING, &state.samplers[unit]);
+    }
+    glActiveTexture(GLenum(state.activeTexture));
+
+    const auto getIndexedBindings = [](GLenum binding, GLenum start, GLenum size, GLenum maxBindings, IndexedBufferBinding * pBindings)
+    {
+        const auto count = getIntegerMin(maxBindings, stateIndexedBindingCount);
+        for (size_t i = 0; i < count; ++i)
+        {
+            glGetIntegeri_v(binding, GLuint(i), &pBindings[i].buffer);
+            glGetInteger64i_v(start, GLuint(i), &pBindings[i].offset);
+            glGetInteger64i_v(size, GLuint(i), &pBindings[i].size);
+        }
+    };
+    getIndexedBindings(GL_UNIFORM_BUFFER_BINDING, GL_UNIFORM_BUFFER_START, GL_UNIFORM_BUFFER_SIZE, GL_MAX_UNIFORM_BUFFER_BINDINGS, state.uniformBuffers);
+    getIndexedBindings(GL_SHADER_STORAGE_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_START, GL_SHADER_STORAGE_BUFFER_SIZE, GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, state.storageBuffers);
+
+    return state;
+}
+
+void referenceGLState(const GLStateSnapshot& state)
+{
+    recorder.reference(ObjectType::Program, GLuint(state.program));
+    recorder.reference(ObjectType::VertexArray, GLuint(state.vertexArray));
+    recorder.reference(ObjectType::Framebuffer, GLuint(state.drawFramebuffer));
+    recorder.reference(ObjectType::Framebuffer, GLuint(state.readFramebuffer));
+    for (const auto buffer : state.buffers) {
+        recorder.reference(ObjectType::Buffer, GLuint(buffer));
+    }
+    for (size_t unit = 0; unit < stateTextureUnitCount; ++unit)
+    {
+        for (const auto texture : state.textures[unit]) {
+            recorder.reference(ObjectType::Texture, GLuint(texture));
+        }
+        recorder.reference(ObjectType::Sampler, GLuint(state.samplers[unit]));
+    }
+    for (size_t i = 0; i < stateIndexedBindingCount; ++i)
+    {
+        recorder.reference(ObjectType::Buffer, GLuint(state.uniformBuffers[i].buffer));
+        recorder.reference(ObjectType::Buffer, GLuint(state.storageBuffers[i].buffer));
+    }
+}
+
+// Replay side
+
+struct ReplayContext
+{
+    ByteReader reader;
+    std::vector<GLCommandTrace::NameMap>& names;
+
+    // Names read or written by the glGen* / glCreate* / glDelete* call being replayed
+    ObjectType pendingType = ObjectType::Count;
+    std::vector<GLuint> pendingTraceNames;
+    std::vector<GLuint> pendingNames;
+
+    ReplayContext(const std::vector<unsigned char>& bytes, std::vector<GLCommandTrace::NameMap>& names):
+        reader(bytes), names(names)
+    {
+    }
+
+    // Objects deleted during a previous replay of the frame are mapped to 0
+    GLuint map(ObjectType type, GLuint traceName) const
+    {
+        if (!traceName) {
+            return 0;
+        }
+        const auto & typeNames = names[size_t(type)];
+        const auto it = typeNames.find(traceName);
+        return it != end(typeNames) ? (*it).second : 0;
+    }
+
+    void readPendingNames(ObjectType type)
+    {
+        pendingType = type;
+        const auto count = size_t(std::max(reader.read<int32_t>(), 0));
+        pendingTraceNames.resize(count);
+        for (auto & name : pendingTraceNames) {
+            name = reader.read<uint32_t>();
+        }
+        pendingNames.assign(count, 0);
+    }
+};
+
+// Codecs: prepare() is called before the recorded call (objects are saved before being modified), record() after it
+// (names written by glGen* are known). decode() reads the argument for the replayed call, afterReplay() runs after it.
+template<typename Kind>
+struct Codec;
+
+template<>
+struct Codec<Value>
+{
+    template<typename T>
+    static void prepare(T)
+    {
+    }
+
+    template<size_t Index, typename T, typename... Args>
+    static void record(T value, Args...)
+    {
+        recorder.commands.write(value);
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        return context.reader.read<T>();
+    }
+
+    static void afterReplay(ReplayContext&)
+    {
+    }
+};
+
+template<>
+struct Codec<Offset>
+{
+    template<typename T>
+    static void prepare(T)
+    {
+    }
+
+    template<size_t Index, typename T, typename... Args>
+    static void record(T pointer, Args...)
+    {
+        recorder.commands.write(uint64_t(reinterpret_cast<uintptr_t>(pointer)));
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        return reinterpret_cast<T>(uintptr_t(context.reader.read<uint64_t>()));
+    }
+
+    static void afterReplay(ReplayContext&)
+    {
+    }
+};
+
+template<>
+struct Codec<Data>
+{
+    template<typename T>
+    static void prepare(T)
+    {
+    }
+
+    template<size_t Index, typename T, typename... Args>
+    static void record(T pointer, Args... args)
+    {
+        recorder.commands.write(uint8_t(pointer != nullptr));
+        if (pointer) {
+            recorder.commands.writeBlob(pointer, DataSize<Index>::get(args...));
+        }
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        if (!context.reader.read<uint8_t>()) {
+            return nullptr;
+        }
+        return static_cast<T>(context.reader.readBlob());
+    }
+
+    static void afterReplay(ReplayContext&)
+    {
+    }
+};
+
+template<ObjectType Type>
+struct Codec<Name<Type>>
+{
+    static void prepare(GLuint name)
+    {
+        recorder.reference(Type, name);
+    }
+
+    template<size_t Index, typename... Args>
+    static void record(GLuint name, Args...)
+    {
+        recorder.commands.write(uint32_t(name));
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        return context.map(Type, context.reader.read<uint32_t>());
+    }
+
+    static void afterReplay(ReplayContext&)
+    {
+    }
+};
+
+template<ObjectType Type, size_t CountParameter>
+struct Codec<NewNames<Type, CountParameter>>
+{
+    static void prepare(GLuint *)
+    {
+    }
+
+    template<size_t Index, typename... Args>
+    static void record(GLuint * pNames, Args... args)
+    {
+        const auto count = std::get<CountParameter>(std::make_tuple(args...));
+        recorder.commands.write(int32_t(count));
+        for (GLsizei i = 0; i < count; ++i)
+        {
+            recorder.commands.write(uint32_t(pNames[i]));
+            recorder.markCreated(Type, pNames[i]);
+        }
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        context.readPendingNames(Type);
+        return context.pendingNames.data();
+    }
+
+    static void afterReplay(ReplayContext& context)
+    {
+        auto & typeNames = context.names[size_t(Type)];
+        for (size_t i = 0; i < context.pendingNames.size(); ++i) {
+            typeNames[context.pendingTraceNames[i]] = context.pendingNames[i];
+        }
+    }
+};
+
+template<ObjectType Type, size_t CountParameter>
+struct Codec<DeletedNames<Type, CountParameter>>
+{
+    static void prepare(const GLuint *)
+    {
+    }
+
+    template<size_t Index, typename... Args>
+    static void record(const GLuint * pNames, Args... args)
+    {
+        const auto count = std::get<CountParameter>(std::make_tuple(args...));
+        recorder.commands.write(int32_t(count));
+        for (GLsizei i = 0; i < count; ++i) {
+            recorder.commands.write(uint32_t(pNames[i]));
+        }
+    }
+
+    template<typename T>
+    static T decode(ReplayContext& context)
+    {
+        context.readPendingNames(Type);
+        for (size_t i = 0; i < context.pendingNames.size(); ++i) {
+            context.pendingNames[i] = context.map(Type, context.pendingTraceNames[i]);
+        }
+        return context.pendingNames.data();
+    }
+
+    static void afterReplay(ReplayContext& context)
+    {
+        auto & typeNames = context.names[size_t(Type)];
+        for (const auto name : context.pendingTraceNames) {
+            typeNames.erase(name);
+        }
+    }
+};
+
+// One instantiation per entry point: saves the referenced objects, forwards the call, then records it
+template<size_t Index, typename Kinds, typename... Args>
+struct RecordingTrampoline;
+
+template<size_t Index, typename... Kinds, typename... Args>
+struct RecordingTrampoline<Index, std::tuple<Kinds...>, Args...>
+{
+    static_assert(sizeof...(Kinds) == sizeof...(Args), "One argument kind per parameter of the entry point");
+
+    static void (APIENTRYP original)(Args...);
+
+    static void APIENTRY call(Args... args)
+    {
+        if (!recorder.isActive())
+        {
+            original(args...);
+            return;
+        }
+
+        const int prepared[] = { 0, (Codec<Kinds>::prepare(args), 0)... };
+        (void) prepared;
+
+        original(args...);
+
+        PauseRecording pause; // DataSize may query the unpack state
+        recorder.commands.write(uint16_t(Index));
+        const int recorded[] = { 0, (Codec<Kinds>::template record<Index>(args, args...), 0)... };
+        (void) recorded;
+        ++recorder.commandCount;
+    }
+};
+
+template<size_t Index, typename... Kinds, typename... Args>
+void (APIENTRYP RecordingTrampoline<Index, std::tuple<Kinds...>, Args...>::original)(Args...) = nullptr;
+
+template<size_t Index, typename... Args>
+void intercept(void (APIENTRYP & pointer)(Args...))
+{
+    using T = RecordingTrampoline<Index, typename EntryKinds<Index>::type, Args...>;
+    if (!pointer || pointer == &T::call) {
+        return;
+    }
+    T::original = pointer;
+    pointer = &T::call;
+}
+
+template<size_t Index, typename... Args>
+void restore(void (APIENTRYP & pointer)(Args...))
+{
+    using T = RecordingTrampoline<Index, typename EntryKinds<Index>::type, Args...>;
+    if (pointer == &T::call) {
+        pointer = T::original;
+    }
+}
+
+// The arguments are decoded in order (braced initialization), then the function is called with them
+template<typename... Kinds, typename... Args, size_t... I>
+void replayCommand(std::tuple<Kinds...> *, void (APIENTRYP function)(Args...), ReplayContext& context, std::index_sequence<I...>)
+{
+    const std::tuple<Args...> args{ Codec<Kinds>::template decode<Args>(context)... };
+    function(std::get<I>(args)...);
+    const int replayed[] = { 0, (Codec<Kinds>::afterReplay(context), 0)... };
+    (void) replayed;
+}
+
+template<size_t Index, typename... Args>
+void replayCommand(void (APIENTRYP function)(Args...), ReplayContext& context)
+{
+    if (!function)
+    {
+        std::cerr << "GL trace: " << entryNames[Index] << " is not provided by this context" << std::endl;
+        throw std::runtime_error(std::string("GL trace: ") + entryNames[Index] + " is not provided by this context");
+    }
+    replayCommand(static_cast<typename EntryKinds<Index>::type *>(nullptr), function, context, std::index_sequence_for<Args...>());
+}
+
+void startCapture(int framebufferWidth, int framebufferHeight)
+{
+    recorder.objects = ByteWriter();
+    recorder.state = ByteWriter();
+    recorder.commands = ByteWriter();
+    recorder.objectCount = 0;
+    recorder.commandCount = 0;
+    recorder.knownObjects.clear();
+    recorder.mappedBuffers.clear();
+    recorder.framebufferWidth = framebufferWidth;
+    recorder.framebufferHeight = framebufferHeight;
+
+    {
+        PauseRecording pause;
+        const auto state = captureGLState();
+        referenceGLState(state);
+        recorder.state.write(state);
+    }
+
+#define GLMLV_INTERCEPT(name, kinds) intercept<Entry_##name>(glad_##name);
+    GLMLV_RECORDED_GL_CALLS(GLMLV_INTERCEPT)
+#undef GLMLV_INTERCEPT
+
+    recorder.recording = true;
+}
+
+void finishCapture()
+{
+#define GLMLV_RESTORE(name, kinds) restore<Entry_##name>(glad_##name);
+    GLMLV_RECORDED_GL_CALLS(GLMLV_RESTORE)
+#undef GLMLV_RESTORE
+
+    recorder.recording = false;
+    recorder.pending = false;
+
+    // What the application wrote through the mapped pointers during the frame
+    for (const auto & mappedBuffer : recorder.mappedBuffers)
+    {
+        GLint64 byteSize = 0;
+        glGetNamedBufferParameteri64v(mappedBuffer.first, GL_BUFFER_SIZE, &byteSize);
+        glGetNamedBufferSubData(mappedBuffer.first, 0, GLsizeiptr(byteSize), recorder.objects.bytes().data() + mappedBuffer.second);
+    }
+
+    const auto & path = recorder.path;
+    if (path.has_parent_path() && !fs::exists(path.parent_path())) {
+        fs::create_directories(path.parent_path());
+    }
+
+    std::ofstream out(path.string(), std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        throw std::runtime_error("Unable to open " + path.string() + " for writing");
+    }
+
+    ByteWriter header;
+    header.writeBytes(traceMagic, sizeof(traceMagic));
+    header.write(traceVersion);
+    header.write(int32_t(recorder.framebufferWidth));
+    header.write(int32_t(recorder.framebufferHeight));
+    header.write(uint32_t(EntryCount));
+    for (const auto name : entryNames)
+    {
+        header.write(uint16_t(std::strlen(name)));
+        header.writeBytes(name, std::strlen(name));
+    }
+    header.write(uint64_t(recorder.objectCount));
+    header.write(uint64_t(recorder.objects.bytes().size()));
+    header.write(uint64_t(recorder.state.bytes().size()));
+    header.write(uint64_t(recorder.commandCount));
+    header.write(uint64_t(recorder.commands.bytes().size()));
+
+    for (auto pWriter : { &header, &recorder.objects, &recorder.state, &recorder.commands }) {
+        out.write(reinterpret_cast<const char *>(pWriter->bytes().data()), pWriter->bytes().size());
+    }
+
+    std::clog << "GL trace written to " << path << " (" << recorder.commandCount << " commands, " << recorder.objectCount << " objects, "
+        << (recorder.objects.bytes().size() + recorder.commands.bytes().size()) / 1024 << " KB)" << std::endl;
+
+    recorder.objects = ByteWriter();
+    recorder.commands = ByteWriter();
+    recorder.knownObjects.clear();
+}
+
+}
+
+void requestGLCommandTraceCapture(const fs::path& path)
+{
+    if (recorder.pending) {
+        return;
+    }
+    recorder.path = path;
+    recorder.pending = true;
+}
+
+bool isGLCommandTraceCapturePending()
+{
+    return recorder.pending;
+}
+
+void updateGLCommandTraceCapture(int framebufferWidth, int framebufferHeight)
+{
+    if (recorder.recording) {
+        finishCapture();
+    }
+    else if (recorder.pending) {
+        startCapture(framebufferWidth, framebufferHeight);
+    }
+}
+
+GLCommandTrace::GLCommandTrace(const fs::path& path):
+    m_Names(size_t(ObjectType::Count))
+{
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Unable to open GL trace " << path << std::endl;
+        throw std::runtime_error("Unable to open GL trace " + path.string());
+    }
+
+    const auto readBytes = [&](void * pData, size_t byteSize)
+    {
+        if (!in.read(static_cast<char *>(pData), byteSize))
+        {
+            std::cerr << "Truncated GL trace " << path << std::endl;
+            throw std::runtime_error("Truncated GL trace " + path.string());
+        }
+    };
+    const auto read = [&](auto & value)
+    {
+        readBytes(&value, sizeof(value));
+    };
+
+    char magic[sizeof(traceMagic)];
+    uint32_t version = 0;
+    readBytes(magic, sizeof(magic));
+    read(version);
+    if (std::memcmp(magic, traceMagic, sizeof(magic)) != 0 || version != traceVersion)
+    {
+        std::cerr << path << " is not a GL trace of version " << traceVersion << std::endl;
+        throw std::runtime_error(path.string() + " is not a supported GL trace");
+    }
+
+    int32_t width = 0, height = 0;
+    uint32_t entryCount = 0;
+    read(width);
+    read(height);
+    read(entryCount);
+    m_nFramebufferWidth = width;
+    m_nFramebufferHeight = height;
+
+    // Entry points are stored by name: traces stay readable when the list of recorded entry points changes
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        uint16_t length = 0;
+        read(length);
+        std::string name(length, '\0');
+        readBytes(&name[0], length);
+
+        const auto it = std::find_if(std::begin(entryNames), std::end(entryNames), [&](const char * entryName) { return name == entryName; });
+        if (it == std::end(entryNames))
+        {
+            std::cerr << "GL trace " << path << " uses " << name << ", which this build does not replay" << std::endl;
+            throw std::runtime_error("Unknown entry point " + name + " in GL trace " + path.string());
+        }
+        m_EntryRemap.emplace_back(uint16_t(it - std::begin(entryNames)));
+    }
+
+    uint64_t objectCount = 0, objectByteSize = 0, stateByteSize = 0, commandCount = 0, commandByteSize = 0;
+    read(objectCount);
+    read(objectByteSize);
+    read(stateByteSize);
+    read(commandCount);
+    read(commandByteSize);
+    m_nObjectCount = size_t(objectCount);
+    m_nCommandCount = size_t(commandCount);
+
+    if (stateByteSize != sizeof(GLStateSnapshot))
+    {
+        std::cerr << "GL trace " << path << " has a state block of " << stateByteSize << " bytes, expected " << sizeof(GLStateSnapshot) << std::endl;
+        throw std::runtime_error("Incompatible GL trace " + path.string());
+    }
+
+    m_Objects.resize(size_t(objectByteSize));
+    m_State.resize(size_t(stateByteSize));
+    m_Commands.resize(size_t(commandByteSize));
+    readBytes(m_Objects.data(), m_Objects.size());
+    readBytes(m_State.data(), m_State.size());
+    readBytes(m_Commands.data(), m_Commands.size());
+}
+
+GLCommandTrace::~GLCommandTrace()
+{
+    destroyObjects();
+}
+
+void GLCommandTrace::createObjects()
+{
+    if (m_bObjectsCreated) {
+        return;
+    }
+    m_bObjectsCreated = true;
+
+    GLint unpackAlignment = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Texture contents are saved tightly packed
+
+    // Objects are in the order they were saved: the buffers and textures of a vertex array or a framebuffer come before it
+    ReplayContext context(m_Objects, m_Names);
+    auto & reader = context.reader;
+    for (size_t i = 0; i < m_nObjectCount; ++i)
+    {
+        const auto type = ObjectType(reader.read<uint8_t>());
+        const auto traceName = reader.read<uint32_t>();
+        const bool exists = reader.read<uint8_t>() != 0;
+
+        GLuint name = 0;
+        switch (type)
+        {
+        case ObjectType::Buffer:
+        {
+            if (!exists)
+            {
+                glGenBuffers(1, &name);
+                break;
+            }
+            const auto immutable = reader.read<int32_t>();
+            const auto storageFlags = reader.read<uint32_t>();
+            const auto usage = reader.read<uint32_t>();
+            size_t byteSize = 0;
+            const auto pData = reader.readBlob(byteSize);
+
+            glCreateBuffers(1, &name);
+            if (immutable) {
+                // Contents written through mapped pointers in the recorded frame are part of the saved contents
+                glNamedBufferStorage(name, GLsizeiptr(byteSize), pData, storageFlags | GL_DYNAMIC_STORAGE_BIT);
+            }
+            else if (byteSize) {
+                glNamedBufferData(name, GLsizeiptr(byteSize), pData, usage);
+            }
+            break;
+        }
+        case ObjectType::Texture:
+        {
+            if (!exists)
+            {
+                glGenTextures(1, &name);
+                break;
+            }
+            const auto target = reader.read<uint32_t>();
+            const auto internalFormat = reader.read<uint32_t>();
+            const auto levelCount = reader.read<int32_t>();
+            const auto width = reader.read<int32_t>();
+            const auto height = reader.read<int32_t>();
+            const auto depth = reader.read<int32_t>();
+            const auto format = reader.read<uint32_t>();
+            const auto pixelType = reader.read<uint32_t>();
+
+            glCreateTextures(target, 1, &name);
+            if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP) {
+                glTextureStorage2D(name, levelCount, internalFormat, width, height);
+            }
+            else {
+                glTextureStorage3D(name, levelCount, internalFormat, width, height, depth);
+            }
+
+            for (const auto pname : textureIntParameters) {
+                glTextureParameteri(name, pname, reader.read<GLint>());
+            }
+            for (const auto pname : floatParameters) {
+                glTextureParameterf(name, pname, reader.read<GLfloat>());
+            }
+            const auto borderColor = reader.read<std::array<GLfloat, 4>>();
+            glTextureParameterfv(name, GL_TEXTURE_BORDER_COLOR, borderColor.data());
+
+            for (GLint level = 0; level < levelCount; ++level)
+            {
+                const auto levelWidth = std::max(width >> level, 1);
+                const auto levelHeight = std::max(height >> level, 1);
+                const auto levelDepth = target == GL_TEXTURE_3D ? std::max(depth >> level, 1) : depth;
+                const auto pPixels = reader.readBlob();
+                if (target == GL_TEXTURE_2D) {
+                    glTextureSubImage2D(name, level, 0, 0, levelWidth, levelHeight, format, pixelType, pPixels);
+                }
+                else {
+                    glTextureSubImage3D(name, level, 0, 0, 0, levelWidth, levelHeight, levelDepth, format, pixelType, pPixels);
+                }
+            }
+            break;
+        }
+        case ObjectType::Sampler:
+        {
+            if (!exists)
+            {
+                glGenSamplers(1, &name);
+                break;
+            }
+            glCreateSamplers(1, &name);
+            for (const auto pname : samplerIntParameters) {
+                glSamplerParameteri(name, pname, reader.read<GLint>());
+            }
+            for (const auto pname : floatParameters) {
+                glSamplerParameterf(name, pname, reader.read<GLfloat>());
+            }
+            const auto borderColor = reader.read<std::array<GLfloat, 4>>();
+            glSamplerParameterfv(name, GL_TEXTURE_BORDER_COLOR, borderColor.data());
+            break;
+        }
+        case ObjectType::Program:
+        {
+            if (!exists) {
+                break; // Mapped to program 0
+            }
+            const auto binaryFormat = reader.read<uint32_t>();
+            size_t binaryLength = 0;
+            const auto pBinary = reader.readBlob(binaryLength);
+
+            name = glCreateProgram();
+            glProgramBinary(name, binaryFormat, pBinary, GLsizei(binaryLength));
+            GLint linked = 0;
+            glGetProgramiv(name, GL_LINK_STATUS, &linked);
+            if (!linked)
+            {
+                glDeleteProgram(name);
+                std::cerr << "The driver rejected the binary of program " << traceName << ": the trace was recorded with another driver or GPU" << std::endl;
+                throw std::runtime_error("GL trace program binary rejected by the driver");
+            }
+
+            const auto uniformCount = reader.read<uint32_t>();
+            for (uint32_t u = 0; u < uniformCount; ++u)
+            {
+                const auto location = reader.read<int32_t>();
+                const auto uniformType = getUniformType(reader.read<uint32_t>());
+                const auto values = reader.read<std::array<GLint, 16>>();
+                setUniform(name, location, uniformType, values.data());
+            }
+            const auto uniformBlockCount = reader.read<uint32_t>();
+            for (uint32_t b = 0; b < uniformBlockCount; ++b) {
+                glUniformBlockBinding(name, b, GLuint(reader.read<int32_t>()));
+            }
+            const auto storageBlockCount = reader.read<uint32_t>();
+            for (uint32_t b = 0; b < storageBlockCount; ++b) {
+                glShaderStorageBlockBinding(name, b, GLuint(reader.read<int32_t>()));
+            }
+            break;
+        }
+        case ObjectType::VertexArray:
+        {
+            if (!exists)
+            {
+                glGenVertexArrays(1, &name);
+                break;
+            }
+            struct Attrib
+            {
+                GLint enabled, size, type, normalized, integer, relativeOffset, binding;
+            };
+            struct Binding
+            {
+                GLint buffer, stride, divisor;
+                GLint64 offset;
+            };
+
+            glCreateVertexArrays(1, &name);
+            glVertexArrayElementBuffer(name, context.map(ObjectType::Buffer, reader.read<uint32_t>()));
+            for (GLuint a = 0; a < maxVertexAttribCount; ++a)
+            {
+                const auto attrib = reader.read<Attrib>();
+                if (attrib.integer) {
+                    glVertexArrayAttribIFormat(name, a, attrib.size, attrib.type, attrib.relativeOffset);
+                }
+                else {
+                    glVertexArrayAttribFormat(name, a, attrib.size, attrib.type, GLboolean(attrib.normalized), attrib.relativeOffset);
+                }
+                glVertexArrayAttribBinding(name, a, GLuint(attrib.binding));
+                if (attrib.enabled) {
+                    glEnableVertexArrayAttrib(name, a);
+                }
+            }
+            for (GLuint b = 0; b < maxVertexAttribCount; ++b)
+            {
+                const auto binding = reader.read<Binding>();
+                if (binding.buffer) {
+                    glVertexArrayVertexBuffer(name, b, context.map(ObjectType::Buffer, GLuint(binding.buffer)), GLintptr(binding.offset), binding.stride);
+                }
+                if (binding.divisor) {
+                    glVertexArrayBindingDivisor(name, b, GLuint(binding.divisor));
+                }
+            }
+            break;
+        }
+        case ObjectType::Framebuffer:
+        {
+            if (!exists)
+            {
+                glGenFramebuffers(1, &name);
+                break;
+            }
+            struct Attachment
+            {
+                GLint texture, level, layer;
+            };
+
+            glCreateFramebuffers(1, &name);
+            for (const auto attachmentPoint : framebufferAttachments)
+            {
+                const auto attachment = reader.read<Attachment>();
+                if (!attachment.texture) {
+                    continue;
+                }
+                const auto texture = context.map(ObjectType::Texture, GLuint(attachment.texture));
+                if (attachment.layer < 0) {
+                    glNamedFramebufferTexture(name, attachmentPoint, texture, attachment.level);
+                }
+                else {
+                    glNamedFramebufferTextureLayer(name, attachmentPoint, texture, attachment.level, attachment.layer);
+                }
+            }
+            const auto drawBuffers = reader.read<std::array<GLint, maxFramebufferDrawBufferCount>>();
+            std::array<GLenum, maxFramebufferDrawBufferCount> buffers;
+            std::copy(begin(drawBuffers), end(drawBuffers), begin(buffers));
+            glNamedFramebufferDrawBuffers(name, GLsizei(buffers.size()), buffers.data());
+            glNamedFramebufferReadBuffer(name, GLenum(reader.read<int32_t>()));
+            break;
+        }
+        default:
+            std::cerr << "Invalid object type " << int(type) << " in GL trace" << std::endl;
+            throw std::runtime_error("Invalid object type in GL trace");
+        }
+
+        if (name) {
+            m_Names[size_t(type)][traceName] = name;
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+}
+
+void GLCommandTrace::destroyObjects()
+{
+    if (!m_bObjectsCreated) {
+        return;
+    }
+    m_bObjectsCreated = false;
+
+    const auto names = [&](ObjectType type)
+    {
+        std::vector<GLuint> result;
+        for (const auto & entry : m_Names[size_t(type)]) {
+            result.emplace_back(entry.second);
+        }
+        m_Names[size_t(type)].clear();
+        return result;
+    };
+
+    auto framebuffers = names(ObjectType::Framebuffer);
+    glDeleteFramebuffers(GLsizei(framebuffers.size()), framebuffers.data());
+    auto vertexArrays = names(ObjectType::VertexArray);
+    glDeleteVertexArrays(GLsizei(vertexArrays.size()), vertexArrays.data());
+    for (const auto program : names(ObjectType::Program)) {
+        glDeleteProgram(program);
+    }
+    auto samplers = names(ObjectType::Sampler);
+    glDeleteSamplers(GLsizei(samplers.size()), samplers.data());
+    auto textures = names(ObjectType::Texture);
+    glDeleteTextures(GLsizei(textures.size()), textures.data());
+    auto buffers = names(ObjectType::Buffer);
+    glDeleteBuffers(GLsizei(buffers.size()), buffers.data());
+}
+
+void GLCommandTrace::replayFrame()
+{
+    ReplayContext context(m_Commands, m_Names);
+
+    GLStateSnapshot state;
+    std::memcpy(&state, m_State.data(), sizeof(state));
+
+    for (size_t i = 0; i < stateCapabilityCount; ++i)
+    {
+        if (state.capabilities[i]) {
+            glEnable(stateCapabilities[i]);
+        }
+        else {
+            glDisable(stateCapabilities[i]);
+        }
+    }
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+    glScissor(state.scissorBox[0], state.scissorBox[1], state.scissorBox[2], state.scissorBox[3]);
+    glClearColor(state.clearColor[0], state.clearColor[1], state.clearColor[2], state.clearColor[3]);
+    glClearDepth(state.clearDepth);
+    glDepthFunc(GLenum(state.depthFunc));
+    glDepthMask(state.depthMask);
+    glColorMask(state.colorMask[0], state.colorMask[1], state.colorMask[2], state.colorMask[3]);
+    glBlendFuncSeparate(GLenum(state.blendSrcRGB), GLenum(state.blendDstRGB), GLenum(state.blendSrcAlpha), GLenum(state.blendDstAlpha));
+    glBlendEquationSeparate(GLenum(state.blendEquationRGB), GLenum(state.blendEquationAlpha));
+    glCullFace(GLenum(state.cullFaceMode));
+    glFrontFace(GLenum(state.frontFace));
+    glPolygonMode(GL_FRONT_AND_BACK, GLenum(state.polygonMode[0]));
+    glPolygonOffset(state.polygonOffsetFactor, state.polygonOffsetUnits);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, state.unpackAlignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, state.packAlignment);
+
+    glUseProgram(context.map(ObjectType::Program, GLuint(state.program)));
+    glBindVertexArray(context.map(ObjectType::VertexArray, GLuint(state.vertexArray)));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, context.map(ObjectType::Framebuffer, GLuint(state.drawFramebuffer)));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, context.map(ObjectType::Framebuffer, GLuint(state.readFramebuffer)));
+    for (size_t i = 0; i < stateBufferTargetCount; ++i) {
+        glBindBuffer(stateBufferTargets[i], context.map(ObjectType::Buffer, GLuint(state.buffers[i])));
+    }
+    for (size_t unit = 0; unit < stateTextureUnitCount; ++unit)
+    {
+        glActiveTexture(GLenum(GL_TEXTURE0 + unit));
+        for (size_t i = 0; i < stateTextureTargetCount; ++i) {
+            glBindTexture(stateTextureTargets[i], context.map(ObjectType::Texture, GLuint(state.textures[unit][i])));
+        }
+        glBindSampler(GLuint(unit), context.map(ObjectType::Sampler, GLuint(state.samplers[unit])));
+    }
+    glActiveTexture(GLenum(state.activeTexture));
+
+    const auto bindIndexedBuffers = [&](GLenum target, const IndexedBufferBinding * pBindings)
+    {
+        for (size_t i = 0; i < stateIndexedBindingCount; ++i)
+        {
+            const auto buffer = context.map(ObjectType::Buffer, GLuint(pBindings[i].buffer));
+            if (buffer && pBindings[i].size) {
+                glBindBufferRange(target, GLuint(i), buffer, GLintptr(pBindings[i].offset), GLsizeiptr(pBindings[i].size));
+            }
+            else {
+                glBindBufferBase(target, GLuint(i), buffer);
+            }
+        }
+    };
+    bindIndexedBuffers(GL_UNIFORM_BUFFER, state.uniformBuffers);
+    bindIndexedBuffers(GL_SHADER_STORAGE_BUFFER, state.storageBuffers);
+    // The generic bindings are also set by glBindBufferRange / glBindBufferBase
+    glBindBuffer(GL_UNIFORM_BUFFER, context.map(ObjectType::Buffer, GLuint(state.buffers[stateBufferTargetCount - 1])));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, context.map(ObjectType::Buffer, GLuint(state.buffers[stateBufferTargetCount - 2])));
+
+    auto & reader = context.reader;
+    for (size_t i = 0; i < m_nCommandCount; ++i)
+    {
+        const auto fileEntry = reader.read<uint16_t>();
+        if (fileEntry >= m_EntryRemap.size())
+        {
+            std::cerr << "Invalid entry point " << fileEntry << " in GL trace" << std::endl;
+            throw std::runtime_error("Invalid entry point in GL trace");
+        }
+
+        switch (m_EntryRemap[fileEntry])
+        {
+#define GLMLV_REPLAY_CASE(name, kinds) case Entry_##name: replayCommand<Entry_##name>(glad_##name, context); break;
+            GLMLV_RECORDED_GL_CALLS(GLMLV_REPLAY_CASE)
+#undef GLMLV_REPLAY_CASE
+        }
+    }
+}
+
+}
@@ -6,6 +6,10 @@
 #include <algorithm>
 #include <unordered_map>
 #include <vector>
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
 #include <imgui.h>
 
 namespace glmlv
@@ -73,36 +77,282 @@ static std::array<std::tuple<const char *, bool, GLenum>, 4> severitySelector =
     std::make_tuple("NOTIFICATION", false, GL_DEBUG_SEVERITY_NOTIFICATION)
 };
 
-void logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
-    GLsizei length, const GLchar* message, GLvoid* userParam);
+static GLDebugMode currentMode = GLDebugMode::Disabled;
 
-void initGLDebugOutput()
+static const char * findEnumString(GLenum value, const std::unordered_map<GLenum, const char *> & map)
 {
-    glDebugMessageCallback((GLDEBUGPROCARB)logGLDebugInfo, nullptr);
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    const auto it = map.find(value);
+    if (it == end(map)) {
+        return "UNDEFINED";
+    }
+    return (*it).second;
+}
+
+static void logGLDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, const char * message)
+{
+    std::clog << "OpenGL: " << message << " [source=" << findEnumString(source, sourceEnumToString) << " type=" << findEnumString(type, typeEnumToString)
+        << " severity=" << findEnumString(severity, severityEnumToString) << " id=" << id << "]\n\n";
+}
+
+// ---- Aggregation, only accessed from the thread of the context ---- //
+
+struct AggregatedMessage
+{
+    GLenum source;
+    GLenum type;
+    GLenum severity;
+    GLuint id;
+    std::string message; // Last received text for this id
+    size_t count;
+};
+
+static std::vector<AggregatedMessage> aggregatedMessages;
+static std::unordered_map<uint64_t, size_t> aggregatedMessageIndices;
+static size_t performanceMessageCount = 0;
+
+// Return true for the first occurrence of (source, type, id)
+static bool aggregate(GLenum source, GLenum type, GLuint id, GLenum severity, const char * message)
+{
+    if (type == GL_DEBUG_TYPE_PERFORMANCE) {
+        ++performanceMessageCount;
+    }
+
+    const auto key = (uint64_t(id) << 32) | (uint64_t(source & 0xFFFF) << 16) | uint64_t(type & 0xFFFF);
+    const auto it = aggregatedMessageIndices.find(key);
+    if (it != end(aggregatedMessageIndices))
+    {
+        auto & aggregated = aggregatedMessages[(*it).second];
+        ++aggregated.count;
+        aggregated.severity = severity;
+        aggregated.message = message;
+        return false;
+    }
+
+    aggregatedMessageIndices.emplace(key, aggregatedMessages.size());
+    aggregatedMessages.push_back({ source, type, severity, id, message, 1 });
+    return true;
+}
+
+// ---- Asynchronous mode: bounded multi producer / single consumer queue ---- //
+// The driver may call the callback from any of its threads. Producers reserve a slot by incrementing the tail with a CAS,
+// write it, then publish it through its sequence number; the consumer only reads slots whose sequence says they are complete.
+
+struct QueuedMessage
+{
+    std::atomic<size_t> sequence{ 0 };
+    GLenum source;
+    GLenum type;
+    GLenum severity;
+    GLuint id;
+    char message[256]; // Truncated
+};
+
+static const size_t messageQueueSize = 1024; // Power of two
+static QueuedMessage messageQueue[messageQueueSize];
+static std::atomic<size_t> messageQueueTail{ 0 };
+static size_t messageQueueHead = 0; // Consumer only
+static std::atomic<size_t> receivedMessageCount{ 0 };
+static std::atomic<size_t> droppedMessageCount{ 0 };
+
+static void APIENTRY enqueueGLDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar* message, const void*)
+{
+    ++receivedMessageCount;
+
+    auto position = messageQueueTail.load(std::memory_order_relaxed);
+    QueuedMessage * slot = nullptr;
+    for (;;)
+    {
+        slot = &messageQueue[position & (messageQueueSize - 1)];
+        const auto sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto difference = std::ptrdiff_t(sequence) - std::ptrdiff_t(position);
+        if (difference == 0)
+        {
+            if (messageQueueTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            ++droppedMessageCount; // Full: the render thread has not drained the queue for a while
+            return;
+        }
+        else {
+            position = messageQueueTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->source = source;
+    slot->type = type;
+    slot->severity = severity;
+    slot->id = id;
+    const auto messageLength = std::min(length >= 0 ? size_t(length) : std::strlen(message), sizeof(slot->message) - 1);
+    std::memcpy(slot->message, message, messageLength);
+    slot->message[messageLength] = '\0';
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+static void APIENTRY logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei, const GLchar* message, const void*)
+{
+    ++receivedMessageCount;
+    if (aggregate(source, type, id, severity, message)) {
+        logGLDebugMessage(source, type, id, severity, message);
+    }
+}
+
+GLDebugMode getDefaultGLDebugMode()
+{
+    if (const auto value = std::getenv("GLMLV_GL_DEBUG"))
+    {
+        const std::string mode = value;
+        if (mode == "off") {
+            return GLDebugMode::Disabled;
+        }
+        if (mode == "sync") {
+            return GLDebugMode::Synchronous;
+        }
+        if (mode == "async") {
+            return GLDebugMode::Asynchronous;
+        }
+        std::cerr << "Unknown GLMLV_GL_DEBUG value " << mode << ", expected off, sync or async" << std::endl;
+    }
+#ifdef NDEBUG
+    return GLDebugMode::Disabled;
+#else
+    return GLDebugMode::Asynchronous;
+#endif
+}
+
+void initGLDebugOutput(GLDebugMode mode)
+{
+    currentMode = mode;
+    if (mode == GLDebugMode::Disabled)
+    {
+        glDisable(GL_DEBUG_OUTPUT);
+        return;
+    }
+
+    for (size_t i = 0; i < messageQueueSize; ++i) {
+        messageQueue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    messageQueueTail = 0;
+    messageQueueHead = 0;
+
+    glEnable(GL_DEBUG_OUTPUT);
+    if (mode == GLDebugMode::Synchronous)
+    {
+        glDebugMessageCallback(logGLDebugInfo, nullptr);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    else
+    {
+        glDebugMessageCallback(enqueueGLDebugMessage, nullptr);
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
 
     for (const auto & tuple : ignoreList) {
         glDebugMessageControl(std::get<0>(tuple), std::get<1>(tuple), std::get<2>(tuple), 0, nullptr, GL_FALSE);
     }
 }
 
-void logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
-    GLsizei length, const GLchar* message, GLvoid* userParam)
+GLDebugMode getGLDebugMode()
 {
-    const auto findStr = [](GLenum value, const auto & map)
+    return currentMode;
+}
+
+void processGLDebugMessages()
+{
+    if (currentMode != GLDebugMode::Asynchronous) {
+        return;
+    }
+
+    for (;;)
     {
-        const auto it = map.find(value);
-        if (it == end(map)) {
-            return "UNDEFINED";
+        auto & slot = messageQueue[messageQueueHead & (messageQueueSize - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != messageQueueHead + 1) {
+            return; // Empty, or the next message is still being written
         }
-        return (*it).second;
-    };
 
-    const auto sourceStr = findStr(source, sourceEnumToString);
-    const auto typeStr = findStr(type, typeEnumToString);
-    const auto severityStr = findStr(severity, severityEnumToString);
+        if (aggregate(slot.source, slot.type, slot.id, slot.severity, slot.message)) {
+            logGLDebugMessage(slot.source, slot.type, slot.id, slot.severity, slot.message);
+        }
+
+        slot.sequence.store(messageQueueHead + messageQueueSize, std::memory_order_release);
+        ++messageQueueHead;
+    }
+}
+
+GLDebugStats getGLDebugStats()
+{
+    GLDebugStats stats;
+    stats.messageCount = receivedMessageCount;
+    stats.uniqueMessageCount = aggregatedMessages.size();
+    stats.performanceMessageCount = performanceMessageCount;
+    stats.droppedMessageCount = droppedMessageCount;
+    return stats;
+}
+
+void drawGLDebugOutputGUI()
+{
+    static const char * modeNames[] = { "disabled", "synchronous", "asynchronous" };
+    const auto stats = getGLDebugStats();
+    ImGui::Text("Debug output %s: %zu messages, %zu distinct, %zu performance warnings, %zu dropped", modeNames[int(currentMode)],
+        stats.messageCount, stats.uniqueMessageCount, stats.performanceMessageCount, stats.droppedMessageCount);
+    if (currentMode == GLDebugMode::Disabled) {
+        ImGui::TextWrapped("Set GLMLV_GL_DEBUG to sync or async to create a debug context.");
+        return;
+    }
 
-    std::clog << "OpenGL: " << message << " [source=" << sourceStr << " type=" << typeStr << " severity=" << severityStr << " id=" << id << "]\n\n";
+    static bool performanceOnly = false;
+    ImGui::Checkbox("Performance warnings only", &performanceOnly);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+    {
+        aggregatedMessages.clear();
+        aggregatedMessageIndices.clear();
+        performanceMessageCount = 0;
+        receivedMessageCount = 0;
+        droppedMessageCount = 0;
+    }
+
+    if (ImGui::TreeNode("Reported messages"))
+    {
+        const auto selector = [](auto & selectors, const char * label, auto control)
+        {
+            ImGui::Text("%s:", label);
+            for (auto & tuple : selectors)
+            {
+                ImGui::SameLine();
+                if (ImGui::Checkbox(std::get<0>(tuple), &std::get<1>(tuple))) {
+                    control(std::get<2>(tuple), std::get<1>(tuple) ? GL_TRUE : GL_FALSE);
+                }
+            }
+        };
+        selector(sourceSelector, "Source", [](GLenum source, GLboolean enabled) { glDebugMessageControl(source, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, enabled); });
+        selector(typeSelector, "Type", [](GLenum type, GLboolean enabled) { glDebugMessageControl(GL_DONT_CARE, type, GL_DONT_CARE, 0, nullptr, enabled); });
+        selector(severitySelector, "Severity", [](GLenum severity, GLboolean enabled) { glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled); });
+        ImGui::TreePop();
+    }
+
+    // Performance warnings first, then the other messages in order of first occurrence
+    for (const bool performance : { true, false })
+    {
+        if (!performance && performanceOnly) {
+            break;
+        }
+        for (const auto & aggregated : aggregatedMessages)
+        {
+            if ((aggregated.type == GL_DEBUG_TYPE_PERFORMANCE) != performance) {
+                continue;
+            }
+            const auto color = aggregated.type == GL_DEBUG_TYPE_ERROR ? ImVec4(1.f, 0.4f, 0.4f, 1.f) :
+                aggregated.type == GL_DEBUG_TYPE_PERFORMANCE ? ImVec4(1.f, 0.8f, 0.2f, 1.f) : ImGui::GetStyle().Colors[ImGuiCol_Text];
+            ImGui::TextColored(color, "%zux %s %s [%s id=%u]", aggregated.count, findEnumString(aggregated.type, typeEnumToString),
+                findEnumString(aggregated.severity, severityEnumToString), findEnumString(aggregated.source, sourceEnumToString), aggregated.id);
+            ImGui::TextWrapped("%s", aggregated.message.c_str());
+        }
+    }
 }
 
 }
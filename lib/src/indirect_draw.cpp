@@ -0,0 +1,20 @@
+#include <glmlv/indirect_draw.hpp>
+#include <glmlv/glfw.hpp>
+
+glmlv::MultiDrawElementsIndirectCountFunction glad_glMultiDrawElementsIndirectCount = nullptr;
+
+namespace glmlv
+{
+
+void loadIndirectDrawFunctions()
+{
+    glad_glMultiDrawElementsIndirectCount = nullptr;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6)) {
+        glad_glMultiDrawElementsIndirectCount = (MultiDrawElementsIndirectCountFunction) glfwGetProcAddress("glMultiDrawElementsIndirectCount");
+    }
+    if (!glad_glMultiDrawElementsIndirectCount && glfwExtensionSupported("GL_ARB_indirect_parameters")) {
+        glad_glMultiDrawElementsIndirectCount = (MultiDrawElementsIndirectCountFunction) glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+    }
+}
+
+}
@@ -0,0 +1,780 @@
+#include <glmlv/parallel_png.hpp>
+#include <glmlv/ThreadPool.hpp>
+#include <glmlv/CPUProfiler.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Checksums
+
+struct CRCTable
+{
+    uint32_t values[256];
+
+    CRCTable()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            values[n] = c;
+        }
+    }
+};
+
+uint32_t updateCRC(uint32_t crc, const uint8_t * pData, size_t size)
+{
+    static const CRCTable table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.values[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+const uint32_t AdlerBase = 65521;
+
+uint32_t computeAdler32(const uint8_t * pData, size_t size)
+{
+    uint32_t s1 = 1, s2 = 0;
+    while (size > 0)
+    {
+        const size_t blockSize = std::min(size, size_t(5552)); // Largest block for which s2 can't overflow before the modulo
+        for (size_t i = 0; i < blockSize; ++i)
+        {
+            s1 += pData[i];
+            s2 += s1;
+        }
+        s1 %= AdlerBase;
+        s2 %= AdlerBase;
+        pData += blockSize;
+        size -= blockSize;
+    }
+    return (s2 << 16) | s1;
+}
+
+// Adler-32 of the concatenation of two sequences, from their checksums and the size of the second one
+uint32_t combineAdler32(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    const uint32_t rem = uint32_t(size2 % AdlerBase);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % AdlerBase);
+    sum1 += (adler2 & 0xFFFF) + AdlerBase - 1;
+    sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + AdlerBase - rem;
+    if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+    if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+    if (sum2 >= (AdlerBase << 1)) sum2 -= (AdlerBase << 1);
+    if (sum2 >= AdlerBase) sum2 -= AdlerBase;
+    return sum1 | (sum2 << 16);
+}
+
+// Deflate (RFC 1951)
+
+const size_t WindowSize = 32768;
+const size_t MinMatchLength = 3;
+const size_t MaxMatchLength = 258;
+const size_t LitLenSymbolCount = 286;
+const size_t DistSymbolCount = 30;
+const size_t CodeLengthSymbolCount = 19;
+const uint16_t EndOfBlock = 256;
+
+const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DistExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t CodeLengthOrder[CodeLengthSymbolCount] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+struct SymbolTables
+{
+    uint8_t lengthCode[MaxMatchLength + 1]; // Match length -> index in LengthBase
+    uint8_t distCode[512]; // (distance - 1) for distances <= 256, 256 + ((distance - 1) >> 7) above -> index in DistBase
+
+    SymbolTables()
+    {
+        for (uint8_t code = 0; code < 29; ++code)
+        {
+            for (size_t length = LengthBase[code]; length < LengthBase[code] + (size_t(1) << LengthExtraBits[code]) && length <= MaxMatchLength; ++length) {
+                lengthCode[length] = code;
+            }
+        }
+        lengthCode[MaxMatchLength] = 28; // 258 has its own code instead of being 227 + 31
+
+        for (uint8_t code = 0; code < 30; ++code)
+        {
+            for (size_t d = DistBase[code] - 1; d < DistBase[code] - 1 + (size_t(1) << DistExtraBits[code]); ++d)
+            {
+                if (d < 256) {
+                    distCode[d] = code;
+                }
+                else {
+                    distCode[256 + (d >> 7)] = code;
+                }
+            }
+        }
+    }
+
+    uint8_t getDistCode(size_t distance) const
+    {
+        const auto d = distance - 1;
+        return d < 256 ? distCode[d] : distCode[256 + (d >> 7)];
+    }
+};
+
+const SymbolTables& getSymbolTables()
+{
+    static const SymbolTables tables;
+    return tables;
+}
+
+// Write bits least significant first, as required by deflate
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& output): m_Output(output)
+    {
+    }
+
+    void write(uint32_t bits, unsigned count)
+    {
+        m_nBuffer |= uint64_t(bits) << m_nCount;
+        m_nCount += count;
+        if (m_nCount >= 32)
+        {
+            for (int i = 0; i < 4; ++i) {
+                m_Output.push_back(uint8_t(m_nBuffer >> (8 * i)));
+            }
+            m_nBuffer >>= 32;
+            m_nCount -= 32;
+        }
+    }
+
+    // Pad with zeros up to the next byte boundary and flush
+    void alignToByte()
+    {
+        while (m_nCount > 0)
+        {
+            m_Output.push_back(uint8_t(m_nBuffer));
+            m_nBuffer >>= 8;
+            m_nCount = m_nCount > 8 ? m_nCount - 8 : 0;
+        }
+        m_nBuffer = 0;
+    }
+
+private:
+    std::vector<uint8_t>& m_Output;
+    uint64_t m_nBuffer = 0;
+    unsigned m_nCount = 0;
+};
+
+// Compute Huffman code lengths limited to maxBits for the symbols with a non zero frequency.
+// At least two symbols must be used, otherwise the code would not be complete.
+void computeCodeLengths(const uint32_t * pFrequencies, size_t symbolCount, unsigned maxBits, uint8_t * pLengths)
+{
+    std::fill(pLengths, pLengths + symbolCount, uint8_t(0));
+
+    std::vector<uint16_t> symbols;
+    for (size_t s = 0; s < symbolCount; ++s)
+    {
+        if (pFrequencies[s]) {
+            symbols.push_back(uint16_t(s));
+        }
+    }
+    std::stable_sort(begin(symbols), end(symbols), [&](uint16_t lhs, uint16_t rhs) { return pFrequencies[lhs] < pFrequencies[rhs]; });
+
+    // Build the tree with two queues: the sorted leaves and the internal nodes, which are created by increasing weight
+    const size_t leafCount = symbols.size();
+    const size_t nodeCount = 2 * leafCount - 1;
+    std::vector<uint64_t> weights(nodeCount);
+    std::vector<size_t> parents(nodeCount, 0);
+    for (size_t i = 0; i < leafCount; ++i) {
+        weights[i] = pFrequencies[symbols[i]];
+    }
+
+    size_t nextLeaf = 0, nextInternal = leafCount;
+    for (size_t node = leafCount; node < nodeCount; ++node)
+    {
+        size_t children[2];
+        for (auto & child : children) {
+            child = (nextLeaf < leafCount && (nextInternal >= node || weights[nextLeaf] <= weights[nextInternal])) ? nextLeaf++ : nextInternal++;
+        }
+        weights[node] = weights[children[0]] + weights[children[1]];
+        parents[children[0]] = parents[children[1]] = node;
+    }
+
+    std::vector<unsigned> depths(nodeCount, 0);
+    for (size_t node = nodeCount - 1; node-- > 0; ) {
+        depths[node] = depths[parents[node]] + 1; // Parents always have a bigger index than their children
+    }
+
+    // Clamp the lengths then fix the Kraft sum by moving codes down, like miniz does
+    std::vector<unsigned> lengthCounts(maxBits + 1, 0);
+    for (size_t i = 0; i < leafCount; ++i) {
+        ++lengthCounts[std::min(depths[i], maxBits)];
+    }
+
+    uint64_t kraftSum = 0;
+    for (unsigned length = 1; length <= maxBits; ++length) {
+        kraftSum += uint64_t(lengthCounts[length]) << (maxBits - length);
+    }
+    while (kraftSum > (uint64_t(1) << maxBits))
+    {
+        --lengthCounts[maxBits];
+        for (unsigned length = maxBits - 1; length > 0; --length)
+        {
+            if (lengthCounts[length])
+            {
+                --lengthCounts[length];
+                lengthCounts[length + 1] += 2;
+                break;
+            }
+        }
+        --kraftSum;
+    }
+
+    // Least frequent symbols get the longest codes
+    size_t i = 0;
+    for (unsigned length = maxBits; length > 0; --length)
+    {
+        for (unsigned c = 0; c < lengthCounts[length]; ++c) {
+            pLengths[symbols[i++]] = uint8_t(length);
+        }
+    }
+}
+
+// Canonical codes from code lengths, bit-reversed for the LSB first BitWriter
+void computeCodes(const uint8_t * pLengths, size_t symbolCount, uint16_t * pCodes)
+{
+    unsigned lengthCounts[16] = { 0 };
+    for (size_t s = 0; s < symbolCount; ++s) {
+        ++lengthCounts[pLengths[s]];
+    }
+    lengthCounts[0] = 0;
+
+    unsigned nextCodes[16] = { 0 };
+    unsigned code = 0;
+    for (unsigned length = 1; length < 16; ++length)
+    {
+        code = (code + lengthCounts[length - 1]) << 1;
+        nextCodes[length] = code;
+    }
+
+    for (size_t s = 0; s < symbolCount; ++s)
+    {
+        const auto length = pLengths[s];
+        if (!length) {
+            pCodes[s] = 0;
+            continue;
+        }
+        auto c = nextCodes[length]++;
+        uint16_t reversed = 0;
+        for (unsigned b = 0; b < length; ++b, c >>= 1) {
+            reversed = uint16_t((reversed << 1) | (c & 1));
+        }
+        pCodes[s] = reversed;
+    }
+}
+
+// Make sure at least two symbols are used so that computeCodeLengths() produces a complete code
+void ensureTwoSymbols(uint32_t * pFrequencies, size_t symbolCount)
+{
+    size_t usedCount = std::count_if(pFrequencies, pFrequencies + symbolCount, [](uint32_t f) { return f != 0; });
+    for (size_t s = 0; usedCount < 2 && s < symbolCount; ++s)
+    {
+        if (!pFrequencies[s])
+        {
+            pFrequencies[s] = 1;
+            ++usedCount;
+        }
+    }
+}
+
+struct Token
+{
+    uint16_t litLen; // Literal byte if dist == 0, match length otherwise
+    uint16_t dist;
+};
+
+// Emit one dynamic Huffman block (BTYPE = 2) for the tokens
+void writeDynamicBlock(BitWriter& writer, const std::vector<Token>& tokens, bool isFinal)
+{
+    const auto & tables = getSymbolTables();
+
+    uint32_t litLenFrequencies[LitLenSymbolCount] = { 0 };
+    uint32_t distFrequencies[DistSymbolCount] = { 0 };
+    for (const auto & token : tokens)
+    {
+        if (token.dist == 0) {
+            ++litLenFrequencies[token.litLen];
+        }
+        else
+        {
+            ++litLenFrequencies[257 + tables.lengthCode[token.litLen]];
+            ++distFrequencies[tables.getDistCode(token.dist)];
+        }
+    }
+    litLenFrequencies[EndOfBlock] = 1;
+    ensureTwoSymbols(litLenFrequencies, LitLenSymbolCount);
+    ensureTwoSymbols(distFrequencies, DistSymbolCount);
+
+    uint8_t lengths[LitLenSymbolCount + DistSymbolCount];
+    uint8_t * const pLitLenLengths = lengths;
+    uint8_t * const pDistLengths = lengths + LitLenSymbolCount;
+    computeCodeLengths(litLenFrequencies, LitLenSymbolCount, 15, pLitLenLengths);
+    computeCodeLengths(distFrequencies, DistSymbolCount, 15, pDistLengths);
+
+    uint16_t litLenCodes[LitLenSymbolCount];
+    uint16_t distCodes[DistSymbolCount];
+    computeCodes(pLitLenLengths, LitLenSymbolCount, litLenCodes);
+    computeCodes(pDistLengths, DistSymbolCount, distCodes);
+
+    size_t litLenCount = LitLenSymbolCount;
+    while (litLenCount > 257 && !pLitLenLengths[litLenCount - 1]) {
+        --litLenCount;
+    }
+    size_t distCount = DistSymbolCount;
+    while (distCount > 1 && !pDistLengths[distCount - 1]) {
+        --distCount;
+    }
+
+    // Run length encode the code lengths of both alphabets as a single sequence
+    uint8_t sequence[LitLenSymbolCount + DistSymbolCount];
+    std::copy(pLitLenLengths, pLitLenLengths + litLenCount, sequence);
+    std::copy(pDistLengths, pDistLengths + distCount, sequence + litLenCount);
+    const size_t sequenceSize = litLenCount + distCount;
+
+    struct RLESymbol { uint8_t symbol; uint8_t extra; };
+    std::vector<RLESymbol> rleSymbols;
+    uint32_t codeLengthFrequencies[CodeLengthSymbolCount] = { 0 };
+    const auto emit = [&](uint8_t symbol, uint8_t extra)
+    {
+        rleSymbols.push_back({ symbol, extra });
+        ++codeLengthFrequencies[symbol];
+    };
+
+    for (size_t i = 0; i < sequenceSize; )
+    {
+        const auto length = sequence[i];
+        size_t run = 1;
+        while (i + run < sequenceSize && sequence[i + run] == length) {
+            ++run;
+        }
+        i += run;
+
+        if (length == 0)
+        {
+            for (; run >= 11; ) { const auto n = std::min(run, size_t(138)); emit(18, uint8_t(n - 11)); run -= n; }
+            for (; run >= 3; ) { const auto n = std::min(run, size_t(10)); emit(17, uint8_t(n - 3)); run -= n; }
+        }
+        else
+        {
+            emit(length, 0);
+            --run;
+            for (; run >= 3; ) { const auto n = std::min(run, size_t(6)); emit(16, uint8_t(n - 3)); run -= n; }
+        }
+        for (; run > 0; --run) {
+            emit(length, 0);
+        }
+    }
+
+    ensureTwoSymbols(codeLengthFrequencies, CodeLengthSymbolCount);
+    uint8_t codeLengthLengths[CodeLengthSymbolCount];
+    uint16_t codeLengthCodes[CodeLengthSymbolCount];
+    computeCodeLengths(codeLengthFrequencies, CodeLengthSymbolCount, 7, codeLengthLengths);
+    computeCodes(codeLengthLengths, CodeLengthSymbolCount, codeLengthCodes);
+
+    size_t codeLengthCount = CodeLengthSymbolCount;
+    while (codeLengthCount > 4 && !codeLengthLengths[CodeLengthOrder[codeLengthCount - 1]]) {
+        --codeLengthCount;
+    }
+
+    // Block header
+    writer.write(isFinal ? 1 : 0, 1);
+    writer.write(2, 2);
+    writer.write(uint32_t(litLenCount - 257), 5);
+    writer.write(uint32_t(distCount - 1), 5);
+    writer.write(uint32_t(codeLengthCount - 4), 4);
+    for (size_t i = 0; i < codeLengthCount; ++i) {
+        writer.write(codeLengthLengths[CodeLengthOrder[i]], 3);
+    }
+    for (const auto & rle : rleSymbols)
+    {
+        writer.write(codeLengthCodes[rle.symbol], codeLengthLengths[rle.symbol]);
+        if (rle.symbol == 16) {
+            writer.write(rle.extra, 2);
+        }
+        else if (rle.symbol == 17) {
+            writer.write(rle.extra, 3);
+        }
+        else if (rle.symbol == 18) {
+            writer.write(rle.extra, 7);
+        }
+    }
+
+    // Block data
+    for (const auto & token : tokens)
+    {
+        if (token.dist == 0)
+        {
+            writer.write(litLenCodes[token.litLen], pLitLenLengths[token.litLen]);
+            continue;
+        }
+
+        const auto lengthCode = tables.lengthCode[token.litLen];
+        writer.write(litLenCodes[257 + lengthCode], pLitLenLengths[257 + lengthCode]);
+        writer.write(token.litLen - LengthBase[lengthCode], LengthExtraBits[lengthCode]);
+
+        const auto distCode = tables.getDistCode(token.dist);
+        writer.write(distCodes[distCode], pDistLengths[distCode]);
+        writer.write(token.dist - DistBase[distCode], DistExtraBits[distCode]);
+    }
+    writer.write(litLenCodes[EndOfBlock], pLitLenLengths[EndOfBlock]);
+}
+
+struct LZ77Params
+{
+    size_t maxChainLength; // Number of previous occurences of a hash examined to find a match
+    size_t niceLength; // Stop searching when a match is at least that long
+    size_t maxInsertLength; // Longer matches only insert their first position in the hash chains
+};
+
+LZ77Params getLZ77Params(int level)
+{
+    static const LZ77Params params[10] = {
+        { 0, 0, 0 },
+        { 4, 16, 8 },
+        { 8, 32, 16 },
+        { 16, 64, 32 },
+        { 32, 128, MaxMatchLength },
+        { 64, 128, MaxMatchLength },
+        { 128, MaxMatchLength, MaxMatchLength },
+        { 256, MaxMatchLength, MaxMatchLength },
+        { 1024, MaxMatchLength, MaxMatchLength },
+        { 4096, MaxMatchLength, MaxMatchLength },
+    };
+    return params[std::max(0, std::min(level, 9))];
+}
+
+// Compress pData[begin, end), using pData[windowBegin, begin) as a preset dictionary since it precedes the band in the stream.
+// The last band ends the stream, the others end with an empty stored block to realign on a byte boundary (a sync flush in zlib terms).
+void deflateBand(const uint8_t * pData, size_t windowBegin, size_t begin, size_t end, int level, bool isLastBand, std::vector<uint8_t>& output)
+{
+    const size_t HashBits = 15;
+    const size_t MaxBlockTokenCount = 16384;
+    const auto params = getLZ77Params(level);
+
+    std::vector<int32_t> head(params.maxChainLength ? size_t(1) << HashBits : 0, -1);
+    std::vector<int32_t> previous(params.maxChainLength ? end - windowBegin : 0);
+
+    const auto hash = [&](size_t position)
+    {
+        const uint32_t value = pData[position] | (pData[position + 1] << 8) | (pData[position + 2] << 16);
+        return (value * 2654435761u) >> (32 - HashBits);
+    };
+    const auto insert = [&](size_t position)
+    {
+        if (position + MinMatchLength <= end)
+        {
+            const auto h = hash(position);
+            previous[position - windowBegin] = head[h];
+            head[h] = int32_t(position - windowBegin);
+        }
+    };
+    const auto matchLength = [&](const uint8_t * p1, const uint8_t * p2, size_t maxLength)
+    {
+        size_t length = 0;
+        for (uint64_t a, b; length + 8 <= maxLength; length += 8)
+        {
+            std::memcpy(&a, p1 + length, 8);
+            std::memcpy(&b, p2 + length, 8);
+            if (a != b) {
+                break;
+            }
+        }
+        while (length < maxLength && p1[length] == p2[length]) {
+            ++length;
+        }
+        return length;
+    };
+
+    if (params.maxChainLength)
+    {
+        for (size_t position = windowBegin; position < begin; ++position) {
+            insert(position);
+        }
+    }
+
+    BitWriter writer(output);
+    std::vector<Token> tokens;
+    tokens.reserve(MaxBlockTokenCount);
+
+    for (size_t position = begin; position < end; )
+    {
+        size_t bestLength = 0, bestDistance = 0;
+        const auto maxLength = std::min(MaxMatchLength, end - position);
+
+        if (params.maxChainLength && maxLength >= MinMatchLength)
+        {
+            const auto niceLength = std::min(params.niceLength, maxLength);
+            bestLength = MinMatchLength - 1;
+
+            auto candidate = head[hash(position)];
+            for (size_t chain = 0; candidate >= 0 && chain < params.maxChainLength; ++chain, candidate = previous[candidate])
+            {
+                const auto candidatePosition = windowBegin + candidate;
+                const auto distance = position - candidatePosition;
+                if (distance > WindowSize) {
+                    break;
+                }
+                if (pData[candidatePosition + bestLength] != pData[position + bestLength]) {
+                    continue; // Can't be longer than the current best
+                }
+                const auto length = matchLength(pData + candidatePosition, pData + position, maxLength);
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = distance;
+                    if (length >= niceLength) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (bestDistance)
+        {
+            tokens.push_back({ uint16_t(bestLength), uint16_t(bestDistance) });
+            const auto insertEnd = position + (bestLength <= params.maxInsertLength ? bestLength : 1);
+            for (auto p = position; p < insertEnd; ++p) {
+                insert(p);
+            }
+            position += bestLength;
+        }
+        else
+        {
+            tokens.push_back({ pData[position], 0 });
+            if (params.maxChainLength) {
+                insert(position);
+            }
+            ++position;
+        }
+
+        if (tokens.size() == MaxBlockTokenCount || position == end)
+        {
+            writeDynamicBlock(writer, tokens, isLastBand && position == end);
+            tokens.clear();
+        }
+    }
+
+    if (!isLastBand)
+    {
+        writer.write(0, 3); // BFINAL = 0, BTYPE = 0 (stored)
+        writer.alignToByte();
+        const uint8_t emptyStoredBlock[] = { 0x00, 0x00, 0xFF, 0xFF }; // LEN = 0, NLEN = ~0
+        output.insert(output.end(), emptyStoredBlock, emptyStoredBlock + 4);
+    }
+    else {
+        writer.alignToByte();
+    }
+}
+
+// PNG filtering (PNG specification, section 9)
+
+uint8_t paethPredictor(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return uint8_t(a);
+    }
+    return uint8_t(pb <= pc ? b : c);
+}
+
+// Filter one row into pOutput[0] (filter type) and pOutput[1, rowSize].
+// The filter is chosen with the minimum sum of absolute differences heuristic recommended by the specification,
+// all five candidates being evaluated in a single pass over the row.
+void filterRow(const uint8_t * pRow, const uint8_t * pPreviousRow, size_t rowSize, size_t bytesPerPixel, uint8_t * pOutput)
+{
+    const auto absSigned = [](unsigned value) { const auto v = int8_t(uint8_t(value)); return unsigned(v < 0 ? -v : v); };
+
+    unsigned sums[5] = { 0 };
+    for (size_t i = 0; i < rowSize; ++i)
+    {
+        const unsigned x = pRow[i];
+        const unsigned a = i >= bytesPerPixel ? pRow[i - bytesPerPixel] : 0;
+        const unsigned b = pPreviousRow[i];
+        const unsigned c = i >= bytesPerPixel ? pPreviousRow[i - bytesPerPixel] : 0;
+        sums[0] += absSigned(x);
+        sums[1] += absSigned(x - a);
+        sums[2] += absSigned(x - b);
+        sums[3] += absSigned(x - ((a + b) >> 1));
+        sums[4] += absSigned(x - paethPredictor(a, b, c));
+    }
+
+    const auto filter = uint8_t(std::min_element(sums, sums + 5) - sums);
+    pOutput[0] = filter;
+    ++pOutput;
+
+    for (size_t i = 0; i < rowSize; ++i)
+    {
+        const unsigned x = pRow[i];
+        const unsigned a = i >= bytesPerPixel ? pRow[i - bytesPerPixel] : 0;
+        const unsigned b = pPreviousRow[i];
+        const unsigned c = i >= bytesPerPixel ? pPreviousRow[i - bytesPerPixel] : 0;
+        switch (filter)
+        {
+        case 0: pOutput[i] = uint8_t(x); break;
+        case 1: pOutput[i] = uint8_t(x - a); break;
+        case 2: pOutput[i] = uint8_t(x - b); break;
+        case 3: pOutput[i] = uint8_t(x - ((a + b) >> 1)); break;
+        default: pOutput[i] = uint8_t(x - paethPredictor(a, b, c)); break;
+        }
+    }
+}
+
+void appendBigEndian(std::vector<uint8_t>& output, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        output.push_back(uint8_t(value >> shift));
+    }
+}
+
+// Append a complete chunk (length, type, data, CRC)
+void appendChunk(std::vector<uint8_t>& output, const char * type, const uint8_t * pData, size_t size)
+{
+    appendBigEndian(output, uint32_t(size));
+    const auto typeOffset = output.size();
+    output.insert(output.end(), type, type + 4);
+    output.insert(output.end(), pData, pData + size);
+    appendBigEndian(output, updateCRC(0, output.data() + typeOffset, size + 4));
+}
+
+}
+
+std::vector<unsigned char> encodePNGParallel(size_t width, size_t height, size_t componentCount, const unsigned char * pData,
+    const PNGEncodeOptions& options)
+{
+    GLMLV_PROFILE_FUNCTION();
+    if (width == 0 || height == 0 || componentCount < 1 || componentCount > 4)
+    {
+        std::cerr << "encodePNGParallel: invalid image size or component count" << std::endl;
+        throw std::runtime_error("encodePNGParallel: invalid image size or component count");
+    }
+
+    auto & threadPool = options.pThreadPool ? *options.pThreadPool : ThreadPool::getDefault();
+
+    const size_t rowSize = width * componentCount;
+    const size_t filteredRowSize = rowSize + 1; // Filter type byte + filtered row
+
+    size_t bandHeight = options.bandHeight;
+    if (bandHeight == 0)
+    {
+        // A few bands per thread for load balancing, but big enough for the 32KB dictionary overhead to stay small
+        const size_t bandCount = (threadPool.threadCount() + 1) * 4;
+        bandHeight = std::max((height + bandCount - 1) / bandCount, (size_t(256) * 1024 + filteredRowSize - 1) / filteredRowSize);
+    }
+    bandHeight = std::max(size_t(1), std::min(bandHeight, (size_t(1) << 30) / filteredRowSize)); // Chunk length is limited to 2^31 - 1
+    const size_t bandCount = (height + bandHeight - 1) / bandHeight;
+
+    // Filtering: each row only depends on the unfiltered previous row
+    std::vector<uint8_t> filtered(height * filteredRowSize);
+    const std::vector<uint8_t> zeroRow(rowSize, 0);
+    threadPool.parallelFor(bandCount, [&](size_t band)
+    {
+        for (size_t y = band * bandHeight, yEnd = std::min(height, y + bandHeight); y < yEnd; ++y)
+        {
+            const auto pRow = pData + y * rowSize;
+            filterRow(pRow, y > 0 ? pRow - rowSize : zeroRow.data(), rowSize, componentCount, filtered.data() + y * filteredRowSize);
+        }
+    });
+
+    // Compression: one IDAT chunk per band, the first one starting with the zlib header
+    const int level = std::max(0, std::min(options.compressionLevel, 9));
+    std::vector<std::vector<uint8_t>> bandChunks(bandCount);
+    std::vector<uint32_t> bandAdlers(bandCount);
+    threadPool.parallelFor(bandCount, [&](size_t band)
+    {
+        const size_t begin = band * bandHeight * filteredRowSize;
+        const size_t end = std::min(filtered.size(), begin + bandHeight * filteredRowSize);
+        const size_t windowBegin = begin - std::min(begin, WindowSize);
+
+        std::vector<uint8_t> compressed;
+        compressed.reserve((end - begin) / 2);
+        if (band == 0)
+        {
+            // CMF: deflate with a 32KB window, FLG: compression level hint, FCHECK makes CMF * 256 + FLG a multiple of 31
+            compressed.push_back(0x78);
+            compressed.push_back(level <= 1 ? 0x01 : (level <= 5 ? 0x5E : (level <= 6 ? 0x9C : 0xDA)));
+        }
+        deflateBand(filtered.data(), windowBegin, begin, end, level, band + 1 == bandCount, compressed);
+
+        appendChunk(bandChunks[band], "IDAT", compressed.data(), compressed.size());
+        bandAdlers[band] = computeAdler32(filtered.data() + begin, end - begin);
+    });
+
+    uint32_t adler = bandAdlers[0];
+    for (size_t band = 1; band < bandCount; ++band)
+    {
+        const size_t begin = band * bandHeight * filteredRowSize;
+        const size_t end = std::min(filtered.size(), begin + bandHeight * filteredRowSize);
+        adler = combineAdler32(adler, bandAdlers[band], end - begin);
+    }
+
+    std::vector<unsigned char> png;
+    size_t totalSize = 8 + 25 + 16 + 12;
+    for (const auto & chunk : bandChunks) {
+        totalSize += chunk.size();
+    }
+    png.reserve(totalSize);
+
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    png.insert(png.end(), signature, signature + 8);
+
+    static const uint8_t colorTypes[] = { 0, 4, 2, 6 }; // Grey, grey + alpha, RGB, RGBA
+    std::vector<uint8_t> header;
+    appendBigEndian(header, uint32_t(width));
+    appendBigEndian(header, uint32_t(height));
+    const uint8_t headerEnd[] = { 8, colorTypes[componentCount - 1], 0, 0, 0 }; // Bit depth, color type, compression, filter, interlace
+    header.insert(header.end(), headerEnd, headerEnd + 5);
+    appendChunk(png, "IHDR", header.data(), header.size());
+
+    for (const auto & chunk : bandChunks) {
+        png.insert(png.end(), begin(chunk), end(chunk));
+    }
+
+    // The zlib stream ends with the Adler-32 of the whole filtered image, known only once every band is done
+    std::vector<uint8_t> adlerBytes;
+    appendBigEndian(adlerBytes, adler);
+    appendChunk(png, "IDAT", adlerBytes.data(), adlerBytes.size());
+
+    appendChunk(png, "IEND", nullptr, 0);
+
+    return png;
+}
+
+void writePNGParallel(const fs::path& path, size_t width, size_t height, size_t componentCount, const unsigned char * pData,
+    const PNGEncodeOptions& options)
+{
+    const auto png = encodePNGParallel(width, height, componentCount, pData, options);
+
+    std::ofstream file(path.string(), std::ios::binary);
+    if (!file.write((const char *) png.data(), png.size()))
+    {
+        std::cerr << "Unable to write image " << path << std::endl;
+        throw std::runtime_error("Unable to write image");
+    }
+}
+
+}
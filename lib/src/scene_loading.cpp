@@ -1,4 +1,5 @@
 #include <glmlv/scene_loading.hpp>
+#include <glmlv/CPUProfiler.hpp>
 
 #include <cstdio>
 #include <fstream>
@@ -22,6 +23,51 @@
 namespace glmlv
 {
 
+// Print the memory used by the textures loaded from textureIdOffset, compared to their size at full resolution and as RGBA8 images
+static void logTextureMemory(const SceneData & data, size_t textureIdOffset, size_t fullResolutionByteSize)
+{
+    size_t byteSize = 0;
+    size_t rgbaByteSize = 0;
+    for (auto i = textureIdOffset; i < data.textures.size(); ++i)
+    {
+        byteSize += data.textures[i].byteSize();
+        rgbaByteSize += data.textures[i].size() * Image2DRGBA::NumComponents;
+    }
+    std::clog << "Loaded " << data.textures.size() - textureIdOffset << " textures: " << byteSize / (1024. * 1024.) << " MB ("
+        << fullResolutionByteSize / (1024. * 1024.) << " MB at full resolution, " << rgbaByteSize / (1024. * 1024.) << " MB as RGBA8)" << std::endl;
+}
+
+// Append the images of paths to data.textures, flipped for OpenGL and downsampled to fit in the limits of options.
+// The sizes are planned from the image headers so that the memory budget is shared by all images before any of them is decoded.
+static void loadSceneTextures(const std::vector<fs::path> & paths, const TextureLoadOptions & options, SceneData & data)
+{
+    GLMLV_PROFILE_FUNCTION();
+    std::vector<ImageInfo> infos(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        readImageInfo(paths[i], infos[i]);
+    }
+    const auto sizes = computeBudgetedImageSizes(infos, options);
+
+    const auto textureIdOffset = data.textures.size();
+    size_t fullResolutionByteSize = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        std::clog << "Loading image " << paths[i] << std::endl;
+        auto image = readAnyImage(paths[i]);
+        fullResolutionByteSize += image.byteSize();
+
+        if (sizes[i].width < image.width() || sizes[i].height < image.height())
+        {
+            std::clog << "    downsampled from " << image.width() << "x" << image.height() << " to " << sizes[i].width << "x" << sizes[i].height << std::endl;
+            image = downsampleImage(image, sizes[i].width, sizes[i].height);
+        }
+
+        image.flipY();
+        data.textures.emplace_back(std::move(image));
+    }
+    logTextureMemory(data, textureIdOffset, fullResolutionByteSize);
+}
+
 #ifdef GLMLV_USE_ASSIMP
 glm::mat4 aiMatrixToGlmMatrix(const aiMatrix4x4 & mat)
 {
@@ -35,8 +81,9 @@ glm::mat4 aiMatrixToGlmMatrix(const aiMatrix4x4 & mat)
 	);
 }
 
-void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures)
+void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures, const TextureLoadOptions & textureOptions)
 {
+	GLMLV_PROFILE_FUNCTION();
 	Assimp::Importer importer;
 	const aiScene *scene = importer.ReadFile(objPath.string().c_str(), aiProcess_Triangulate);
 
@@ -85,6 +132,8 @@ void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, Scen
 			data.indexCountPerShape.emplace_back(indexCount);
 			data.localToWorldMatrixPerShape.emplace_back(aiMatrixToGlmMatrix(localToWorldMatrix));
 			data.indexBuffer.reserve(data.indexBuffer.size() + indexCount);
+			auto shapeBBoxMin = glm::vec3(std::numeric_limits<float>::max());
+			auto shapeBBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
 			for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 			{
 				aiFace face = mesh->mFaces[i];
@@ -93,10 +142,14 @@ void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, Scen
 				{
 					const auto index = uint32_t(indexOffset + face.mIndices[j]);
 					data.indexBuffer.emplace_back(index);
-					data.bboxMin = glm::min(data.bboxMin, data.vertexBuffer[index].position);
-					data.bboxMax = glm::max(data.bboxMax, data.vertexBuffer[index].position);
+					shapeBBoxMin = glm::min(shapeBBoxMin, data.vertexBuffer[index].position);
+					shapeBBoxMax = glm::max(shapeBBoxMax, data.vertexBuffer[index].position);
 				}
 			}
+			data.bboxMin = glm::min(data.bboxMin, shapeBBoxMin);
+			data.bboxMax = glm::max(data.bboxMax, shapeBBoxMax);
+			data.bboxMinPerShape.emplace_back(shapeBBoxMin);
+			data.bboxMaxPerShape.emplace_back(shapeBBoxMax);
 
 			data.materialIDPerShape.emplace_back(mesh->mMaterialIndex >= 0 ? int(materialIdOffset + mesh->mMaterialIndex) : -1);
 
@@ -135,21 +188,21 @@ void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, Scen
 
 	if (loadTextures)
 	{
-		for (const auto & keyVal : textureIds)
+		std::vector<fs::path> texturePaths;
+		for (auto & keyVal : textureIds)
 		{
 			const auto completePath = mtlBaseDir / keyVal.first;
 			if (fs::exists(completePath))
 			{
-				std::clog << "Loading image " << completePath << std::endl;
-				textureIds[keyVal.first] = int32_t(data.textures.size());
-				data.textures.emplace_back(readImage(completePath));
-				data.textures.back().flipY();
+				keyVal.second = int32_t(data.textures.size() + texturePaths.size());
+				texturePaths.emplace_back(completePath);
 			}
 			else
 			{
 				std::clog << "'Warning: image " << completePath << " not found" << std::endl;
 			}
 		}
+		loadSceneTextures(texturePaths, textureOptions, data);
 	}
 
 	// Materials
@@ -261,8 +314,9 @@ struct TinyObjLoaderEqualTo
 
 // Load an obj model with tinyobjloader
 // Obj models might use different set of indices per vertex. The default rendering mechanism of OpenGL does not support this feature to this functions duplicate attributes with different indices.
-void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures)
+void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures, const TextureLoadOptions & textureOptions)
 {
+    GLMLV_PROFILE_FUNCTION();
     // Load obj
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -317,6 +371,17 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
         }
         data.indexCountPerShape.emplace_back(mesh.indices.size());
 
+        // Vertices are shared between shapes, the bounding box of the shape is computed on its own indices
+        auto shapeBBoxMin = glm::vec3(std::numeric_limits<float>::max());
+        auto shapeBBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
+        for (auto i = data.indexBuffer.size() - mesh.indices.size(); i < data.indexBuffer.size(); ++i)
+        {
+            shapeBBoxMin = glm::min(shapeBBoxMin, data.vertexBuffer[data.indexBuffer[i]].position);
+            shapeBBoxMax = glm::max(shapeBBoxMax, data.vertexBuffer[data.indexBuffer[i]].position);
+        }
+        data.bboxMinPerShape.emplace_back(shapeBBoxMin);
+        data.bboxMaxPerShape.emplace_back(shapeBBoxMax);
+
         const int32_t localMaterialID = mesh.material_ids.empty() ? -1 : mesh.material_ids[0];
         const int32_t materialID = localMaterialID >= 0 ? materialIdOffset + localMaterialID : -1;
 
@@ -339,6 +404,7 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
     if (loadTextures)
     {
         const auto textureIdOffset = data.textures.size();
+        std::vector<fs::path> existingTexturePaths;
         for (const auto & texturePath : texturePaths)
         {
             if (!texturePath.empty())
@@ -348,12 +414,9 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
                 const auto completePath = mtlBaseDir / newTexturePath;
                 if (fs::exists(completePath))
                 {
-                    std::clog << "Loading image " << completePath << std::endl;
-                    data.textures.emplace_back(readImage(completePath));
-                    data.textures.back().flipY();
-
                     const auto localTexId = textureIdMap.size();
                     textureIdMap[texturePath] = textureIdOffset + localTexId;
+                    existingTexturePaths.emplace_back(completePath);
                 }
                 else
                 {
@@ -361,6 +424,7 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
                 }
             }
         }
+        loadSceneTextures(existingTexturePaths, textureOptions, data);
     }
 
     for (const auto & material : materials)
@@ -0,0 +1,62 @@
+#include <glmlv/OcclusionRasterizer.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <vector>
+
+// Headless checks of glmlv::OcclusionRasterizer, no OpenGL context needed. The camera is at the origin looking down -z.
+
+static int failureCount = 0;
+
+static void check(bool condition, const char * description)
+{
+    std::cout << (condition ? "passed: " : "FAILED: ") << description << std::endl;
+    if (!condition) {
+        ++failureCount;
+    }
+}
+
+// Quad given counter-clockwise as seen from its front side
+static void addQuad(glmlv::OcclusionRasterizer & rasterizer, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3)
+{
+    std::vector<glmlv::Vertex3f3f2f> vertices(4);
+    vertices[0].position = p0;
+    vertices[1].position = p1;
+    vertices[2].position = p2;
+    vertices[3].position = p3;
+    const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+    rasterizer.addOccluder(vertices, indices, 6, glm::mat4(1));
+}
+
+int main()
+{
+    const auto projMatrix = glm::perspective(1.2f, 320.f / 192.f, 0.1f, 100.f);
+
+    {
+        // Wall facing the camera
+        glmlv::OcclusionRasterizer rasterizer(320, 192);
+        addQuad(rasterizer, glm::vec3(-5, -5, -10), glm::vec3(5, -5, -10), glm::vec3(5, 5, -10), glm::vec3(-5, 5, -10));
+        rasterizer.render(projMatrix);
+
+        check(!rasterizer.isVisible(glm::vec3(-1, -1, -20), glm::vec3(1, 1, -15)), "box behind a quad occluder is culled");
+        check(rasterizer.isVisible(glm::vec3(-1, -1, -8), glm::vec3(1, 1, -6)), "box in front of a quad occluder is visible");
+    }
+
+    {
+        // Floor extending behind the camera: its triangles cross the near plane
+        glmlv::OcclusionRasterizer rasterizer(320, 192);
+        addQuad(rasterizer, glm::vec3(-50, -1, 50), glm::vec3(50, -1, 50), glm::vec3(50, -1, -50), glm::vec3(-50, -1, -50));
+        rasterizer.render(projMatrix);
+
+        check(rasterizer.lastRenderStats().rasterizedTriangleCount > 0, "triangles crossing the near plane are clipped, not rejected");
+        check(!rasterizer.isVisible(glm::vec3(-1, -3, -10), glm::vec3(1, -2, -9)), "box under a floor crossing the near plane is culled");
+        check(rasterizer.isVisible(glm::vec3(-1, 0, -10), glm::vec3(1, 1, -9)), "box above a floor crossing the near plane is visible");
+        check(rasterizer.isVisible(glm::vec3(-0.5f, -0.5f, -1), glm::vec3(0.5f, 0.5f, -0.5f)), "box above the clipped floor near the camera is visible");
+    }
+
+    if (failureCount) {
+        std::cerr << failureCount << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}